@@ -30,7 +30,8 @@ let package = Package(
                 "GRDB",
                 "TrackerRadarKit",
                 .product(name: "Punnycode", package: "Punycode"),
-                "BloomFilterWrapper"
+                "BloomFilterWrapper",
+                "ScriptTemplate"
             ],
             resources: [
                 .process("ContentBlocking/UserScripts/contentblockerrules.js"),
@@ -43,6 +44,16 @@ let package = Package(
             ]),
         .target(
             name: "BloomFilter",
+            exclude: [
+                "fuzz",
+                "tests",
+                "tools"
+            ],
+            resources: [
+                .process("CMakeLists.txt")
+            ]),
+        .target(
+            name: "ScriptTemplate",
             resources: [
                 .process("CMakeLists.txt")
             ]),
@@ -55,5 +66,6 @@ let package = Package(
                 .process("UserScript/testUserScript.js"),
                 .copy("Resources")
             ])
-    ]
+    ],
+    cxxLanguageStandard: .cxx1z
 )
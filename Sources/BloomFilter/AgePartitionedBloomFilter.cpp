@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdexcept>
+#include "AgePartitionedBloomFilter.hpp"
+#include "Hash64.hpp"
+#include "HostKey.hpp"
+
+using namespace std;
+
+// Marks a generation that is being recycled, nothing in it is reported
+static const int64_t EXPIRED = INT64_MIN;
+
+// Implementation
+
+AgePartitionedBloomFilter::AgePartitionedBloomFilter(size_t capacity, double errorRate, Clock::duration ttl,
+                                                     size_t generationCount)
+    : ttl(ttl), newest(0) {
+    if (capacity == 0 || !(errorRate > 0 && errorRate < 1) || ttl <= Clock::duration::zero() || generationCount < 2) {
+        throw runtime_error("Invalid filter parameters");
+    }
+    // Any `ttl` spans the keys of generationCount - 1 closed generations and the
+    // open one, and a lookup may match in each of them
+    generationSpan = ttl / (Clock::rep) (generationCount - 1);
+    generationCapacity = (capacity + generationCount - 2) / (generationCount - 1);
+    double generationErrorRate = errorRate / (double) generationCount;
+    for (size_t i = 0; i < generationCount; i++) {
+        generations.push_back(unique_ptr<Generation>(new Generation {
+            BlockedBloomFilter(generationCapacity, generationErrorRate), { EXPIRED }, Clock::time_point(), 0
+        }));
+    }
+}
+
+void AgePartitionedBloomFilter::add(string_view key, Clock::time_point now) {
+    addHash(hash64(key.data(), key.size()), now);
+}
+
+void AgePartitionedBloomFilter::add(const HostKey &key, Clock::time_point now) {
+    addHash(key.hash(), now);
+}
+
+void AgePartitionedBloomFilter::addHash(uint64_t hash, Clock::time_point now) {
+    lock_guard<mutex> lock(addMutex);
+    Generation *generation = generations[newest].get();
+    bool isPresent = generation->itemCount > 0 && generation->filter.contains(hash);
+    if (!isPresent && generation->itemCount > 0
+        && (generation->itemCount >= generationCapacity || now - generation->openedAt >= generationSpan)) {
+        newest = (newest + 1) % generations.size();
+        generation = generations[newest].get();
+        // Hidden from lookups before its bits are cleared
+        generation->expiry.store(EXPIRED, memory_order_release);
+        generation->filter.clear();
+        generation->itemCount = 0;
+    }
+    if (generation->itemCount == 0) {
+        generation->openedAt = now;
+    }
+    if (!isPresent) {
+        generation->filter.add(hash);
+        generation->itemCount++;
+    }
+    // Published after the bits, see containsHash
+    generation->expiry.store(nanoseconds(now + ttl), memory_order_release);
+}
+
+bool AgePartitionedBloomFilter::contains(string_view key, Clock::time_point now) const {
+    return containsHash(hash64(key.data(), key.size()), now);
+}
+
+bool AgePartitionedBloomFilter::contains(const HostKey &key, Clock::time_point now) const {
+    return containsHash(key.hash(), now);
+}
+
+bool AgePartitionedBloomFilter::containsHash(uint64_t hash, Clock::time_point now) const {
+    int64_t time = nanoseconds(now);
+    for (const auto &generation : generations) {
+        if (time < generation->expiry.load(memory_order_acquire) && generation->filter.contains(hash)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t AgePartitionedBloomFilter::getGenerationCount() const {
+    return generations.size();
+}
+
+AgePartitionedBloomFilter::Clock::duration AgePartitionedBloomFilter::getTTL() const {
+    return ttl;
+}
+
+size_t AgePartitionedBloomFilter::byteCount() const {
+    size_t bytes = 0;
+    for (const auto &generation : generations) {
+        bytes += generation->filter.byteCount();
+    }
+    return bytes;
+}
+
+int64_t AgePartitionedBloomFilter::nanoseconds(Clock::time_point time) {
+    return (int64_t) chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+}
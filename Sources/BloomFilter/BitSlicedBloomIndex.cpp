@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "BitSlicedBloomIndex.hpp"
+#include "BloomFilter.hpp"
+#include "Hash64.hpp"
+#include "HostKey.hpp"
+
+using namespace std;
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Words are stored little endian");
+
+static const char MAGIC[8] = { 'D', 'D', 'G', 'B', 'S', 'I', 'D', 'X' };
+static const size_t HEADER_SIZE = 32;
+static const uint64_t STEP_SEED = 0x94d049bb133111ebull;
+
+// Forward declarations
+
+struct ProbeSequence {
+    uint64_t hash;
+    uint64_t step;
+};
+
+static ProbeSequence probeSequenceFor(uint64_t hash);
+
+static uint64_t slotFor(uint64_t hash, uint64_t slotCount);
+
+static uint32_t wordBytesFor(size_t listCount);
+
+
+// Implementation
+
+BitSlicedBloomIndex::BitSlicedBloomIndex(size_t listCount, size_t maxItemsPerList, double targetProbability) {
+    if (listCount == 0 || listCount > MAX_LISTS || maxItemsPerList == 0 || !(targetProbability > 0 && targetProbability < 1)) {
+        throw runtime_error("Invalid index parameters");
+    }
+    // Same sizing as BloomFilter, per list
+    auto slots = (uint64_t) ceil((maxItemsPerList * log(targetProbability)) / log(1.0 / (pow(2.0, log(2.0)))));
+    auto rounds = (uint64_t) max(1.0, round(log(2.0) * slots / maxItemsPerList));
+    uint32_t width = wordBytesFor(listCount);
+    if (rounds > BloomFilter::MAX_HASH_ROUNDS || slots > (SIZE_MAX - HEADER_SIZE) / width) {
+        throw runtime_error("Invalid index parameters");
+    }
+
+    storage.assign(HEADER_SIZE + slots * width, 0);
+    memcpy(storage.data(), MAGIC, sizeof(MAGIC));
+    uint32_t version = CURRENT_VERSION;
+    auto listCount32 = (uint32_t) listCount;
+    auto rounds32 = (uint32_t) rounds;
+    memcpy(&storage[8], &version, sizeof(version));
+    memcpy(&storage[12], &listCount32, sizeof(listCount32));
+    memcpy(&storage[16], &rounds32, sizeof(rounds32));
+    memcpy(&storage[24], &slots, sizeof(slots));
+    attach();
+}
+
+BitSlicedBloomIndex::BitSlicedBloomIndex(vector<char> data) : storage(move(data)) {
+    attach();
+}
+
+BitSlicedBloomIndex BitSlicedBloomIndex::readFromFile(const string &path) {
+    ifstream in(path, ifstream::binary);
+    if (!in) {
+        throw runtime_error("Can't read " + path);
+    }
+    return BitSlicedBloomIndex(vector<char>((istreambuf_iterator<char>(in)), istreambuf_iterator<char>()));
+}
+
+void BitSlicedBloomIndex::attach() {
+    if (storage.size() < HEADER_SIZE || memcmp(storage.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw runtime_error("Not a bit sliced index");
+    }
+    uint32_t version;
+    memcpy(&version, &storage[8], sizeof(version));
+    memcpy(&listCount, &storage[12], sizeof(listCount));
+    memcpy(&hashRounds, &storage[16], sizeof(hashRounds));
+    memcpy(&slotCount, &storage[24], sizeof(slotCount));
+    if (version != CURRENT_VERSION) {
+        throw runtime_error("Unsupported bit sliced index version");
+    }
+    if (listCount == 0 || listCount > MAX_LISTS || hashRounds == 0 || hashRounds > BloomFilter::MAX_HASH_ROUNDS || slotCount == 0) {
+        throw runtime_error("Malformed bit sliced index");
+    }
+    wordBytes = wordBytesFor(listCount);
+    if (slotCount != (storage.size() - HEADER_SIZE) / wordBytes || (storage.size() - HEADER_SIZE) % wordBytes != 0) {
+        throw runtime_error("Malformed bit sliced index");
+    }
+    words = storage.data() + HEADER_SIZE;
+    allLists = listCount == 64 ? UINT64_MAX : (1ull << listCount) - 1;
+}
+
+void BitSlicedBloomIndex::add(size_t list, string_view key) {
+    if (list >= listCount) {
+        throw runtime_error("No list " + to_string(list));
+    }
+    ProbeSequence sequence = probeSequenceFor(hash64(key.data(), key.size()));
+    uint64_t bit = 1ull << list;
+    for (uint32_t i = 0; i < hashRounds; i++) {
+        char *word = words + slotFor(sequence.hash, slotCount) * wordBytes;
+        uint64_t value = 0;
+        memcpy(&value, word, wordBytes);
+        value |= bit;
+        memcpy(word, &value, wordBytes);
+        sequence.hash += sequence.step;
+    }
+}
+
+uint64_t BitSlicedBloomIndex::query(string_view key) const {
+    return queryHashed(hash64(key.data(), key.size()));
+}
+
+uint64_t BitSlicedBloomIndex::query(const HostKey &key, size_t label) const {
+    return queryHashed(key.hash(label));
+}
+
+uint64_t BitSlicedBloomIndex::queryHashed(uint64_t hash) const {
+    ProbeSequence sequence = probeSequenceFor(hash);
+    uint64_t mask = allLists;
+    for (uint32_t i = 0; i < hashRounds && mask != 0; i++) {
+        mask &= wordAt(slotFor(sequence.hash, slotCount));
+        sequence.hash += sequence.step;
+    }
+    return mask;
+}
+
+uint64_t BitSlicedBloomIndex::queryAnySuffix(string_view host) const {
+    uint64_t mask = 0;
+    string_view domain = host;
+    while (!domain.empty()) {
+        mask |= query(domain);
+        size_t dot = domain.find('.');
+        if (dot == string_view::npos) {
+            break;
+        }
+        domain.remove_prefix(dot + 1);
+    }
+    return mask;
+}
+
+uint64_t BitSlicedBloomIndex::queryAnySuffix(const HostKey &key) const {
+    uint64_t mask = 0;
+    for (size_t label = 0; label < key.labelCount(); label++) {
+        mask |= queryHashed(key.hash(label));
+    }
+    return mask;
+}
+
+uint64_t BitSlicedBloomIndex::wordAt(uint64_t slot) const {
+    const char *word = words + slot * wordBytes;
+    // A switch on the fixed width keeps each load a single instruction
+    switch (wordBytes) {
+        case 1:
+            return (uint8_t) *word;
+        case 2: {
+            uint16_t value;
+            memcpy(&value, word, sizeof(value));
+            return value;
+        }
+        case 4: {
+            uint32_t value;
+            memcpy(&value, word, sizeof(value));
+            return value;
+        }
+        default: {
+            uint64_t value;
+            memcpy(&value, word, sizeof(value));
+            return value;
+        }
+    }
+}
+
+size_t BitSlicedBloomIndex::getListCount() const {
+    return listCount;
+}
+
+size_t BitSlicedBloomIndex::getSlotCount() const {
+    return slotCount;
+}
+
+size_t BitSlicedBloomIndex::getHashRounds() const {
+    return hashRounds;
+}
+
+const char *BitSlicedBloomIndex::data() const {
+    return storage.data();
+}
+
+size_t BitSlicedBloomIndex::dataLength() const {
+    return storage.size();
+}
+
+void BitSlicedBloomIndex::writeToFile(const string &path) const {
+    ofstream out(path, ofstream::binary);
+    out.write(storage.data(), (streamsize) storage.size());
+    if (!out) {
+        throw runtime_error("Can't write " + path);
+    }
+}
+
+// Kirsch-Mitzenmacher double hashing over 64 bits, one hash64 per key
+static ProbeSequence probeSequenceFor(uint64_t hash) {
+    return ProbeSequence { hash, hash64Remix(hash, STEP_SEED) | 1 };
+}
+
+static uint64_t slotFor(uint64_t hash, uint64_t slotCount) {
+    return (uint64_t) (((__uint128_t) hash * slotCount) >> 64);
+}
+
+static uint32_t wordBytesFor(size_t listCount) {
+    if (listCount <= 8) {
+        return 1;
+    }
+    if (listCount <= 16) {
+        return 2;
+    }
+    return listCount <= 32 ? 4 : 8;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include "BlockedBloomFilter.hpp"
+#include "Hash64.hpp"
+
+using namespace std;
+
+static const size_t BLOCK_ALIGNMENT = 64;
+// Separates the in-block positions from the block index, both come from one hash
+static const uint64_t POSITION_SEED = 0x9e3779b97f4a7c15ull;
+// Nine bits pick a bit in a block, so one 64-bit hash gives seven positions
+static const size_t POSITIONS_PER_HASH = 7;
+// Block counts are picked with 32-bit multiply-shift reduction
+static const size_t MAX_BLOCK_COUNT = (size_t) 1 << 32;
+// Growth of the block count per step while sizing for a rate
+static const double SIZING_STEP = 1.02;
+
+// Forward declarations
+
+static size_t blockIndex(uint64_t hash, size_t blockCount);
+
+static void blockMasks(uint64_t hash, size_t hashRounds, uint64_t *masks);
+
+
+// Implementation
+
+BlockedBloomFilter::BlockedBloomFilter(size_t maxItems, double targetProbability)
+    : BlockedBloomFilter(shapeFor(maxItems, targetProbability)) {
+}
+
+BlockedBloomFilter::BlockedBloomFilter(Shape shape)
+    : blockCount(shape.blockCount),
+      hashRounds(shape.hashRounds),
+      storage(new (align_val_t(BLOCK_ALIGNMENT)) uint64_t[shape.blockCount * WORDS_PER_BLOCK]()) {
+}
+
+BlockedBloomFilter BlockedBloomFilter::withShape(size_t blockCount, size_t hashRounds) {
+    if (blockCount == 0 || blockCount > MAX_BLOCK_COUNT || hashRounds == 0 || hashRounds > MAX_HASH_ROUNDS) {
+        throw runtime_error("Invalid filter shape");
+    }
+    return BlockedBloomFilter(Shape { blockCount, hashRounds });
+}
+
+void BlockedBloomFilter::add(uint64_t hash) {
+    uint64_t masks[WORDS_PER_BLOCK];
+    blockMasks(hash, hashRounds, masks);
+    uint64_t *block = storage.get() + blockIndex(hash, blockCount) * WORDS_PER_BLOCK;
+    for (size_t i = 0; i < WORDS_PER_BLOCK; i++) {
+        if (masks[i] != 0) {
+            __atomic_fetch_or(&block[i], masks[i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+bool BlockedBloomFilter::contains(uint64_t hash) const {
+    uint64_t masks[WORDS_PER_BLOCK];
+    blockMasks(hash, hashRounds, masks);
+    const uint64_t *block = storage.get() + blockIndex(hash, blockCount) * WORDS_PER_BLOCK;
+    uint64_t missing = 0;
+    for (size_t i = 0; i < WORDS_PER_BLOCK; i++) {
+        missing |= masks[i] & ~__atomic_load_n(&block[i], __ATOMIC_RELAXED);
+    }
+    return missing == 0;
+}
+
+void BlockedBloomFilter::clear() {
+    // Not atomic as a whole, a concurrent lookup may see part of the old bits
+    for (size_t i = 0; i < blockCount * WORDS_PER_BLOCK; i++) {
+        __atomic_store_n(&storage[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+size_t BlockedBloomFilter::getBlockCount() const {
+    return blockCount;
+}
+
+size_t BlockedBloomFilter::getHashRounds() const {
+    return hashRounds;
+}
+
+size_t BlockedBloomFilter::byteCount() const {
+    return blockCount * BLOCK_BITS / 8;
+}
+
+double BlockedBloomFilter::fillRatio() const {
+    size_t setBits = 0;
+    for (size_t i = 0; i < blockCount * WORDS_PER_BLOCK; i++) {
+        setBits += __builtin_popcountll(__atomic_load_n(&storage[i], __ATOMIC_RELAXED));
+    }
+    return setBits / (double) (blockCount * BLOCK_BITS);
+}
+
+uint64_t *BlockedBloomFilter::words() {
+    return storage.get();
+}
+
+const uint64_t *BlockedBloomFilter::words() const {
+    return storage.get();
+}
+
+size_t BlockedBloomFilter::byteCountFor(size_t maxItems, double targetProbability) {
+    return shapeFor(maxItems, targetProbability).blockCount * BLOCK_BITS / 8;
+}
+
+double BlockedBloomFilter::falsePositiveRate(size_t blockCount, size_t hashRounds, size_t itemCount) {
+    // Keys per block are Poisson distributed. For each count, `bitsSet`
+    // tracks the exact distribution of set bits after its keys' positions;
+    // averaging the fill alone underestimates the rate severalfold.
+    double load = itemCount / (double) blockCount;
+    vector<double> bitsSet(BLOCK_BITS + 1, 0);
+    bitsSet[0] = 1;
+    double rate = 0;
+    double probability = exp(-load);
+    auto last = (size_t) ceil(load + 12 * sqrt(load) + 12);
+    for (size_t keys = 0; keys <= last; keys++) {
+        if (keys > 0) {
+            for (size_t round = 0; round < hashRounds; round++) {
+                for (size_t set = BLOCK_BITS; set > 0; set--) {
+                    bitsSet[set] = bitsSet[set] * set / BLOCK_BITS + bitsSet[set - 1] * (BLOCK_BITS - set + 1) / BLOCK_BITS;
+                }
+                bitsSet[0] = 0;
+            }
+        }
+        double blockRate = 0;
+        for (size_t set = 1; set <= BLOCK_BITS; set++) {
+            blockRate += bitsSet[set] * pow(set / (double) BLOCK_BITS, (double) hashRounds);
+        }
+        rate += probability * blockRate;
+        probability *= load / (double) (keys + 1);
+    }
+    return rate;
+}
+
+BlockedBloomFilter::Shape BlockedBloomFilter::shapeFor(size_t maxItems, double targetProbability) {
+    if (maxItems == 0 || !(targetProbability > 0 && targetProbability < 1)) {
+        throw runtime_error("Invalid filter parameters");
+    }
+    // The classic optimum, then more blocks until the uneven load across them is paid for
+    double bitsPerItem = -log(targetProbability) / (log(2.0) * log(2.0));
+    size_t rounds = min(max<size_t>((size_t) lround(bitsPerItem * log(2.0)), 1), MAX_HASH_ROUNDS);
+    auto blocks = max<size_t>((size_t) ceil(maxItems * bitsPerItem / BLOCK_BITS), 1);
+    while (falsePositiveRate(blocks, rounds, maxItems) > targetProbability && blocks < MAX_BLOCK_COUNT) {
+        blocks = max(blocks + 1, (size_t) (blocks * SIZING_STEP));
+    }
+    return Shape { min(blocks, MAX_BLOCK_COUNT), rounds };
+}
+
+void BlockedBloomFilter::AlignedDelete::operator()(uint64_t *words) const {
+    operator delete[](words, align_val_t(BLOCK_ALIGNMENT));
+}
+
+static size_t blockIndex(uint64_t hash, size_t blockCount) {
+    return (size_t) (((hash >> 32) * (uint64_t) blockCount) >> 32);
+}
+
+static void blockMasks(uint64_t hash, size_t hashRounds, uint64_t *masks) {
+    // Fresh hash bits for every position; double hashing inside a block
+    // repeats patterns often enough to double the false positive rate
+    uint64_t positions = hash64Remix(hash, POSITION_SEED);
+    size_t available = POSITIONS_PER_HASH;
+    memset(masks, 0, BlockedBloomFilter::WORDS_PER_BLOCK * sizeof(uint64_t));
+    for (size_t i = 0; i < hashRounds; i++) {
+        if (available == 0) {
+            positions = hash64Remix(hash, POSITION_SEED + i);
+            available = POSITIONS_PER_HASH;
+        }
+        auto position = (uint32_t) (positions % BlockedBloomFilter::BLOCK_BITS);
+        masks[position / 64] |= (uint64_t) 1 << (position % 64);
+        positions /= BlockedBloomFilter::BLOCK_BITS;
+        available--;
+    }
+}
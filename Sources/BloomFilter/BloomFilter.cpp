@@ -14,36 +14,59 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <climits>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <stdexcept>
+#include <thread>
 #include "BloomFilter.hpp"
+#include "BloomFilterMetrics.hpp"
+#include "HostKey.hpp"
 
 static const size_t BITS_PER_BLOCK = 8;
+// Below this a thread costs more to start than the inserts it takes over
+static const size_t MIN_ELEMENTS_PER_THREAD = 16384;
+// Multipliers of djb2 and sdbm, and the seed of djb2
+static const unsigned int DJB2_MULTIPLIER = 33;
+static const unsigned int DJB2_SEED = 5381;
+static const unsigned int SDBM_MULTIPLIER = 65599;
+// Enough for any host within the 253 byte DNS limit; longer ones go to the heap
+static const size_t MAX_STACK_SUFFIXES = 128;
+// Smallest read from a stream that can't tell its length
+static const size_t READ_CHUNK_SIZE = 64 * 1024;
 
 // Forward declarations
 
 static void checkArchitecture();
 
-static size_t calculateHashRounds(size_t size, size_t maxItems);
+static void checkParameters(size_t bitCount, size_t maxItems, const vector<BlockType> &blocks);
 
-static unsigned int djb2Hash(const string &text);
+static size_t calculateHashRounds(size_t size, size_t maxItems);
 
-static unsigned int sdbmHash(const string &text);
+static unsigned int djb2Hash(string_view text);
 
-static unsigned int doubleHash(unsigned int hash1, unsigned int hash2, unsigned int round);
+static unsigned int sdbmHash(string_view text);
 
 static vector<BlockType> readVectorFromFile(const string &path);
 
 static vector<BlockType> readVectorFromStream(BinaryInputStream &in);
 
+static size_t countSetBits(const vector<BlockType> &blocks, size_t bitCount);
+
+static double byteEntropy(const vector<BlockType> &blocks);
+
+static double binaryEntropy(double probability);
+
 
 // Implementation
 
 BloomFilter::BloomFilter(size_t maxItems, double targetProbability) {
     checkArchitecture();
-    bitCount = (size_t) ceil((maxItems * log(targetProbability)) / log(1.0 / (pow(2.0, log(2.0)))));
+    bitCount = bitCountFor(maxItems, targetProbability);
     auto blocks = (size_t) ceil(bitCount / (double) BITS_PER_BLOCK);
     bloomVector = vector<BlockType>(blocks);
     hashRounds = calculateHashRounds(bitCount, maxItems);
@@ -52,12 +75,21 @@ BloomFilter::BloomFilter(size_t maxItems, double targetProbability) {
 BloomFilter::BloomFilter(const string &importFilePath, size_t bitCount, size_t maxItems) : bitCount(bitCount) {
     checkArchitecture();
     bloomVector = readVectorFromFile(importFilePath);
+    checkParameters(bitCount, maxItems, bloomVector);
     hashRounds = calculateHashRounds(bitCount, maxItems);
 }
 
 BloomFilter::BloomFilter(BinaryInputStream &in, size_t bitCount, size_t maxItems) : bitCount(bitCount) {
     checkArchitecture();
     bloomVector = readVectorFromStream(in);
+    checkParameters(bitCount, maxItems, bloomVector);
+    hashRounds = calculateHashRounds(bitCount, maxItems);
+}
+
+BloomFilter::BloomFilter(vector<BlockType> blocks, size_t bitCount, size_t maxItems) : bitCount(bitCount) {
+    checkArchitecture();
+    bloomVector = move(blocks);
+    checkParameters(bitCount, maxItems, bloomVector);
     hashRounds = calculateHashRounds(bitCount, maxItems);
 }
 
@@ -67,43 +99,238 @@ static void checkArchitecture() {
     }
 }
 
+static void checkParameters(size_t bitCount, size_t maxItems, const vector<BlockType> &blocks) {
+    if (bitCount == 0 || maxItems == 0) {
+        throw runtime_error("Invalid filter parameters");
+    }
+    // Every probed bit must be backed by the data, a truncated download would otherwise be read out of bounds
+    if (blocks.size() < bitCount / BITS_PER_BLOCK + (bitCount % BITS_PER_BLOCK != 0)) {
+        throw runtime_error("Filter data is shorter than its bit count");
+    }
+    if (calculateHashRounds(bitCount, maxItems) > BloomFilter::MAX_HASH_ROUNDS) {
+        throw runtime_error("Invalid filter parameters");
+    }
+}
+
 static size_t calculateHashRounds(size_t size, size_t maxItems) {
     return (size_t) round(log(2.0) * size / maxItems);
 }
 
 void BloomFilter::add(const string &element) {
+    insert(element, false);
+}
+
+void BloomFilter::addAll(const vector<string_view> &elements, size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = max<size_t>(thread::hardware_concurrency(), 1);
+    }
+    threadCount = min(threadCount, max<size_t>(elements.size() / MIN_ELEMENTS_PER_THREAD, 1));
+
+    if (threadCount == 1) {
+        for (auto element : elements) {
+            insert(element, false);
+        }
+        return;
+    }
+
+    vector<thread> threads;
+    size_t chunk = (elements.size() + threadCount - 1) / threadCount;
+    for (size_t begin = 0; begin < elements.size(); begin += chunk) {
+        size_t end = min(begin + chunk, elements.size());
+        threads.emplace_back([this, &elements, begin, end]() {
+            for (size_t i = begin; i < end; i++) {
+                insert(elements[i], true);
+            }
+        });
+    }
+    for (auto &worker : threads) {
+        worker.join();
+    }
+}
+
+void BloomFilter::insert(string_view element, bool concurrent) {
     unsigned int hash1 = djb2Hash(element);
     unsigned int hash2 = sdbmHash(element);
 
     for (size_t i = 0; i < hashRounds; i++) {
-        unsigned int hash = doubleHash(hash1, hash2, i);
+        unsigned int hash = roundHash(hash1, hash2, (unsigned int) i);
         size_t bitIndex = hash % bitCount;
         size_t blockIndex = bitIndex / BITS_PER_BLOCK;
         size_t blockOffset = bitIndex % BITS_PER_BLOCK;
-        auto block = bloomVector[blockIndex];
-        bloomVector[blockIndex] = block | (1 << blockOffset);
+        auto mask = (BlockType) (1 << blockOffset);
+        if (concurrent) {
+            __atomic_fetch_or(&bloomVector[blockIndex], mask, __ATOMIC_RELAXED);
+        } else {
+            bloomVector[blockIndex] = bloomVector[blockIndex] | mask;
+        }
     }
 }
 
-bool BloomFilter::contains(const string &element) {
-    unsigned int hash1 = djb2Hash(element);
-    unsigned int hash2 = sdbmHash(element);
+bool BloomFilter::contains(string_view element) {
+    size_t roundsProbed;
+    if (!BloomFilterMetrics::isEnabled()) {
+        return probe(element, roundsProbed);
+    }
+
+    bool sampleLatency = BloomFilterMetrics::shouldSampleProbeLatency();
+    uint64_t start = sampleLatency ? BloomFilterMetrics::now() : 0;
+    bool result = probe(element, roundsProbed);
+    if (sampleLatency) {
+        BloomFilterMetrics::recordProbeLatency(BloomFilterMetrics::now() - start);
+    }
+    BloomFilterMetrics::recordLookup(result, roundsProbed);
+    return result;
+}
+
+bool BloomFilter::probe(string_view element, size_t &roundsProbed) const {
+    return probeBlocks(bloomVector.data(), bitCount, hashRounds, element, roundsProbed);
+}
+
+bool BloomFilter::contains(const HostKey &key) {
+    if (key.labelCount() == 0) {
+        return false;
+    }
+    const SuffixHash &host = key.legacyHashes()[key.labelCount() - 1];
+    size_t roundsProbed;
+    if (!BloomFilterMetrics::isEnabled()) {
+        return probeHashes(bloomVector.data(), bitCount, hashRounds, host.hash1, host.hash2, roundsProbed);
+    }
+
+    bool sampleLatency = BloomFilterMetrics::shouldSampleProbeLatency();
+    uint64_t start = sampleLatency ? BloomFilterMetrics::now() : 0;
+    bool result = probeHashes(bloomVector.data(), bitCount, hashRounds, host.hash1, host.hash2, roundsProbed);
+    if (sampleLatency) {
+        BloomFilterMetrics::recordProbeLatency(BloomFilterMetrics::now() - start);
+    }
+    BloomFilterMetrics::recordLookup(result, roundsProbed);
+    return result;
+}
+
+string_view BloomFilter::containsAnySuffix(const HostKey &key) {
+    size_t roundsProbed;
+    bool metricsEnabled = BloomFilterMetrics::isEnabled();
+    bool sampleLatency = metricsEnabled && BloomFilterMetrics::shouldSampleProbeLatency();
+    uint64_t start = sampleLatency ? BloomFilterMetrics::now() : 0;
+    const SuffixHash *found = probeSuffixHashes(bloomVector.data(), bitCount, hashRounds,
+                                                key.legacyHashes(), key.labelCount(), roundsProbed);
+    if (sampleLatency) {
+        BloomFilterMetrics::recordProbeLatency(BloomFilterMetrics::now() - start);
+    }
+    if (metricsEnabled) {
+        BloomFilterMetrics::recordLookup(found != nullptr, roundsProbed);
+    }
+    string_view host = key.host();
+    return found != nullptr ? host.substr(found->start) : host.substr(host.size());
+}
+
+string_view BloomFilter::containsAnySuffix(string_view host) {
+    size_t roundsProbed;
+    if (!BloomFilterMetrics::isEnabled()) {
+        return probeSuffixes(bloomVector.data(), bitCount, hashRounds, host, roundsProbed);
+    }
+
+    bool sampleLatency = BloomFilterMetrics::shouldSampleProbeLatency();
+    uint64_t start = sampleLatency ? BloomFilterMetrics::now() : 0;
+    string_view result = probeSuffixes(bloomVector.data(), bitCount, hashRounds, host, roundsProbed);
+    if (sampleLatency) {
+        BloomFilterMetrics::recordProbeLatency(BloomFilterMetrics::now() - start);
+    }
+    BloomFilterMetrics::recordLookup(!result.empty(), roundsProbed);
+    return result;
+}
+
+bool BloomFilter::probeBlocks(const BlockType *blocks, size_t bitCount, size_t hashRounds, string_view element, size_t &roundsProbed) {
+    return probeHashes(blocks, bitCount, hashRounds, djb2Hash(element), sdbmHash(element), roundsProbed);
+}
+
+string_view BloomFilter::probeSuffixes(const BlockType *blocks, size_t bitCount, size_t hashRounds, string_view host, size_t &roundsProbed) {
+    SuffixHash stackSuffixes[MAX_STACK_SUFFIXES];
+    vector<SuffixHash> heapSuffixes;
+    SuffixHash *suffixes = stackSuffixes;
+    size_t count = hashSuffixes(host, stackSuffixes, MAX_STACK_SUFFIXES);
+    if (count > MAX_STACK_SUFFIXES) {
+        heapSuffixes.resize(count);
+        suffixes = heapSuffixes.data();
+        hashSuffixes(host, suffixes, count);
+    }
 
+    const SuffixHash *found = probeSuffixHashes(blocks, bitCount, hashRounds, suffixes, count, roundsProbed);
+    return found != nullptr ? host.substr(found->start) : host.substr(host.size());
+}
+
+const BloomFilter::SuffixHash *BloomFilter::probeSuffixHashes(const BlockType *blocks, size_t bitCount, size_t hashRounds,
+                                                              const SuffixHash *suffixes, size_t count, size_t &roundsProbed) {
+    // Every suffix is going to be probed unless a longer one hits, so start
+    // fetching the first two blocks of each before looking at any of them
+    for (size_t i = 0; i < count; i++) {
+        __builtin_prefetch(&blocks[(suffixes[i].hash1 % bitCount) / BITS_PER_BLOCK]);
+        __builtin_prefetch(&blocks[(suffixes[i].hash2 % bitCount) / BITS_PER_BLOCK]);
+    }
+
+    roundsProbed = 0;
+    for (size_t i = count; i > 0; i--) {
+        const SuffixHash &suffix = suffixes[i - 1];
+        size_t rounds;
+        bool found = probeHashes(blocks, bitCount, hashRounds, suffix.hash1, suffix.hash2, rounds);
+        roundsProbed += rounds;
+        if (found) {
+            return &suffix;
+        }
+    }
+    return nullptr;
+}
+
+bool BloomFilter::probeHashes(const BlockType *blocks, size_t bitCount, size_t hashRounds, unsigned int hash1, unsigned int hash2, size_t &roundsProbed) {
     for (size_t i = 0; i < hashRounds; i++) {
-        unsigned int hash = doubleHash(hash1, hash2, i);
+        unsigned int hash = roundHash(hash1, hash2, (unsigned int) i);
         size_t bitIndex = hash % bitCount;
         size_t blockIndex = bitIndex / BITS_PER_BLOCK;
         size_t blockOffset = bitIndex % BITS_PER_BLOCK;
-        auto block = bloomVector[blockIndex];
+        auto block = blocks[blockIndex];
 
         if ((block & (1 << blockOffset)) == 0) {
+            roundsProbed = i + 1;
             return false;
         }
     }
+    roundsProbed = hashRounds;
     return true;
 }
 
-static unsigned int djb2Hash(const string &text) {
+/*
+ djb2 and sdbm are polynomials in the characters, so walking right to left the
+ hash of each suffix follows from the previous one with one multiply-add:
+ djb2(s[k..]) = 5381 * 33^(n-k) + sum(s[i] * 33^(n-1-i)) and likewise for sdbm
+ without the seed. Everything wraps exactly like the left to right originals.
+ Writes the suffixes starting the host or following a dot, shortest first, and
+ returns how many there are even when that exceeds `capacity`.
+ */
+size_t BloomFilter::hashSuffixes(string_view host, SuffixHash *suffixes, size_t capacity) {
+    unsigned int djb2Tail = 0;
+    unsigned int djb2Power = 1;
+    unsigned int sdbmTail = 0;
+    unsigned int sdbmPower = 1;
+    size_t count = 0;
+
+    for (size_t k = host.size(); k > 0; k--) {
+        // Characters are added as the originals add them, sign extended
+        auto character = (unsigned int) (int) host[k - 1];
+        djb2Tail += character * djb2Power;
+        djb2Power *= DJB2_MULTIPLIER;
+        sdbmTail += character * sdbmPower;
+        sdbmPower *= SDBM_MULTIPLIER;
+
+        if (k == 1 || host[k - 2] == '.') {
+            if (count < capacity) {
+                suffixes[count] = SuffixHash { k - 1, DJB2_SEED * djb2Power + djb2Tail, sdbmTail };
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+static unsigned int djb2Hash(string_view text) {
     unsigned int hash = 5381;
     for (const char &iterator : text) {
         hash = ((hash << 5) + hash) + iterator;
@@ -111,7 +338,7 @@ static unsigned int djb2Hash(const string &text) {
     return hash;
 }
 
-static unsigned int sdbmHash(const string &text) {
+static unsigned int sdbmHash(string_view text) {
     unsigned int hash = 0;
     for (const char &iterator : text) {
         hash = iterator + ((hash << 6) + (hash << 16) - hash);
@@ -119,24 +346,13 @@ static unsigned int sdbmHash(const string &text) {
     return hash;
 }
 
-static unsigned int doubleHash(unsigned int hash1, unsigned int hash2, unsigned int round) {
-    switch (round) {
-        case 0:
-            return hash1;
-        case 1:
-            return hash2;
-        default:
-            return (hash1 + (round * hash2) + (round ^ 2));
-    }
-}
-
 void BloomFilter::writeToFile(const string &path) {
     basic_ofstream<BlockType> out(path.c_str(), ofstream::binary);
     writeToStream(out);
 }
 
 void BloomFilter::writeToStream(BinaryOutputStream &out) {
-    out.write(&bloomVector[0], bloomVector.size() * sizeof(BlockType));
+    out.write(bloomVector.data(), bloomVector.size() * sizeof(BlockType));
 }
 
 static vector<BlockType> readVectorFromFile(const string &path) {
@@ -145,10 +361,151 @@ static vector<BlockType> readVectorFromFile(const string &path) {
 }
 
 static vector<BlockType> readVectorFromStream(BinaryInputStream &in) {
-    vector<BlockType> bloomVector((istreambuf_iterator<BlockType>(in)), istreambuf_iterator<BlockType>());
+    // Bulk reads into the vector itself rather than a character at a time,
+    // sized up front when the stream can tell how much is left
+    vector<BlockType> bloomVector;
+    size_t length = 0;
+    auto start = in.tellg();
+    if (start != -1 && in.seekg(0, ios::end)) {
+        auto end = in.tellg();
+        in.seekg(start);
+        if (end >= start) {
+            bloomVector.reserve((size_t) (end - start) + 1);
+        }
+    }
+    in.clear(in.rdstate() & ~ios::failbit);
+    while (in) {
+        bloomVector.resize(max(bloomVector.capacity(), length + max<size_t>(READ_CHUNK_SIZE, length / 2)));
+        in.read(bloomVector.data() + length, (streamsize) (bloomVector.size() - length));
+        length += (size_t) in.gcount();
+    }
+    bloomVector.resize(length);
     return bloomVector;
 }
 
 size_t BloomFilter::getBitCount() const {
     return bitCount;
-}
\ No newline at end of file
+}
+
+size_t BloomFilter::getHashRounds() const {
+    return hashRounds;
+}
+
+size_t BloomFilter::hashRoundsFor(size_t bitCount, size_t maxItems) {
+    return calculateHashRounds(bitCount, maxItems);
+}
+
+size_t BloomFilter::bitCountFor(size_t maxItems, double targetProbability) {
+    if (maxItems == 0 || !(targetProbability > 0 && targetProbability < 1)) {
+        throw runtime_error("Invalid filter parameters");
+    }
+    return (size_t) ceil((maxItems * log(targetProbability)) / log(1.0 / (pow(2.0, log(2.0)))));
+}
+
+void BloomFilter::hashElement(string_view element, unsigned int &hash1, unsigned int &hash2) {
+    hash1 = djb2Hash(element);
+    hash2 = sdbmHash(element);
+}
+
+const vector<BlockType> &BloomFilter::getBlocks() const {
+    return bloomVector;
+}
+
+BloomFilterStats BloomFilter::stats() const {
+    BloomFilterStats stats;
+    stats.bitCount = bitCount;
+    stats.hashRounds = hashRounds;
+    stats.setBits = countSetBits(bloomVector, bitCount);
+    stats.fillRatio = bitCount == 0 ? 1.0 : (double) stats.setBits / bitCount;
+    stats.falsePositiveRate = pow(stats.fillRatio, (double) hashRounds);
+
+    // Swamidass & Baldi estimate of the number of distinct items added
+    if (stats.fillRatio >= 1.0 || hashRounds == 0) {
+        stats.estimatedItemCount = INFINITY;
+    } else {
+        stats.estimatedItemCount = -((double) bitCount / hashRounds) * log(1.0 - stats.fillRatio);
+    }
+
+    stats.byteEntropy = byteEntropy(bloomVector);
+    stats.expectedByteEntropy = BITS_PER_BLOCK * binaryEntropy(stats.fillRatio);
+    return stats;
+}
+
+bool BloomFilterStats::isWithinErrorRate(double errorRate, double tolerance) const {
+    return falsePositiveRate <= errorRate * tolerance * (1.0 + falsePositiveRateMargin());
+}
+
+double BloomFilterStats::falsePositiveRateMargin() const {
+    // Whole hash rounds put a filter filled to capacity up to 1.7% above its
+    // target for rates up to 10%, and under 1% for rates below 1%
+    static const double HASH_ROUNDING_MARGIN = 0.02;
+    // The set bit count is roughly binomial, so the fill ratio has a relative
+    // standard error of sqrt((1 - fill) / (fill * bits)). The rate is the fill
+    // to the power of hashRounds, which multiplies that error by hashRounds.
+    static const double STANDARD_ERRORS = 3.0;
+    if (setBits == 0 || bitCount == 0) {
+        return HASH_ROUNDING_MARGIN;
+    }
+    double fillError = sqrt((1.0 - fillRatio) / (fillRatio * bitCount));
+    return HASH_ROUNDING_MARGIN + STANDARD_ERRORS * hashRounds * fillError;
+}
+
+bool BloomFilterStats::hasExpectedEntropy(double margin) const {
+    // Too few bytes to estimate byte entropy without a large bias
+    static const size_t MIN_ENTROPY_SAMPLE_BITS = 8 * 4096;
+    if (bitCount < MIN_ENTROPY_SAMPLE_BITS) {
+        return true;
+    }
+    return byteEntropy >= expectedByteEntropy - margin;
+}
+
+static size_t countSetBits(const vector<BlockType> &blocks, size_t bitCount) {
+    size_t bytes = min(blocks.size(), bitCount / BITS_PER_BLOCK);
+    const char *data = blocks.data();
+    size_t count = 0;
+
+    // Whole words first; the compiler lowers this to POPCNT / CNT where available
+    size_t index = 0;
+    for (; index + sizeof(uint64_t) <= bytes; index += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + index, sizeof(word));
+        count += __builtin_popcountll(word);
+    }
+    for (; index < bytes; index++) {
+        count += __builtin_popcount((unsigned char) data[index]);
+    }
+
+    // Bits of a trailing partial block beyond bitCount are never probed
+    size_t remainingBits = bitCount % BITS_PER_BLOCK;
+    if (remainingBits != 0 && bytes < blocks.size()) {
+        count += __builtin_popcount((unsigned char) data[bytes] & ((1u << remainingBits) - 1));
+    }
+    return count;
+}
+
+static double byteEntropy(const vector<BlockType> &blocks) {
+    if (blocks.empty()) {
+        return 0;
+    }
+
+    size_t frequencies[256] = { 0 };
+    for (auto block : blocks) {
+        frequencies[(unsigned char) block]++;
+    }
+
+    double entropy = 0;
+    for (auto frequency : frequencies) {
+        if (frequency != 0) {
+            double probability = (double) frequency / blocks.size();
+            entropy -= probability * log2(probability);
+        }
+    }
+    return entropy;
+}
+
+static double binaryEntropy(double probability) {
+    if (probability <= 0 || probability >= 1) {
+        return 0;
+    }
+    return -probability * log2(probability) - (1 - probability) * log2(1 - probability);
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include "BloomFilterBuilder.hpp"
+
+using namespace std;
+
+// Below this a thread costs more to start than the inserts it takes over
+static const size_t MIN_ELEMENTS_PER_THREAD = 16384;
+
+// Implementation
+
+BloomFilterBuilder::BloomFilterBuilder(size_t maxItems, double targetProbability)
+    : bitCount(BloomFilter::bitCountFor(maxItems, targetProbability)) {
+    hashRounds = BloomFilter::hashRoundsFor(bitCount, maxItems);
+    words = FrozenBloomFilter::allocateWords(bitCount);
+}
+
+BloomFilterBuilder::BloomFilterBuilder(const BloomFilter &filter)
+    : words(FrozenBloomFilter::allocateWords(filter.getBitCount())),
+      bitCount(filter.getBitCount()),
+      hashRounds(filter.getHashRounds()) {
+    // Bytes are little endian words, bit i of the filter stays bit i
+    const vector<BlockType> &blocks = filter.getBlocks();
+    size_t length = min(blocks.size(), (bitCount + 7) / 8);
+    for (size_t i = 0; i < length; i++) {
+        words[i / sizeof(uint64_t)] |= (uint64_t) (unsigned char) blocks[i] << (8 * (i % sizeof(uint64_t)));
+    }
+}
+
+void BloomFilterBuilder::add(string_view element) {
+    if (words == nullptr) {
+        throw runtime_error("The filter is already frozen");
+    }
+    unsigned int hash1;
+    unsigned int hash2;
+    BloomFilter::hashElement(element, hash1, hash2);
+    for (size_t i = 0; i < hashRounds; i++) {
+        size_t bit = BloomFilter::roundHash(hash1, hash2, (unsigned int) i) % bitCount;
+        __atomic_fetch_or(&words[bit / 64], (uint64_t) 1 << (bit % 64), __ATOMIC_RELAXED);
+    }
+}
+
+void BloomFilterBuilder::addAll(const vector<string_view> &elements, size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = max<size_t>(thread::hardware_concurrency(), 1);
+    }
+    threadCount = min(threadCount, max<size_t>(elements.size() / MIN_ELEMENTS_PER_THREAD, 1));
+
+    if (threadCount == 1) {
+        for (auto element : elements) {
+            add(element);
+        }
+        return;
+    }
+
+    if (words == nullptr) {
+        throw runtime_error("The filter is already frozen");
+    }
+    vector<thread> threads;
+    size_t chunk = (elements.size() + threadCount - 1) / threadCount;
+    for (size_t begin = 0; begin < elements.size(); begin += chunk) {
+        size_t end = min(begin + chunk, elements.size());
+        threads.emplace_back([this, &elements, begin, end]() {
+            for (size_t i = begin; i < end; i++) {
+                add(elements[i]);
+            }
+        });
+    }
+    for (auto &worker : threads) {
+        worker.join();
+    }
+}
+
+FrozenBloomFilter BloomFilterBuilder::freeze() {
+    if (words == nullptr) {
+        throw runtime_error("The filter is already frozen");
+    }
+    return FrozenBloomFilter(move(words), bitCount, hashRounds);
+}
+
+size_t BloomFilterBuilder::getBitCount() const {
+    return bitCount;
+}
+
+size_t BloomFilterBuilder::getHashRounds() const {
+    return hashRounds;
+}
@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "BloomFilterFile.hpp"
+#include "RANSCoder.hpp"
+
+using namespace std;
+
+static const char MAGIC[8] = { 'D', 'D', 'G', 'B', 'L', 'O', 'O', 'M' };
+// How much of a payload is read, copied or decoded before it is hashed, small
+// enough that the hash reads it from cache
+static const size_t CHUNK_SIZE = 64 * 1024;
+static const uint64_t UNKNOWN_LENGTH = UINT64_MAX;
+
+// Forward declarations
+
+static void storeLittleEndian(char *output, uint64_t value, size_t bytes);
+
+static uint64_t loadLittleEndian(const char *input, size_t bytes);
+
+static uint64_t remainingLength(BinaryInputStream &in);
+
+static vector<char> readStored(BinaryInputStream &in, uint64_t length);
+
+static void loadStored(BloomFilterFile &file, const char *stored);
+
+static void readHashed(BinaryInputStream &in, char *output, uint64_t length, SHA256 &hasher);
+
+static void decodeHashed(RANSDecoder &decoder, const char *input, size_t length, const char *output, SHA256 &hasher);
+
+static void checkDigest(SHA256 &hasher, const SHA256::Digest &expected);
+
+
+// Implementation
+
+void BloomFilterFileHeader::encode(char *output) const {
+    memcpy(output, MAGIC, sizeof(MAGIC));
+    storeLittleEndian(output + 8, version, 4);
+    storeLittleEndian(output + 12, flags, 4);
+    storeLittleEndian(output + 16, bitCount, 8);
+    storeLittleEndian(output + 24, maxItems, 8);
+    storeLittleEndian(output + 32, hashRounds, 4);
+    storeLittleEndian(output + 36, hashScheme, 4);
+    storeLittleEndian(output + 40, payloadLength, 8);
+    memcpy(output + 48, payloadSHA256.data(), payloadSHA256.size());
+}
+
+bool BloomFilterFileHeader::decode(const char *input, size_t length, BloomFilterFileHeader &header) {
+    if (length < ENCODED_SIZE || memcmp(input, MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+    header.version = (uint32_t) loadLittleEndian(input + 8, 4);
+    header.flags = (uint32_t) loadLittleEndian(input + 12, 4);
+    header.bitCount = loadLittleEndian(input + 16, 8);
+    header.maxItems = loadLittleEndian(input + 24, 8);
+    header.hashRounds = (uint32_t) loadLittleEndian(input + 32, 4);
+    header.hashScheme = (uint32_t) loadLittleEndian(input + 36, 4);
+    header.payloadLength = loadLittleEndian(input + 40, 8);
+    memcpy(header.payloadSHA256.data(), input + 48, header.payloadSHA256.size());
+    return true;
+}
+
+bool BloomFilterFileHeader::isPayloadCoded() const {
+    return (flags & FLAG_RANS_PAYLOAD) != 0;
+}
+
+uint64_t BloomFilterFileHeader::decodedPayloadLength() const {
+    return isPayloadCoded() ? bitCount / 8 + (bitCount % 8 != 0) : payloadLength;
+}
+
+BloomFilterFile BloomFilterFile::fromFilter(const BloomFilter &filter, size_t maxItems) {
+    BloomFilterFile file;
+    file.format = BloomFilterFileFormat::container;
+    file.payload = filter.getBlocks();
+    file.header.bitCount = filter.getBitCount();
+    file.header.maxItems = maxItems;
+    file.header.hashRounds = (uint32_t) filter.getHashRounds();
+    file.header.payloadLength = file.payload.size();
+    file.header.payloadSHA256 = SHA256::hash(file.payload.data(), file.payload.size());
+    return file;
+}
+
+bool BloomFilterFile::isContainer(const string &path) {
+    ifstream in(path, ifstream::binary);
+    char magic[sizeof(MAGIC)];
+    return in.read(magic, sizeof(magic)) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+BloomFilterFile BloomFilterFile::readContainer(const string &path) {
+    basic_ifstream<BlockType> in(path, ifstream::binary);
+    if (!in) {
+        throw runtime_error("Can't read " + path);
+    }
+    BloomFilterFile file = readContainer(in);
+    if (in.peek() != char_traits<BlockType>::eof()) {
+        throw runtime_error("Payload length doesn't match the file size");
+    }
+    return file;
+}
+
+BloomFilterFile BloomFilterFile::readContainer(BinaryInputStream &in) {
+    BloomFilterFile file;
+    char encoded[BloomFilterFileHeader::ENCODED_SIZE];
+    if (!in.read(encoded, sizeof(encoded)) || !BloomFilterFileHeader::decode(encoded, sizeof(encoded), file.header)) {
+        throw runtime_error("Not a filter container");
+    }
+    checkHeader(file.header);
+
+    // The header is untrusted, its lengths are checked against the data before anything is sized from them
+    uint64_t available = remainingLength(in);
+    if (available == UNKNOWN_LENGTH) {
+        // A pipe or socket: a payload the stream doesn't deliver fails while it grows
+        vector<char> stored = readStored(in, file.header.payloadLength);
+        if (file.header.isPayloadCoded()) {
+            loadStored(file, stored.data());
+            return file;
+        }
+        file.format = BloomFilterFileFormat::container;
+        file.payload = move(stored);
+        if (SHA256::hash(file.payload.data(), file.payload.size()) != file.header.payloadSHA256) {
+            throw runtime_error("Payload doesn't match its SHA-256");
+        }
+        return file;
+    }
+    if (file.header.payloadLength > available) {
+        throw runtime_error("Payload is truncated");
+    }
+    file.format = file.header.isPayloadCoded() ? BloomFilterFileFormat::compressed : BloomFilterFileFormat::container;
+    file.payload.resize(file.header.decodedPayloadLength());
+    readPayload(in, file.header, file.payload.data());
+    return file;
+}
+
+BloomFilterFile BloomFilterFile::parseContainer(const char *data, size_t length) {
+    BloomFilterFile file;
+    if (!BloomFilterFileHeader::decode(data, length, file.header)) {
+        throw runtime_error("Not a filter container");
+    }
+    checkHeader(file.header);
+    if (file.header.payloadLength != length - BloomFilterFileHeader::ENCODED_SIZE) {
+        throw runtime_error("Payload length doesn't match the file size");
+    }
+    loadStored(file, data + BloomFilterFileHeader::ENCODED_SIZE);
+    return file;
+}
+
+void BloomFilterFile::checkHeader(const BloomFilterFileHeader &header) {
+    if (header.version > BloomFilterFileHeader::CURRENT_VERSION) {
+        throw runtime_error("Unsupported container version " + to_string(header.version));
+    }
+    // Version 1 reserved the flags and its readers ignore them, so it can't carry a coded payload
+    if (header.isPayloadCoded() && header.version < 2) {
+        throw runtime_error("Coded payload in a version " + to_string(header.version) + " container");
+    }
+    if (header.hashScheme != BloomFilterFileHeader::HASH_SCHEME_LEGACY) {
+        throw runtime_error("Unsupported hash scheme " + to_string(header.hashScheme));
+    }
+    if (header.bitCount == 0 || header.maxItems == 0 || header.decodedPayloadLength() < header.bitCount / 8 + (header.bitCount % 8 != 0)) {
+        throw runtime_error("Bit count doesn't fit the payload");
+    }
+    if (header.isPayloadCoded() && (header.payloadLength < RANSCoder::PREFIX_LENGTH ||
+                                    header.decodedPayloadLength() > BloomFilterFileHeader::MAX_DECODED_PAYLOAD_LENGTH ||
+                                    header.decodedPayloadLength() / BloomFilterFileHeader::MAX_CODING_RATIO > header.payloadLength)) {
+        throw runtime_error("Coded payload length is out of range");
+    }
+    if (header.hashRounds != BloomFilter::hashRoundsFor(header.bitCount, header.maxItems)) {
+        throw runtime_error("Hash rounds don't match the bit count and max items");
+    }
+}
+
+void BloomFilterFile::readPayload(BinaryInputStream &in, const BloomFilterFileHeader &header, char *output) {
+    SHA256 hasher;
+    if (!header.isPayloadCoded()) {
+        // Already in its final form, read straight into place
+        readHashed(in, output, header.payloadLength, hasher);
+        checkDigest(hasher, header.payloadSHA256);
+        return;
+    }
+
+    char prefix[RANSCoder::PREFIX_LENGTH];
+    if (!in.read(prefix, sizeof(prefix))) {
+        throw runtime_error("Payload is truncated");
+    }
+    if (RANSCoder::decodedLength(prefix) != header.decodedPayloadLength()) {
+        throw runtime_error("Coded payload doesn't decode to the bit count");
+    }
+    RANSDecoder decoder(prefix, output, header.decodedPayloadLength());
+
+    vector<char> chunk(CHUNK_SIZE);
+    uint64_t remaining = header.payloadLength - RANSCoder::PREFIX_LENGTH;
+    do {
+        auto length = (size_t) min<uint64_t>(remaining, chunk.size());
+        if (!in.read(chunk.data(), (streamsize) length)) {
+            throw runtime_error("Payload is truncated");
+        }
+        decodeHashed(decoder, chunk.data(), length, output, hasher);
+        remaining -= length;
+    } while (remaining > 0);
+    if (!decoder.isComplete()) {
+        throw runtime_error("Coded payload is truncated");
+    }
+    checkDigest(hasher, header.payloadSHA256);
+}
+
+BloomFilterFile BloomFilterFile::readLegacy(const string &path, size_t bitCount, size_t maxItems) {
+    basic_ifstream<BlockType> in(path, ifstream::binary | ifstream::ate);
+    if (!in) {
+        throw runtime_error("Can't read " + path);
+    }
+    auto end = in.tellg();
+    if (end < 0 || !in.seekg(0)) {
+        throw runtime_error("Can't read " + path);
+    }
+    auto length = (uint64_t) end;
+
+    BloomFilterFile file;
+    file.format = BloomFilterFileFormat::legacy;
+    if (bitCount == 0 || maxItems == 0 || length < bitCount / 8 + (bitCount % 8 != 0)) {
+        throw runtime_error("Bit count doesn't fit the payload");
+    }
+
+    // The digest is taken while the data is read, not in a second pass over it
+    SHA256 hasher;
+    file.payload.resize(length);
+    readHashed(in, file.payload.data(), length, hasher);
+
+    file.header.bitCount = bitCount;
+    file.header.maxItems = maxItems;
+    file.header.hashRounds = (uint32_t) BloomFilter::hashRoundsFor(bitCount, maxItems);
+    file.header.payloadLength = length;
+    file.header.payloadSHA256 = hasher.finish();
+    return file;
+}
+
+BloomFilterFile BloomFilterFile::readLegacy(const string &path, size_t bitCount, size_t maxItems, const SHA256::Digest &expectedSHA256) {
+    BloomFilterFile file = readLegacy(path, bitCount, maxItems);
+    if (file.header.payloadSHA256 != expectedSHA256) {
+        throw runtime_error("Payload doesn't match its SHA-256");
+    }
+    return file;
+}
+
+void BloomFilterFile::write(const string &path, BloomFilterFileFormat outputFormat) const {
+    BloomFilterFileHeader written = header;
+    written.version = BloomFilterFileHeader::PLAIN_VERSION;
+    written.flags &= ~BloomFilterFileHeader::FLAG_RANS_PAYLOAD;
+    written.payloadLength = payload.size();
+
+    // Coded before the file is opened, so a payload that can't be written leaves it untouched
+    vector<char> coded;
+    if (outputFormat == BloomFilterFileFormat::compressed) {
+        written.version = BloomFilterFileHeader::CURRENT_VERSION;
+        written.flags |= BloomFilterFileHeader::FLAG_RANS_PAYLOAD;
+        // Codes exactly the bytes the bit count needs, any padding beyond them is dropped
+        auto decodedLength = (size_t) written.decodedPayloadLength();
+        coded = RANSCoder::encode(payload.data(), decodedLength);
+        written.payloadLength = coded.size();
+        if (decodedLength / BloomFilterFileHeader::MAX_CODING_RATIO > coded.size()) {
+            throw runtime_error("Payload codes beyond the ratio readers accept, write it plain");
+        }
+        written.payloadSHA256 = SHA256::hash(payload.data(), decodedLength);
+    }
+
+    ofstream out(path, ofstream::binary | ofstream::trunc);
+    if (outputFormat != BloomFilterFileFormat::legacy) {
+        char encoded[BloomFilterFileHeader::ENCODED_SIZE];
+        written.encode(encoded);
+        out.write(encoded, sizeof(encoded));
+    }
+    if (outputFormat == BloomFilterFileFormat::compressed) {
+        out.write(coded.data(), coded.size());
+    } else {
+        out.write(payload.data(), payload.size());
+    }
+    if (!out) {
+        throw runtime_error("Can't write " + path);
+    }
+}
+
+BloomFilter BloomFilterFile::makeFilter() const {
+    return BloomFilter(payload, header.bitCount, header.maxItems);
+}
+
+BloomFilter BloomFilterFile::takeFilter() {
+    return BloomFilter(move(payload), header.bitCount, header.maxItems);
+}
+
+static void storeLittleEndian(char *output, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        output[i] = (char) (value >> (8 * i));
+    }
+}
+
+static uint64_t loadLittleEndian(const char *input, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t) (unsigned char) input[i] << (8 * i);
+    }
+    return value;
+}
+
+static uint64_t remainingLength(BinaryInputStream &in) {
+    auto position = in.tellg();
+    if (position < 0 || !in.seekg(0, ios::end)) {
+        in.clear();
+        return UNKNOWN_LENGTH;
+    }
+    auto end = in.tellg();
+    if (!in.seekg(position) || end < position) {
+        throw runtime_error("Can't read the payload");
+    }
+    return (uint64_t) (end - position);
+}
+
+static vector<char> readStored(BinaryInputStream &in, uint64_t length) {
+    // Grows with what actually arrives rather than to the length the header claims
+    vector<char> stored;
+    while (stored.size() < length) {
+        size_t offset = stored.size();
+        auto chunkLength = (size_t) min<uint64_t>(CHUNK_SIZE, length - offset);
+        stored.resize(offset + chunkLength);
+        if (!in.read(stored.data() + offset, (streamsize) chunkLength)) {
+            throw runtime_error("Payload is truncated");
+        }
+    }
+    return stored;
+}
+
+// Decodes the header.payloadLength bytes at `stored` following a checked header
+static void loadStored(BloomFilterFile &file, const char *stored) {
+    const auto &header = file.header;
+    file.payload.resize(header.decodedPayloadLength());
+    SHA256 hasher;
+    if (header.isPayloadCoded()) {
+        file.format = BloomFilterFileFormat::compressed;
+        if (RANSCoder::decodedLength(stored) != file.payload.size()) {
+            throw runtime_error("Coded payload doesn't decode to the bit count");
+        }
+        RANSDecoder decoder(stored, file.payload.data(), file.payload.size());
+        decodeHashed(decoder, stored + RANSCoder::PREFIX_LENGTH, header.payloadLength - RANSCoder::PREFIX_LENGTH, file.payload.data(), hasher);
+        if (!decoder.isComplete()) {
+            throw runtime_error("Coded payload is truncated");
+        }
+    } else {
+        file.format = BloomFilterFileFormat::container;
+        for (size_t offset = 0; offset < file.payload.size(); offset += CHUNK_SIZE) {
+            size_t chunkLength = min(CHUNK_SIZE, file.payload.size() - offset);
+            memcpy(file.payload.data() + offset, stored + offset, chunkLength);
+            hasher.update(file.payload.data() + offset, chunkLength);
+        }
+    }
+    checkDigest(hasher, header.payloadSHA256);
+}
+
+static void readHashed(BinaryInputStream &in, char *output, uint64_t length, SHA256 &hasher) {
+    for (uint64_t offset = 0; offset < length; offset += CHUNK_SIZE) {
+        auto chunkLength = (size_t) min<uint64_t>(CHUNK_SIZE, length - offset);
+        if (!in.read(output + offset, (streamsize) chunkLength)) {
+            throw runtime_error("Payload is truncated");
+        }
+        hasher.update(output + offset, chunkLength);
+    }
+}
+
+static void decodeHashed(RANSDecoder &decoder, const char *input, size_t length, const char *output, SHA256 &hasher) {
+    // Fed in pieces so what each one decodes is hashed while still in cache
+    size_t offset = 0;
+    do {
+        size_t hashed = decoder.decodedCount();
+        size_t chunkLength = min(CHUNK_SIZE / 4, length - offset);
+        decoder.decode(input + offset, chunkLength);
+        hasher.update(output + hashed, decoder.decodedCount() - hashed);
+        offset += chunkLength;
+    } while (offset < length);
+}
+
+static void checkDigest(SHA256 &hasher, const SHA256::Digest &expected) {
+    if (hasher.finish() != expected) {
+        throw runtime_error("Payload doesn't match its SHA-256");
+    }
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <unordered_set>
+#include "BloomFilterMetrics.hpp"
+
+using namespace std;
+
+static const uint32_t DEFAULT_LATENCY_SAMPLE_INTERVAL = 64;
+
+namespace {
+
+// Only the owning thread writes these, readers tolerate slightly stale values
+struct ThreadCounter {
+    atomic<uint64_t> value { 0 };
+
+    void increment(uint64_t amount = 1) {
+        value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+
+    uint64_t load() const {
+        return value.load(memory_order_relaxed);
+    }
+};
+
+struct ThreadMetrics {
+    ThreadCounter lookups;
+    ThreadCounter positives;
+    ThreadCounter roundsProbed;
+    ThreadCounter roundsHistogram[BloomFilterMetricsSnapshot::MAX_TRACKED_ROUNDS + 1];
+    ThreadCounter probeLatency[LatencyHistogram::BUCKET_COUNT];
+    ThreadCounter wrapperLatency[LatencyHistogram::BUCKET_COUNT];
+    uint32_t probeSampleCountdown = 0;
+    uint32_t wrapperSampleCountdown = 0;
+
+    ThreadMetrics();
+
+    ~ThreadMetrics();
+
+    void addTo(BloomFilterMetricsSnapshot &snapshot) const;
+};
+
+struct MetricsRegistry {
+    mutex lock;
+    unordered_set<const ThreadMetrics *> live;
+    // Totals of threads that have exited
+    BloomFilterMetricsSnapshot retired;
+};
+
+}
+
+// Forward declarations
+
+static MetricsRegistry &registry();
+
+static ThreadMetrics &threadMetrics();
+
+static bool sampleCountdownExpired(uint32_t &countdown, uint32_t interval);
+
+
+// Implementation
+
+atomic<bool> BloomFilterMetrics::enabled { false };
+atomic<uint32_t> BloomFilterMetrics::latencySampleInterval { DEFAULT_LATENCY_SAMPLE_INTERVAL };
+
+void BloomFilterMetrics::setEnabled(bool isEnabled) {
+    enabled.store(isEnabled, memory_order_relaxed);
+}
+
+void BloomFilterMetrics::setLatencySampleInterval(uint32_t interval) {
+    latencySampleInterval.store(max<uint32_t>(interval, 1), memory_order_relaxed);
+}
+
+void BloomFilterMetrics::recordLookup(bool positive, size_t roundsProbed) {
+    auto &metrics = threadMetrics();
+    metrics.lookups.increment();
+    if (positive) {
+        metrics.positives.increment();
+    }
+    metrics.roundsProbed.increment(roundsProbed);
+    metrics.roundsHistogram[min(roundsProbed, BloomFilterMetricsSnapshot::MAX_TRACKED_ROUNDS)].increment();
+}
+
+void BloomFilterMetrics::recordProbeLatency(uint64_t nanoseconds) {
+    threadMetrics().probeLatency[LatencyHistogram::bucketIndex(nanoseconds)].increment();
+}
+
+void BloomFilterMetrics::recordWrapperLatency(uint64_t nanoseconds) {
+    threadMetrics().wrapperLatency[LatencyHistogram::bucketIndex(nanoseconds)].increment();
+}
+
+bool BloomFilterMetrics::shouldSampleProbeLatency() {
+    return sampleCountdownExpired(threadMetrics().probeSampleCountdown, latencySampleInterval.load(memory_order_relaxed));
+}
+
+bool BloomFilterMetrics::shouldSampleWrapperLatency() {
+    return sampleCountdownExpired(threadMetrics().wrapperSampleCountdown, latencySampleInterval.load(memory_order_relaxed));
+}
+
+uint64_t BloomFilterMetrics::now() {
+    // steady_clock is clock_gettime(CLOCK_MONOTONIC) on Linux and mach_absolute_time on Apple platforms
+    auto elapsed = chrono::steady_clock::now().time_since_epoch();
+    return (uint64_t) chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+}
+
+BloomFilterMetricsSnapshot BloomFilterMetrics::snapshot() {
+    auto &metricsRegistry = registry();
+    lock_guard<mutex> lock(metricsRegistry.lock);
+
+    BloomFilterMetricsSnapshot snapshot = metricsRegistry.retired;
+    for (auto metrics : metricsRegistry.live) {
+        metrics->addTo(snapshot);
+    }
+    return snapshot;
+}
+
+ThreadMetrics::ThreadMetrics() {
+    auto &metricsRegistry = registry();
+    lock_guard<mutex> lock(metricsRegistry.lock);
+    metricsRegistry.live.insert(this);
+}
+
+ThreadMetrics::~ThreadMetrics() {
+    auto &metricsRegistry = registry();
+    lock_guard<mutex> lock(metricsRegistry.lock);
+    addTo(metricsRegistry.retired);
+    metricsRegistry.live.erase(this);
+}
+
+void ThreadMetrics::addTo(BloomFilterMetricsSnapshot &snapshot) const {
+    snapshot.lookups += lookups.load();
+    snapshot.positives += positives.load();
+    snapshot.roundsProbed += roundsProbed.load();
+    for (size_t i = 0; i < snapshot.roundsHistogram.size(); i++) {
+        snapshot.roundsHistogram[i] += roundsHistogram[i].load();
+    }
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        snapshot.probeLatency.counts[i] += probeLatency[i].load();
+        snapshot.wrapperLatency.counts[i] += wrapperLatency[i].load();
+    }
+}
+
+static MetricsRegistry &registry() {
+    // Never destroyed, so threads exiting during static destruction can still retire their counters
+    static auto metricsRegistry = new MetricsRegistry();
+    return *metricsRegistry;
+}
+
+static ThreadMetrics &threadMetrics() {
+    thread_local ThreadMetrics metrics;
+    return metrics;
+}
+
+static bool sampleCountdownExpired(uint32_t &countdown, uint32_t interval) {
+    if (countdown > 0) {
+        countdown--;
+        return false;
+    }
+    countdown = interval - 1;
+    return true;
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return (size_t) value;
+    }
+    size_t magnitude = 63 - __builtin_clzll(value);
+    size_t shift = magnitude - SUB_BUCKET_BITS;
+    size_t index = (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+    return min(index, BUCKET_COUNT - 1);
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    size_t shift = index / SUB_BUCKETS - 1;
+    return (uint64_t) (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+uint64_t LatencyHistogram::totalCount() const {
+    uint64_t total = 0;
+    for (auto count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+uint64_t LatencyHistogram::valueAtPercentile(double percentile) const {
+    uint64_t total = totalCount();
+    if (total == 0) {
+        return 0;
+    }
+
+    auto target = (uint64_t) max(1.0, percentile / 100.0 * total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += counts[i];
+        if (seen >= target) {
+            return bucketLowerBound(i);
+        }
+    }
+    return bucketLowerBound(BUCKET_COUNT - 1);
+}
+
+double BloomFilterMetricsSnapshot::hitRatio() const {
+    return lookups == 0 ? 0 : (double) positives / lookups;
+}
+
+double BloomFilterMetricsSnapshot::averageRoundsProbed() const {
+    return lookups == 0 ? 0 : (double) roundsProbed / lookups;
+}
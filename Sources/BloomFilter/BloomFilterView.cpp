@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdexcept>
+#include "BloomFilterView.hpp"
+#include "HostKey.hpp"
+
+using namespace std;
+
+BloomFilterView::BloomFilterView(const BlockType *blocks,
+                                 size_t byteLength,
+                                 size_t bitCount,
+                                 size_t hashRounds,
+                                 shared_ptr<const void> owner,
+                                 uint64_t generation)
+    : blocks(blocks),
+      bitCount(bitCount),
+      hashRounds(hashRounds),
+      owner(move(owner)),
+      generation(generation) {
+    if (bitCount == 0 || byteLength < bitCount / 8 + (bitCount % 8 != 0) || hashRounds > BloomFilter::MAX_HASH_ROUNDS) {
+        throw runtime_error("Invalid filter view");
+    }
+}
+
+bool BloomFilterView::contains(string_view element) const {
+    size_t roundsProbed;
+    return BloomFilter::probeBlocks(blocks, bitCount, hashRounds, element, roundsProbed);
+}
+
+string_view BloomFilterView::containsAnySuffix(string_view host) const {
+    size_t roundsProbed;
+    return BloomFilter::probeSuffixes(blocks, bitCount, hashRounds, host, roundsProbed);
+}
+
+bool BloomFilterView::contains(const HostKey &key) const {
+    if (key.labelCount() == 0) {
+        return false;
+    }
+    const BloomFilter::SuffixHash &host = key.legacyHashes()[key.labelCount() - 1];
+    size_t roundsProbed;
+    return BloomFilter::probeHashes(blocks, bitCount, hashRounds, host.hash1, host.hash2, roundsProbed);
+}
+
+string_view BloomFilterView::containsAnySuffix(const HostKey &key) const {
+    size_t roundsProbed;
+    const BloomFilter::SuffixHash *found = BloomFilter::probeSuffixHashes(blocks, bitCount, hashRounds,
+                                                                          key.legacyHashes(), key.labelCount(), roundsProbed);
+    string_view host = key.host();
+    return found != nullptr ? host.substr(found->start) : host.substr(host.size());
+}
+
+size_t BloomFilterView::getBitCount() const {
+    return bitCount;
+}
+
+size_t BloomFilterView::getHashRounds() const {
+    return hashRounds;
+}
+
+uint64_t BloomFilterView::getGeneration() const {
+    return generation;
+}
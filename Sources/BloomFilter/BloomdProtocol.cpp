@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstring>
+#include <stdexcept>
+#include "BloomdProtocol.hpp"
+
+using namespace std;
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The wire format is little endian");
+
+static const size_t ITEM_PREFIX_LENGTH = 2;
+
+// Forward declarations
+
+static size_t resultWidth(BloomdOperation operation);
+
+template <typename T>
+static T load(const char *address);
+
+template <typename T>
+static void append(vector<char> &output, T value);
+
+
+// Implementation
+
+size_t BloomdProtocol::frameLength(const char *data, size_t available) {
+    if (available < FRAME_PREFIX_LENGTH) {
+        return 0;
+    }
+    size_t payloadLength = load<uint32_t>(data);
+    if (payloadLength > MAX_PAYLOAD_LENGTH) {
+        throw runtime_error("Frame of " + to_string(payloadLength) + " bytes exceeds the limit");
+    }
+    return available >= FRAME_PREFIX_LENGTH + payloadLength ? FRAME_PREFIX_LENGTH + payloadLength : 0;
+}
+
+void BloomdProtocol::appendRequest(vector<char> &output, uint32_t requestID, BloomdOperation operation,
+                                   const vector<string_view> &items) {
+    size_t payloadLength = HEADER_LENGTH;
+    for (string_view item : items) {
+        if (item.size() > MAX_ITEM_LENGTH) {
+            throw runtime_error("Item of " + to_string(item.size()) + " bytes exceeds the limit");
+        }
+        payloadLength += ITEM_PREFIX_LENGTH + item.size();
+    }
+    if (payloadLength > MAX_PAYLOAD_LENGTH) {
+        throw runtime_error("Request of " + to_string(payloadLength) + " bytes exceeds the limit");
+    }
+
+    output.reserve(output.size() + FRAME_PREFIX_LENGTH + payloadLength);
+    append<uint32_t>(output, (uint32_t) payloadLength);
+    append<uint32_t>(output, requestID);
+    append<uint8_t>(output, (uint8_t) operation);
+    append<uint8_t>(output, 0);
+    append<uint16_t>(output, 0);
+    append<uint32_t>(output, (uint32_t) items.size());
+    for (string_view item : items) {
+        append<uint16_t>(output, (uint16_t) item.size());
+        output.insert(output.end(), item.begin(), item.end());
+    }
+}
+
+bool BloomdProtocol::decodeRequest(const char *payload, size_t length, BloomdRequest &request) {
+    // Nothing from the previous frame may be echoed for this one
+    request.requestID = 0;
+    request.operation = BloomdOperation();
+    request.items.clear();
+    if (length < HEADER_LENGTH) {
+        return false;
+    }
+    request.requestID = load<uint32_t>(payload);
+    request.operation = (BloomdOperation) load<uint8_t>(payload + 4);
+    uint32_t itemCount = load<uint32_t>(payload + 8);
+    // Every item takes at least its prefix, which bounds the count before anything is reserved
+    if (itemCount > (length - HEADER_LENGTH) / ITEM_PREFIX_LENGTH) {
+        return false;
+    }
+
+    size_t offset = HEADER_LENGTH;
+    for (uint32_t i = 0; i < itemCount; i++) {
+        if (length - offset < ITEM_PREFIX_LENGTH) {
+            return false;
+        }
+        size_t itemLength = load<uint16_t>(payload + offset);
+        offset += ITEM_PREFIX_LENGTH;
+        if (length - offset < itemLength) {
+            return false;
+        }
+        request.items.emplace_back(payload + offset, itemLength);
+        offset += itemLength;
+    }
+    return offset == length;
+}
+
+size_t BloomdProtocol::maxResults(BloomdOperation operation) {
+    return (MAX_PAYLOAD_LENGTH - HEADER_LENGTH) / resultWidth(operation);
+}
+
+void BloomdProtocol::appendResponse(vector<char> &output, const BloomdResponse &response) {
+    size_t resultCount = response.status == BloomdStatus::ok ? response.results.size() : 0;
+    size_t width = resultWidth(response.operation);
+    if (resultCount > maxResults(response.operation)) {
+        throw runtime_error("Response of " + to_string(resultCount) + " results exceeds the limit");
+    }
+    append<uint32_t>(output, (uint32_t) (HEADER_LENGTH + resultCount * width));
+    append<uint32_t>(output, response.requestID);
+    append<uint8_t>(output, (uint8_t) response.operation);
+    append<uint8_t>(output, (uint8_t) response.status);
+    append<uint16_t>(output, 0);
+    append<uint32_t>(output, (uint32_t) resultCount);
+    for (size_t i = 0; i < resultCount; i++) {
+        if (width == sizeof(uint64_t)) {
+            append<uint64_t>(output, response.results[i]);
+        } else if (width == sizeof(uint32_t)) {
+            append<uint32_t>(output, (uint32_t) response.results[i]);
+        } else {
+            append<uint8_t>(output, (uint8_t) response.results[i]);
+        }
+    }
+}
+
+bool BloomdProtocol::decodeResponse(const char *payload, size_t length, BloomdResponse &response) {
+    response.results.clear();
+    if (length < HEADER_LENGTH) {
+        return false;
+    }
+    response.requestID = load<uint32_t>(payload);
+    response.operation = (BloomdOperation) load<uint8_t>(payload + 4);
+    response.status = (BloomdStatus) load<uint8_t>(payload + 5);
+    uint32_t resultCount = load<uint32_t>(payload + 8);
+    size_t width = resultWidth(response.operation);
+    if (resultCount != (length - HEADER_LENGTH) / width || (length - HEADER_LENGTH) % width != 0) {
+        return false;
+    }
+    response.results.reserve(resultCount);
+    for (size_t offset = HEADER_LENGTH; offset < length; offset += width) {
+        if (width == sizeof(uint64_t)) {
+            response.results.push_back(load<uint64_t>(payload + offset));
+        } else if (width == sizeof(uint32_t)) {
+            response.results.push_back(load<uint32_t>(payload + offset));
+        } else {
+            response.results.push_back(load<uint8_t>(payload + offset));
+        }
+    }
+    return true;
+}
+
+static size_t resultWidth(BloomdOperation operation) {
+    switch (operation) {
+        case BloomdOperation::domainLists:
+            return sizeof(uint64_t);
+        case BloomdOperation::trackerEntity:
+            return sizeof(uint32_t);
+        default:
+            return sizeof(uint8_t);
+    }
+}
+
+template <typename T>
+static T load(const char *address) {
+    T value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+template <typename T>
+static void append(vector<char> &output, T value) {
+    char bytes[sizeof(value)];
+    memcpy(bytes, &value, sizeof(value));
+    output.insert(output.end(), bytes, bytes + sizeof(value));
+}
@@ -0,0 +1,501 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+#include "ContentRuleList.hpp"
+#include "JSONReader.hpp"
+
+using namespace std;
+
+static const size_t LITERAL_LENGTH = 4;
+static const size_t LITERAL_FILTER_BITS = 1 << 16;
+
+struct ResourceTypeName {
+    const char *name;
+    uint32_t flag;
+};
+
+static const ResourceTypeName RESOURCE_TYPE_NAMES[] = {
+    { "document", ContentRuleResourceDocument },
+    { "image", ContentRuleResourceImage },
+    { "style-sheet", ContentRuleResourceStyleSheet },
+    { "script", ContentRuleResourceScript },
+    { "font", ContentRuleResourceFont },
+    { "raw", ContentRuleResourceRaw },
+    { "svg-document", ContentRuleResourceSVGDocument },
+    { "media", ContentRuleResourceMedia },
+    { "popup", ContentRuleResourcePopup },
+    { "ping", ContentRuleResourcePing },
+    { "fetch", ContentRuleResourceFetch },
+    { "websocket", ContentRuleResourceWebSocket },
+    { "other", ContentRuleResourceOther }
+};
+
+// Forward declarations
+
+static ContentRuleActionType parseActionType(const string &type);
+
+static vector<string> readDomains(const JSONValue &value);
+
+static vector<string> requiredLiterals(string_view pattern);
+
+static size_t skipGroup(string_view pattern, size_t start);
+
+static size_t skipClass(string_view pattern, size_t start);
+
+static bool hasTopLevelAlternation(string_view pattern);
+
+static bool domainMatches(const string &entry, string_view host);
+
+static uint32_t literalKey(const char *text);
+
+static size_t literalFilterBit(uint32_t key);
+
+static char toLowerASCII(char character);
+
+
+// Implementation
+
+ContentRuleList ContentRuleList::parse(string_view json) {
+    return fromJSON(JSONReader::parse(json));
+}
+
+ContentRuleList ContentRuleList::parseFile(const string &path) {
+    return fromJSON(JSONReader::parseFile(path));
+}
+
+ContentRuleList ContentRuleList::fromJSON(const JSONValue &root) {
+    ContentRuleList list;
+
+    for (const auto &item : root.asArray()) {
+        size_t number = list.rules.size();
+        const JSONValue &trigger = item.at("trigger");
+        Rule rule;
+        rule.action = parseActionType(item.at("action").at("type").asString());
+        rule.resourceTypes = 0;
+        rule.loadType = LoadType::any;
+        rule.supported = true;
+
+        string urlFilter;
+        bool caseSensitive = false;
+        bool hasURLFilter = false;
+        for (const auto &member : trigger.asObject()) {
+            const string &key = member.first;
+            const JSONValue &value = member.second;
+            if (key == "url-filter") {
+                urlFilter = value.asString();
+                hasURLFilter = true;
+            } else if (key == "url-filter-is-case-sensitive") {
+                caseSensitive = value.asBool();
+            } else if (key == "if-domain") {
+                rule.ifDomains = readDomains(value);
+            } else if (key == "unless-domain") {
+                rule.unlessDomains = readDomains(value);
+            } else if (key == "resource-type") {
+                for (const auto &type : value.asArray()) {
+                    uint32_t flag = resourceTypeNamed(type.asString());
+                    if (flag == 0) {
+                        throw runtime_error("Rule " + to_string(number) + ": unknown resource-type " + type.asString());
+                    }
+                    rule.resourceTypes |= flag;
+                }
+            } else if (key == "load-type") {
+                bool firstParty = false;
+                bool thirdParty = false;
+                for (const auto &type : value.asArray()) {
+                    firstParty = firstParty || type.asString() == "first-party";
+                    thirdParty = thirdParty || type.asString() == "third-party";
+                    if (type.asString() != "first-party" && type.asString() != "third-party") {
+                        throw runtime_error("Rule " + to_string(number) + ": unknown load-type " + type.asString());
+                    }
+                }
+                if (firstParty != thirdParty) {
+                    rule.loadType = firstParty ? LoadType::firstParty : LoadType::thirdParty;
+                }
+            } else {
+                // if-top-url, load-context and friends
+                rule.supported = false;
+            }
+        }
+
+        if (!hasURLFilter) {
+            throw runtime_error("Rule " + to_string(number) + ": missing url-filter");
+        }
+        if (!rule.ifDomains.empty() && !rule.unlessDomains.empty()) {
+            throw runtime_error("Rule " + to_string(number) + ": if-domain and unless-domain are exclusive");
+        }
+        try {
+            auto flags = regex::ECMAScript | regex::optimize | regex::nosubs;
+            rule.urlFilter = regex(urlFilter, caseSensitive ? flags : flags | regex::icase);
+        } catch (const regex_error &) {
+            throw runtime_error("Rule " + to_string(number) + ": invalid url-filter " + urlFilter);
+        }
+
+        list.unsupportedRules += !rule.supported;
+        list.rules.push_back(move(rule));
+        list.urlFilters.push_back(move(urlFilter));
+    }
+
+    list.index();
+    return list;
+}
+
+void ContentRuleList::index() {
+    // Candidate literals of every rule, then the rarest one of each
+    vector<vector<uint32_t>> ruleKeys(rules.size());
+    unordered_map<uint32_t, size_t> keyCounts;
+    for (size_t i = 0; i < rules.size(); i++) {
+        if (!rules[i].supported) {
+            continue;
+        }
+        unordered_set<uint32_t> keys;
+        for (const auto &literal : requiredLiterals(urlFilters[i])) {
+            for (size_t offset = 0; offset + LITERAL_LENGTH <= literal.size(); offset++) {
+                keys.insert(literalKey(literal.data() + offset));
+            }
+        }
+        for (uint32_t key : keys) {
+            keyCounts[key]++;
+            ruleKeys[i].push_back(key);
+        }
+    }
+
+    literalFilter.assign(LITERAL_FILTER_BITS / 64, 0);
+    for (size_t i = 0; i < rules.size(); i++) {
+        if (!rules[i].supported) {
+            continue;
+        }
+        if (!ruleKeys[i].empty()) {
+            uint32_t best = *min_element(ruleKeys[i].begin(), ruleKeys[i].end(), [&keyCounts](uint32_t lhs, uint32_t rhs) {
+                return keyCounts[lhs] < keyCounts[rhs] || (keyCounts[lhs] == keyCounts[rhs] && lhs < rhs);
+            });
+            literalIndex[best].push_back((uint32_t) i);
+            size_t bit = literalFilterBit(best);
+            literalFilter[bit / 64] |= 1ull << (bit % 64);
+        } else if (!rules[i].ifDomains.empty()) {
+            for (const auto &domain : rules[i].ifDomains) {
+                string key = domain[0] == '*' ? domain.substr(1) : domain;
+                auto &indexed = domainIndex[key];
+                if (indexed.empty() || indexed.back() != i) {
+                    indexed.push_back((uint32_t) i);
+                }
+            }
+        } else {
+            unindexedRules.push_back((uint32_t) i);
+        }
+    }
+}
+
+ContentRuleDecision ContentRuleList::evaluate(const ContentRuleRequest &request) const {
+    vector<uint32_t> candidates;
+
+    string lowercased(request.url.size(), '\0');
+    transform(request.url.begin(), request.url.end(), lowercased.begin(), toLowerASCII);
+    for (size_t offset = 0; offset + LITERAL_LENGTH <= lowercased.size(); offset++) {
+        uint32_t key = literalKey(lowercased.data() + offset);
+        size_t bit = literalFilterBit(key);
+        if ((literalFilter[bit / 64] & (1ull << (bit % 64))) == 0) {
+            continue;
+        }
+        auto indexed = literalIndex.find(key);
+        if (indexed != literalIndex.end()) {
+            candidates.insert(candidates.end(), indexed->second.begin(), indexed->second.end());
+        }
+    }
+
+    string_view domain = request.pageHost;
+    while (!domain.empty()) {
+        auto indexed = domainIndex.find(string(domain));
+        if (indexed != domainIndex.end()) {
+            candidates.insert(candidates.end(), indexed->second.begin(), indexed->second.end());
+        }
+        size_t dot = domain.find('.');
+        if (dot == string_view::npos) {
+            break;
+        }
+        domain.remove_prefix(dot + 1);
+    }
+
+    candidates.insert(candidates.end(), unindexedRules.begin(), unindexedRules.end());
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    ContentRuleDecision decision {};
+    for (uint32_t candidate : candidates) {
+        const Rule &rule = rules[candidate];
+        if (!matches(rule, request, decision.regexesTested)) {
+            continue;
+        }
+        if (rule.action == ContentRuleActionType::ignorePreviousRules) {
+            decision.rules.clear();
+        } else {
+            decision.rules.push_back(candidate);
+        }
+    }
+
+    for (size_t matched : decision.rules) {
+        decision.block = decision.block || rules[matched].action == ContentRuleActionType::block;
+        decision.blockCookies = decision.blockCookies || rules[matched].action == ContentRuleActionType::blockCookies;
+        decision.makeHTTPS = decision.makeHTTPS || rules[matched].action == ContentRuleActionType::makeHTTPS;
+    }
+    return decision;
+}
+
+bool ContentRuleList::matches(const Rule &rule, const ContentRuleRequest &request, size_t &regexesTested) const {
+    if (rule.resourceTypes != 0 && (rule.resourceTypes & request.resourceType) == 0) {
+        return false;
+    }
+    if ((rule.loadType == LoadType::firstParty && request.thirdParty)
+        || (rule.loadType == LoadType::thirdParty && !request.thirdParty)) {
+        return false;
+    }
+    if (!rule.ifDomains.empty() && none_of(rule.ifDomains.begin(), rule.ifDomains.end(), [&request](const string &entry) {
+            return domainMatches(entry, request.pageHost);
+        })) {
+        return false;
+    }
+    if (any_of(rule.unlessDomains.begin(), rule.unlessDomains.end(), [&request](const string &entry) {
+            return domainMatches(entry, request.pageHost);
+        })) {
+        return false;
+    }
+    regexesTested++;
+    return regex_search(request.url.begin(), request.url.end(), rule.urlFilter);
+}
+
+size_t ContentRuleList::size() const {
+    return rules.size();
+}
+
+size_t ContentRuleList::unsupportedRuleCount() const {
+    return unsupportedRules;
+}
+
+size_t ContentRuleList::unindexedRuleCount() const {
+    return unindexedRules.size();
+}
+
+ContentRuleActionType ContentRuleList::actionType(size_t rule) const {
+    return rules.at(rule).action;
+}
+
+uint32_t ContentRuleList::resourceTypeNamed(string_view name) {
+    for (const auto &type : RESOURCE_TYPE_NAMES) {
+        if (name == type.name) {
+            return type.flag;
+        }
+    }
+    return 0;
+}
+
+static ContentRuleActionType parseActionType(const string &type) {
+    if (type == "block") {
+        return ContentRuleActionType::block;
+    } else if (type == "block-cookies") {
+        return ContentRuleActionType::blockCookies;
+    } else if (type == "css-display-none") {
+        return ContentRuleActionType::cssDisplayNone;
+    } else if (type == "ignore-previous-rules") {
+        return ContentRuleActionType::ignorePreviousRules;
+    } else if (type == "make-https") {
+        return ContentRuleActionType::makeHTTPS;
+    }
+    throw runtime_error("Unknown action type " + type);
+}
+
+static vector<string> readDomains(const JSONValue &value) {
+    vector<string> domains;
+    for (const auto &domain : value.asArray()) {
+        string lowercased = domain.asString();
+        transform(lowercased.begin(), lowercased.end(), lowercased.begin(), toLowerASCII);
+        if (lowercased.empty() || lowercased == "*") {
+            throw runtime_error("Empty domain in " + lowercased);
+        }
+        domains.push_back(move(lowercased));
+    }
+    return domains;
+}
+
+/*
+ Runs of lowercase bytes that every match of `pattern` contains. Anything that
+ isn't a plain or escaped character breaks the current run, a quantifier
+ allowing zero repetitions also drops the character before it, and top level
+ alternatives leave nothing that is required.
+ */
+static vector<string> requiredLiterals(string_view pattern) {
+    vector<string> literals;
+    if (hasTopLevelAlternation(pattern)) {
+        return literals;
+    }
+
+    string run;
+    bool lastWasLiteral = false;
+    auto breakRun = [&literals, &run, &lastWasLiteral]() {
+        if (!run.empty()) {
+            literals.push_back(run);
+            run.clear();
+        }
+        lastWasLiteral = false;
+    };
+
+    size_t i = 0;
+    while (i < pattern.size()) {
+        char character = pattern[i];
+        if (character == '\\' && i + 1 < pattern.size()) {
+            char escaped = pattern[i + 1];
+            i += 2;
+            if (isalnum((unsigned char) escaped)) {
+                // Classes, assertions, back references and code points
+                if (escaped == 'x') {
+                    i += 2;
+                } else if (escaped == 'u') {
+                    i += 4;
+                } else if (escaped == 'c') {
+                    i += 1;
+                }
+                breakRun();
+            } else {
+                run += toLowerASCII(escaped);
+                lastWasLiteral = true;
+            }
+        } else if (character == '[') {
+            i = skipClass(pattern, i);
+            breakRun();
+        } else if (character == '(') {
+            i = skipGroup(pattern, i);
+            breakRun();
+        } else if (character == '*' || character == '?' || character == '{') {
+            if (lastWasLiteral) {
+                run.pop_back();
+            }
+            breakRun();
+            if (character == '{') {
+                size_t end = pattern.find('}', i);
+                i = end == string_view::npos ? pattern.size() : end + 1;
+            } else {
+                i++;
+            }
+        } else if (character == '+' || character == '.' || character == '^' || character == '$'
+                   || character == ')' || character == '|' || character == '\\') {
+            breakRun();
+            i++;
+        } else {
+            run += toLowerASCII(character);
+            lastWasLiteral = true;
+            i++;
+        }
+    }
+    breakRun();
+    return literals;
+}
+
+// Returns the position after the group opening at `start`
+static size_t skipGroup(string_view pattern, size_t start) {
+    size_t depth = 0;
+    size_t i = start;
+    while (i < pattern.size()) {
+        char character = pattern[i];
+        if (character == '\\') {
+            i += 2;
+            continue;
+        }
+        if (character == '[') {
+            i = skipClass(pattern, i);
+            continue;
+        }
+        if (character == '(') {
+            depth++;
+        } else if (character == ')' && --depth == 0) {
+            return i + 1;
+        }
+        i++;
+    }
+    return pattern.size();
+}
+
+// Returns the position after the class opening at `start`
+static size_t skipClass(string_view pattern, size_t start) {
+    size_t i = start + 1;
+    if (i < pattern.size() && pattern[i] == '^') {
+        i++;
+    }
+    // A leading ']' is a member, not the end
+    if (i < pattern.size() && pattern[i] == ']') {
+        i++;
+    }
+    while (i < pattern.size()) {
+        if (pattern[i] == '\\') {
+            i += 2;
+            continue;
+        }
+        if (pattern[i] == ']') {
+            return i + 1;
+        }
+        i++;
+    }
+    return pattern.size();
+}
+
+static bool hasTopLevelAlternation(string_view pattern) {
+    size_t i = 0;
+    while (i < pattern.size()) {
+        char character = pattern[i];
+        if (character == '\\') {
+            i += 2;
+        } else if (character == '[') {
+            i = skipClass(pattern, i);
+        } else if (character == '(') {
+            i = skipGroup(pattern, i);
+        } else if (character == '|') {
+            return true;
+        } else {
+            i++;
+        }
+    }
+    return false;
+}
+
+// "*example.com" covers example.com and its subdomains, "example.com" only itself
+static bool domainMatches(const string &entry, string_view host) {
+    if (entry[0] != '*') {
+        return host == entry;
+    }
+    string_view domain = string_view(entry).substr(1);
+    if (host.size() == domain.size()) {
+        return host == domain;
+    }
+    return host.size() > domain.size()
+        && host.compare(host.size() - domain.size(), domain.size(), domain) == 0
+        && host[host.size() - domain.size() - 1] == '.';
+}
+
+static uint32_t literalKey(const char *text) {
+    uint32_t key;
+    memcpy(&key, text, sizeof(key));
+    return key;
+}
+
+static size_t literalFilterBit(uint32_t key) {
+    return (uint32_t) (key * 0x9E3779B1u) >> 16;
+}
+
+static char toLowerASCII(char character) {
+    return character >= 'A' && character <= 'Z' ? (char) (character + ('a' - 'A')) : character;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstring>
+#include <stdexcept>
+#include "DomainArena.hpp"
+#include "Hash64.hpp"
+#include "HostKey.hpp"
+
+using namespace std;
+
+static const size_t CHUNK_SIZE = 64 * 1024;
+static const size_t FIRST_SEGMENT_SIZE = 1024;
+static const size_t INITIAL_SLOT_COUNT = 2048;
+static const uint64_t TAG_MASK = 0xffffffff00000000ull;
+static const uint64_t ID_MASK = 0xffffffffull;
+// IDs are stored plus one so an empty slot is 0
+static const uint32_t MAX_IDS = 0xffffffffu;
+
+// Forward declarations
+
+static size_t segmentOf(uint32_t id);
+
+static size_t segmentStart(size_t segment);
+
+
+// Implementation
+
+DomainArena::DomainArena() : table(nullptr), count(0), bytes(0), chunkCursor(nullptr), chunkRemaining(0) {
+    for (auto &segment : segments) {
+        segment.store(nullptr, memory_order_relaxed);
+    }
+    unique_ptr<Table> initial(new Table { INITIAL_SLOT_COUNT - 1, unique_ptr<atomic<uint64_t>[]>(new atomic<uint64_t>[INITIAL_SLOT_COUNT]) });
+    for (size_t i = 0; i < INITIAL_SLOT_COUNT; i++) {
+        initial->slots[i].store(0, memory_order_relaxed);
+    }
+    table.store(initial.get(), memory_order_release);
+    tables.push_back(move(initial));
+}
+
+DomainArena::~DomainArena() {
+    for (auto &segment : segments) {
+        delete[] segment.load(memory_order_relaxed);
+    }
+}
+
+DomainArena &DomainArena::shared() {
+    static DomainArena arena;
+    return arena;
+}
+
+uint32_t DomainArena::intern(string_view domain) {
+    uint64_t hash = hash64(domain.data(), domain.size());
+    uint32_t id;
+    // Most domains are interned again by every list naming them, which needs no lock
+    if (findHashed(domain, hash, id)) {
+        return id;
+    }
+
+    lock_guard<std::mutex> lock(mutex);
+    if (findHashed(domain, hash, id)) {
+        return id;
+    }
+    id = count.load(memory_order_relaxed);
+    if (id == MAX_IDS - 1) {
+        throw runtime_error("Domain arena is full");
+    }
+    if (domain.size() > ID_MASK) {
+        throw runtime_error("Domain too long for the arena");
+    }
+
+    size_t segment = segmentOf(id);
+    Record *records = segments[segment].load(memory_order_relaxed);
+    if (records == nullptr) {
+        records = new Record[FIRST_SEGMENT_SIZE << segment];
+        segments[segment].store(records, memory_order_release);
+    }
+    records[id - segmentStart(segment)] = Record { store(domain), (uint32_t) domain.size(), hash };
+
+    // Grown at half full so probe sequences stay short
+    Table *current = table.load(memory_order_relaxed);
+    if (((size_t) id + 1) * 2 > current->mask + 1) {
+        size_t slotCount = (current->mask + 1) * 2;
+        unique_ptr<Table> grown(new Table { slotCount - 1, unique_ptr<atomic<uint64_t>[]>(new atomic<uint64_t>[slotCount]) });
+        for (size_t i = 0; i < slotCount; i++) {
+            grown->slots[i].store(0, memory_order_relaxed);
+        }
+        for (uint32_t existing = 0; existing < id; existing++) {
+            insertSlot(*grown, recordAt(existing).hash, existing);
+        }
+        current = grown.get();
+        table.store(current, memory_order_release);
+        tables.push_back(move(grown));
+    }
+    insertSlot(*current, hash, id);
+    count.store(id + 1, memory_order_release);
+    return id;
+}
+
+bool DomainArena::find(string_view domain, uint32_t &id) const {
+    return findHashed(domain, hash64(domain.data(), domain.size()), id);
+}
+
+bool DomainArena::find(const HostKey &key, size_t label, uint32_t &id) const {
+    return findHashed(key.suffix(label), key.hash(label), id);
+}
+
+string_view DomainArena::domain(uint32_t id) const {
+    const Record &record = recordAt(id);
+    return string_view(record.data, record.length);
+}
+
+size_t DomainArena::size() const {
+    return count.load(memory_order_acquire);
+}
+
+size_t DomainArena::byteCount() const {
+    return bytes.load(memory_order_relaxed);
+}
+
+bool DomainArena::findHashed(string_view domain, uint64_t hash, uint32_t &id) const {
+    const Table *current = table.load(memory_order_acquire);
+    for (size_t slot = hash & current->mask;; slot = (slot + 1) & current->mask) {
+        // Acquire pairs with the release in insertSlot, the record is complete once its slot is seen
+        uint64_t entry = current->slots[slot].load(memory_order_acquire);
+        if (entry == 0) {
+            return false;
+        }
+        if ((entry & TAG_MASK) == (hash & TAG_MASK)) {
+            uint32_t candidate = (uint32_t) (entry & ID_MASK) - 1;
+            const Record &record = recordAt(candidate);
+            if (record.hash == hash && string_view(record.data, record.length) == domain) {
+                id = candidate;
+                return true;
+            }
+        }
+    }
+}
+
+const DomainArena::Record &DomainArena::recordAt(uint32_t id) const {
+    size_t segment = segmentOf(id);
+    return segments[segment].load(memory_order_acquire)[id - segmentStart(segment)];
+}
+
+void DomainArena::insertSlot(Table &target, uint64_t hash, uint32_t id) {
+    size_t slot = hash & target.mask;
+    while (target.slots[slot].load(memory_order_relaxed) != 0) {
+        slot = (slot + 1) & target.mask;
+    }
+    target.slots[slot].store((hash & TAG_MASK) | ((uint64_t) id + 1), memory_order_release);
+}
+
+const char *DomainArena::store(string_view domain) {
+    // Domains longer than a chunk get one of their own and leave the current chunk in place
+    if (domain.size() > CHUNK_SIZE) {
+        chunks.emplace_back(new char[domain.size()]);
+        memcpy(chunks.back().get(), domain.data(), domain.size());
+        bytes.fetch_add(domain.size(), memory_order_relaxed);
+        return chunks.back().get();
+    }
+    if (chunkCursor == nullptr || domain.size() > chunkRemaining) {
+        chunks.emplace_back(new char[CHUNK_SIZE]);
+        chunkCursor = chunks.back().get();
+        chunkRemaining = CHUNK_SIZE;
+    }
+    char *stored = chunkCursor;
+    memcpy(stored, domain.data(), domain.size());
+    chunkCursor += domain.size();
+    chunkRemaining -= domain.size();
+    bytes.fetch_add(domain.size(), memory_order_relaxed);
+    return stored;
+}
+
+// Segment s holds FIRST_SEGMENT_SIZE << s records, so 23 of them cover every 32-bit ID
+static size_t segmentOf(uint32_t id) {
+    return 63 - (size_t) __builtin_clzll((uint64_t) id / FIRST_SEGMENT_SIZE + 1);
+}
+
+static size_t segmentStart(size_t segment) {
+    return FIRST_SEGMENT_SIZE * ((1ull << segment) - 1);
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include "FrozenBloomFilter.hpp"
+#include "HostKey.hpp"
+
+using namespace std;
+
+static const size_t WORD_BITS = 64;
+static const size_t CACHE_LINE_BYTES = 64;
+static const size_t WORDS_PER_CACHE_LINE = CACHE_LINE_BYTES / sizeof(uint64_t);
+// Hashes are 32 bits, so larger bit counts reduce like this one: not at all
+static const uint64_t MAX_REDUCTION_DIVISOR = (uint64_t) 1 << 32;
+
+// Implementation
+
+FrozenBloomFilter::FrozenBloomFilter(Words words, size_t bitCount, size_t hashRounds)
+    : words(move(words)), bitCount(bitCount), hashRounds(hashRounds) {
+    reductionDivisor = min<uint64_t>(bitCount, MAX_REDUCTION_DIVISOR);
+    reductionMultiplier = UINT64_MAX / reductionDivisor + 1;
+}
+
+bool FrozenBloomFilter::contains(string_view element) const noexcept {
+    unsigned int hash1;
+    unsigned int hash2;
+    BloomFilter::hashElement(element, hash1, hash2);
+    return probeHashes(hash1, hash2);
+}
+
+bool FrozenBloomFilter::contains(const HostKey &key) const noexcept {
+    if (key.labelCount() == 0) {
+        return false;
+    }
+    const BloomFilter::SuffixHash &host = key.legacyHashes()[key.labelCount() - 1];
+    return probeHashes(host.hash1, host.hash2);
+}
+
+string_view FrozenBloomFilter::containsAnySuffix(const HostKey &key) const noexcept {
+    const BloomFilter::SuffixHash *suffixes = key.legacyHashes();
+    // Same early fetch as BloomFilter::probeSuffixHashes, every suffix is probed unless a longer one hits
+    for (size_t i = 0; i < key.labelCount(); i++) {
+        __builtin_prefetch(&words[reduce(suffixes[i].hash1) / WORD_BITS]);
+        __builtin_prefetch(&words[reduce(suffixes[i].hash2) / WORD_BITS]);
+    }
+
+    string_view host = key.host();
+    for (size_t i = key.labelCount(); i > 0; i--) {
+        if (probeHashes(suffixes[i - 1].hash1, suffixes[i - 1].hash2)) {
+            return host.substr(suffixes[i - 1].start);
+        }
+    }
+    return host.substr(host.size());
+}
+
+size_t FrozenBloomFilter::getBitCount() const noexcept {
+    return bitCount;
+}
+
+size_t FrozenBloomFilter::getHashRounds() const noexcept {
+    return hashRounds;
+}
+
+vector<BlockType> FrozenBloomFilter::blocks() const {
+    vector<BlockType> blocks((bitCount + 7) / 8);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i] = (BlockType) (words[i / sizeof(uint64_t)] >> (8 * (i % sizeof(uint64_t))));
+    }
+    return blocks;
+}
+
+FrozenBloomFilter::Words FrozenBloomFilter::allocateWords(size_t bitCount) {
+    return Words(new (align_val_t(CACHE_LINE_BYTES)) uint64_t[wordCountFor(bitCount)]());
+}
+
+size_t FrozenBloomFilter::wordCountFor(size_t bitCount) {
+    size_t words = (bitCount + WORD_BITS - 1) / WORD_BITS;
+    return (words + WORDS_PER_CACHE_LINE - 1) / WORDS_PER_CACHE_LINE * WORDS_PER_CACHE_LINE;
+}
+
+bool FrozenBloomFilter::probeHashes(unsigned int hash1, unsigned int hash2) const noexcept {
+    for (size_t i = 0; i < hashRounds; i++) {
+        size_t bit = reduce(BloomFilter::roundHash(hash1, hash2, (unsigned int) i));
+        if ((words[bit / WORD_BITS] & ((uint64_t) 1 << (bit % WORD_BITS))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t FrozenBloomFilter::reduce(unsigned int hash) const noexcept {
+    // Lemire's fastmod: the low bits of the multiplied hash are the fraction
+    // hash / divisor, which times the divisor gives the remainder
+    uint64_t fraction = reductionMultiplier * hash;
+    return (size_t) (((unsigned __int128) fraction * reductionDivisor) >> 64);
+}
+
+void FrozenBloomFilter::AlignedDelete::operator()(uint64_t *words) const {
+    operator delete[](words, align_val_t(CACHE_LINE_BYTES));
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include "HTTPSUpgradeEngine.hpp"
+#include "HostKey.hpp"
+
+using namespace std;
+
+static const char HTTP_PREFIX[] = "http://";
+static const size_t HTTP_PREFIX_LENGTH = sizeof(HTTP_PREFIX) - 1;
+static const char HTTPS_SCHEME[] = "https";
+static const size_t HTTPS_SCHEME_LENGTH = sizeof(HTTPS_SCHEME) - 1;
+// Length of "http", which the rewritten URL replaces with "https"
+static const size_t HTTP_SCHEME_LENGTH = 4;
+
+// Forward declarations
+
+static char toLowerASCII(char character);
+
+
+// Implementation
+
+HTTPSUpgradeEngine::HTTPSUpgradeEngine(size_t decisionCacheCapacity)
+    : upgradeList(make_shared<const UpgradeList>(UpgradeList { nullptr, PerfectDomainSet::build(vector<string>()) })),
+      featureState(make_shared<const FeatureState>(FeatureState { false, PerfectDomainSet::build(vector<string>()), PerfectDomainSet::build(vector<string>()) })),
+      decisionCache(decisionCacheCapacity) {
+}
+
+void HTTPSUpgradeEngine::setUpgradeList(shared_ptr<const FrozenBloomFilter> filter, const vector<string> &excludedDomains) {
+    auto list = make_shared<const UpgradeList>(UpgradeList { move(filter), PerfectDomainSet::build(excludedDomains) });
+    atomic_store(&upgradeList, list);
+    // Published before the generation moves on, see HostDecisionCache::store
+    decisionCache.invalidate();
+}
+
+void HTTPSUpgradeEngine::setExcludedDomains(const vector<string> &excludedDomains) {
+    setUpgradeList(atomic_load(&upgradeList)->filter, excludedDomains);
+}
+
+void HTTPSUpgradeEngine::setFeatureState(bool enabled,
+                                         const vector<string> &exceptionDomains,
+                                         const vector<string> &unprotectedDomains) {
+    auto state = make_shared<const FeatureState>(FeatureState {
+        enabled,
+        PerfectDomainSet::build(exceptionDomains),
+        PerfectDomainSet::build(unprotectedDomains)
+    });
+    atomic_store(&featureState, state);
+}
+
+void HTTPSUpgradeEngine::setFailureMemory(shared_ptr<AgePartitionedBloomFilter> failures) {
+    atomic_store(&recentFailures, move(failures));
+}
+
+bool HTTPSUpgradeEngine::recordUpgradeFailure(string_view host) {
+    HostKey key;
+    auto failures = atomic_load(&recentFailures);
+    if (failures == nullptr || host.size() > MAX_HOST_LENGTH || !key.assign(host)) {
+        return false;
+    }
+    failures->add(key);
+    return true;
+}
+
+HTTPSUpgradeVerdict HTTPSUpgradeEngine::decide(const char *url, size_t length, char *output, size_t capacity, size_t &outputLength) {
+    outputLength = 0;
+
+    string_view hostPart;
+    HTTPSUpgradeVerdict verdict = findHost(string_view(url, length), hostPart);
+    if (verdict != HTTPSUpgradeVerdict::upgrade) {
+        return verdict;
+    }
+    verdict = decideHost(hostPart);
+    if (verdict != HTTPSUpgradeVerdict::upgrade) {
+        return verdict;
+    }
+
+    outputLength = length + HTTPS_SCHEME_LENGTH - HTTP_SCHEME_LENGTH;
+    if (capacity < outputLength + 1) {
+        return HTTPSUpgradeVerdict::bufferTooSmall;
+    }
+    memcpy(output, HTTPS_SCHEME, HTTPS_SCHEME_LENGTH);
+    memcpy(output + HTTPS_SCHEME_LENGTH, url + HTTP_SCHEME_LENGTH, length - HTTP_SCHEME_LENGTH);
+    output[outputLength] = '\0';
+    return HTTPSUpgradeVerdict::upgrade;
+}
+
+HTTPSUpgradeVerdict HTTPSUpgradeEngine::decideHost(string_view host) {
+    // Canonicalized and hashed once for the feature state, the cache, the excluded domains and the filter
+    HostKey key;
+    if (host.size() > MAX_HOST_LENGTH || !key.assign(host)) {
+        return HTTPSUpgradeVerdict::invalidHost;
+    }
+
+    if (!atomic_load(&featureState)->isEnabledFor(key)) {
+        return HTTPSUpgradeVerdict::featureDisabled;
+    }
+
+    bool upgradable;
+    HostDecisionCache::Generation generation;
+    if (!decisionCache.lookup(key.hash(), upgradable, generation)) {
+        auto list = atomic_load(&upgradeList);
+        if (list->excludedDomains.contains(key)) {
+            decisionCache.store(key.hash(), false, generation);
+            return HTTPSUpgradeVerdict::excluded;
+        }
+        upgradable = list->containsUpgradable(key);
+        decisionCache.store(key.hash(), upgradable, generation);
+    }
+    // Cached negatives don't remember why; both reasons are a failure to the caller
+    if (!upgradable) {
+        return HTTPSUpgradeVerdict::notInUpgradeList;
+    }
+
+    // Never cached, failures expire on their own
+    auto failures = atomic_load(&recentFailures);
+    if (failures != nullptr && failures->contains(key)) {
+        return HTTPSUpgradeVerdict::recentlyFailed;
+    }
+    return HTTPSUpgradeVerdict::upgrade;
+}
+
+HTTPSUpgradeVerdict HTTPSUpgradeEngine::parseHost(string_view url, char *host, size_t &hostLength) {
+    hostLength = 0;
+    string_view hostPart;
+    HTTPSUpgradeVerdict verdict = findHost(url, hostPart);
+    if (verdict != HTTPSUpgradeVerdict::upgrade) {
+        return verdict;
+    }
+    for (size_t i = 0; i < hostPart.size(); i++) {
+        host[i] = toLowerASCII(hostPart[i]);
+    }
+    hostLength = hostPart.size();
+    return HTTPSUpgradeVerdict::upgrade;
+}
+
+HTTPSUpgradeVerdict HTTPSUpgradeEngine::findHost(string_view url, string_view &host) {
+    if (url.size() < HTTP_PREFIX_LENGTH) {
+        return HTTPSUpgradeVerdict::notHTTP;
+    }
+    // Schemes are case insensitive, the slashes are required for a host
+    for (size_t i = 0; i < HTTP_PREFIX_LENGTH; i++) {
+        if (toLowerASCII(url[i]) != HTTP_PREFIX[i]) {
+            return HTTPSUpgradeVerdict::notHTTP;
+        }
+    }
+
+    size_t authorityStart = HTTP_PREFIX_LENGTH;
+    size_t authorityEnd = url.find_first_of("/?#", authorityStart);
+    if (authorityEnd == string_view::npos) {
+        authorityEnd = url.size();
+    }
+    string_view authority = url.substr(authorityStart, authorityEnd - authorityStart);
+
+    size_t userInfoEnd = authority.rfind('@');
+    if (userInfoEnd != string_view::npos) {
+        authority.remove_prefix(userInfoEnd + 1);
+    }
+
+    if (!authority.empty() && authority.front() == '[') {
+        size_t literalEnd = authority.find(']');
+        if (literalEnd == string_view::npos) {
+            return HTTPSUpgradeVerdict::invalidHost;
+        }
+        host = authority.substr(1, literalEnd - 1);
+    } else {
+        host = authority.substr(0, authority.find(':'));
+    }
+
+    if (host.empty() || host.size() > MAX_HOST_LENGTH) {
+        return HTTPSUpgradeVerdict::invalidHost;
+    }
+    for (char character : host) {
+        if ((unsigned char) character <= ' ') {
+            return HTTPSUpgradeVerdict::invalidHost;
+        }
+    }
+    return HTTPSUpgradeVerdict::upgrade;
+}
+
+HostDecisionCacheStats HTTPSUpgradeEngine::cacheStats() const {
+    return decisionCache.stats();
+}
+
+bool HTTPSUpgradeEngine::UpgradeList::containsUpgradable(const HostKey &key) const {
+    return filter != nullptr && filter->contains(key);
+}
+
+bool HTTPSUpgradeEngine::FeatureState::isEnabledFor(const HostKey &key) const {
+    if (!enabled) {
+        return false;
+    }
+    if (unprotectedDomains.contains(key)) {
+        return false;
+    }
+
+    // Exceptions match the host and its parents, down to the last two labels
+    for (size_t label = 0; label + 1 < key.labelCount(); label++) {
+        if (exceptionDomains.contains(key, label)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static char toLowerASCII(char character) {
+    return character >= 'A' && character <= 'Z' ? (char) (character + ('a' - 'A')) : character;
+}
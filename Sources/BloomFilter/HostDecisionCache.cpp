@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include "HostDecisionCache.hpp"
+
+using namespace std;
+
+static const uint64_t VALID_BIT = 1;
+static const uint64_t VERDICT_BIT = 2;
+static const size_t WAYS = 2;
+
+// Forward declarations
+
+static size_t roundUpToPowerOfTwo(size_t value);
+
+
+// Implementation
+
+HostDecisionCache::HostDecisionCache(size_t capacity)
+    : mask(roundUpToPowerOfTwo(max<size_t>(capacity, WAYS)) - 1),
+      slots(new atomic<uint64_t>[mask + 1]),
+      generation(0),
+      invalidations(0) {
+    for (size_t i = 0; i <= mask; i++) {
+        slots[i].store(0, memory_order_relaxed);
+    }
+}
+
+bool HostDecisionCache::lookup(uint64_t hostHash, bool &verdict, Generation &currentGeneration) {
+    currentGeneration = generation.load(memory_order_acquire);
+    uint64_t expected = pack(hostHash, false, currentGeneration);
+
+    size_t bucket = hostHash & mask & ~(size_t) 1;
+    for (size_t way = 0; way < WAYS; way++) {
+        uint64_t entry = slots[bucket + way].load(memory_order_relaxed);
+        if ((entry & ~VERDICT_BIT) == expected) {
+            counters[counterShard()].hits.fetch_add(1, memory_order_relaxed);
+            verdict = (entry & VERDICT_BIT) != 0;
+            return true;
+        }
+    }
+
+    counters[counterShard()].misses.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+void HostDecisionCache::store(uint64_t hostHash, bool verdict, Generation computedInGeneration) {
+    // A verdict computed against data that has since been replaced is dropped
+    if (computedInGeneration != generation.load(memory_order_acquire)) {
+        return;
+    }
+
+    uint64_t entry = pack(hostHash, verdict, computedInGeneration);
+    uint64_t generationBits = entry & GENERATION_FIELD;
+    size_t bucket = hostHash & mask & ~(size_t) 1;
+
+    // Reuse the way that holds this host or a retired entry, otherwise evict by a hash bit
+    size_t target = bucket + ((hostHash >> TAG_SHIFT) & 1);
+    for (size_t way = 0; way < WAYS; way++) {
+        uint64_t existing = slots[bucket + way].load(memory_order_relaxed);
+        bool sameHost = ((existing ^ entry) >> TAG_SHIFT) == 0 && (existing & VALID_BIT) != 0;
+        bool retired = (existing & VALID_BIT) == 0 || (existing & GENERATION_FIELD) != generationBits;
+        if (sameHost || retired) {
+            target = bucket + way;
+            break;
+        }
+    }
+    slots[target].store(entry, memory_order_relaxed);
+}
+
+void HostDecisionCache::invalidate() {
+    Generation next = generation.fetch_add(1, memory_order_acq_rel) + 1;
+    invalidations.fetch_add(1, memory_order_relaxed);
+
+    // Generations are stored in GENERATION_BITS; once they wrap, old entries could match again
+    if ((next & GENERATION_MASK) == 0) {
+        for (size_t i = 0; i <= mask; i++) {
+            slots[i].store(0, memory_order_relaxed);
+        }
+    }
+}
+
+size_t HostDecisionCache::getCapacity() const {
+    return mask + 1;
+}
+
+HostDecisionCacheStats HostDecisionCache::stats() const {
+    HostDecisionCacheStats stats { 0, 0, invalidations.load(memory_order_relaxed) };
+    for (const auto &shard : counters) {
+        stats.hits += shard.hits.load(memory_order_relaxed);
+        stats.misses += shard.misses.load(memory_order_relaxed);
+    }
+    return stats;
+}
+
+uint64_t HostDecisionCache::pack(uint64_t hostHash, bool verdict, Generation entryGeneration) {
+    // Slot index comes from the low bits, so the tag uses the high ones
+    uint64_t tag = hostHash >> TAG_SHIFT;
+    return (tag << TAG_SHIFT)
+        | (((uint64_t) entryGeneration & GENERATION_MASK) << 2)
+        | (verdict ? VERDICT_BIT : 0)
+        | VALID_BIT;
+}
+
+size_t HostDecisionCache::counterShard() {
+    // Handed out round robin on a thread's first lookup
+    static atomic<size_t> nextShard { 0 };
+    thread_local size_t shard = nextShard.fetch_add(1, memory_order_relaxed) % COUNTER_SHARDS;
+    return shard;
+}
+
+double HostDecisionCacheStats::hitRatio() const {
+    uint64_t total = hits + misses;
+    return total == 0 ? 0 : (double) hits / total;
+}
+
+static size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "Hash64.hpp"
+#include "HostKey.hpp"
+
+using namespace std;
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Byte positions are read from the low end of a word");
+
+static const uint64_t ONES = 0x0101010101010101ull;
+static const uint64_t HIGH_BITS = 0x8080808080808080ull;
+// The bit that separates upper and lower case ASCII letters
+static const int CASE_SHIFT = 2;
+static const char WWW_PREFIX[] = "www.";
+static const size_t WWW_PREFIX_LENGTH = sizeof(WWW_PREFIX) - 1;
+
+// Forward declarations
+
+static uint64_t bytesInRange(uint64_t word, unsigned char low, unsigned char high);
+
+
+// Implementation
+
+HostKey::HostKey() : length(0), labels(0) {
+}
+
+bool HostKey::assign(string_view rawHost, bool stripWWW) {
+    length = 0;
+    labels = 0;
+    // One more byte for a trailing dot
+    if (rawHost.empty() || rawHost.size() > MAX_LENGTH + 1) {
+        return false;
+    }
+
+    labelStarts[0] = 0;
+    size_t starts = 1;
+    for (size_t offset = 0; offset < rawHost.size(); offset += sizeof(uint64_t)) {
+        size_t count = min(sizeof(uint64_t), rawHost.size() - offset);
+        uint64_t word = 0;
+        memcpy(&word, rawHost.data() + offset, count);
+        uint64_t present = count == sizeof(uint64_t) ? HIGH_BITS : HIGH_BITS & ((1ull << (count * 8)) - 1);
+
+        // The range checks below need every byte below 0x80
+        if ((word & HIGH_BITS) != 0) {
+            return false;
+        }
+        word |= bytesInRange(word, 'A', 'Z') >> CASE_SHIFT;
+        uint64_t allowed = bytesInRange(word, 'a', 'z')
+            | bytesInRange(word, '0', ':')
+            | bytesInRange(word, '-', '.')
+            | bytesInRange(word, '_', '_');
+        if ((allowed & present) != present) {
+            return false;
+        }
+        memcpy(bytes + offset, &word, count);
+
+        uint64_t dots = bytesInRange(word, '.', '.') & present;
+        while (dots != 0) {
+            size_t next = offset + (size_t) __builtin_ctzll(dots) / 8 + 1;
+            if (starts == MAX_LABELS + 1) {
+                return false;
+            }
+            labelStarts[starts++] = (uint8_t) next;
+            dots &= dots - 1;
+        }
+    }
+
+    size_t end = rawHost.size();
+    if (bytes[end - 1] == '.') {
+        end--;
+        starts--;
+    }
+    // Empty labels, including a leading dot or a lone "."
+    for (size_t i = 0; i < starts; i++) {
+        size_t labelEnd = i + 1 < starts ? labelStarts[i + 1] - 1 : end;
+        if (labelEnd <= labelStarts[i]) {
+            return false;
+        }
+    }
+    if (end > MAX_LENGTH) {
+        return false;
+    }
+
+    size_t first = 0;
+    if (stripWWW && starts > 1 && end > WWW_PREFIX_LENGTH && memcmp(bytes, WWW_PREFIX, WWW_PREFIX_LENGTH) == 0) {
+        memmove(bytes, bytes + WWW_PREFIX_LENGTH, end - WWW_PREFIX_LENGTH);
+        end -= WWW_PREFIX_LENGTH;
+        first = 1;
+    }
+    for (size_t i = first; i < starts; i++) {
+        labelStarts[i - first] = (uint8_t) (labelStarts[i] - (first == 0 ? 0 : WWW_PREFIX_LENGTH));
+    }
+    length = (uint8_t) end;
+    labels = (uint8_t) (starts - first);
+
+    for (size_t i = 0; i < labels; i++) {
+        hashes[i] = hash64(bytes + labelStarts[i], length - labelStarts[i]);
+    }
+    BloomFilter::hashSuffixes(host(), legacy, MAX_LABELS);
+    return true;
+}
+
+string_view HostKey::host() const {
+    return string_view(bytes, length);
+}
+
+size_t HostKey::labelCount() const {
+    return labels;
+}
+
+string_view HostKey::suffix(size_t label) const {
+    return label < labels ? host().substr(labelStarts[label]) : host().substr(length);
+}
+
+uint64_t HostKey::hash(size_t label) const {
+    return hashes[label];
+}
+
+const BloomFilter::SuffixHash *HostKey::legacyHashes() const {
+    return legacy;
+}
+
+/*
+ Sets the high bit of every byte of `word` within [low, high], for words whose
+ bytes are all below 0x80. Adding 0x80 - low carries into the high bit exactly
+ when a byte is at least low, adding 0x7f - high when it is above high, and
+ neither sum can carry into the next byte.
+ */
+static uint64_t bytesInRange(uint64_t word, unsigned char low, unsigned char high) {
+    uint64_t atLeastLow = word + ONES * (uint64_t) (0x80 - low);
+    uint64_t aboveHigh = word + ONES * (uint64_t) (0x7f - high);
+    return atLeastLow & ~aboveHigh & HIGH_BITS;
+}
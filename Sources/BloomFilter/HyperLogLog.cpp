@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include "Hash64.hpp"
+#include "HyperLogLog.hpp"
+
+using namespace std;
+
+// Below this multiple of the register count, linear counting is more accurate
+static const double LINEAR_COUNTING_THRESHOLD = 2.5;
+
+// Forward declarations
+
+static double biasCorrection(size_t registerCount);
+
+
+// Implementation
+
+HyperLogLog::HyperLogLog(unsigned precision) : precision(precision) {
+    if (precision < MIN_PRECISION || precision > MAX_PRECISION) {
+        throw runtime_error("Invalid HyperLogLog precision " + to_string(precision));
+    }
+    registers.resize((size_t) 1 << precision);
+}
+
+void HyperLogLog::add(uint64_t hash) {
+    size_t index = hash >> (64 - precision);
+    // The position of the first set bit after the index bits, with a stop bit in case there is none
+    uint64_t remaining = (hash << precision) | ((uint64_t) 1 << (precision - 1));
+    auto rank = (uint8_t) (__builtin_clzll(remaining) + 1);
+    if (rank > registers[index]) {
+        registers[index] = rank;
+    }
+}
+
+void HyperLogLog::add(string_view element) {
+    add(hash64(element.data(), element.size()));
+}
+
+void HyperLogLog::merge(const HyperLogLog &other) {
+    if (other.precision != precision) {
+        throw runtime_error("Can't merge HyperLogLogs of different precision");
+    }
+    for (size_t i = 0; i < registers.size(); i++) {
+        registers[i] = max(registers[i], other.registers[i]);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    double sum = 0;
+    size_t emptyRegisters = 0;
+    for (uint8_t value : registers) {
+        sum += ldexp(1.0, -value);
+        emptyRegisters += value == 0;
+    }
+
+    auto count = (double) registers.size();
+    double estimate = biasCorrection(registers.size()) * count * count / sum;
+    if (estimate <= LINEAR_COUNTING_THRESHOLD * count && emptyRegisters > 0) {
+        estimate = count * log(count / emptyRegisters);
+    }
+    return estimate;
+}
+
+double HyperLogLog::relativeError() const {
+    return 1.04 / sqrt((double) registers.size());
+}
+
+static double biasCorrection(size_t registerCount) {
+    switch (registerCount) {
+    case 16:
+        return 0.673;
+    case 32:
+        return 0.697;
+    case 64:
+        return 0.709;
+    default:
+        return 0.7213 / (1 + 1.079 / registerCount);
+    }
+}
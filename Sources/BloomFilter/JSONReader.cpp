@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "JSONReader.hpp"
+
+using namespace std;
+
+// Deeper documents are rejected rather than risking the stack
+static const size_t MAX_DEPTH = 512;
+
+// Forward declarations
+
+static void appendUTF8(string &output, uint32_t codePoint);
+
+static int hexDigitValue(char digit);
+
+
+// Implementation
+
+JSONValue::JSONValue() : type(Type::null), boolValue(false), numberValue(0) {
+}
+
+JSONValue::Type JSONValue::getType() const {
+    return type;
+}
+
+bool JSONValue::isNull() const {
+    return type == Type::null;
+}
+
+bool JSONValue::isBool() const {
+    return type == Type::boolean;
+}
+
+bool JSONValue::isNumber() const {
+    return type == Type::number;
+}
+
+bool JSONValue::isString() const {
+    return type == Type::string;
+}
+
+bool JSONValue::isArray() const {
+    return type == Type::array;
+}
+
+bool JSONValue::isObject() const {
+    return type == Type::object;
+}
+
+bool JSONValue::asBool() const {
+    if (type != Type::boolean) {
+        throw runtime_error("JSON value is not a boolean");
+    }
+    return boolValue;
+}
+
+double JSONValue::asNumber() const {
+    if (type != Type::number) {
+        throw runtime_error("JSON value is not a number");
+    }
+    return numberValue;
+}
+
+const string &JSONValue::asString() const {
+    if (type != Type::string) {
+        throw runtime_error("JSON value is not a string");
+    }
+    return stringValue;
+}
+
+const JSONValue::Array &JSONValue::asArray() const {
+    if (type != Type::array) {
+        throw runtime_error("JSON value is not an array");
+    }
+    return arrayValue;
+}
+
+const JSONValue::Object &JSONValue::asObject() const {
+    if (type != Type::object) {
+        throw runtime_error("JSON value is not an object");
+    }
+    return objectValue;
+}
+
+const JSONValue *JSONValue::find(string_view key) const {
+    if (type != Type::object) {
+        return nullptr;
+    }
+    for (const auto &member : objectValue) {
+        if (member.first == key) {
+            return &member.second;
+        }
+    }
+    return nullptr;
+}
+
+const JSONValue &JSONValue::at(string_view key) const {
+    const JSONValue *value = find(key);
+    if (value == nullptr) {
+        throw runtime_error("JSON object has no member " + string(key));
+    }
+    return *value;
+}
+
+JSONValue JSONReader::parse(string_view text) {
+    JSONReader reader(text);
+    JSONValue value = reader.parseValue(0);
+    reader.skipWhitespace();
+    if (reader.position != text.size()) {
+        reader.fail("Unexpected trailing characters");
+    }
+    return value;
+}
+
+JSONValue JSONReader::parseFile(const string &path) {
+    ifstream in(path, ifstream::binary);
+    if (!in) {
+        throw runtime_error("Can't read " + path);
+    }
+    string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    return parse(contents);
+}
+
+JSONReader::JSONReader(string_view text) : text(text), position(0) {
+}
+
+JSONValue JSONReader::parseValue(size_t depth) {
+    if (depth > MAX_DEPTH) {
+        fail("Nesting too deep");
+    }
+    skipWhitespace();
+    if (position >= text.size()) {
+        fail("Unexpected end of input");
+    }
+
+    JSONValue value;
+    char next = text[position];
+    if (next == '{') {
+        position++;
+        value.type = JSONValue::Type::object;
+        skipWhitespace();
+        if (consume('}')) {
+            return value;
+        }
+        do {
+            skipWhitespace();
+            string key;
+            parseString(key);
+            skipWhitespace();
+            expect(':');
+            value.objectValue.emplace_back(move(key), parseValue(depth + 1));
+            skipWhitespace();
+        } while (consume(','));
+        expect('}');
+    } else if (next == '[') {
+        position++;
+        value.type = JSONValue::Type::array;
+        skipWhitespace();
+        if (consume(']')) {
+            return value;
+        }
+        do {
+            value.arrayValue.push_back(parseValue(depth + 1));
+            skipWhitespace();
+        } while (consume(','));
+        expect(']');
+    } else if (next == '"') {
+        value.type = JSONValue::Type::string;
+        parseString(value.stringValue);
+    } else if (text.substr(position, 4) == "true") {
+        position += 4;
+        value.type = JSONValue::Type::boolean;
+        value.boolValue = true;
+    } else if (text.substr(position, 5) == "false") {
+        position += 5;
+        value.type = JSONValue::Type::boolean;
+    } else if (text.substr(position, 4) == "null") {
+        position += 4;
+    } else {
+        parseNumber(value);
+    }
+    return value;
+}
+
+void JSONReader::parseString(string &output) {
+    expect('"');
+    while (true) {
+        size_t end = text.find_first_of("\"\\", position);
+        if (end == string_view::npos) {
+            fail("Unterminated string");
+        }
+        output.append(text.data() + position, end - position);
+        position = end + 1;
+        if (text[end] == '"') {
+            return;
+        }
+
+        if (position >= text.size()) {
+            fail("Unterminated escape");
+        }
+        char escaped = text[position++];
+        switch (escaped) {
+            case '"': output.push_back('"'); break;
+            case '\\': output.push_back('\\'); break;
+            case '/': output.push_back('/'); break;
+            case 'b': output.push_back('\b'); break;
+            case 'f': output.push_back('\f'); break;
+            case 'n': output.push_back('\n'); break;
+            case 'r': output.push_back('\r'); break;
+            case 't': output.push_back('\t'); break;
+            case 'u': {
+                uint32_t codePoint = 0;
+                for (int pass = 0; pass < 2; pass++) {
+                    if (position + 4 > text.size()) {
+                        fail("Truncated unicode escape");
+                    }
+                    uint32_t unit = 0;
+                    for (size_t i = 0; i < 4; i++) {
+                        int digit = hexDigitValue(text[position++]);
+                        if (digit < 0) {
+                            fail("Invalid unicode escape");
+                        }
+                        unit = (unit << 4) | (uint32_t) digit;
+                    }
+                    if (pass == 1) {
+                        if (unit < 0xdc00 || unit > 0xdfff) {
+                            fail("Invalid surrogate pair");
+                        }
+                        codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (unit - 0xdc00);
+                        break;
+                    }
+                    codePoint = unit;
+                    // A high surrogate must be followed by an escaped low one
+                    if (unit < 0xd800 || unit > 0xdbff) {
+                        break;
+                    }
+                    if (text.substr(position, 2) != "\\u") {
+                        fail("Invalid surrogate pair");
+                    }
+                    position += 2;
+                }
+                appendUTF8(output, codePoint);
+                break;
+            }
+            default:
+                fail("Invalid escape");
+        }
+    }
+}
+
+void JSONReader::parseNumber(JSONValue &value) {
+    size_t start = position;
+    if (position < text.size() && text[position] == '-') {
+        position++;
+    }
+    while (position < text.size() && (isdigit((unsigned char) text[position]) || text[position] == '.'
+                                      || text[position] == 'e' || text[position] == 'E'
+                                      || text[position] == '+' || text[position] == '-')) {
+        position++;
+    }
+    if (position == start) {
+        fail("Unexpected character");
+    }
+
+    string number(text.substr(start, position - start));
+    char *end;
+    value.numberValue = strtod(number.c_str(), &end);
+    if (end != number.c_str() + number.size()) {
+        position = start;
+        fail("Invalid number");
+    }
+    value.type = JSONValue::Type::number;
+}
+
+void JSONReader::skipWhitespace() {
+    while (position < text.size()
+           && (text[position] == ' ' || text[position] == '\n' || text[position] == '\r' || text[position] == '\t')) {
+        position++;
+    }
+}
+
+bool JSONReader::consume(char expected) {
+    if (position < text.size() && text[position] == expected) {
+        position++;
+        return true;
+    }
+    return false;
+}
+
+void JSONReader::expect(char expected) {
+    if (!consume(expected)) {
+        string message = "Expected '";
+        message.push_back(expected);
+        message.push_back('\'');
+        fail(message.c_str());
+    }
+}
+
+void JSONReader::fail(const char *message) const {
+    throw runtime_error(string(message) + " at offset " + to_string(position));
+}
+
+static void appendUTF8(string &output, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        output.push_back((char) codePoint);
+    } else if (codePoint < 0x800) {
+        output.push_back((char) (0xc0 | (codePoint >> 6)));
+        output.push_back((char) (0x80 | (codePoint & 0x3f)));
+    } else if (codePoint < 0x10000) {
+        output.push_back((char) (0xe0 | (codePoint >> 12)));
+        output.push_back((char) (0x80 | ((codePoint >> 6) & 0x3f)));
+        output.push_back((char) (0x80 | (codePoint & 0x3f)));
+    } else {
+        output.push_back((char) (0xf0 | (codePoint >> 18)));
+        output.push_back((char) (0x80 | ((codePoint >> 12) & 0x3f)));
+        output.push_back((char) (0x80 | ((codePoint >> 6) & 0x3f)));
+        output.push_back((char) (0x80 | (codePoint & 0x3f)));
+    }
+}
+
+static int hexDigitValue(char digit) {
+    if (digit >= '0' && digit <= '9') {
+        return digit - '0';
+    }
+    if (digit >= 'a' && digit <= 'f') {
+        return digit - 'a' + 10;
+    }
+    if (digit >= 'A' && digit <= 'F') {
+        return digit - 'A' + 10;
+    }
+    return -1;
+}
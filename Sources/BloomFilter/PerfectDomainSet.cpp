@@ -0,0 +1,596 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include "Hash64.hpp"
+#include "HostKey.hpp"
+#include "PerfectDomainSet.hpp"
+
+using namespace std;
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The serialized form is read in place as little endian");
+
+static const char MAGIC[8] = { 'D', 'D', 'G', 'P', 'H', 'S', 'E', 'T' };
+static const size_t HEADER_SIZE = 64;
+static const size_t PARTITION_SIZE = 32;
+static const uint32_t FLAG_STRINGS = 1;
+
+// Average keys per partition, small enough to stay in cache while building
+static const size_t KEYS_PER_PARTITION = 1 << 15;
+// Buckets are c * n / log2(n), a larger c gives smaller pilots but more of them
+static const double BUCKET_FACTOR = 3.5;
+// 60% of the keys go to the first 30% of the buckets, which are placed while the table is empty
+static const uint32_t DENSE_KEY_THRESHOLD = (uint32_t) (0.6 * 4294967296.0);
+static const double DENSE_BUCKET_SHARE = 0.3;
+// One spare slot per 100 keys keeps the last pilots small
+static const uint32_t TABLE_SLACK_DIVISOR = 100;
+static const uint32_t MAX_PILOT = 1 << 24;
+static const int MAX_SEED_ATTEMPTS = 8;
+static const uint64_t BUCKET_SEED = 0x9e3779b97f4a7c15ull;
+
+// Forward declarations
+
+struct Layout {
+    size_t partitions;
+    size_t pilots;
+    size_t remap;
+    size_t fingerprints;
+    size_t stringBytes;
+    size_t total;
+};
+
+static bool computeLayout(uint64_t keyCount, uint64_t partitionCount, uint64_t pilotWordCount, uint64_t remapCount,
+                          bool strings, uint64_t stringByteCount, Layout &layout);
+
+static uint32_t bucketFor(uint64_t hash, uint32_t bucketCount);
+
+static uint32_t positionFor(uint64_t hash, uint64_t pilotHash, uint32_t tableSize);
+
+static bool buildPartition(const uint64_t *hashes, uint32_t keyCount, uint32_t tableSize, uint32_t bucketCount, uint64_t seed,
+                           uint32_t *pilots, uint32_t *remap, uint32_t *positions);
+
+template <typename T>
+static T load(const char *address);
+
+template <typename T>
+static void store(char *address, T value);
+
+
+// Implementation
+
+PerfectDomainSet PerfectDomainSet::build(const vector<string> &domains, bool keepStrings, size_t threadCount) {
+    vector<string_view> views(domains.begin(), domains.end());
+    return build(views, keepStrings, threadCount);
+}
+
+PerfectDomainSet PerfectDomainSet::build(const vector<string_view> &domains, bool keepStrings, size_t threadCount) {
+    if (domains.size() >= UINT32_MAX / 2) {
+        throw runtime_error("Too many domains");
+    }
+    if (threadCount == 0) {
+        threadCount = max<size_t>(thread::hardware_concurrency(), 1);
+    }
+
+    // Seeds are mixed into the unseeded hash, which is what a HostKey holds
+    vector<uint64_t> domainHashes(domains.size());
+    for (size_t i = 0; i < domains.size(); i++) {
+        domainHashes[i] = hash64(domains[i].data(), domains[i].size());
+    }
+
+    for (int attempt = 0; attempt < MAX_SEED_ATTEMPTS; attempt++) {
+        uint64_t seed = hash64Remix((uint64_t) attempt, BUCKET_SEED);
+
+        // Sorting by hash removes duplicates and lays the partitions out contiguously
+        vector<pair<uint64_t, uint32_t>> keys(domains.size());
+        for (size_t i = 0; i < domains.size(); i++) {
+            keys[i] = { hash64Remix(domainHashes[i], seed), (uint32_t) i };
+        }
+        sort(keys.begin(), keys.end());
+
+        vector<uint64_t> hashes;
+        vector<uint32_t> sources;
+        hashes.reserve(keys.size());
+        sources.reserve(keys.size());
+        bool collision = false;
+        for (size_t i = 0; i < keys.size() && !collision; i++) {
+            if (!hashes.empty() && hashes.back() == keys[i].first) {
+                collision = domains[sources.back()] != domains[keys[i].second];
+                continue;
+            }
+            hashes.push_back(keys[i].first);
+            sources.push_back(keys[i].second);
+        }
+        if (collision) {
+            continue;
+        }
+
+        uint64_t keyCount = hashes.size();
+        uint32_t partitionCount = (uint32_t) max<uint64_t>(1, (keyCount + KEYS_PER_PARTITION - 1) / KEYS_PER_PARTITION);
+        vector<Partition> partitionTable(partitionCount);
+        uint64_t bucketTotal = 0;
+        uint64_t remapTotal = 0;
+        size_t keyIndex = 0;
+        for (uint32_t p = 0; p < partitionCount; p++) {
+            size_t end = keyIndex;
+            while (end < keyCount && (uint32_t) (((__uint128_t) hashes[end] * partitionCount) >> 64) == p) {
+                end++;
+            }
+            Partition &partition = partitionTable[p];
+            partition.keyOffset = keyIndex;
+            partition.keyCount = (uint32_t) (end - keyIndex);
+            partition.tableSize = partition.keyCount == 0 ? 0 : partition.keyCount + partition.keyCount / TABLE_SLACK_DIVISOR + 1;
+            partition.bucketCount = partition.keyCount == 0 ? 0 : (uint32_t) ceil(BUCKET_FACTOR * partition.keyCount / log2(partition.keyCount + 1.0));
+            partition.bucketOffset = bucketTotal;
+            partition.remapOffset = (uint32_t) remapTotal;
+            bucketTotal += partition.bucketCount;
+            remapTotal += partition.tableSize - partition.keyCount;
+            keyIndex = end;
+        }
+
+        vector<uint32_t> pilotValues(bucketTotal);
+        vector<uint32_t> remapValues(remapTotal);
+        vector<uint32_t> positions(keyCount);
+        atomic<uint32_t> nextPartition(0);
+        atomic<bool> failed(false);
+        auto worker = [&]() {
+            uint32_t p;
+            while (!failed.load(memory_order_relaxed) && (p = nextPartition.fetch_add(1)) < partitionCount) {
+                const Partition &partition = partitionTable[p];
+                if (partition.keyCount == 0) {
+                    continue;
+                }
+                if (!buildPartition(&hashes[partition.keyOffset], partition.keyCount, partition.tableSize, partition.bucketCount, seed,
+                                    &pilotValues[partition.bucketOffset], &remapValues[partition.remapOffset], &positions[partition.keyOffset])) {
+                    failed = true;
+                }
+            }
+        };
+        size_t workers = min<size_t>(threadCount, partitionCount);
+        if (workers <= 1) {
+            worker();
+        } else {
+            vector<thread> threads;
+            for (size_t i = 0; i < workers; i++) {
+                threads.emplace_back(worker);
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+        }
+        if (failed) {
+            continue;
+        }
+
+        uint32_t maxPilot = pilotValues.empty() ? 0 : *max_element(pilotValues.begin(), pilotValues.end());
+        uint32_t pilotBits = 1;
+        while (pilotBits < 32 && (maxPilot >> pilotBits) != 0) {
+            pilotBits++;
+        }
+        uint64_t pilotWordCount = (bucketTotal * pilotBits + 63) / 64;
+
+        // Fingerprints and verification strings are stored in slot order
+        vector<uint32_t> slotSources(keyCount);
+        vector<uint64_t> slotHashes(keyCount);
+        uint64_t stringByteCount = 0;
+        for (uint32_t p = 0; p < partitionCount; p++) {
+            const Partition &partition = partitionTable[p];
+            for (uint32_t i = 0; i < partition.keyCount; i++) {
+                size_t key = partition.keyOffset + i;
+                slotSources[partition.keyOffset + positions[key]] = sources[key];
+                slotHashes[partition.keyOffset + positions[key]] = hashes[key];
+            }
+        }
+        if (keepStrings) {
+            for (auto source : sources) {
+                stringByteCount += domains[source].size();
+            }
+            if (stringByteCount >= UINT32_MAX) {
+                throw runtime_error("Domains are too long to keep");
+            }
+        }
+
+        Layout layout;
+        if (!computeLayout(keyCount, partitionCount, pilotWordCount, remapTotal, keepStrings, stringByteCount, layout)) {
+            throw runtime_error("Too many domains");
+        }
+        vector<char> data(layout.total, 0);
+        memcpy(data.data(), MAGIC, sizeof(MAGIC));
+        store<uint32_t>(&data[8], CURRENT_VERSION);
+        store<uint32_t>(&data[12], keepStrings ? FLAG_STRINGS : 0);
+        store<uint64_t>(&data[16], seed);
+        store<uint64_t>(&data[24], keyCount);
+        store<uint32_t>(&data[32], partitionCount);
+        store<uint32_t>(&data[36], pilotBits);
+        store<uint64_t>(&data[40], pilotWordCount);
+        store<uint64_t>(&data[48], remapTotal);
+        store<uint64_t>(&data[56], stringByteCount);
+
+        for (uint32_t p = 0; p < partitionCount; p++) {
+            const Partition &partition = partitionTable[p];
+            char *entry = &data[layout.partitions + p * PARTITION_SIZE];
+            store<uint64_t>(entry, partition.keyOffset);
+            store<uint64_t>(entry + 8, partition.bucketOffset);
+            store<uint32_t>(entry + 16, partition.keyCount);
+            store<uint32_t>(entry + 20, partition.tableSize);
+            store<uint32_t>(entry + 24, partition.bucketCount);
+            store<uint32_t>(entry + 28, partition.remapOffset);
+        }
+        for (uint64_t bucket = 0; bucket < bucketTotal; bucket++) {
+            uint64_t bit = bucket * pilotBits;
+            char *word = &data[layout.pilots + bit / 64 * 8];
+            store<uint64_t>(word, load<uint64_t>(word) | (uint64_t) pilotValues[bucket] << (bit % 64));
+            if (bit % 64 + pilotBits > 64) {
+                store<uint64_t>(word + 8, load<uint64_t>(word + 8) | (uint64_t) pilotValues[bucket] >> (64 - bit % 64));
+            }
+        }
+        for (uint64_t i = 0; i < remapTotal; i++) {
+            store<uint32_t>(&data[layout.remap + i * 4], remapValues[i]);
+        }
+        if (keepStrings) {
+            // The string offset shares the slot's word with a 32-bit fingerprint, so a
+            // lookup reads both in one access; the next slot's offset ends the string
+            uint64_t offset = 0;
+            for (uint64_t slot = 0; slot <= keyCount; slot++) {
+                uint32_t fingerprint = slot < keyCount ? (uint32_t) slotHashes[slot] : 0;
+                store<uint64_t>(&data[layout.fingerprints + slot * 8], offset << 32 | fingerprint);
+                if (slot < keyCount) {
+                    string_view domain = domains[slotSources[slot]];
+                    memcpy(&data[layout.stringBytes + offset], domain.data(), domain.size());
+                    offset += domain.size();
+                }
+            }
+        } else {
+            for (uint64_t slot = 0; slot < keyCount; slot++) {
+                store<uint64_t>(&data[layout.fingerprints + slot * 8], slotHashes[slot]);
+            }
+        }
+        return PerfectDomainSet(move(data));
+    }
+    throw runtime_error("Could not find a perfect hash for the domains");
+}
+
+PerfectDomainSet::PerfectDomainSet(vector<char> data) : storage(move(data)), bytes(storage.data()), length(storage.size()) {
+    attach();
+}
+
+PerfectDomainSet::PerfectDomainSet(const char *data, size_t length, shared_ptr<const void> owner)
+    : owner(move(owner)), bytes(data), length(length) {
+    attach();
+}
+
+PerfectDomainSet PerfectDomainSet::mapFile(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Can't open " + path);
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+        close(fd);
+        throw runtime_error("Can't read " + path);
+    }
+    auto size = (size_t) status.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw runtime_error("Can't map " + path);
+    }
+    shared_ptr<const void> owner(mapping, [size](const void *address) {
+        munmap((void *) address, size);
+    });
+    return PerfectDomainSet((const char *) mapping, size, owner);
+}
+
+void PerfectDomainSet::attach() {
+    if (length < HEADER_SIZE || memcmp(bytes, MAGIC, sizeof(MAGIC)) != 0) {
+        throw runtime_error("Not a domain set");
+    }
+    if (load<uint32_t>(bytes + 8) != CURRENT_VERSION) {
+        throw runtime_error("Unsupported domain set version");
+    }
+    strings = (load<uint32_t>(bytes + 12) & FLAG_STRINGS) != 0;
+    seed = load<uint64_t>(bytes + 16);
+    keyCount = load<uint64_t>(bytes + 24);
+    partitionCount = load<uint32_t>(bytes + 32);
+    pilotBits = load<uint32_t>(bytes + 36);
+    pilotWordCount = load<uint64_t>(bytes + 40);
+    remapCount = load<uint64_t>(bytes + 48);
+    stringByteCount = load<uint64_t>(bytes + 56);
+
+    Layout layout;
+    if (partitionCount == 0 || pilotBits == 0 || pilotBits > 32
+        || !computeLayout(keyCount, partitionCount, pilotWordCount, remapCount, strings, stringByteCount, layout)
+        || layout.total != length) {
+        throw runtime_error("Malformed domain set");
+    }
+    partitions = bytes + layout.partitions;
+    pilots = bytes + layout.pilots;
+    remap = bytes + layout.remap;
+    fingerprints = bytes + layout.fingerprints;
+    stringBytes = bytes + layout.stringBytes;
+
+    // Every index a lookup can derive has to stay inside the data
+    uint64_t pilotBitCount = pilotWordCount * 64;
+    for (uint32_t p = 0; p < partitionCount; p++) {
+        const char *entry = partitions + p * PARTITION_SIZE;
+        uint64_t partitionKeyOffset = load<uint64_t>(entry);
+        uint64_t bucketOffset = load<uint64_t>(entry + 8);
+        uint32_t partitionKeyCount = load<uint32_t>(entry + 16);
+        uint32_t tableSize = load<uint32_t>(entry + 20);
+        uint32_t bucketCount = load<uint32_t>(entry + 24);
+        uint32_t remapOffset = load<uint32_t>(entry + 28);
+        if (partitionKeyCount == 0) {
+            continue;
+        }
+        if (partitionKeyOffset > keyCount || partitionKeyCount > keyCount - partitionKeyOffset
+            || tableSize < partitionKeyCount || bucketCount == 0
+            || bucketOffset > pilotBitCount / pilotBits || bucketCount > pilotBitCount / pilotBits - bucketOffset
+            || remapOffset > remapCount || tableSize - partitionKeyCount > remapCount - remapOffset) {
+            throw runtime_error("Malformed domain set");
+        }
+        for (uint32_t i = 0; i < tableSize - partitionKeyCount; i++) {
+            if (load<uint32_t>(remap + (remapOffset + (uint64_t) i) * 4) >= partitionKeyCount) {
+                throw runtime_error("Malformed domain set");
+            }
+        }
+    }
+    if (strings) {
+        uint32_t previous = 0;
+        for (uint64_t slot = 0; slot <= keyCount; slot++) {
+            auto offset = (uint32_t) (load<uint64_t>(fingerprints + slot * 8) >> 32);
+            if (offset < previous || offset > stringByteCount) {
+                throw runtime_error("Malformed domain set");
+            }
+            previous = offset;
+        }
+    }
+}
+
+bool PerfectDomainSet::contains(string_view domain) const {
+    return contains(domain, hash64(domain.data(), domain.size()));
+}
+
+bool PerfectDomainSet::contains(const HostKey &key, size_t label) const {
+    return contains(key.suffix(label), key.hash(label));
+}
+
+bool PerfectDomainSet::contains(string_view domain, uint64_t domainHash) const {
+    if (keyCount == 0) {
+        return false;
+    }
+    uint64_t hash = hash64Remix(domainHash, seed);
+    size_t slot = slotFor(hash);
+    if (slot == SIZE_MAX) {
+        return false;
+    }
+    uint64_t entry = load<uint64_t>(fingerprints + slot * 8);
+    if (!strings) {
+        return entry == hash;
+    }
+    if ((uint32_t) entry != (uint32_t) hash) {
+        return false;
+    }
+    auto begin = (uint32_t) (entry >> 32);
+    auto end = (uint32_t) (load<uint64_t>(fingerprints + slot * 8 + 8) >> 32);
+    return string_view(stringBytes + begin, end - begin) == domain;
+}
+
+size_t PerfectDomainSet::slotFor(uint64_t hash) const {
+    auto p = (uint32_t) (((__uint128_t) hash * partitionCount) >> 64);
+    const char *entry = partitions + p * PARTITION_SIZE;
+    uint32_t partitionKeyCount = load<uint32_t>(entry + 16);
+    if (partitionKeyCount == 0) {
+        return SIZE_MAX;
+    }
+    uint32_t tableSize = load<uint32_t>(entry + 20);
+
+    uint64_t bit = (load<uint64_t>(entry + 8) + bucketFor(hash, load<uint32_t>(entry + 24))) * pilotBits;
+    const char *word = pilots + bit / 64 * 8;
+    uint64_t pilot = load<uint64_t>(word) >> (bit % 64);
+    if (bit % 64 + pilotBits > 64) {
+        pilot |= load<uint64_t>(word + 8) << (64 - bit % 64);
+    }
+    pilot &= (1ull << pilotBits) - 1;
+
+    uint32_t position = positionFor(hash, hash64Remix(pilot, seed), tableSize);
+    if (position >= partitionKeyCount) {
+        position = load<uint32_t>(remap + (load<uint32_t>(entry + 28) + (uint64_t) position - partitionKeyCount) * 4);
+    }
+    return load<uint64_t>(entry) + position;
+}
+
+size_t PerfectDomainSet::size() const {
+    return keyCount;
+}
+
+bool PerfectDomainSet::hasStrings() const {
+    return strings;
+}
+
+size_t PerfectDomainSet::indexBytes() const {
+    return partitionCount * PARTITION_SIZE + pilotWordCount * 8 + remapCount * 4;
+}
+
+const char *PerfectDomainSet::data() const {
+    return bytes;
+}
+
+size_t PerfectDomainSet::dataLength() const {
+    return length;
+}
+
+void PerfectDomainSet::writeToFile(const string &path) const {
+    ofstream out(path, ofstream::binary);
+    out.write(bytes, (streamsize) length);
+    if (!out) {
+        throw runtime_error("Can't write " + path);
+    }
+}
+
+static bool computeLayout(uint64_t keyCount, uint64_t partitionCount, uint64_t pilotWordCount, uint64_t remapCount,
+                          bool strings, uint64_t stringByteCount, Layout &layout) {
+    size_t offset = HEADER_SIZE;
+    // Sections start 8 byte aligned, so a mapped set reads aligned words
+    auto append = [&offset](uint64_t count, size_t elementSize, size_t &start) {
+        start = offset;
+        if (count > (SIZE_MAX - offset - 8) / elementSize) {
+            return false;
+        }
+        offset += (size_t) count * elementSize;
+        offset = (offset + 7) & ~(size_t) 7;
+        return true;
+    };
+
+    layout.stringBytes = 0;
+    // With strings there is one more fingerprint entry, holding the end of the last string
+    bool valid = keyCount < UINT32_MAX
+        && append(partitionCount, PARTITION_SIZE, layout.partitions)
+        && append(pilotWordCount, 8, layout.pilots)
+        && append(remapCount, 4, layout.remap)
+        && append(strings ? keyCount + 1 : keyCount, 8, layout.fingerprints);
+    if (valid && strings) {
+        valid = append(stringByteCount, 1, layout.stringBytes);
+    }
+    layout.total = offset;
+    return valid;
+}
+
+static uint32_t bucketFor(uint64_t hash, uint32_t bucketCount) {
+    uint64_t mixed = hash64Remix(hash, BUCKET_SEED);
+    auto denseBuckets = (uint32_t) (bucketCount * DENSE_BUCKET_SHARE);
+    auto selector = (uint32_t) (mixed >> 32);
+    if ((uint32_t) mixed < DENSE_KEY_THRESHOLD && denseBuckets > 0) {
+        return (uint32_t) (((uint64_t) selector * denseBuckets) >> 32);
+    }
+    return denseBuckets + (uint32_t) (((uint64_t) selector * (bucketCount - denseBuckets)) >> 32);
+}
+
+static uint32_t positionFor(uint64_t hash, uint64_t pilotHash, uint32_t tableSize) {
+    return (uint32_t) (((__uint128_t) hash64Remix(hash, pilotHash) * tableSize) >> 64);
+}
+
+/*
+ PTHash search: buckets are placed largest first, each with the smallest pilot
+ that sends all of its keys to free slots. Slots at or beyond keyCount are
+ then remapped, in order, to the slots below it that were left free.
+ */
+static bool buildPartition(const uint64_t *hashes, uint32_t keyCount, uint32_t tableSize, uint32_t bucketCount, uint64_t seed,
+                           uint32_t *pilots, uint32_t *remap, uint32_t *positions) {
+    vector<uint32_t> bucketStarts(bucketCount + 1, 0);
+    vector<uint32_t> keyBuckets(keyCount);
+    for (uint32_t i = 0; i < keyCount; i++) {
+        keyBuckets[i] = bucketFor(hashes[i], bucketCount);
+        bucketStarts[keyBuckets[i] + 1]++;
+    }
+    uint32_t largestBucket = 0;
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        largestBucket = max(largestBucket, bucketStarts[b + 1]);
+        bucketStarts[b + 1] += bucketStarts[b];
+    }
+    vector<uint32_t> bucketKeys(keyCount);
+    vector<uint32_t> fill(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (uint32_t i = 0; i < keyCount; i++) {
+        bucketKeys[fill[keyBuckets[i]]++] = i;
+    }
+
+    // Counting sort of the buckets by size, largest first
+    vector<uint32_t> sizeStarts(largestBucket + 2, 0);
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        sizeStarts[largestBucket - (bucketStarts[b + 1] - bucketStarts[b]) + 1]++;
+    }
+    for (uint32_t s = 0; s <= largestBucket; s++) {
+        sizeStarts[s + 1] += sizeStarts[s];
+    }
+    vector<uint32_t> order(bucketCount);
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        order[sizeStarts[largestBucket - (bucketStarts[b + 1] - bucketStarts[b])]++] = b;
+    }
+
+    vector<bool> taken(tableSize, false);
+    vector<uint32_t> candidate(largestBucket);
+    for (uint32_t bucket : order) {
+        uint32_t begin = bucketStarts[bucket];
+        uint32_t size = bucketStarts[bucket + 1] - begin;
+        pilots[bucket] = 0;
+        if (size == 0) {
+            continue;
+        }
+
+        uint32_t pilot = 0;
+        for (; pilot < MAX_PILOT; pilot++) {
+            uint64_t pilotHash = hash64Remix(pilot, seed);
+            uint32_t placed = 0;
+            for (; placed < size; placed++) {
+                uint32_t position = positionFor(hashes[bucketKeys[begin + placed]], pilotHash, tableSize);
+                if (taken[position] || find(candidate.begin(), candidate.begin() + placed, position) != candidate.begin() + placed) {
+                    break;
+                }
+                candidate[placed] = position;
+            }
+            if (placed == size) {
+                break;
+            }
+        }
+        if (pilot == MAX_PILOT) {
+            return false;
+        }
+        pilots[bucket] = pilot;
+        for (uint32_t i = 0; i < size; i++) {
+            taken[candidate[i]] = true;
+            positions[bucketKeys[begin + i]] = candidate[i];
+        }
+    }
+
+    vector<uint32_t> spare(tableSize - keyCount, 0);
+    uint32_t freeSlot = 0;
+    for (uint32_t position = keyCount; position < tableSize; position++) {
+        if (!taken[position]) {
+            continue;
+        }
+        while (taken[freeSlot]) {
+            freeSlot++;
+        }
+        spare[position - keyCount] = freeSlot++;
+    }
+    for (uint32_t i = 0; i < keyCount; i++) {
+        if (positions[i] >= keyCount) {
+            positions[i] = spare[positions[i] - keyCount];
+        }
+    }
+    copy(spare.begin(), spare.end(), remap);
+    return true;
+}
+
+template <typename T>
+static T load(const char *address) {
+    T value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+template <typename T>
+static void store(char *address, T value) {
+    memcpy(address, &value, sizeof(value));
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "RANSCoder.hpp"
+
+using namespace std;
+
+static const uint32_t PROBABILITY_BITS = 12;
+static const uint32_t PROBABILITY_SCALE = 1u << PROBABILITY_BITS;
+// States stay within [LOWER_BOUND, LOWER_BOUND << 8) between symbols
+static const uint32_t LOWER_BOUND = 1u << 23;
+static const size_t SYMBOL_COUNT = 256;
+static const size_t STATE_COUNT = 4;
+static const size_t FREQUENCIES_OFFSET = 8;
+static const size_t STATES_OFFSET = FREQUENCIES_OFFSET + SYMBOL_COUNT * 2;
+
+// Forward declarations
+
+static void normalizeFrequencies(const uint64_t *counts, uint64_t total, uint32_t *frequencies);
+
+static void storeLittleEndian(char *output, uint64_t value, size_t bytes);
+
+static uint64_t loadLittleEndian(const char *input, size_t bytes);
+
+
+// Implementation
+
+vector<char> RANSCoder::encode(const char *data, size_t length) {
+    uint64_t counts[SYMBOL_COUNT] = {};
+    for (size_t i = 0; i < length; i++) {
+        counts[(unsigned char) data[i]]++;
+    }
+    uint32_t frequencies[SYMBOL_COUNT] = {};
+    uint32_t starts[SYMBOL_COUNT] = {};
+    if (length > 0) {
+        normalizeFrequencies(counts, length, frequencies);
+    }
+    for (size_t symbol = 1; symbol < SYMBOL_COUNT; symbol++) {
+        starts[symbol] = starts[symbol - 1] + frequencies[symbol - 1];
+    }
+
+    // Symbols are encoded last to first and the bytes written back to front,
+    // so the decoder reads both forwards. A symbol costs at most 12 bits.
+    vector<char> encoded(PREFIX_LENGTH + 2 * length + 4);
+    char *end = encoded.data() + encoded.size();
+    char *cursor = end;
+    uint32_t states[STATE_COUNT] = { LOWER_BOUND, LOWER_BOUND, LOWER_BOUND, LOWER_BOUND };
+    for (size_t i = length; i-- > 0;) {
+        uint32_t &state = states[i % STATE_COUNT];
+        auto symbol = (unsigned char) data[i];
+        uint32_t frequency = frequencies[symbol];
+        uint32_t limit = ((LOWER_BOUND >> PROBABILITY_BITS) << 8) * frequency;
+        while (state >= limit) {
+            *--cursor = (char) (state & 0xff);
+            state >>= 8;
+        }
+        state = ((state / frequency) << PROBABILITY_BITS) + state % frequency + starts[symbol];
+    }
+
+    size_t streamLength = (size_t) (end - cursor);
+    memmove(encoded.data() + PREFIX_LENGTH, cursor, streamLength);
+    encoded.resize(PREFIX_LENGTH + streamLength);
+    storeLittleEndian(encoded.data(), length, 8);
+    for (size_t symbol = 0; symbol < SYMBOL_COUNT; symbol++) {
+        storeLittleEndian(encoded.data() + FREQUENCIES_OFFSET + symbol * 2, frequencies[symbol], 2);
+    }
+    for (size_t i = 0; i < STATE_COUNT; i++) {
+        storeLittleEndian(encoded.data() + STATES_OFFSET + i * 4, states[i], 4);
+    }
+    return encoded;
+}
+
+uint64_t RANSCoder::decodedLength(const char *prefix) {
+    return loadLittleEndian(prefix, 8);
+}
+
+RANSDecoder::RANSDecoder(const char *prefix, char *output, size_t outputLength)
+    : output(output), outputLength(outputLength), position(0), renormalizing(false) {
+    if (RANSCoder::decodedLength(prefix) != outputLength) {
+        throw runtime_error("Decoded length doesn't match the output");
+    }
+
+    // Each slot packs its symbol, the symbol's frequency minus one and the slot's offset within it
+    slots.resize(PROBABILITY_SCALE);
+    uint32_t start = 0;
+    for (uint32_t symbol = 0; symbol < SYMBOL_COUNT; symbol++) {
+        auto frequency = (uint32_t) loadLittleEndian(prefix + FREQUENCIES_OFFSET + symbol * 2, 2);
+        if (frequency > PROBABILITY_SCALE - start) {
+            throw runtime_error("Symbol frequencies exceed the probability scale");
+        }
+        for (uint32_t offset = 0; offset < frequency; offset++) {
+            slots[start + offset] = symbol | ((frequency - 1) << 8) | (offset << 20);
+        }
+        start += frequency;
+    }
+    if (start != (outputLength == 0 ? 0 : PROBABILITY_SCALE)) {
+        throw runtime_error("Symbol frequencies don't sum to the probability scale");
+    }
+
+    for (size_t i = 0; i < STATE_COUNT; i++) {
+        states[i] = (uint32_t) loadLittleEndian(prefix + STATES_OFFSET + i * 4, 4);
+        if (states[i] < LOWER_BOUND || states[i] >= (uint64_t) LOWER_BOUND << 8) {
+            throw runtime_error("Invalid initial coder state");
+        }
+    }
+}
+
+void RANSDecoder::decode(const char *input, size_t length) {
+    const auto *cursor = (const unsigned char *) input;
+    const unsigned char *end = cursor + length;
+
+    if (renormalizing) {
+        uint32_t &state = states[(position - 1) % STATE_COUNT];
+        while (state < LOWER_BOUND && cursor < end) {
+            state = (state << 8) | *cursor++;
+        }
+        if (state < LOWER_BOUND) {
+            return;
+        }
+        renormalizing = false;
+    }
+
+    // A byte reads at most two input bytes, so whole rounds over the states can skip the bounds
+    // checks. The states are copied out since stores through `output` could alias them.
+    if (position % STATE_COUNT == 0) {
+        uint32_t local[STATE_COUNT] = { states[0], states[1], states[2], states[3] };
+        const uint32_t *table = slots.data();
+        char *written = output + position;
+        size_t rounds = min((outputLength - position) / STATE_COUNT, (size_t) (end - cursor) / (2 * STATE_COUNT));
+        while (rounds > 0) {
+            for (size_t i = 0; i < STATE_COUNT; i++) {
+                uint32_t slot = table[local[i] & (PROBABILITY_SCALE - 1)];
+                written[i] = (char) (slot & 0xff);
+                uint32_t state = (((slot >> 8) & 0xfff) + 1) * (local[i] >> PROBABILITY_BITS) + (slot >> 20);
+                // Whether 0, 1 or 2 bytes are needed is data dependent, so it is computed rather than branched on
+                uint32_t shift = 8 * ((state < LOWER_BOUND) + (state < (LOWER_BOUND >> 8)));
+                uint32_t next = ((uint32_t) cursor[0] << 8) | cursor[1];
+                local[i] = (uint32_t) (((uint64_t) state << shift) | (next >> (16 - shift)));
+                cursor += shift / 8;
+            }
+            written += STATE_COUNT;
+            // Renormalizing may have read less than the worst case, which leaves room for more rounds
+            if (--rounds == 0) {
+                rounds = min((outputLength - (size_t) (written - output)) / STATE_COUNT, (size_t) (end - cursor) / (2 * STATE_COUNT));
+            }
+        }
+        position = (size_t) (written - output);
+        memcpy(states, local, sizeof(local));
+    }
+
+    while (position < outputLength) {
+        uint32_t &state = states[position % STATE_COUNT];
+        uint32_t slot = slots[state & (PROBABILITY_SCALE - 1)];
+        output[position++] = (char) (slot & 0xff);
+        state = (((slot >> 8) & 0xfff) + 1) * (state >> PROBABILITY_BITS) + (slot >> 20);
+        while (state < LOWER_BOUND) {
+            if (cursor == end) {
+                renormalizing = true;
+                return;
+            }
+            state = (state << 8) | *cursor++;
+        }
+    }
+    if (cursor != end) {
+        throw runtime_error("Encoded data continues past the decoded length");
+    }
+}
+
+size_t RANSDecoder::decodedCount() const {
+    return position;
+}
+
+bool RANSDecoder::isComplete() const {
+    if (position != outputLength || renormalizing) {
+        return false;
+    }
+    // The encoder started every state at the lower bound
+    for (uint32_t state : states) {
+        if (state != LOWER_BOUND) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Scales counts to sum to PROBABILITY_SCALE, keeping every present symbol codable
+static void normalizeFrequencies(const uint64_t *counts, uint64_t total, uint32_t *frequencies) {
+    uint32_t sum = 0;
+    size_t largest = 0;
+    for (size_t symbol = 0; symbol < SYMBOL_COUNT; symbol++) {
+        if (counts[symbol] == 0) {
+            continue;
+        }
+        frequencies[symbol] = max<uint32_t>(1, (uint32_t) ((double) counts[symbol] * PROBABILITY_SCALE / total));
+        sum += frequencies[symbol];
+        if (counts[symbol] > counts[largest]) {
+            largest = symbol;
+        }
+    }
+
+    // Rounding is settled on the most frequent symbol, where it costs the least. When
+    // that alone can't absorb it, the others give up one each, down to 1.
+    while (sum != PROBABILITY_SCALE) {
+        if (sum < PROBABILITY_SCALE) {
+            frequencies[largest] += PROBABILITY_SCALE - sum;
+            sum = PROBABILITY_SCALE;
+        } else if (frequencies[largest] > sum - PROBABILITY_SCALE) {
+            frequencies[largest] -= sum - PROBABILITY_SCALE;
+            sum = PROBABILITY_SCALE;
+        } else {
+            for (size_t symbol = 0; symbol < SYMBOL_COUNT && sum > PROBABILITY_SCALE; symbol++) {
+                if (frequencies[symbol] > 1) {
+                    frequencies[symbol]--;
+                    sum--;
+                }
+            }
+        }
+    }
+}
+
+static void storeLittleEndian(char *output, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        output[i] = (char) (value >> (8 * i));
+    }
+}
+
+static uint64_t loadLittleEndian(const char *input, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t) (unsigned char) input[i] << (8 * i);
+    }
+    return value;
+}
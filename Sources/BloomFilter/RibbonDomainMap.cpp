@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Hash64.hpp"
+#include "HostKey.hpp"
+#include "RibbonDomainMap.hpp"
+
+using namespace std;
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The serialized form is read in place as little endian");
+
+static const char MAGIC[8] = { 'D', 'D', 'G', 'R', 'I', 'B', 'B', 'N' };
+static const size_t HEADER_SIZE = 48;
+static const uint64_t BAND_WIDTH = 64;
+// Slots per key. Enough for a million keys with 64 wide bands; larger sets
+// need more, so every failed attempt adds some.
+static const double INITIAL_SLOTS_PER_KEY = 1.08;
+static const double SLOTS_PER_KEY_STEP = 0.02;
+static const int MAX_SEED_ATTEMPTS = 16;
+static const uint64_t SEED_BASE = 0x7a3c5e9f1d2b4860ull;
+static const uint64_t COEFFICIENT_SEED = 0x2545f4914f6cdd1dull;
+static const uint64_t FINGERPRINT_SEED = 0x5851f42d4c957f2dull;
+
+// Forward declarations
+
+struct Band {
+    uint64_t start;
+    uint64_t coefficients;
+};
+
+static Band bandFor(uint64_t hash, uint64_t slotCount);
+
+static uint64_t fingerprintFor(uint64_t hash, uint32_t fingerprintBits);
+
+static uint64_t solutionLength(uint64_t slotCount, uint32_t resultBits);
+
+template <typename T>
+static T load(const char *address);
+
+template <typename T>
+static void store(char *address, T value);
+
+
+// Implementation
+
+RibbonDomainMap RibbonDomainMap::build(const vector<pair<string_view, uint32_t>> &entries, uint32_t fingerprintBits) {
+    if (fingerprintBits > MAX_FINGERPRINT_BITS) {
+        throw runtime_error("Too many fingerprint bits");
+    }
+    uint32_t maxID = 0;
+    for (const auto &entry : entries) {
+        maxID = max(maxID, entry.second);
+    }
+    // At least one bit, so even a map of only ID 0 stores something
+    uint32_t valueBits = 1;
+    while (valueBits < 32 && (maxID >> valueBits) != 0) {
+        valueBits++;
+    }
+    uint32_t resultBits = valueBits + fingerprintBits;
+
+    double slotsPerKey = INITIAL_SLOTS_PER_KEY;
+    // Seeds are mixed into the unseeded hash, which is what a HostKey holds
+    vector<uint64_t> domainHashes(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        domainHashes[i] = hash64(entries[i].first.data(), entries[i].first.size());
+    }
+
+    for (int attempt = 0; attempt < MAX_SEED_ATTEMPTS; attempt++) {
+        uint64_t seed = hash64Remix((uint64_t) attempt, SEED_BASE);
+
+        vector<pair<uint64_t, uint32_t>> keys(entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            keys[i] = { hash64Remix(domainHashes[i], seed), (uint32_t) i };
+        }
+        sort(keys.begin(), keys.end());
+
+        bool collision = false;
+        size_t unique = 0;
+        for (size_t i = 0; i < keys.size() && !collision; i++) {
+            if (unique > 0 && keys[unique - 1].first == keys[i].first) {
+                const auto &kept = entries[keys[unique - 1].second];
+                const auto &duplicate = entries[keys[i].second];
+                if (kept.first != duplicate.first) {
+                    collision = true;
+                } else if (kept.second != duplicate.second) {
+                    throw runtime_error(string(kept.first) + " is mapped to two IDs");
+                }
+                continue;
+            }
+            keys[unique++] = keys[i];
+        }
+        if (collision) {
+            continue;
+        }
+        keys.resize(unique);
+
+        uint64_t slotCount = (uint64_t) ceil(unique * slotsPerKey) + BAND_WIDTH;
+        slotCount = (slotCount + BAND_WIDTH - 1) / BAND_WIDTH * BAND_WIDTH;
+
+        // On the fly Gaussian elimination: each row is reduced against the
+        // pivots already placed until it finds an empty pivot slot
+        vector<uint64_t> rows(slotCount, 0);
+        vector<uint64_t> results(slotCount, 0);
+        bool solved = true;
+        for (size_t k = 0; k < unique && solved; k++) {
+            uint64_t hash = keys[k].first;
+            Band band = bandFor(hash, slotCount);
+            uint64_t result = entries[keys[k].second].second | fingerprintFor(hash, fingerprintBits) << valueBits;
+
+            uint64_t slot = band.start;
+            uint64_t coefficients = band.coefficients;
+            while (true) {
+                if (rows[slot] == 0) {
+                    rows[slot] = coefficients;
+                    results[slot] = result;
+                    break;
+                }
+                coefficients ^= rows[slot];
+                result ^= results[slot];
+                if (coefficients == 0) {
+                    // Only the same row twice could be consistent, and hashes are distinct
+                    solved = false;
+                    break;
+                }
+                int shift = __builtin_ctzll(coefficients);
+                slot += shift;
+                coefficients >>= shift;
+            }
+        }
+        if (!solved) {
+            slotsPerKey += SLOTS_PER_KEY_STEP;
+            continue;
+        }
+
+        // Back substitution, free slots stay zero
+        vector<uint64_t> solution(slotCount, 0);
+        for (uint64_t slot = slotCount; slot > 0; slot--) {
+            uint64_t row = rows[slot - 1];
+            if (row == 0) {
+                continue;
+            }
+            uint64_t value = results[slot - 1];
+            for (uint64_t rest = row >> 1; rest != 0; rest &= rest - 1) {
+                value ^= solution[slot + __builtin_ctzll(rest)];
+            }
+            solution[slot - 1] = value;
+        }
+
+        vector<char> data(HEADER_SIZE + solutionLength(slotCount, resultBits), 0);
+        memcpy(data.data(), MAGIC, sizeof(MAGIC));
+        store<uint32_t>(&data[8], CURRENT_VERSION);
+        store<uint32_t>(&data[12], valueBits);
+        store<uint32_t>(&data[16], fingerprintBits);
+        store<uint64_t>(&data[24], seed);
+        store<uint64_t>(&data[32], unique);
+        store<uint64_t>(&data[40], slotCount);
+
+        // Block b holds one word per result bit, bit i of word k being bit k of slot 64b + i
+        char *words = &data[HEADER_SIZE];
+        for (uint64_t slot = 0; slot < slotCount; slot++) {
+            for (uint32_t bit = 0; bit < resultBits; bit++) {
+                if ((solution[slot] >> bit) & 1) {
+                    char *word = words + ((slot / BAND_WIDTH) * resultBits + bit) * 8;
+                    store<uint64_t>(word, load<uint64_t>(word) | 1ull << (slot % BAND_WIDTH));
+                }
+            }
+        }
+        return RibbonDomainMap(move(data));
+    }
+    throw runtime_error("Could not solve the retrieval system for the domains");
+}
+
+RibbonDomainMap::RibbonDomainMap(vector<char> data) : storage(move(data)), bytes(storage.data()), length(storage.size()) {
+    attach();
+}
+
+RibbonDomainMap::RibbonDomainMap(const char *data, size_t length, shared_ptr<const void> owner)
+    : owner(move(owner)), bytes(data), length(length) {
+    attach();
+}
+
+RibbonDomainMap RibbonDomainMap::mapFile(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Can't open " + path);
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+        close(fd);
+        throw runtime_error("Can't read " + path);
+    }
+    auto size = (size_t) status.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw runtime_error("Can't map " + path);
+    }
+    shared_ptr<const void> owner(mapping, [size](const void *address) {
+        munmap((void *) address, size);
+    });
+    return RibbonDomainMap((const char *) mapping, size, owner);
+}
+
+void RibbonDomainMap::attach() {
+    if (length < HEADER_SIZE || memcmp(bytes, MAGIC, sizeof(MAGIC)) != 0) {
+        throw runtime_error("Not a domain map");
+    }
+    if (load<uint32_t>(bytes + 8) != CURRENT_VERSION) {
+        throw runtime_error("Unsupported domain map version");
+    }
+    valueBits = load<uint32_t>(bytes + 12);
+    fingerprintBits = load<uint32_t>(bytes + 16);
+    seed = load<uint64_t>(bytes + 24);
+    keyCount = load<uint64_t>(bytes + 32);
+    slotCount = load<uint64_t>(bytes + 40);
+    solution = bytes + HEADER_SIZE;
+
+    if (valueBits == 0 || valueBits > 32 || fingerprintBits > MAX_FINGERPRINT_BITS
+        || slotCount < BAND_WIDTH || slotCount % BAND_WIDTH != 0
+        || slotCount / BAND_WIDTH > (length - HEADER_SIZE) / ((valueBits + fingerprintBits) * 8)
+        || solutionLength(slotCount, valueBits + fingerprintBits) != length - HEADER_SIZE) {
+        throw runtime_error("Malformed domain map");
+    }
+}
+
+bool RibbonDomainMap::find(string_view domain, uint32_t &id) const {
+    return findHashed(hash64(domain.data(), domain.size()), id);
+}
+
+bool RibbonDomainMap::find(const HostKey &key, size_t label, uint32_t &id) const {
+    return findHashed(key.hash(label), id);
+}
+
+bool RibbonDomainMap::findHashed(uint64_t domainHash, uint32_t &id) const {
+    id = 0;
+    uint32_t resultBits = valueBits + fingerprintBits;
+    if (keyCount == 0) {
+        return false;
+    }
+
+    uint64_t hash = hash64Remix(domainHash, seed);
+    Band band = bandFor(hash, slotCount);
+    uint64_t offset = band.start % BAND_WIDTH;
+    const char *low = solution + (band.start / BAND_WIDTH) * resultBits * 8;
+    const char *high = low + resultBits * 8;
+
+    uint64_t result = 0;
+    for (uint32_t bit = 0; bit < resultBits; bit++) {
+        uint64_t window = load<uint64_t>(low + bit * 8) >> offset;
+        if (offset != 0) {
+            window |= load<uint64_t>(high + bit * 8) << (BAND_WIDTH - offset);
+        }
+        result |= (uint64_t) __builtin_parityll(window & band.coefficients) << bit;
+    }
+
+    if (result >> valueBits != fingerprintFor(hash, fingerprintBits)) {
+        return false;
+    }
+    id = (uint32_t) (result & ((1ull << valueBits) - 1));
+    return true;
+}
+
+string_view RibbonDomainMap::findAnySuffix(string_view host, uint32_t &id) const {
+    string_view domain = host;
+    size_t dot;
+    while ((dot = domain.find('.')) != string_view::npos) {
+        if (find(domain, id)) {
+            return domain;
+        }
+        domain.remove_prefix(dot + 1);
+    }
+    id = 0;
+    return host.substr(host.size());
+}
+
+string_view RibbonDomainMap::findAnySuffix(const HostKey &key, uint32_t &id) const {
+    // Down to two labels, like the string version
+    for (size_t label = 0; label + 1 < key.labelCount(); label++) {
+        if (findHashed(key.hash(label), id)) {
+            return key.suffix(label);
+        }
+    }
+    id = 0;
+    return key.suffix(key.labelCount());
+}
+
+size_t RibbonDomainMap::size() const {
+    return keyCount;
+}
+
+uint32_t RibbonDomainMap::getValueBits() const {
+    return valueBits;
+}
+
+uint32_t RibbonDomainMap::getFingerprintBits() const {
+    return fingerprintBits;
+}
+
+const char *RibbonDomainMap::data() const {
+    return bytes;
+}
+
+size_t RibbonDomainMap::dataLength() const {
+    return length;
+}
+
+void RibbonDomainMap::writeToFile(const string &path) const {
+    ofstream out(path, ofstream::binary);
+    out.write(bytes, (streamsize) length);
+    if (!out) {
+        throw runtime_error("Can't write " + path);
+    }
+}
+
+static Band bandFor(uint64_t hash, uint64_t slotCount) {
+    uint64_t start = (uint64_t) (((__uint128_t) hash * (slotCount - BAND_WIDTH + 1)) >> 64);
+    // The first coefficient is always set, it is the row's pivot candidate
+    return Band { start, hash64Remix(hash, COEFFICIENT_SEED) | 1 };
+}
+
+static uint64_t fingerprintFor(uint64_t hash, uint32_t fingerprintBits) {
+    return fingerprintBits == 0 ? 0 : hash64Remix(hash, FINGERPRINT_SEED) >> (64 - fingerprintBits);
+}
+
+static uint64_t solutionLength(uint64_t slotCount, uint32_t resultBits) {
+    return slotCount / BAND_WIDTH * resultBits * 8;
+}
+
+template <typename T>
+static T load(const char *address) {
+    T value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+template <typename T>
+static void store(char *address, T value) {
+    memcpy(address, &value, sizeof(value));
+}
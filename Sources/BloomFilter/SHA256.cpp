@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "SHA256.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SHA256_X86_EXTENSIONS 1
+#include <cpuid.h>
+#include <immintrin.h>
+// Not yet run on arm64 hardware, so opt-in until it has been
+#elif defined(BLOOM_FILTER_ARMV8_SHA256) && defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#define SHA256_ARMV8_EXTENSIONS 1
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+static const uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+typedef void (*CompressFunction)(uint32_t *state, const uint8_t *blocks, size_t count);
+
+// Forward declarations
+
+static CompressFunction compressFunctionFor(SHA256::Implementation implementation);
+
+static void compressPortable(uint32_t *state, const uint8_t *blocks, size_t count);
+
+#if SHA256_X86_EXTENSIONS
+static bool hasSHAExtensions();
+
+static void compressSHAExtensions(uint32_t *state, const uint8_t *blocks, size_t count);
+#elif SHA256_ARMV8_EXTENSIONS
+static void compressARMv8(uint32_t *state, const uint8_t *blocks, size_t count);
+#endif
+
+static uint32_t rotateRight(uint32_t value, unsigned bits);
+
+static uint32_t loadBigEndian(const uint8_t *bytes);
+
+
+// Implementation
+
+SHA256::SHA256() : SHA256(availableImplementations().back()) {
+}
+
+SHA256::SHA256(Implementation implementation)
+    : compress(compressFunctionFor(implementation)),
+      state { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 },
+      buffer {},
+      bufferLength(0),
+      totalLength(0) {
+    if (compress == nullptr) {
+        throw runtime_error(string("SHA-256 implementation ") + implementationName(implementation) + " is unavailable");
+    }
+}
+
+void SHA256::update(const void *data, size_t length) {
+    auto bytes = (const uint8_t *) data;
+    totalLength += length;
+
+    if (bufferLength > 0) {
+        size_t take = min(length, buffer.size() - bufferLength);
+        memcpy(buffer.data() + bufferLength, bytes, take);
+        bufferLength += take;
+        bytes += take;
+        length -= take;
+        if (bufferLength < buffer.size()) {
+            return;
+        }
+        compress(state.data(), buffer.data(), 1);
+        bufferLength = 0;
+    }
+
+    size_t blocks = length / buffer.size();
+    if (blocks > 0) {
+        compress(state.data(), bytes, blocks);
+        bytes += blocks * buffer.size();
+        length -= blocks * buffer.size();
+    }
+
+    memcpy(buffer.data(), bytes, length);
+    bufferLength = length;
+}
+
+SHA256::Digest SHA256::finish() {
+    uint64_t bitLength = totalLength * 8;
+
+    uint8_t padding[72] = { 0x80 };
+    size_t paddingLength = (bufferLength < 56 ? 56 : 120) - bufferLength;
+    for (size_t i = 0; i < 8; i++) {
+        padding[paddingLength + i] = (uint8_t) (bitLength >> (56 - 8 * i));
+    }
+    update(padding, paddingLength + 8);
+
+    Digest digest;
+    for (size_t i = 0; i < state.size(); i++) {
+        digest[4 * i] = (uint8_t) (state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t) (state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t) (state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t) state[i];
+    }
+    return digest;
+}
+
+SHA256::Digest SHA256::hash(const void *data, size_t length) {
+    SHA256 hasher;
+    hasher.update(data, length);
+    return hasher.finish();
+}
+
+bool SHA256::fromHex(const string &hex, Digest &digest) {
+    if (hex.size() != digest.size() * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < hex.size(); i++) {
+        char character = hex[i];
+        int value;
+        if (character >= '0' && character <= '9') {
+            value = character - '0';
+        } else if (character >= 'a' && character <= 'f') {
+            value = character - 'a' + 10;
+        } else if (character >= 'A' && character <= 'F') {
+            value = character - 'A' + 10;
+        } else {
+            return false;
+        }
+        digest[i / 2] = (uint8_t) (i % 2 == 0 ? value << 4 : digest[i / 2] | value);
+    }
+    return true;
+}
+
+const char *SHA256::implementationName() {
+    return implementationName(availableImplementations().back());
+}
+
+const char *SHA256::implementationName(Implementation implementation) {
+    switch (implementation) {
+        case Implementation::portable:
+            return "portable";
+        case Implementation::shaExtensions:
+            return "sha-ni";
+        case Implementation::armv8:
+            return "armv8";
+    }
+    return "unknown";
+}
+
+const vector<SHA256::Implementation> &SHA256::availableImplementations() {
+    static const vector<Implementation> implementations = [] {
+        vector<Implementation> available { Implementation::portable };
+        for (auto implementation : { Implementation::shaExtensions, Implementation::armv8 }) {
+            if (compressFunctionFor(implementation) != nullptr) {
+                available.push_back(implementation);
+            }
+        }
+        return available;
+    }();
+    return implementations;
+}
+
+string SHA256::toHex(const Digest &digest) {
+    static const char DIGITS[] = "0123456789abcdef";
+    string hex;
+    hex.reserve(digest.size() * 2);
+    for (auto byte : digest) {
+        hex.push_back(DIGITS[byte >> 4]);
+        hex.push_back(DIGITS[byte & 0xf]);
+    }
+    return hex;
+}
+
+// Null when this build or CPU can't run `implementation`
+static CompressFunction compressFunctionFor(SHA256::Implementation implementation) {
+    switch (implementation) {
+        case SHA256::Implementation::portable:
+            return compressPortable;
+        case SHA256::Implementation::shaExtensions:
+#if SHA256_X86_EXTENSIONS
+            return hasSHAExtensions() ? compressSHAExtensions : nullptr;
+#else
+            return nullptr;
+#endif
+        case SHA256::Implementation::armv8:
+#if SHA256_ARMV8_EXTENSIONS
+            return compressARMv8;
+#else
+            return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+static void compressPortable(uint32_t *state, const uint8_t *blocks, size_t count) {
+    for (const uint8_t *block = blocks; block < blocks + count * 64; block += 64) {
+        uint32_t schedule[64];
+        for (size_t i = 0; i < 16; i++) {
+            schedule[i] = loadBigEndian(block + 4 * i);
+        }
+        for (size_t i = 16; i < 64; i++) {
+            uint32_t s0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+            uint32_t s1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+            schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (size_t i = 0; i < 64; i++) {
+            uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            uint32_t choice = (e & f) ^ (~e & g);
+            uint32_t temp1 = h + s1 + choice + ROUND_CONSTANTS[i] + schedule[i];
+            uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t temp2 = s0 + majority;
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + temp2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if SHA256_X86_EXTENSIONS
+
+static bool hasSHAExtensions() {
+    // Asked once, every hasher checks
+    static const bool available = [] {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & bit_SSE4_1) == 0) {
+            return false;
+        }
+        return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA) != 0;
+    }();
+    return available;
+}
+
+// Four rounds with the SHA extensions, whose state is kept as ABEF and CDGH
+#define SHA256_X86_ROUNDS(message, round) \
+    do { \
+        __m128i sum = _mm_add_epi32(message, _mm_loadu_si128((const __m128i *) &ROUND_CONSTANTS[round])); \
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, sum); \
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(sum, 0x0e)); \
+    } while (0)
+
+// The next four schedule words from the previous sixteen
+#define SHA256_X86_SCHEDULE(w0, w1, w2, w3) \
+    _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(w0, w1), _mm_alignr_epi8(w3, w2, 4)), w3)
+
+__attribute__((target("sha,sse4.1")))
+static void compressSHAExtensions(uint32_t *state, const uint8_t *blocks, size_t count) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xb1);
+    __m128i hgfe = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1b);
+    __m128i abef = _mm_alignr_epi8(dcba, hgfe, 8);
+    __m128i cdgh = _mm_blend_epi16(hgfe, dcba, 0xf0);
+
+    for (const uint8_t *block = blocks; block < blocks + count * 64; block += 64) {
+        __m128i savedABEF = abef;
+        __m128i savedCDGH = cdgh;
+        __m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) block), byteSwap);
+        __m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (block + 16)), byteSwap);
+        __m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (block + 32)), byteSwap);
+        __m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (block + 48)), byteSwap);
+
+        for (size_t round = 0; round < 64; round += 16) {
+            SHA256_X86_ROUNDS(w0, round);
+            SHA256_X86_ROUNDS(w1, round + 4);
+            SHA256_X86_ROUNDS(w2, round + 8);
+            SHA256_X86_ROUNDS(w3, round + 12);
+            if (round < 48) {
+                w0 = SHA256_X86_SCHEDULE(w0, w1, w2, w3);
+                w1 = SHA256_X86_SCHEDULE(w1, w2, w3, w0);
+                w2 = SHA256_X86_SCHEDULE(w2, w3, w0, w1);
+                w3 = SHA256_X86_SCHEDULE(w3, w0, w1, w2);
+            }
+        }
+
+        abef = _mm_add_epi32(abef, savedABEF);
+        cdgh = _mm_add_epi32(cdgh, savedCDGH);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(feba, dchg, 0xf0));
+    _mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(dchg, feba, 8));
+}
+
+#elif SHA256_ARMV8_EXTENSIONS
+
+#define SHA256_ARMV8_ROUNDS(message, round) \
+    do { \
+        uint32x4_t sum = vaddq_u32(message, vld1q_u32(&ROUND_CONSTANTS[round])); \
+        uint32x4_t previousABCD = abcd; \
+        abcd = vsha256hq_u32(abcd, efgh, sum); \
+        efgh = vsha256h2q_u32(efgh, previousABCD, sum); \
+    } while (0)
+
+#define SHA256_ARMV8_SCHEDULE(w0, w1, w2, w3) vsha256su1q_u32(vsha256su0q_u32(w0, w1), w2, w3)
+
+static void compressARMv8(uint32_t *state, const uint8_t *blocks, size_t count) {
+    uint32x4_t abcd = vld1q_u32(&state[0]);
+    uint32x4_t efgh = vld1q_u32(&state[4]);
+
+    for (const uint8_t *block = blocks; block < blocks + count * 64; block += 64) {
+        uint32x4_t savedABCD = abcd;
+        uint32x4_t savedEFGH = efgh;
+        uint32x4_t w0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block)));
+        uint32x4_t w1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block + 16)));
+        uint32x4_t w2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block + 32)));
+        uint32x4_t w3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block + 48)));
+
+        for (size_t round = 0; round < 64; round += 16) {
+            SHA256_ARMV8_ROUNDS(w0, round);
+            SHA256_ARMV8_ROUNDS(w1, round + 4);
+            SHA256_ARMV8_ROUNDS(w2, round + 8);
+            SHA256_ARMV8_ROUNDS(w3, round + 12);
+            if (round < 48) {
+                w0 = SHA256_ARMV8_SCHEDULE(w0, w1, w2, w3);
+                w1 = SHA256_ARMV8_SCHEDULE(w1, w2, w3, w0);
+                w2 = SHA256_ARMV8_SCHEDULE(w2, w3, w0, w1);
+                w3 = SHA256_ARMV8_SCHEDULE(w3, w0, w1, w2);
+            }
+        }
+
+        abcd = vaddq_u32(abcd, savedABCD);
+        efgh = vaddq_u32(efgh, savedEFGH);
+    }
+
+    vst1q_u32(&state[0], abcd);
+    vst1q_u32(&state[4], efgh);
+}
+
+#endif
+
+static uint32_t rotateRight(uint32_t value, unsigned bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static uint32_t loadBigEndian(const uint8_t *bytes) {
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | bytes[3];
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "Hash64.hpp"
+#include "HostKey.hpp"
+#include "SHA256.hpp"
+#include "ScalableBloomFilter.hpp"
+
+using namespace std;
+
+static const char MAGIC[8] = { 'D', 'D', 'G', 'S', 'C', 'A', 'L', 'E' };
+static const uint32_t CURRENT_VERSION = 2;
+static const size_t HEADER_LENGTH = 40;
+static const size_t SLICE_HEADER_LENGTH = 32;
+// Doubling capacities, so far more than any device learns
+static const size_t MAX_SLICE_COUNT = 48;
+static const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+// Forward declarations
+
+static void storeLittleEndian(vector<char> &output, uint64_t value, size_t bytes);
+
+static uint64_t loadLittleEndian(const char *input, size_t bytes);
+
+static vector<char> readAll(BinaryInputStream &in);
+
+
+// Implementation
+
+ScalableBloomFilter::ScalableBloomFilter(size_t initialCapacity, double errorRate)
+    : initialCapacity(initialCapacity), errorRate(errorRate) {
+    if (initialCapacity == 0 || !(errorRate > 0 && errorRate < 1)) {
+        throw runtime_error("Invalid filter parameters");
+    }
+}
+
+bool ScalableBloomFilter::add(string_view key) {
+    return addHash(hash64(key.data(), key.size()));
+}
+
+bool ScalableBloomFilter::add(const HostKey &key) {
+    return addHash(key.hash());
+}
+
+bool ScalableBloomFilter::addHash(uint64_t hash) {
+    // Already answered as present, adding it again would only fill the slice
+    if (containsHash(hash)) {
+        return false;
+    }
+    if (slices.empty() || slices.back().itemCount >= slices.back().capacity) {
+        addSlice(slices.empty() ? initialCapacity : slices.back().capacity * GROWTH_FACTOR);
+    }
+    Slice &slice = slices.back();
+    slice.filter.add(hash);
+    slice.itemCount++;
+    return true;
+}
+
+bool ScalableBloomFilter::contains(string_view key) const {
+    return containsHash(hash64(key.data(), key.size()));
+}
+
+bool ScalableBloomFilter::contains(const HostKey &key) const {
+    return containsHash(key.hash());
+}
+
+bool ScalableBloomFilter::containsHash(uint64_t hash) const {
+    // Newest first, the largest slice holds half the keys
+    for (auto slice = slices.rbegin(); slice != slices.rend(); ++slice) {
+        if (slice->filter.contains(hash)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ScalableBloomFilter::compact(size_t memoryBudget) {
+    size_t bytes = byteCount();
+    size_t dropped = 0;
+    while (dropped < slices.size() && bytes > memoryBudget) {
+        bytes -= slices[dropped].filter.byteCount();
+        dropped++;
+    }
+    slices.erase(slices.begin(), slices.begin() + (ptrdiff_t) dropped);
+    droppedSlices += dropped;
+    // Nothing left to stay below, so the chain starts over at its loosest rate
+    if (slices.empty()) {
+        droppedSlices = 0;
+    }
+}
+
+size_t ScalableBloomFilter::getItemCount() const {
+    size_t itemCount = 0;
+    for (const Slice &slice : slices) {
+        itemCount += slice.itemCount;
+    }
+    return itemCount;
+}
+
+size_t ScalableBloomFilter::getSliceCount() const {
+    return slices.size();
+}
+
+size_t ScalableBloomFilter::byteCount() const {
+    size_t bytes = 0;
+    for (const Slice &slice : slices) {
+        bytes += slice.filter.byteCount();
+    }
+    return bytes;
+}
+
+double ScalableBloomFilter::falsePositiveRate() const {
+    double missesAll = 1;
+    for (const Slice &slice : slices) {
+        missesAll *= 1 - BlockedBloomFilter::falsePositiveRate(slice.filter.getBlockCount(), slice.filter.getHashRounds(), slice.itemCount);
+    }
+    return 1 - missesAll;
+}
+
+/*
+ Little endian throughout, followed by the SHA-256 of everything before it:
+
+   0  magic "DDGSCALE"
+   8  u32 version
+  12  u32 slice count
+  16  u64 initial capacity
+  24  u64 error rate, IEEE 754 double
+  32  u64 dropped slices, the position of the first slice in the chain
+  40  per slice, oldest first: u64 capacity, u64 item count, u64 block
+      count, u32 hash rounds, u32 reserved, then the block words
+
+ Version 1 followed the slices with the hash of every key learned.
+ */
+void ScalableBloomFilter::writeToStream(BinaryOutputStream &out) const {
+    vector<char> encoded(MAGIC, MAGIC + sizeof(MAGIC));
+    uint64_t rateBits;
+    memcpy(&rateBits, &errorRate, sizeof(rateBits));
+    storeLittleEndian(encoded, CURRENT_VERSION, 4);
+    storeLittleEndian(encoded, slices.size(), 4);
+    storeLittleEndian(encoded, initialCapacity, 8);
+    storeLittleEndian(encoded, rateBits, 8);
+    storeLittleEndian(encoded, droppedSlices, 8);
+    for (const Slice &slice : slices) {
+        storeLittleEndian(encoded, slice.capacity, 8);
+        storeLittleEndian(encoded, slice.itemCount, 8);
+        storeLittleEndian(encoded, slice.filter.getBlockCount(), 8);
+        storeLittleEndian(encoded, slice.filter.getHashRounds(), 4);
+        storeLittleEndian(encoded, 0, 4);
+        const uint64_t *words = slice.filter.words();
+        for (size_t i = 0; i < slice.filter.getBlockCount() * BlockedBloomFilter::WORDS_PER_BLOCK; i++) {
+            storeLittleEndian(encoded, words[i], 8);
+        }
+    }
+    SHA256::Digest digest = SHA256::hash(encoded.data(), encoded.size());
+    encoded.insert(encoded.end(), digest.begin(), digest.end());
+    out.write(encoded.data(), (streamsize) encoded.size());
+}
+
+ScalableBloomFilter ScalableBloomFilter::readFromStream(BinaryInputStream &in) {
+    vector<char> encoded = readAll(in);
+    SHA256::Digest digest;
+    if (encoded.size() < HEADER_LENGTH + digest.size() || memcmp(encoded.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw runtime_error("Not a scalable filter");
+    }
+    size_t length = encoded.size() - digest.size();
+    memcpy(digest.data(), encoded.data() + length, digest.size());
+    if (SHA256::hash(encoded.data(), length) != digest) {
+        throw runtime_error("Scalable filter doesn't match its SHA-256");
+    }
+
+    const char *data = encoded.data();
+    auto version = (uint32_t) loadLittleEndian(data + 8, 4);
+    if (version != CURRENT_VERSION) {
+        throw runtime_error("Unsupported scalable filter version " + to_string(version));
+    }
+    size_t sliceCount = loadLittleEndian(data + 12, 4);
+    uint64_t rateBits = loadLittleEndian(data + 24, 8);
+    double rate;
+    memcpy(&rate, &rateBits, sizeof(rate));
+    ScalableBloomFilter filter(loadLittleEndian(data + 16, 8), rate);
+    uint64_t droppedSlices = loadLittleEndian(data + 32, 8);
+    if (sliceCount > MAX_SLICE_COUNT || droppedSlices > MAX_SLICE_COUNT - sliceCount) {
+        throw runtime_error("Too many slices");
+    }
+    filter.droppedSlices = (size_t) droppedSlices;
+
+    size_t offset = HEADER_LENGTH;
+    for (size_t i = 0; i < sliceCount; i++) {
+        if (length - offset < SLICE_HEADER_LENGTH) {
+            throw runtime_error("Scalable filter is truncated");
+        }
+        uint64_t capacity = loadLittleEndian(data + offset, 8);
+        uint64_t sliceItems = loadLittleEndian(data + offset + 8, 8);
+        uint64_t blockCount = loadLittleEndian(data + offset + 16, 8);
+        auto hashRounds = (size_t) loadLittleEndian(data + offset + 24, 4);
+        offset += SLICE_HEADER_LENGTH;
+        if (sliceItems > capacity || blockCount > (length - offset) / (BlockedBloomFilter::BLOCK_BITS / 8)) {
+            throw runtime_error("Slice doesn't fit the scalable filter");
+        }
+
+        Slice slice { BlockedBloomFilter::withShape(blockCount, hashRounds), capacity, sliceItems };
+        uint64_t *words = slice.filter.words();
+        for (size_t word = 0; word < blockCount * BlockedBloomFilter::WORDS_PER_BLOCK; word++, offset += 8) {
+            words[word] = loadLittleEndian(data + offset, 8);
+        }
+        filter.slices.push_back(move(slice));
+    }
+    if (offset != length) {
+        throw runtime_error("Slices don't match the scalable filter");
+    }
+    return filter;
+}
+
+void ScalableBloomFilter::writeToFile(const string &path) const {
+    basic_ofstream<BlockType> out(path, ofstream::binary | ofstream::trunc);
+    writeToStream(out);
+    if (!out) {
+        throw runtime_error("Can't write " + path);
+    }
+}
+
+ScalableBloomFilter ScalableBloomFilter::readFromFile(const string &path) {
+    basic_ifstream<BlockType> in(path, ifstream::binary);
+    if (!in) {
+        throw runtime_error("Can't read " + path);
+    }
+    return readFromStream(in);
+}
+
+void ScalableBloomFilter::addSlice(size_t capacity) {
+    size_t index = droppedSlices + slices.size();
+    if (index >= MAX_SLICE_COUNT) {
+        throw runtime_error("Scalable filter can't grow further");
+    }
+    slices.push_back(Slice { BlockedBloomFilter(capacity, sliceErrorRate(index)), capacity, 0 });
+}
+
+double ScalableBloomFilter::sliceErrorRate(size_t index) const {
+    // A geometric series summing to errorRate
+    return errorRate * (1 - TIGHTENING_RATIO) * pow(TIGHTENING_RATIO, (double) index);
+}
+
+static void storeLittleEndian(vector<char> &output, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        output.push_back((char) (value >> (8 * i)));
+    }
+}
+
+static uint64_t loadLittleEndian(const char *input, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t) (unsigned char) input[i] << (8 * i);
+    }
+    return value;
+}
+
+static vector<char> readAll(BinaryInputStream &in) {
+    vector<char> data;
+    size_t length = 0;
+    while (in) {
+        data.resize(length + max(READ_CHUNK_SIZE, length / 2));
+        in.read(data.data() + length, (streamsize) (data.size() - length));
+        length += (size_t) in.gcount();
+    }
+    data.resize(length);
+    return data;
+}
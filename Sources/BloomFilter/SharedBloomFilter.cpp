@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SharedBloomFilter.hpp"
+
+using namespace std;
+
+static const char CONTROL_MAGIC[8] = { 'D', 'D', 'G', 'B', 'L', 'C', 'T', 'L' };
+static const char SEGMENT_MAGIC[8] = { 'D', 'D', 'G', 'B', 'L', 'S', 'H', 'M' };
+// A reader can lose the race against a publisher unlinking the segment it is about to open
+static const int ATTACH_ATTEMPTS = 4;
+
+static_assert(atomic<uint64_t>::is_always_lock_free, "The generation must be lock free to live in shared memory");
+
+// Forward declarations
+
+static string segmentName(const string &name, uint64_t generation);
+
+static void *mapReadOnly(const string &name, size_t &length);
+
+[[noreturn]] static void throwSystemError(const string &what);
+
+
+// Implementation
+
+SharedBloomFilterPublisher::SharedBloomFilterPublisher(const string &name)
+    : name(name), control(nullptr), publishedGeneration(0) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throwSystemError("shm_open " + name);
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || ((size_t) status.st_size < sizeof(SharedBloomFilterControl)
+                                    && ftruncate(fd, sizeof(SharedBloomFilterControl)) != 0)) {
+        close(fd);
+        throwSystemError("ftruncate " + name);
+    }
+    void *mapping = mmap(nullptr, sizeof(SharedBloomFilterControl), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throwSystemError("mmap " + name);
+    }
+
+    control = (SharedBloomFilterControl *) mapping;
+    if (memcmp(control->magic, CONTROL_MAGIC, sizeof(CONTROL_MAGIC)) != 0) {
+        control->version = SharedBloomFilterControl::CURRENT_VERSION;
+        control->generation.store(0, memory_order_relaxed);
+        memcpy(control->magic, CONTROL_MAGIC, sizeof(CONTROL_MAGIC));
+    }
+    // Continue after a previous publisher so readers still see a bump
+    publishedGeneration = control->generation.load(memory_order_acquire);
+}
+
+SharedBloomFilterPublisher::~SharedBloomFilterPublisher() {
+    if (publishedGeneration != 0) {
+        shm_unlink(segmentName(name, publishedGeneration).c_str());
+    }
+    munmap(control, sizeof(SharedBloomFilterControl));
+    shm_unlink(name.c_str());
+}
+
+uint64_t SharedBloomFilterPublisher::publish(const BloomFilter &filter, size_t maxItems) {
+    uint64_t generation = publishedGeneration + 1;
+    string dataName = segmentName(name, generation);
+    const auto &blocks = filter.getBlocks();
+    size_t length = SharedBloomFilterSegmentHeader::PAYLOAD_OFFSET + blocks.size();
+
+    // A stale segment of the same name can only come from a crashed publisher
+    shm_unlink(dataName.c_str());
+    int fd = shm_open(dataName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        throwSystemError("shm_open " + dataName);
+    }
+    if (ftruncate(fd, (off_t) length) != 0) {
+        close(fd);
+        shm_unlink(dataName.c_str());
+        throwSystemError("ftruncate " + dataName);
+    }
+    void *mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(dataName.c_str());
+        throwSystemError("mmap " + dataName);
+    }
+
+    SharedBloomFilterSegmentHeader header {};
+    memcpy(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    header.version = SharedBloomFilterSegmentHeader::CURRENT_VERSION;
+    header.hashRounds = (uint32_t) filter.getHashRounds();
+    header.generation = generation;
+    header.bitCount = filter.getBitCount();
+    header.maxItems = maxItems;
+    header.payloadLength = blocks.size();
+    memcpy(mapping, &header, sizeof(header));
+    memcpy((char *) mapping + SharedBloomFilterSegmentHeader::PAYLOAD_OFFSET, blocks.data(), blocks.size());
+    munmap(mapping, length);
+
+    // Readers that see the new generation also see the segment contents
+    control->generation.store(generation, memory_order_release);
+    if (publishedGeneration != 0) {
+        shm_unlink(segmentName(name, publishedGeneration).c_str());
+    }
+    publishedGeneration = generation;
+    return generation;
+}
+
+uint64_t SharedBloomFilterPublisher::getGeneration() const {
+    return publishedGeneration;
+}
+
+SharedBloomFilterReader::SharedBloomFilterReader(const string &name) : name(name), control(nullptr) {
+    size_t length;
+    void *mapping = mapReadOnly(name, length);
+    if (mapping == nullptr) {
+        throwSystemError("shm_open " + name);
+    }
+    control = (const SharedBloomFilterControl *) mapping;
+    if (length < sizeof(SharedBloomFilterControl)
+        || memcmp(control->magic, CONTROL_MAGIC, sizeof(CONTROL_MAGIC)) != 0
+        || control->version != SharedBloomFilterControl::CURRENT_VERSION) {
+        munmap(mapping, length);
+        throw runtime_error(name + " is not a shared filter");
+    }
+}
+
+SharedBloomFilterReader::~SharedBloomFilterReader() {
+    munmap((void *) control, sizeof(SharedBloomFilterControl));
+}
+
+shared_ptr<const BloomFilterView> SharedBloomFilterReader::current() {
+    uint64_t generation = control->generation.load(memory_order_acquire);
+    auto latest = atomic_load(&view);
+    if (generation == 0 || (latest != nullptr && latest->getGeneration() == generation)) {
+        return latest;
+    }
+
+    lock_guard<mutex> lock(attachMutex);
+    for (int attempt = 0; attempt < ATTACH_ATTEMPTS; attempt++) {
+        latest = atomic_load(&view);
+        if (latest != nullptr && latest->getGeneration() == generation) {
+            return latest;
+        }
+        auto attached = attach(name, generation);
+        if (attached != nullptr) {
+            atomic_store(&view, attached);
+            return attached;
+        }
+        generation = control->generation.load(memory_order_acquire);
+    }
+    // Keep serving the previous filter rather than none
+    return atomic_load(&view);
+}
+
+shared_ptr<const BloomFilterView> SharedBloomFilterReader::attach(const string &name, uint64_t generation) {
+    size_t length;
+    void *mapping = mapReadOnly(segmentName(name, generation), length);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+    shared_ptr<const void> owner(mapping, [length](const void *address) {
+        munmap((void *) address, length);
+    });
+
+    // The segment comes from another process, so nothing in it is trusted
+    SharedBloomFilterSegmentHeader header;
+    if (length < SharedBloomFilterSegmentHeader::PAYLOAD_OFFSET) {
+        return nullptr;
+    }
+    memcpy(&header, mapping, sizeof(header));
+    if (memcmp(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0
+        || header.version != SharedBloomFilterSegmentHeader::CURRENT_VERSION
+        || header.generation != generation
+        || header.maxItems == 0
+        || header.payloadLength > length - SharedBloomFilterSegmentHeader::PAYLOAD_OFFSET
+        || header.hashRounds != BloomFilter::hashRoundsFor(header.bitCount, header.maxItems)) {
+        return nullptr;
+    }
+
+    try {
+        auto blocks = (const BlockType *) mapping + SharedBloomFilterSegmentHeader::PAYLOAD_OFFSET;
+        return make_shared<const BloomFilterView>(blocks, header.payloadLength, header.bitCount, header.hashRounds, owner, generation);
+    } catch (const runtime_error &) {
+        return nullptr;
+    }
+}
+
+static string segmentName(const string &name, uint64_t generation) {
+    return name + "." + to_string(generation);
+}
+
+static void *mapReadOnly(const string &name, size_t &length) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    length = (size_t) status.st_size;
+    void *mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return mapping == MAP_FAILED ? nullptr : mapping;
+}
+
+[[noreturn]] static void throwSystemError(const string &what) {
+    throw runtime_error(what + ": " + strerror(errno));
+}
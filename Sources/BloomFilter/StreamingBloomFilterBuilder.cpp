@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+#include "StreamingBloomFilterBuilder.hpp"
+
+using namespace std;
+
+// How much of the input is read at a time, grown for longer lines
+static const size_t CHUNK_SIZE = 8 * 1024 * 1024;
+// Standard errors of the distinct count the filter is sized beyond the estimate
+static const double SIZING_MARGIN = 3;
+
+// Forward declarations
+
+static void forEachChunk(BinaryInputStream &in, const function<void(const vector<string_view> &)> &visit);
+
+static void appendLines(const char *data, size_t length, vector<string_view> &lines);
+
+
+// Implementation
+
+StreamingBloomFilterBuilder::StreamingBloomFilterBuilder(double targetProbability, size_t threadCount)
+    : targetProbability(targetProbability), threadCount(threadCount), lineCount(0), estimatedItemCount(0), maxItems(0) {
+    if (!(targetProbability > 0 && targetProbability < 1)) {
+        throw runtime_error("Invalid filter parameters");
+    }
+}
+
+BloomFilterFile StreamingBloomFilterBuilder::build(BinaryInputStream &in) {
+    auto start = in.tellg();
+    if (start < 0) {
+        throw runtime_error("The domain list can't be read twice");
+    }
+
+    HyperLogLog counter;
+    lineCount = 0;
+    forEachChunk(in, [&](const vector<string_view> &lines) {
+        for (string_view line : lines) {
+            counter.add(line);
+        }
+        lineCount += lines.size();
+    });
+    if (lineCount == 0) {
+        throw runtime_error("The domain list has no domains");
+    }
+    estimatedItemCount = counter.estimate();
+    maxItems = max<size_t>((size_t) ceil(estimatedItemCount * (1 + SIZING_MARGIN * counter.relativeError())), 1);
+
+    in.clear();
+    if (!in.seekg(start)) {
+        throw runtime_error("The domain list can't be read twice");
+    }
+    BloomFilter filter(maxItems, targetProbability);
+    forEachChunk(in, [&](const vector<string_view> &lines) {
+        filter.addAll(lines, threadCount);
+    });
+    return BloomFilterFile::fromFilter(filter, maxItems);
+}
+
+BloomFilterFile StreamingBloomFilterBuilder::build(const string &path) {
+    basic_ifstream<BlockType> in(path, ifstream::binary);
+    if (!in) {
+        throw runtime_error("Can't read " + path);
+    }
+    return build(in);
+}
+
+size_t StreamingBloomFilterBuilder::getLineCount() const {
+    return lineCount;
+}
+
+double StreamingBloomFilterBuilder::getEstimatedItemCount() const {
+    return estimatedItemCount;
+}
+
+size_t StreamingBloomFilterBuilder::getMaxItems() const {
+    return maxItems;
+}
+
+static void forEachChunk(BinaryInputStream &in, const function<void(const vector<string_view> &)> &visit) {
+    vector<char> buffer(CHUNK_SIZE);
+    vector<string_view> lines;
+    size_t carried = 0;
+    while (true) {
+        in.read(buffer.data() + carried, (streamsize) (buffer.size() - carried));
+        size_t length = carried + (size_t) in.gcount();
+        bool ended = !in;
+
+        // Complete lines only, the rest is carried into the next chunk
+        size_t complete = length;
+        if (!ended) {
+            while (complete > 0 && buffer[complete - 1] != '\n') {
+                complete--;
+            }
+            if (complete == 0) {
+                // A line longer than the buffer
+                carried = length;
+                buffer.resize(buffer.size() * 2);
+                continue;
+            }
+        }
+
+        lines.clear();
+        appendLines(buffer.data(), complete, lines);
+        if (!lines.empty()) {
+            visit(lines);
+        }
+        if (ended) {
+            if (in.bad()) {
+                throw runtime_error("Can't read the domain list");
+            }
+            return;
+        }
+        carried = length - complete;
+        memmove(buffer.data(), buffer.data() + complete, carried);
+    }
+}
+
+static void appendLines(const char *data, size_t length, vector<string_view> &lines) {
+    size_t start = 0;
+    while (start < length) {
+        const auto *newline = (const char *) memchr(data + start, '\n', length - start);
+        size_t end = newline != nullptr ? (size_t) (newline - data) : length;
+        string_view line(data + start, end - start);
+        while (!line.empty() && isspace((unsigned char) line.back())) {
+            line.remove_suffix(1);
+        }
+        while (!line.empty() && isspace((unsigned char) line.front())) {
+            line.remove_prefix(1);
+        }
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+        start = end + 1;
+    }
+}
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "DomainArena.hpp"
+#include "HostKey.hpp"
+#include "JSONReader.hpp"
+#include "TrackerAllowlist.hpp"
+
+using namespace std;
+
+static const char ALL_DOMAINS[] = "<all>";
+static const char SCHEME_SEPARATOR[] = "://";
+static const size_t SCHEME_SEPARATOR_LENGTH = sizeof(SCHEME_SEPARATOR) - 1;
+
+// Forward declarations
+
+static bool findHost(string_view url, string_view &host);
+
+static bool consumePrefix(string_view &text, string_view prefix);
+
+static bool isLabelCharacter(char character);
+
+static bool isUppercase(char character);
+
+static char toLowerASCII(char character);
+
+
+// Implementation
+
+TrackerAllowlist::TrackerAllowlist(const vector<TrackerAllowlistEntry> &entries) : trackerIndex(RibbonDomainMap::build({})) {
+    // Rules are grouped per tracker, keeping their order within it
+    vector<size_t> order(entries.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&entries](size_t lhs, size_t rhs) {
+        return entries[lhs].trackerDomain < entries[rhs].trackerDomain;
+    });
+
+    DomainArena &arena = DomainArena::shared();
+    for (size_t i : order) {
+        const TrackerAllowlistEntry &entry = entries[i];
+        uint32_t domain = arena.intern(entry.trackerDomain);
+        if (trackers.empty() || trackers.back().domain != domain) {
+            trackers.push_back(Tracker { domain, (uint32_t) rules.size(), 0 });
+        }
+        trackers.back().ruleCount++;
+
+        vector<string> parts;
+        size_t start = 0;
+        size_t star;
+        while ((star = entry.rule.find('*', start)) != string::npos) {
+            parts.push_back(entry.rule.substr(start, star - start));
+            start = star + 1;
+        }
+        parts.push_back(entry.rule.substr(start));
+
+        bool allDomains = find(entry.domains.begin(), entry.domains.end(), ALL_DOMAINS) != entry.domains.end();
+        // Every rule has a set of its own and most have a handful of domains, so one thread builds each
+        rules.push_back(Rule { move(parts), allDomains, PerfectDomainSet::build(entry.domains, true, 1) });
+    }
+
+    vector<pair<string_view, uint32_t>> indexEntries;
+    for (size_t i = 0; i < trackers.size(); i++) {
+        indexEntries.emplace_back(arena.domain(trackers[i].domain), (uint32_t) i);
+    }
+    trackerIndex = RibbonDomainMap::build(indexEntries);
+}
+
+TrackerAllowlist TrackerAllowlist::fromAllowlistedTrackers(const JSONValue &allowlistedTrackers) {
+    vector<TrackerAllowlistEntry> entries;
+    for (const auto &tracker : allowlistedTrackers.asObject()) {
+        const JSONValue *trackerRules = tracker.second.find("rules");
+        if (trackerRules == nullptr || !trackerRules->isArray()) {
+            continue;
+        }
+        for (const auto &trackerRule : trackerRules->asArray()) {
+            const JSONValue *rule = trackerRule.find("rule");
+            const JSONValue *domains = trackerRule.find("domains");
+            if (rule == nullptr || !rule->isString() || domains == nullptr || !domains->isArray()) {
+                continue;
+            }
+            TrackerAllowlistEntry entry { tracker.first, rule->asString(), {} };
+            for (const auto &domain : domains->asArray()) {
+                if (domain.isString()) {
+                    entry.domains.push_back(domain.asString());
+                }
+            }
+            entries.push_back(move(entry));
+        }
+    }
+    return TrackerAllowlist(entries);
+}
+
+TrackerAllowlist TrackerAllowlist::fromPrivacyConfig(string_view json) {
+    JSONValue root = JSONReader::parse(json);
+    const JSONValue *features = root.find("features");
+    const JSONValue *feature = features == nullptr ? nullptr : features->find("trackerAllowlist");
+    const JSONValue *state = feature == nullptr ? nullptr : feature->find("state");
+    if (state == nullptr || !state->isString() || state->asString() != "enabled") {
+        return TrackerAllowlist({});
+    }
+    const JSONValue *settings = feature->find("settings");
+    const JSONValue *allowlistedTrackers = settings == nullptr ? nullptr : settings->find("allowlistedTrackers");
+    if (allowlistedTrackers == nullptr || !allowlistedTrackers->isObject()) {
+        return TrackerAllowlist({});
+    }
+    return fromAllowlistedTrackers(*allowlistedTrackers);
+}
+
+bool TrackerAllowlist::isAllowlisted(string_view requestURL, string_view siteHost) const {
+    string_view hostPart;
+    HostKey host;
+    if (trackers.empty() || !findHost(requestURL, hostPart) || !host.assign(hostPart)) {
+        return false;
+    }
+
+    // The longest listed parent wins, down to two labels
+    const DomainArena &arena = DomainArena::shared();
+    const Tracker *tracker = nullptr;
+    for (size_t label = 0; tracker == nullptr && label + 1 < host.labelCount(); label++) {
+        uint32_t id;
+        if (trackerIndex.find(host, label, id) && id < trackers.size() && arena.domain(trackers[id].domain) == host.suffix(label)) {
+            tracker = &trackers[id];
+        }
+    }
+    if (tracker == nullptr) {
+        return false;
+    }
+
+    // Rules are lowercase, so are scheme and host for matching them. URLs
+    // from WebKit already are; only others pay for a copy.
+    string lowercased;
+    size_t hostEnd = (size_t) (hostPart.data() + hostPart.size() - requestURL.data());
+    if (any_of(requestURL.begin(), requestURL.begin() + (ptrdiff_t) hostEnd, isUppercase)) {
+        lowercased.assign(requestURL);
+        transform(lowercased.begin(), lowercased.begin() + (ptrdiff_t) hostEnd, lowercased.begin(), toLowerASCII);
+        requestURL = lowercased;
+    }
+
+    for (size_t i = tracker->firstRule; i < tracker->firstRule + tracker->ruleCount; i++) {
+        if (matchesURL(rules[i], requestURL)) {
+            // Only the first matching rule counts, even when it doesn't cover the site
+            return appliesOn(rules[i], siteHost);
+        }
+    }
+    return false;
+}
+
+size_t TrackerAllowlist::size() const {
+    return rules.size();
+}
+
+bool TrackerAllowlist::matchesURL(const Rule &rule, string_view url) const {
+    size_t schemeEnd = url.find(SCHEME_SEPARATOR);
+    if (schemeEnd == string_view::npos) {
+        return false;
+    }
+    string_view scheme = url.substr(0, schemeEnd);
+    if (consumePrefix(scheme, "http")) {
+        consumePrefix(scheme, "s");
+    }
+    if (consumePrefix(scheme, "ws")) {
+        consumePrefix(scheme, "s");
+    }
+    if (!scheme.empty()) {
+        return false;
+    }
+
+    // The rule may start after any number of leading labels
+    string_view rest = url.substr(schemeEnd + SCHEME_SEPARATOR_LENGTH);
+    size_t start = 0;
+    while (true) {
+        string_view candidate = rest.substr(start);
+        if (candidate.compare(0, rule.parts[0].size(), rule.parts[0]) == 0) {
+            size_t position = rule.parts[0].size();
+            bool matched = true;
+            for (size_t i = 1; i < rule.parts.size() && matched; i++) {
+                size_t found = candidate.find(rule.parts[i], position);
+                matched = found != string_view::npos;
+                position = found + rule.parts[i].size();
+            }
+            if (matched) {
+                return true;
+            }
+        }
+
+        size_t labelEnd = start;
+        while (labelEnd < rest.size() && isLabelCharacter(rest[labelEnd])) {
+            labelEnd++;
+        }
+        if (labelEnd == start || labelEnd == rest.size() || rest[labelEnd] != '.') {
+            return false;
+        }
+        start = labelEnd + 1;
+    }
+}
+
+bool TrackerAllowlist::appliesOn(const Rule &rule, string_view siteHost) const {
+    if (rule.allDomains) {
+        return true;
+    }
+    HostKey site;
+    if (!site.assign(siteHost)) {
+        return false;
+    }
+    for (size_t label = 0; label + 1 < site.labelCount(); label++) {
+        if (rule.domains.contains(site, label)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Finds the host of any URL with an authority, as it appears in the URL
+static bool findHost(string_view url, string_view &host) {
+    size_t schemeEnd = url.find(SCHEME_SEPARATOR);
+    if (schemeEnd == string_view::npos) {
+        return false;
+    }
+    size_t authorityStart = schemeEnd + SCHEME_SEPARATOR_LENGTH;
+    size_t authorityEnd = url.find_first_of("/?#", authorityStart);
+    if (authorityEnd == string_view::npos) {
+        authorityEnd = url.size();
+    }
+    string_view authority = url.substr(authorityStart, authorityEnd - authorityStart);
+    size_t userInfoEnd = authority.rfind('@');
+    if (userInfoEnd != string_view::npos) {
+        authority.remove_prefix(userInfoEnd + 1);
+    }
+    host = authority.substr(0, authority.find(':'));
+    return !host.empty();
+}
+
+static bool consumePrefix(string_view &text, string_view prefix) {
+    if (text.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    text.remove_prefix(prefix.size());
+    return true;
+}
+
+static bool isLabelCharacter(char character) {
+    return (character >= 'a' && character <= 'z') || (character >= '0' && character <= '9') || character == '-';
+}
+
+static bool isUppercase(char character) {
+    return character >= 'A' && character <= 'Z';
+}
+
+static char toLowerASCII(char character) {
+    return isUppercase(character) ? (char) (character + ('a' - 'A')) : character;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include "BloomFilterFile.hpp"
+
+using namespace std;
+
+/*
+ Fuzzes container parsing. Headers that decode must survive an encode round
+ trip, containers that parse must produce a usable filter and streaming them
+ must give the same payload. Any input is also streamed on its own, where the
+ header's lengths must not size an allocation beyond the input.
+ */
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    const char *bytes = (const char *) data;
+
+    BloomFilterFileHeader header;
+    if (BloomFilterFileHeader::decode(bytes, size, header)) {
+        char encoded[BloomFilterFileHeader::ENCODED_SIZE];
+        header.encode(encoded);
+        if (memcmp(encoded, bytes, sizeof(encoded)) != 0) {
+            __builtin_trap();
+        }
+    }
+
+    try {
+        istringstream in(string(bytes, size));
+        BloomFilterFile::readContainer(in);
+    } catch (const runtime_error &) {
+    }
+
+    try {
+        BloomFilterFile file = BloomFilterFile::parseContainer(bytes, size);
+        istringstream in(string(bytes, size));
+        if (BloomFilterFile::readContainer(in).payload != file.payload) {
+            __builtin_trap();
+        }
+        BloomFilter filter = file.makeFilter();
+        filter.contains(string_view(bytes, size < 32 ? size : 32));
+        filter.stats();
+    } catch (const runtime_error &) {
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include "FuzzInput.hpp"
+
+using namespace std;
+
+/*
+ Fuzzes the loading constructors with arbitrary parameters and data. Input:
+ u32 bit count, u16 max items, u8 constructor, then the filter data.
+ */
+
+static const size_t PARAMETER_BYTES = 7;
+
+// Forward declarations
+
+static void exercise(BloomFilter &filter, const uint8_t *data, size_t size);
+
+static string temporaryPath();
+
+
+// Implementation
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size < PARAMETER_BYTES) {
+        return 0;
+    }
+    FuzzInput input(data, size);
+    size_t bitCount = input.take<uint32_t>();
+    size_t maxItems = input.take<uint16_t>();
+    uint8_t constructor = input.take<uint8_t>() % 3;
+    string payload = input.rest();
+
+    try {
+        if (constructor == 0) {
+            basic_istringstream<BlockType> in(payload);
+            BloomFilter filter(in, bitCount, maxItems);
+            exercise(filter, data, size);
+        } else if (constructor == 1) {
+            string path = temporaryPath();
+            FILE *file = fopen(path.c_str(), "wb");
+            if (file == nullptr) {
+                // Nothing to load from without a writable temporary directory
+                return 0;
+            }
+            bool written = fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+            if (fclose(file) != 0 || !written) {
+                return 0;
+            }
+            BloomFilter filter(path, bitCount, maxItems);
+            exercise(filter, data, size);
+        } else {
+            BloomFilter filter(vector<BlockType>(payload.begin(), payload.end()), bitCount, maxItems);
+            exercise(filter, data, size);
+        }
+    } catch (const runtime_error &) {
+        // Rejecting the parameters is the expected outcome for most inputs
+    }
+    return 0;
+}
+
+static void exercise(BloomFilter &filter, const uint8_t *data, size_t size) {
+    // Keys are arbitrary slices of the input, including empty and non UTF-8 ones
+    for (size_t length = 0; length <= size && length < 64; length += 7) {
+        filter.contains(string_view((const char *) data, length));
+    }
+    filter.add(string((const char *) data, size));
+    filter.stats();
+
+    basic_ostringstream<BlockType> out;
+    filter.writeToStream(out);
+}
+
+static string temporaryPath() {
+    static string path = "/tmp/bloomfilter-fuzz-" + to_string(getpid());
+    return path;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BloomFilter.hpp"
+#include "BloomFilterBuilder.hpp"
+#include "HTTPSUpgradeEngine.hpp"
+
+using namespace std;
+
+/*
+ Fuzzes lookups with adversarial keys: the raw filter probe, and the engine
+ parsing the same bytes as a URL into exact and too small output buffers.
+ */
+
+// Forward declarations
+
+static shared_ptr<BloomFilter> makeFilter();
+
+static HTTPSUpgradeEngine &engine();
+
+
+// Implementation
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static shared_ptr<BloomFilter> filter = makeFilter();
+    string_view key((const char *) data, size);
+    filter->contains(key);
+
+    char host[HTTPSUpgradeEngine::MAX_HOST_LENGTH];
+    size_t hostLength;
+    HTTPSUpgradeEngine::parseHost(key, host, hostLength);
+
+    // Separate allocations so overruns of either buffer are caught
+    vector<char> url(key.begin(), key.end());
+    vector<char> output(size + 2);
+    vector<char> shortOutput(size / 2);
+    size_t outputLength;
+    engine().decide(url.data(), url.size(), output.data(), output.size(), outputLength);
+    engine().decide(url.data(), url.size(), shortOutput.data(), shortOutput.size(), outputLength);
+    return 0;
+}
+
+static shared_ptr<BloomFilter> makeFilter() {
+    auto filter = make_shared<BloomFilter>(1000, 0.001);
+    for (const char *domain : { "example.com", "www.example.com", "a", "" }) {
+        filter->add(domain);
+    }
+    return filter;
+}
+
+static HTTPSUpgradeEngine &engine() {
+    static HTTPSUpgradeEngine *instance = []() {
+        auto created = new HTTPSUpgradeEngine(64);
+        BloomFilterBuilder builder(*makeFilter());
+        created->setUpgradeList(make_shared<const FrozenBloomFilter>(builder.freeze()), { "excluded.example.com" });
+        created->setFeatureState(true, { "example.org" }, { "unprotected.example.com" });
+        return created;
+    }();
+    return *instance;
+}
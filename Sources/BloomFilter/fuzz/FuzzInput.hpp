@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FUZZ_INPUT_HPP
+#define FUZZ_INPUT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "BloomFilter.hpp"
+
+// Consumes fixed size values from the front of a fuzzer input
+class FuzzInput {
+
+public:
+    FuzzInput(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+    // Missing bytes read as zero
+    template <typename T>
+    T take() {
+        T value = 0;
+        size_t length = size < sizeof(T) ? size : sizeof(T);
+        // An exhausted or empty input may have a null data pointer
+        if (length == 0) {
+            return value;
+        }
+        memcpy(&value, data, length);
+        data += length;
+        size -= length;
+        return value;
+    }
+
+    std::string rest() {
+        if (size == 0) {
+            return std::string();
+        }
+        std::string remaining((const char *) data, size);
+        data += size;
+        size = 0;
+        return remaining;
+    }
+
+private:
+    const uint8_t *data;
+    size_t size;
+};
+
+#endif
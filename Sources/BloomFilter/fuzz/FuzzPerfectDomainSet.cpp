@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+#include "FuzzInput.hpp"
+#include "PerfectDomainSet.hpp"
+
+using namespace std;
+
+/*
+ Fuzzes the perfect hash domain set. Sets built from newline separated
+ domains must contain every one of them, also after a round trip through
+ their serialized form. Serialized sets are then corrupted at a chosen byte,
+ and whatever still loads must answer lookups without reading out of bounds.
+ */
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    FuzzInput input(data, size);
+    auto mode = input.take<uint8_t>();
+    auto corruptOffset = input.take<uint32_t>();
+    auto corruptValue = input.take<uint8_t>();
+    string text = input.rest();
+
+    if (mode % 2 == 0) {
+        try {
+            PerfectDomainSet set(vector<char>(text.begin(), text.end()));
+            set.contains(string_view(text.data(), text.size() < 32 ? text.size() : 32));
+        } catch (const runtime_error &) {
+        }
+        return 0;
+    }
+
+    vector<string_view> domains;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == string::npos) {
+            end = text.size();
+        }
+        domains.push_back(string_view(text).substr(start, end - start));
+        start = end + 1;
+    }
+
+    PerfectDomainSet set = PerfectDomainSet::build(domains, mode & 2, 1);
+    PerfectDomainSet copy(vector<char>(set.data(), set.data() + set.dataLength()));
+    for (auto domain : domains) {
+        if (!set.contains(domain) || !copy.contains(domain)) {
+            __builtin_trap();
+        }
+    }
+
+    vector<char> corrupted(set.data(), set.data() + set.dataLength());
+    corrupted[corruptOffset % corrupted.size()] ^= (char) (corruptValue | 1);
+    try {
+        PerfectDomainSet damaged(move(corrupted));
+        for (auto domain : domains) {
+            damaged.contains(domain);
+        }
+    } catch (const runtime_error &) {
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "FuzzInput.hpp"
+#include "RibbonDomainMap.hpp"
+
+using namespace std;
+
+/*
+ Fuzzes the ribbon domain map. Maps built from newline separated domains,
+ with IDs taken from the line numbers, must return every ID, also after a
+ round trip through their serialized form. Serialized maps are then corrupted
+ at a chosen byte, and whatever still loads must answer lookups without
+ reading out of bounds.
+ */
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    FuzzInput input(data, size);
+    auto mode = input.take<uint8_t>();
+    auto corruptOffset = input.take<uint32_t>();
+    auto corruptValue = input.take<uint8_t>();
+    string text = input.rest();
+
+    if (mode % 2 == 0) {
+        try {
+            RibbonDomainMap map(vector<char>(text.begin(), text.end()));
+            uint32_t id;
+            map.findAnySuffix(string_view(text.data(), text.size() < 32 ? text.size() : 32), id);
+        } catch (const runtime_error &) {
+        }
+        return 0;
+    }
+
+    // Distinct lines only, a repeated domain with another ID is rejected by design
+    vector<pair<string_view, uint32_t>> entries;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == string::npos) {
+            end = text.size();
+        }
+        string_view domain = string_view(text).substr(start, end - start);
+        bool seen = false;
+        for (const auto &entry : entries) {
+            seen = seen || entry.first == domain;
+        }
+        if (!seen) {
+            entries.emplace_back(domain, (uint32_t) (entries.size() * (mode >> 1)));
+        }
+        start = end + 1;
+    }
+
+    RibbonDomainMap map = RibbonDomainMap::build(entries, (mode >> 1) % (RibbonDomainMap::MAX_FINGERPRINT_BITS + 1));
+    RibbonDomainMap copy(vector<char>(map.data(), map.data() + map.dataLength()));
+    for (const auto &entry : entries) {
+        uint32_t id;
+        uint32_t copyID;
+        if (!map.find(entry.first, id) || id != entry.second || !copy.find(entry.first, copyID) || copyID != id) {
+            __builtin_trap();
+        }
+    }
+
+    vector<char> corrupted(map.data(), map.data() + map.dataLength());
+    corrupted[corruptOffset % corrupted.size()] ^= (char) (corruptValue | 1);
+    try {
+        RibbonDomainMap damaged(move(corrupted));
+        for (const auto &entry : entries) {
+            uint32_t id;
+            damaged.find(entry.first, id);
+        }
+    } catch (const runtime_error &) {
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+using namespace std;
+
+/*
+ Runs a fuzz target over files given on the command line, or stdin without
+ arguments. Used where libFuzzer is unavailable: replaying crashes under GCC,
+ and as the target binary for AFL (`afl-fuzz -i seeds -o findings -- ./target @@`).
+ */
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Forward declarations
+
+static void runInput(istream &in);
+
+
+// Implementation
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        runInput(cin);
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        ifstream in(argv[i], ifstream::binary);
+        if (!in) {
+            fprintf(stderr, "Can't read %s\n", argv[i]);
+            return 1;
+        }
+        runInput(in);
+    }
+    return 0;
+}
+
+static void runInput(istream &in) {
+    vector<char> input((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    // A distinct allocation of exactly the input size, so ASan sees reads past its end
+    vector<uint8_t> data(input.begin(), input.end());
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AGE_PARTITIONED_BLOOM_FILTER_HPP
+#define AGE_PARTITIONED_BLOOM_FILTER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "BlockedBloomFilter.hpp"
+
+class HostKey;
+
+/*
+ Remembers keys for a while, e.g. hosts whose upgrade just failed over TLS.
+ Keys go into the newest of a ring of BlockedBloomFilter generations; a new
+ generation is opened every `ttl` / (generationCount - 1), recycling the
+ oldest. A key is reported for at least `ttl` after it was last added and at
+ most one generation span longer.
+
+ Memory is fixed at construction. Each generation holds its share of
+ `capacity`, and one that fills up early is closed early, so a burst of keys
+ shortens how long keys are remembered rather than raising the error rate.
+
+ contains() is lock free and can run while keys are added; adds are
+ serialized among themselves.
+ */
+class AgePartitionedBloomFilter {
+
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr size_t DEFAULT_GENERATION_COUNT = 4;
+
+    // Sized for `capacity` keys added within any `ttl`, at `errorRate` across
+    // all generations. Throws runtime_error for invalid parameters.
+    AgePartitionedBloomFilter(size_t capacity, double errorRate, Clock::duration ttl,
+                              size_t generationCount = DEFAULT_GENERATION_COUNT);
+
+    AgePartitionedBloomFilter(const AgePartitionedBloomFilter &) = delete;
+
+    AgePartitionedBloomFilter &operator=(const AgePartitionedBloomFilter &) = delete;
+
+    // Adding a key again restarts its time to live
+    void add(std::string_view key, Clock::time_point now = Clock::now());
+
+    void add(const HostKey &key, Clock::time_point now = Clock::now());
+
+    void addHash(uint64_t hash, Clock::time_point now = Clock::now());
+
+    bool contains(std::string_view key, Clock::time_point now = Clock::now()) const;
+
+    bool contains(const HostKey &key, Clock::time_point now = Clock::now()) const;
+
+    bool containsHash(uint64_t hash, Clock::time_point now = Clock::now()) const;
+
+    size_t getGenerationCount() const;
+
+    Clock::duration getTTL() const;
+
+    size_t byteCount() const;
+
+private:
+    struct Generation {
+        BlockedBloomFilter filter;
+        // Nanoseconds on Clock after which nothing in the generation is reported
+        std::atomic<int64_t> expiry;
+        Clock::time_point openedAt;
+        size_t itemCount;
+    };
+
+    static int64_t nanoseconds(Clock::time_point time);
+
+    Clock::duration ttl;
+    Clock::duration generationSpan;
+    size_t generationCapacity;
+    // Fixed at construction, only their contents change
+    std::vector<std::unique_ptr<Generation>> generations;
+    size_t newest;
+    std::mutex addMutex;
+};
+
+#endif
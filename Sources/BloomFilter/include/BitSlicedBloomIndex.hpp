@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BIT_SLICED_BLOOM_INDEX_HPP
+#define BIT_SLICED_BLOOM_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class HostKey;
+
+/*
+ Bloom filters for up to 64 domain lists sharing one set of positions. Each
+ position holds a word with one bit per list, so a single hash pass and k
+ word loads ANDed together give the mask of lists that may contain a key.
+ Words are as narrow as the list count allows: 8 lists take one byte per
+ position.
+
+ Every list has the false positive rate the index was sized for, as long as
+ it holds no more than maxItemsPerList keys. Masks are only a prefilter for
+ exact lists; a clear bit is definite.
+ */
+class BitSlicedBloomIndex {
+
+public:
+    static constexpr size_t MAX_LISTS = 64;
+    static constexpr uint32_t CURRENT_VERSION = 1;
+
+    // Throws runtime_error for impossible parameters
+    BitSlicedBloomIndex(size_t listCount, size_t maxItemsPerList, double targetProbability);
+
+    // Validates the serialized form and throws runtime_error when it is malformed
+    explicit BitSlicedBloomIndex(std::vector<char> data);
+
+    static BitSlicedBloomIndex readFromFile(const std::string &path);
+
+    BitSlicedBloomIndex(BitSlicedBloomIndex &&) = default;
+
+    BitSlicedBloomIndex &operator=(BitSlicedBloomIndex &&) = default;
+
+    BitSlicedBloomIndex(const BitSlicedBloomIndex &) = delete;
+
+    BitSlicedBloomIndex &operator=(const BitSlicedBloomIndex &) = delete;
+
+    void add(size_t list, std::string_view key);
+
+    // Bit i is set when list i may contain `key`
+    uint64_t query(std::string_view key) const;
+
+    // Lists that may contain `host` or any of its parent domains
+    uint64_t queryAnySuffix(std::string_view host) const;
+
+    // Same, with the hashes a HostKey already holds
+    uint64_t query(const HostKey &key, size_t label = 0) const;
+
+    uint64_t queryAnySuffix(const HostKey &key) const;
+
+    size_t getListCount() const;
+
+    size_t getSlotCount() const;
+
+    size_t getHashRounds() const;
+
+    const char *data() const;
+
+    size_t dataLength() const;
+
+    void writeToFile(const std::string &path) const;
+
+private:
+    void attach();
+
+    uint64_t queryHashed(uint64_t hash) const;
+
+    uint64_t wordAt(uint64_t slot) const;
+
+    std::vector<char> storage;
+    char *words;
+    uint64_t slotCount;
+    uint32_t listCount;
+    uint32_t wordBytes;
+    uint32_t hashRounds;
+    uint64_t allLists;
+};
+
+#endif
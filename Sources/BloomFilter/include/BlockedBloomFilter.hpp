@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef BLOCKED_BLOOM_FILTER_HPP
+#define BLOCKED_BLOOM_FILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+ Bloom filter for sets built on the device, which don't have to match the
+ server's djb2 / sdbm scheme. Every key sets and probes its bits within one
+ 64-byte block picked by its hash64, so a lookup costs a single cache line.
+ Keys are passed as that hash, e.g. HostKey::hash(), so one hash serves any
+ number of filters.
+
+ Bits are set and read with relaxed atomics: keys can be added while other
+ threads look them up, and a key is found once its add has returned.
+ */
+class BlockedBloomFilter {
+
+public:
+    static constexpr size_t BLOCK_BITS = 512;
+    static constexpr size_t WORDS_PER_BLOCK = BLOCK_BITS / 64;
+    static constexpr size_t MAX_HASH_ROUNDS = 32;
+
+    // Sized for `targetProbability` after the blocks' own skew is accounted for.
+    // Throws runtime_error for invalid parameters.
+    BlockedBloomFilter(size_t maxItems, double targetProbability);
+
+    // A filter of exactly this shape, e.g. to restore persisted words into
+    static BlockedBloomFilter withShape(size_t blockCount, size_t hashRounds);
+
+    BlockedBloomFilter(BlockedBloomFilter &&) noexcept = default;
+
+    BlockedBloomFilter &operator=(BlockedBloomFilter &&) noexcept = default;
+
+    void add(uint64_t hash);
+
+    bool contains(uint64_t hash) const;
+
+    void clear();
+
+    size_t getBlockCount() const;
+
+    size_t getHashRounds() const;
+
+    size_t byteCount() const;
+
+    double fillRatio() const;
+
+    // Aligned to 64 bytes, BLOCK_BITS per block, for persisting and restoring the bits
+    uint64_t *words();
+
+    const uint64_t *words() const;
+
+    // What the filter for `maxItems` and `targetProbability` takes, without building it
+    static size_t byteCountFor(size_t maxItems, double targetProbability);
+
+    // The rate a filter of this shape reaches with `itemCount` keys
+    static double falsePositiveRate(size_t blockCount, size_t hashRounds, size_t itemCount);
+
+private:
+    struct Shape {
+        size_t blockCount;
+        size_t hashRounds;
+    };
+
+    explicit BlockedBloomFilter(Shape shape);
+
+    static Shape shapeFor(size_t maxItems, double targetProbability);
+
+    struct AlignedDelete {
+        void operator()(uint64_t *words) const;
+    };
+
+    size_t blockCount;
+    size_t hashRounds;
+    std::unique_ptr<uint64_t[], AlignedDelete> storage;
+};
+
+#endif
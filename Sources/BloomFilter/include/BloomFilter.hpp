@@ -14,8 +14,12 @@
  * limitations under the License.
  */
 
+#ifndef BLOOM_FILTER_HPP
+#define BLOOM_FILTER_HPP
+
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iterator>
 
@@ -25,6 +29,37 @@ typedef char BlockType;
 typedef basic_istream<BlockType> BinaryInputStream;
 typedef basic_ostream<BlockType> BinaryOutputStream;
 
+class HostKey;
+
+/*
+ Load-time health of a filter, derived from the bits actually set rather than
+ from the parameters it was created with.
+ */
+struct BloomFilterStats {
+    size_t bitCount;
+    size_t hashRounds;
+    size_t setBits;
+    double fillRatio;
+    // Probability that a key which was never added is reported as present
+    double falsePositiveRate;
+    double estimatedItemCount;
+    // Shannon entropy of the byte values, and what independent bits at fillRatio would give
+    double byteEntropy;
+    double expectedByteEntropy;
+
+    // Compares against errorRate itself. The only slack is the estimate's own
+    // error (see falsePositiveRateMargin), and tolerance scales errorRate.
+    bool isWithinErrorRate(double errorRate, double tolerance = 1.0) const;
+
+    // Relative error that falsePositiveRate can carry for a filter that is
+    // exactly at its target rate.
+    double falsePositiveRateMargin() const;
+
+    // Payloads that are not a bit array (truncated, zero padded, an error page)
+    // have far less byte entropy than a real filter of the same fill.
+    bool hasExpectedEntropy(double margin = 1.0) const;
+};
+
 /*
  Bloom filter with djb2 and sdbm hashing. It is a loose C++ port of
  the js library at https://github.com/cry/jsbloom
@@ -32,15 +67,42 @@ typedef basic_ostream<BlockType> BinaryOutputStream;
 class BloomFilter {
 
 public:
+    // Far beyond any sensible error rate, larger values only come from corrupt parameters
+    static constexpr size_t MAX_HASH_ROUNDS = 1024;
+
+    // Where a host or parent domain starts, and its djb2 and sdbm hashes
+    struct SuffixHash {
+        size_t start;
+        unsigned int hash1;
+        unsigned int hash2;
+    };
+
+    // All constructors throw runtime_error for parameters the data can't back,
+    // such as a bit count beyond the end of a truncated file
     BloomFilter(size_t maxItems, double targetProbability);
 
     BloomFilter(const string &importFilePath, size_t bitCount, size_t maxItems);
 
     BloomFilter(BinaryInputStream &in, size_t bitCount, size_t maxItems);
 
+    BloomFilter(vector<BlockType> blocks, size_t bitCount, size_t maxItems);
+
     void add(const string &element);
 
-    bool contains(const string &element);
+    // Splits the elements across `threadCount` threads, 0 uses every core
+    void addAll(const vector<string_view> &elements, size_t threadCount = 0);
+
+    bool contains(string_view element);
+
+    // Probes `host` and every parent domain, e.g. "a.b.com", "b.com" and "com",
+    // hashing the host once. Returns the longest suffix that is present, as a
+    // view into `host`, or an empty view when none is.
+    string_view containsAnySuffix(string_view host);
+
+    // Same, with the hashes a HostKey already holds
+    bool contains(const HostKey &key);
+
+    string_view containsAnySuffix(const HostKey &key);
 
     void writeToFile(const string &exportFilePath);
 
@@ -48,8 +110,61 @@ public:
 
     size_t getBitCount() const;
 
+    size_t getHashRounds() const;
+
+    static size_t hashRoundsFor(size_t bitCount, size_t maxItems);
+
+    // What the constructor for `maxItems` and `targetProbability` allocates.
+    // Throws runtime_error for invalid parameters.
+    static size_t bitCountFor(size_t maxItems, double targetProbability);
+
+    // The djb2 and sdbm hashes every round of `element` derives from
+    static void hashElement(string_view element, unsigned int &hash1, unsigned int &hash2);
+
+    // The hash probed in `round`, before it is taken modulo the bit count
+    static unsigned int roundHash(unsigned int hash1, unsigned int hash2, unsigned int round);
+
+    // Probes bits held outside a BloomFilter, e.g. a shared mapping. The
+    // caller guarantees `blocks` covers `bitCount` bits.
+    static bool probeBlocks(const BlockType *blocks, size_t bitCount, size_t hashRounds, string_view element, size_t &roundsProbed);
+
+    static string_view probeSuffixes(const BlockType *blocks, size_t bitCount, size_t hashRounds, string_view host, size_t &roundsProbed);
+
+    // Probes suffixes recorded shortest first, longest first, and returns the one found or nullptr
+    static const SuffixHash *probeSuffixHashes(const BlockType *blocks, size_t bitCount, size_t hashRounds,
+                                               const SuffixHash *suffixes, size_t count, size_t &roundsProbed);
+
+    static bool probeHashes(const BlockType *blocks, size_t bitCount, size_t hashRounds,
+                            unsigned int hash1, unsigned int hash2, size_t &roundsProbed);
+
+    // Hashes the host and every parent domain in one pass, shortest first.
+    // Returns how many there are even when that exceeds `capacity`.
+    static size_t hashSuffixes(string_view host, SuffixHash *suffixes, size_t capacity);
+
+    const vector<BlockType> &getBlocks() const;
+
+    BloomFilterStats stats() const;
+
 private:
+    // `concurrent` sets bits with atomic ORs so several threads can insert at once
+    void insert(string_view element, bool concurrent);
+
+    bool probe(string_view element, size_t &roundsProbed) const;
+
     size_t bitCount;
     vector<BlockType> bloomVector;
     size_t hashRounds;
 };
+
+inline unsigned int BloomFilter::roundHash(unsigned int hash1, unsigned int hash2, unsigned int round) {
+    switch (round) {
+        case 0:
+            return hash1;
+        case 1:
+            return hash2;
+        default:
+            return (hash1 + (round * hash2) + (round ^ 2));
+    }
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef BLOOM_FILTER_BUILDER_HPP
+#define BLOOM_FILTER_BUILDER_HPP
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "BloomFilter.hpp"
+#include "FrozenBloomFilter.hpp"
+
+/*
+ The write side of a BloomFilter: sized like one, filled from any number of
+ threads at once, then frozen into a FrozenBloomFilter for lookups. Freezing
+ hands over the bits without copying them.
+ */
+class BloomFilterBuilder {
+
+public:
+    // Throws runtime_error for invalid parameters
+    BloomFilterBuilder(size_t maxItems, double targetProbability);
+
+    // Starts from the bits of an existing filter, e.g. one read from a file
+    explicit BloomFilterBuilder(const BloomFilter &filter);
+
+    BloomFilterBuilder(BloomFilterBuilder &&) noexcept = default;
+
+    BloomFilterBuilder &operator=(BloomFilterBuilder &&) noexcept = default;
+
+    BloomFilterBuilder(const BloomFilterBuilder &) = delete;
+
+    BloomFilterBuilder &operator=(const BloomFilterBuilder &) = delete;
+
+    // Safe to call from several threads at once
+    void add(std::string_view element);
+
+    // Splits the elements across `threadCount` threads, 0 uses every core
+    void addAll(const std::vector<std::string_view> &elements, size_t threadCount = 0);
+
+    // Leaves the builder empty, adding to it afterwards throws runtime_error
+    FrozenBloomFilter freeze();
+
+    size_t getBitCount() const;
+
+    size_t getHashRounds() const;
+
+private:
+    FrozenBloomFilter::Words words;
+    size_t bitCount;
+    size_t hashRounds;
+};
+
+#endif
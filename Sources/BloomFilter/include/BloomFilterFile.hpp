@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BLOOM_FILTER_FILE_HPP
+#define BLOOM_FILTER_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BloomFilter.hpp"
+#include "SHA256.hpp"
+
+enum class BloomFilterFileFormat {
+    // Bare bit array as served today; the parameters come from the specification
+    legacy,
+    // Self-describing header followed by the bit array
+    container,
+    // Container whose bit array is rANS coded for transport, see RANSCoder
+    compressed
+};
+
+/*
+ Header of the container format. All integers are little endian:
+
+   0  magic "DDGBLOOM"
+   8  u32 version
+  12  u32 flags
+  16  u64 bit count
+  24  u64 max items
+  32  u32 hash rounds
+  36  u32 hash scheme, 0 for djb2 / sdbm double hashing
+  40  u64 payload length in bytes, as stored
+  48  payload SHA-256, of the bit array once decoded
+  80  payload
+
+ Version 2 adds FLAG_RANS_PAYLOAD, a payload coded by RANSCoder that decodes
+ to exactly the bytes the bit count needs. Containers without it are still
+ written as version 1, which older readers load.
+ */
+struct BloomFilterFileHeader {
+    static constexpr size_t ENCODED_SIZE = 80;
+    static constexpr uint32_t CURRENT_VERSION = 2;
+    static constexpr uint32_t PLAIN_VERSION = 1;
+    static constexpr uint32_t HASH_SCHEME_LEGACY = 0;
+    static constexpr uint32_t FLAG_RANS_PAYLOAD = 1;
+    // A coded payload can expand far beyond its own size, so what it may decode to is bounded
+    static constexpr uint64_t MAX_DECODED_PAYLOAD_LENGTH = 1ull << 30;
+    // And bounded relative to the stored length too. With 12 bit probabilities
+    // rANS spends at least log2(4096 / 4095) bits on a byte unless the payload
+    // is a single repeated value, about 22,700 decoded bytes per stored byte.
+    static constexpr uint64_t MAX_CODING_RATIO = 1ull << 15;
+
+    uint32_t version = CURRENT_VERSION;
+    uint32_t flags = 0;
+    uint64_t bitCount = 0;
+    uint64_t maxItems = 0;
+    uint32_t hashRounds = 0;
+    uint32_t hashScheme = HASH_SCHEME_LEGACY;
+    uint64_t payloadLength = 0;
+    SHA256::Digest payloadSHA256 {};
+
+    void encode(char *output) const;
+
+    // Returns false when `input` doesn't start with the container magic
+    static bool decode(const char *input, size_t length, BloomFilterFileHeader &header);
+
+    bool isPayloadCoded() const;
+
+    // Length of the bit array the payload holds once decoded
+    uint64_t decodedPayloadLength() const;
+};
+
+/*
+ A filter file in any format. Reading validates the header against the
+ payload and throws runtime_error for anything inconsistent. `header`
+ describes the file as stored while `payload` always holds the decoded bits.
+ */
+class BloomFilterFile {
+
+public:
+    BloomFilterFileFormat format;
+    BloomFilterFileHeader header;
+    std::vector<BlockType> payload;
+
+    static BloomFilterFile fromFilter(const BloomFilter &filter, size_t maxItems);
+
+    static bool isContainer(const std::string &path);
+
+    static BloomFilterFile readContainer(const std::string &path);
+
+    // Reads the payload straight into its final storage as the stream
+    // delivers it, decoding a coded one on the way. Nothing is allocated for
+    // more than the stream holds: a seekable stream is measured first, any
+    // other has its stored bytes gathered before they are decoded.
+    static BloomFilterFile readContainer(BinaryInputStream &in);
+
+    static BloomFilterFile parseContainer(const char *data, size_t length);
+
+    // Validates a decoded header against what this version can load
+    static void checkHeader(const BloomFilterFileHeader &header);
+
+    // Streams the payload following a checked header into `output`, which
+    // holds header.decodedPayloadLength() bytes, e.g. a shared mapping. It is
+    // hashed as it arrives and a SHA-256 mismatch throws runtime_error.
+    static void readPayload(BinaryInputStream &in, const BloomFilterFileHeader &header, char *output);
+
+    static BloomFilterFile readLegacy(const std::string &path, size_t bitCount, size_t maxItems);
+
+    // Same, for a file that must match the SHA-256 of its specification
+    static BloomFilterFile readLegacy(const std::string &path, size_t bitCount, size_t maxItems, const SHA256::Digest &expectedSHA256);
+
+    // Throws runtime_error for a compressed payload that codes beyond
+    // MAX_CODING_RATIO, which only near empty filters do; write those plain.
+    void write(const std::string &path, BloomFilterFileFormat outputFormat) const;
+
+    BloomFilter makeFilter() const;
+
+    // Same, moving the payload into the filter instead of copying it
+    BloomFilter takeFilter();
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BLOOM_FILTER_METRICS_HPP
+#define BLOOM_FILTER_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ Log-linear latency histogram in nanoseconds: values below 8 get their own
+ bucket, above that every power of two is split into 8 sub-buckets, so any
+ recorded value is reported within 12.5% of its true value.
+ */
+struct LatencyHistogram {
+    static constexpr size_t SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = 42 * SUB_BUCKETS;
+
+    static size_t bucketIndex(uint64_t value);
+
+    static uint64_t bucketLowerBound(size_t index);
+
+    std::array<uint64_t, BUCKET_COUNT> counts {};
+
+    uint64_t totalCount() const;
+
+    uint64_t valueAtPercentile(double percentile) const;
+};
+
+struct BloomFilterMetricsSnapshot {
+    // Index is the number of rounds probed before the lookup returned
+    static constexpr size_t MAX_TRACKED_ROUNDS = 32;
+
+    uint64_t lookups = 0;
+    uint64_t positives = 0;
+    uint64_t roundsProbed = 0;
+    std::array<uint64_t, MAX_TRACKED_ROUNDS + 1> roundsHistogram {};
+
+    // Native probe only, and the full wrapper call including string bridging
+    LatencyHistogram probeLatency;
+    LatencyHistogram wrapperLatency;
+
+    double hitRatio() const;
+
+    double averageRoundsProbed() const;
+};
+
+/*
+ Opt-in instrumentation of BloomFilter lookups. Counters live in per-thread
+ blocks that are only ever written by their owning thread, so the hot path
+ does no locking and no atomic read-modify-write; snapshot() sums all blocks
+ under a lock that lookups never take. Latency is sampled every
+ `latencySampleInterval` lookups per thread using the monotonic clock.
+ */
+class BloomFilterMetrics {
+
+public:
+    static void setEnabled(bool enabled);
+
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    static void setLatencySampleInterval(uint32_t interval);
+
+    static void recordLookup(bool positive, size_t roundsProbed);
+
+    static void recordProbeLatency(uint64_t nanoseconds);
+
+    static void recordWrapperLatency(uint64_t nanoseconds);
+
+    // Decrement the calling thread's sample countdowns; true when this call should be timed
+    static bool shouldSampleProbeLatency();
+
+    static bool shouldSampleWrapperLatency();
+
+    static uint64_t now();
+
+    static BloomFilterMetricsSnapshot snapshot();
+
+private:
+    static std::atomic<bool> enabled;
+    static std::atomic<uint32_t> latencySampleInterval;
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BLOOM_FILTER_VIEW_HPP
+#define BLOOM_FILTER_VIEW_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include "BloomFilter.hpp"
+
+/*
+ Read-only filter over bits it doesn't own, such as a shared memory mapping
+ published by another process. Lookups hash exactly like BloomFilter. The
+ optional owner keeps the memory alive for as long as the view exists.
+ */
+class BloomFilterView {
+
+public:
+    // Throws runtime_error when `byteLength` can't back `bitCount`
+    BloomFilterView(const BlockType *blocks,
+                    size_t byteLength,
+                    size_t bitCount,
+                    size_t hashRounds,
+                    std::shared_ptr<const void> owner = nullptr,
+                    uint64_t generation = 0);
+
+    bool contains(std::string_view element) const;
+
+    // See BloomFilter::containsAnySuffix
+    std::string_view containsAnySuffix(std::string_view host) const;
+
+    bool contains(const HostKey &key) const;
+
+    std::string_view containsAnySuffix(const HostKey &key) const;
+
+    size_t getBitCount() const;
+
+    size_t getHashRounds() const;
+
+    // Generation of the shared segment the bits came from, 0 otherwise
+    uint64_t getGeneration() const;
+
+private:
+    const BlockType *blocks;
+    size_t bitCount;
+    size_t hashRounds;
+    std::shared_ptr<const void> owner;
+    uint64_t generation;
+};
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef BLOOMD_PROTOCOL_HPP
+#define BLOOMD_PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+enum class BloomdOperation : uint8_t {
+    // Items are hosts, each result is an HTTPSUpgradeVerdict
+    upgrade = 1,
+    // Items are hosts, each result is the entity ID of the tracker the host
+    // or a parent belongs to, or BloomdProtocol::NO_ENTITY
+    trackerEntity = 2,
+    // Items alternate request URL and site host, each pair gives 1 when allowlisted
+    trackerAllowlisted = 3,
+    // Items are hosts whose upgraded navigation failed, each result is 1 when
+    // recorded; upgrade answers recentlyFailed for them until they expire
+    upgradeFailed = 4,
+    // Items are hosts, each result is the mask of the domain lists in the
+    // daemon's BitSlicedBloomIndex that may contain the host or a parent.
+    // A clear bit is definite, a set one needs the exact list to confirm.
+    domainLists = 5
+};
+
+enum class BloomdStatus : uint8_t {
+    ok = 0,
+    malformed = 1,
+    unknownOperation = 2,
+    // The daemon wasn't started with the data the operation needs
+    notLoaded = 3,
+    // More items than BloomdProtocol::maxResults allows; the request can be split
+    tooLarge = 4
+};
+
+struct BloomdRequest {
+    uint32_t requestID;
+    BloomdOperation operation;
+    // Views into the frame the request was decoded from
+    std::vector<std::string_view> items;
+};
+
+struct BloomdResponse {
+    uint32_t requestID;
+    BloomdOperation operation;
+    BloomdStatus status;
+    std::vector<uint64_t> results;
+};
+
+/*
+ Wire format of bloomd, the lookup daemon serving the native engines over a
+ Unix socket. Every message is a frame: a u32 payload length followed by the
+ payload. Clients may pipeline any number of requests on one connection;
+ responses come back in order and echo the request ID. All integers are
+ little endian.
+
+ Request payload:
+   0  u32 request ID
+   4  u8  operation
+   5  u8  reserved, 0
+   6  u16 reserved, 0
+   8  u32 item count
+  12  items, each a u16 length and that many bytes
+
+ Response payload:
+   0  u32 request ID
+   4  u8  operation
+   5  u8  status
+   6  u16 reserved, 0
+   8  u32 result count, 0 unless the status is ok
+  12  results, a u64 each for domainLists, a u32 each for trackerEntity
+      and a u8 each otherwise
+ */
+class BloomdProtocol {
+
+public:
+    static constexpr size_t FRAME_PREFIX_LENGTH = 4;
+    static constexpr size_t HEADER_LENGTH = 12;
+    static constexpr size_t MAX_PAYLOAD_LENGTH = 1 << 20;
+    static constexpr size_t MAX_ITEM_LENGTH = 0xffff;
+    static constexpr uint32_t NO_ENTITY = 0xffffffff;
+
+    // Length of the frame starting at `data`, prefix included, once
+    // `available` bytes hold all of it, and 0 while more are needed. Throws
+    // runtime_error for payloads over MAX_PAYLOAD_LENGTH.
+    static size_t frameLength(const char *data, size_t available);
+
+    // Throws runtime_error for items over MAX_ITEM_LENGTH or frames over MAX_PAYLOAD_LENGTH
+    static void appendRequest(std::vector<char> &output, uint32_t requestID, BloomdOperation operation,
+                              const std::vector<std::string_view> &items);
+
+    // Decodes the payload of a frame. Returns false when it is malformed, with
+    // the request ID and operation still set when the header was readable and
+    // zero otherwise.
+    static bool decodeRequest(const char *payload, size_t length, BloomdRequest &request);
+
+    // Results of `operation` that fit in one frame. Results are wider than the
+    // shortest items, so a legal request can carry more items than this.
+    static size_t maxResults(BloomdOperation operation);
+
+    // Throws runtime_error for more than maxResults results
+    static void appendResponse(std::vector<char> &output, const BloomdResponse &response);
+
+    static bool decodeResponse(const char *payload, size_t length, BloomdResponse &response);
+};
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONTENT_RULE_LIST_HPP
+#define CONTENT_RULE_LIST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class JSONValue;
+
+// Bit flags for the trigger's resource-type values
+enum ContentRuleResourceType : uint32_t {
+    ContentRuleResourceDocument = 1 << 0,
+    ContentRuleResourceImage = 1 << 1,
+    ContentRuleResourceStyleSheet = 1 << 2,
+    ContentRuleResourceScript = 1 << 3,
+    ContentRuleResourceFont = 1 << 4,
+    ContentRuleResourceRaw = 1 << 5,
+    ContentRuleResourceSVGDocument = 1 << 6,
+    ContentRuleResourceMedia = 1 << 7,
+    ContentRuleResourcePopup = 1 << 8,
+    ContentRuleResourcePing = 1 << 9,
+    ContentRuleResourceFetch = 1 << 10,
+    ContentRuleResourceWebSocket = 1 << 11,
+    ContentRuleResourceOther = 1 << 12
+};
+
+enum class ContentRuleActionType {
+    block,
+    blockCookies,
+    cssDisplayNone,
+    ignorePreviousRules,
+    makeHTTPS
+};
+
+struct ContentRuleRequest {
+    std::string_view url;
+    // Host of the top level document, lowercase
+    std::string_view pageHost;
+    uint32_t resourceType;
+    // Whether the request leaves the page's registrable domain; the caller
+    // knows the public suffix list, the evaluator doesn't
+    bool thirdParty;
+};
+
+struct ContentRuleDecision {
+    // Indexes of the rules whose actions apply, in list order
+    std::vector<size_t> rules;
+    bool block;
+    bool blockCookies;
+    bool makeHTTPS;
+    // Rules whose regex was run; the rest were ruled out by the index
+    size_t regexesTested;
+};
+
+/*
+ Evaluates WebKit content rule lists, such as the ones generated for
+ WKContentRuleListStore, outside of WebKit. Triggers support url-filter (and
+ its case sensitivity), if-domain, unless-domain, resource-type and
+ load-type; rules using other trigger fields are counted as unsupported and
+ never match. Like WebKit, rules apply in order and ignore-previous-rules
+ drops every action matched before it.
+
+ Every rule is indexed by a 4 byte literal its url-filter can't match
+ without, picking the rarest one, so a URL only runs the regexes of rules
+ whose literal it contains. Rules without such a literal are indexed by
+ their if-domain entries, and the few left are tried for every request.
+ */
+class ContentRuleList {
+
+public:
+    // Throws runtime_error for malformed JSON, unknown values and invalid regexes
+    static ContentRuleList parse(std::string_view json);
+
+    static ContentRuleList parseFile(const std::string &path);
+
+    ContentRuleDecision evaluate(const ContentRuleRequest &request) const;
+
+    size_t size() const;
+
+    size_t unsupportedRuleCount() const;
+
+    // Rules that fall back to being tried for every request
+    size_t unindexedRuleCount() const;
+
+    ContentRuleActionType actionType(size_t rule) const;
+
+    // Maps a resource-type name to its flag, 0 for unknown names
+    static uint32_t resourceTypeNamed(std::string_view name);
+
+private:
+    enum class LoadType { any, firstParty, thirdParty };
+
+    struct Rule {
+        ContentRuleActionType action;
+        std::regex urlFilter;
+        uint32_t resourceTypes;
+        LoadType loadType;
+        std::vector<std::string> ifDomains;
+        std::vector<std::string> unlessDomains;
+        bool supported;
+    };
+
+    ContentRuleList() = default;
+
+    static ContentRuleList fromJSON(const JSONValue &root);
+
+    // Runs the rule's regex last, counting it in `regexesTested`
+    bool matches(const Rule &rule, const ContentRuleRequest &request, size_t &regexesTested) const;
+
+    void index();
+
+    std::vector<Rule> rules;
+    std::vector<std::string> urlFilters;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> literalIndex;
+    std::unordered_map<std::string, std::vector<uint32_t>> domainIndex;
+    std::vector<uint32_t> unindexedRules;
+    // One bit per hashed literal in literalIndex, to skip most URL positions
+    std::vector<uint64_t> literalFilter;
+    size_t unsupportedRules = 0;
+};
+
+#endif
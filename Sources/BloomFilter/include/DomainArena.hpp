@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef DOMAIN_ARENA_HPP
+#define DOMAIN_ARENA_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+class HostKey;
+
+/*
+ Append-only store of domains that hands out dense 32-bit IDs, 0 for the first
+ domain interned, 1 for the next and so on. A domain interned twice gets the
+ same ID, so indexes that keep their domains here store each one once and
+ joins across them (the entity of a tracker, the tracker of a page host) only
+ compare IDs.
+
+ Strings are copied into 64 KiB chunks and the per-ID records into segments
+ that double in size; neither ever moves, so views returned by domain() stay
+ valid for the lifetime of the arena. The intern table is open addressing over
+ single atomic words holding a hash tag and the ID. Lookups take no lock.
+ Inserts are serialized by a mutex and publish the record before the slot;
+ when the table grows, the old one is kept so readers still probing it stay
+ safe.
+ */
+class DomainArena {
+
+public:
+    DomainArena();
+
+    ~DomainArena();
+
+    DomainArena(const DomainArena &) = delete;
+
+    DomainArena &operator=(const DomainArena &) = delete;
+
+    // The arena every native index shares
+    static DomainArena &shared();
+
+    // Domains are stored as given, callers canonicalize them first. Safe to
+    // call from any thread. Throws runtime_error when the 32-bit IDs run out.
+    uint32_t intern(std::string_view domain);
+
+    bool find(std::string_view domain, uint32_t &id) const;
+
+    // Looks up key.suffix(label) with the hash the key already holds
+    bool find(const HostKey &key, size_t label, uint32_t &id) const;
+
+    // Only valid for IDs this arena returned
+    std::string_view domain(uint32_t id) const;
+
+    size_t size() const;
+
+    // Bytes of domain text stored, without the table and records
+    size_t byteCount() const;
+
+private:
+    struct Record {
+        const char *data;
+        uint32_t length;
+        uint64_t hash;
+    };
+
+    struct Table {
+        size_t mask;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    };
+
+    static constexpr size_t SEGMENT_COUNT = 23;
+
+    bool findHashed(std::string_view domain, uint64_t hash, uint32_t &id) const;
+
+    const Record &recordAt(uint32_t id) const;
+
+    void insertSlot(Table &table, uint64_t hash, uint32_t id);
+
+    const char *store(std::string_view domain);
+
+    std::atomic<Table *> table;
+    std::atomic<Record *> segments[SEGMENT_COUNT];
+    std::atomic<uint32_t> count;
+    std::atomic<size_t> bytes;
+
+    // Owned by the arena and only touched with `mutex` held
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Table>> tables;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char *chunkCursor;
+    size_t chunkRemaining;
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef FROZEN_BLOOM_FILTER_HPP
+#define FROZEN_BLOOM_FILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "BloomFilter.hpp"
+
+class BloomFilterBuilder;
+class HostKey;
+
+/*
+ The read side of a BloomFilter, produced by BloomFilterBuilder::freeze().
+ Same bits and djb2 / sdbm scheme, held in 64-byte aligned words, with the
+ reduction modulo the bit count precomputed as a multiply. Nothing changes
+ after construction, so one filter can be shared by any number of threads
+ without locks; it can only be moved, never copied by accident.
+
+ Lookups don't feed BloomFilterMetrics.
+ */
+class FrozenBloomFilter {
+
+public:
+    FrozenBloomFilter(FrozenBloomFilter &&) noexcept = default;
+
+    FrozenBloomFilter &operator=(FrozenBloomFilter &&) noexcept = default;
+
+    FrozenBloomFilter(const FrozenBloomFilter &) = delete;
+
+    FrozenBloomFilter &operator=(const FrozenBloomFilter &) = delete;
+
+    bool contains(std::string_view element) const noexcept;
+
+    bool contains(const HostKey &key) const noexcept;
+
+    // The longest of the host and its parent domains that is present, as a
+    // view into the key's host, or an empty view when none is
+    std::string_view containsAnySuffix(const HostKey &key) const noexcept;
+
+    size_t getBitCount() const noexcept;
+
+    size_t getHashRounds() const noexcept;
+
+    // The bits in BloomFilter's byte order, e.g. to write the filter out
+    std::vector<BlockType> blocks() const;
+
+private:
+    friend class BloomFilterBuilder;
+
+    struct AlignedDelete {
+        void operator()(uint64_t *words) const;
+    };
+
+    typedef std::unique_ptr<uint64_t[], AlignedDelete> Words;
+
+    // Zeroed words for `bitCount` bits, whole cache lines
+    static Words allocateWords(size_t bitCount);
+
+    static size_t wordCountFor(size_t bitCount);
+
+    FrozenBloomFilter(Words words, size_t bitCount, size_t hashRounds);
+
+    bool probeHashes(unsigned int hash1, unsigned int hash2) const noexcept;
+
+    size_t reduce(unsigned int hash) const noexcept;
+
+    Words words;
+    size_t bitCount;
+    size_t hashRounds;
+    // `hash` % bitCount as (reductionMultiplier * hash) * bitCount >> 64,
+    // exact for 32-bit hashes and bit counts
+    uint64_t reductionMultiplier;
+    uint64_t reductionDivisor;
+};
+
+#endif
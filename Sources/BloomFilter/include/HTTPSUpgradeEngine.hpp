@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HTTPS_UPGRADE_ENGINE_HPP
+#define HTTPS_UPGRADE_ENGINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AgePartitionedBloomFilter.hpp"
+#include "FrozenBloomFilter.hpp"
+#include "HostDecisionCache.hpp"
+#include "HostKey.hpp"
+#include "PerfectDomainSet.hpp"
+
+enum class HTTPSUpgradeVerdict {
+    upgrade,
+    notHTTP,
+    invalidHost,
+    // The feature is off, or the host is covered by an exception or unprotected list
+    featureDisabled,
+    excluded,
+    notInUpgradeList,
+    // The verdict was upgrade but the output buffer can't hold the rewritten URL
+    bufferTooSmall,
+    // In the upgrade list, but its upgrade failed within the failure memory's time to live
+    recentlyFailed
+};
+
+/*
+ Everything HTTPSUpgrade consults for a navigation, answered by one call per
+ URL. The upgrade list (filter and excluded domains) and the privacy
+ configuration's view of the feature are replaced independently as immutable
+ snapshots, so decide() never takes a lock and never allocates. Combined
+ excluded / upgrade list verdicts are cached per host and retired whenever the
+ upgrade list is replaced; the cheaper feature checks always run, as does
+ the lookup of recent upgrade failures, which expire on their own.
+ */
+class HTTPSUpgradeEngine {
+
+public:
+    static constexpr size_t MAX_HOST_LENGTH = 253;
+
+    explicit HTTPSUpgradeEngine(size_t decisionCacheCapacity);
+
+    HTTPSUpgradeEngine(const HTTPSUpgradeEngine &) = delete;
+
+    HTTPSUpgradeEngine &operator=(const HTTPSUpgradeEngine &) = delete;
+
+    // A null filter upgrades nothing. Domains are expected lowercase. A
+    // loaded BloomFilter goes through BloomFilterBuilder to be frozen first.
+    void setUpgradeList(std::shared_ptr<const FrozenBloomFilter> filter, const std::vector<std::string> &excludedDomains);
+
+    // Replaces the excluded domains and keeps the current filter, e.g. when a
+    // new filter was rejected. Not safe to call concurrently with setUpgradeList.
+    void setExcludedDomains(const std::vector<std::string> &excludedDomains);
+
+    // `exceptionDomains` also cover their subdomains, `unprotectedDomains` only match exactly.
+    void setFeatureState(bool enabled,
+                         const std::vector<std::string> &exceptionDomains,
+                         const std::vector<std::string> &unprotectedDomains);
+
+    // Hosts recorded as failing are not upgraded until they expire from
+    // `failures`. A null memory forgets every failure.
+    void setFailureMemory(std::shared_ptr<AgePartitionedBloomFilter> failures);
+
+    // For a host whose upgraded navigation failed, e.g. over TLS. Returns
+    // false for an invalid host or when there is no failure memory.
+    bool recordUpgradeFailure(std::string_view host);
+
+    // On upgrade, writes the https URL and a terminating NUL to `output` and
+    // its length to `outputLength`. For bufferTooSmall `outputLength` is still
+    // set, the buffer needs one byte more than that.
+    HTTPSUpgradeVerdict decide(const char *url, size_t length, char *output, size_t capacity, size_t &outputLength);
+
+    // The same decision for a bare host, e.g. "Example.com"; never bufferTooSmall or notHTTP
+    HTTPSUpgradeVerdict decideHost(std::string_view host);
+
+    // Copies the lowercased host of an http URL into `host`, which holds
+    // MAX_HOST_LENGTH bytes. Returns upgrade when a host was found.
+    static HTTPSUpgradeVerdict parseHost(std::string_view url, char *host, size_t &hostLength);
+
+    HostDecisionCacheStats cacheStats() const;
+
+private:
+    // The checks of parseHost, leaving the host as it appears in the URL
+    static HTTPSUpgradeVerdict findHost(std::string_view url, std::string_view &host);
+
+    struct UpgradeList {
+        std::shared_ptr<const FrozenBloomFilter> filter;
+        PerfectDomainSet excludedDomains;
+
+        bool containsUpgradable(const HostKey &key) const;
+    };
+
+    struct FeatureState {
+        bool enabled;
+        PerfectDomainSet exceptionDomains;
+        PerfectDomainSet unprotectedDomains;
+
+        bool isEnabledFor(const HostKey &key) const;
+    };
+
+    std::shared_ptr<const UpgradeList> upgradeList;
+    std::shared_ptr<const FeatureState> featureState;
+    std::shared_ptr<AgePartitionedBloomFilter> recentFailures;
+    HostDecisionCache decisionCache;
+};
+
+#endif
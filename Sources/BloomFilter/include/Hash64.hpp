@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HASH64_HPP
+#define HASH64_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+ 64-bit multiply-fold hash for native indexes that do not have to match the
+ server-built filter. The legacy filter keeps its djb2/sdbm scheme.
+ */
+
+static const uint64_t HASH64_PRIME0 = 0xa0761d6478bd642full;
+static const uint64_t HASH64_PRIME1 = 0xe7037ed1a0b428dbull;
+static const uint64_t HASH64_PRIME2 = 0x8ebc6af09c88c6e3ull;
+
+inline uint64_t hash64Mix(uint64_t lhs, uint64_t rhs) {
+    __uint128_t product = (__uint128_t) lhs * rhs;
+    return (uint64_t) product ^ (uint64_t) (product >> 64);
+}
+
+inline uint64_t hash64(const char *data, size_t length, uint64_t seed = 0) {
+    uint64_t hash = hash64Mix(seed ^ HASH64_PRIME0, HASH64_PRIME1 ^ length);
+
+    size_t index = 0;
+    for (; index + sizeof(uint64_t) <= length; index += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + index, sizeof(word));
+        hash = hash64Mix(hash ^ word, HASH64_PRIME1);
+    }
+
+    uint64_t tail = 0;
+    if (index < length) {
+        memcpy(&tail, data + index, length - index);
+    }
+    return hash64Mix(hash ^ tail ^ HASH64_PRIME2, HASH64_PRIME0 ^ length);
+}
+
+// Derives further well mixed values from an existing hash, e.g. per-table seeds
+inline uint64_t hash64Remix(uint64_t value, uint64_t seed) {
+    return hash64Mix(value ^ seed ^ HASH64_PRIME2, HASH64_PRIME1);
+}
+
+#endif
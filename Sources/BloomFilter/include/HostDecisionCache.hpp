@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HOST_DECISION_CACHE_HPP
+#define HOST_DECISION_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+struct HostDecisionCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidations;
+
+    double hitRatio() const;
+};
+
+/*
+ Fixed-size, lock-free cache of per-host boolean verdicts keyed by a 64-bit
+ host hash. Each slot is a single atomic word holding the hash tag, the
+ generation it was computed in and the verdict, so readers never see a torn
+ entry. Slots form two-way buckets; a third colliding host evicts one of them.
+ invalidate() bumps the generation, which retires every entry at once.
+ Verdicts computed against the previous data are tagged with the generation
+ observed before computing them and are therefore never served afterwards.
+ */
+class HostDecisionCache {
+
+public:
+    typedef uint32_t Generation;
+
+    // Capacity is rounded up to a power of two, at least 2
+    explicit HostDecisionCache(size_t capacity);
+
+    HostDecisionCache(const HostDecisionCache &) = delete;
+
+    HostDecisionCache &operator=(const HostDecisionCache &) = delete;
+
+    // Returns true and sets `verdict` on a hit. `generation` receives the
+    // generation to pass to store() for a verdict computed after a miss.
+    bool lookup(uint64_t hostHash, bool &verdict, Generation &generation);
+
+    void store(uint64_t hostHash, bool verdict, Generation generation);
+
+    void invalidate();
+
+    size_t getCapacity() const;
+
+    HostDecisionCacheStats stats() const;
+
+private:
+    static constexpr unsigned GENERATION_BITS = 24;
+    static constexpr uint64_t GENERATION_MASK = (1ull << GENERATION_BITS) - 1;
+    static constexpr unsigned TAG_SHIFT = GENERATION_BITS + 2;
+    static constexpr uint64_t GENERATION_FIELD = GENERATION_MASK << 2;
+
+    static constexpr size_t COUNTER_SHARDS = 16;
+
+    // Threads are spread over the shards, so concurrent lookups rarely share a cache line
+    struct alignas(64) CounterShard {
+        std::atomic<uint64_t> hits { 0 };
+        std::atomic<uint64_t> misses { 0 };
+    };
+
+    static uint64_t pack(uint64_t hostHash, bool verdict, Generation generation);
+
+    static size_t counterShard();
+
+    size_t mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    std::atomic<Generation> generation;
+
+    // Kept on separate cache lines from the slots and each other
+    CounterShard counters[COUNTER_SHARDS];
+    alignas(64) std::atomic<uint64_t> invalidations;
+};
+
+#endif
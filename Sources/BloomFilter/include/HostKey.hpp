@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HOST_KEY_HPP
+#define HOST_KEY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "BloomFilter.hpp"
+
+/*
+ A host canonicalized and hashed once per request, so every engine it is
+ looked up in (upgrade filter, exact sets, tracker maps, configuration
+ exceptions) reuses the same hashes instead of hashing the host again.
+
+ assign() lowercases and validates the raw host eight bytes at a time, strips
+ a trailing dot and records where each label starts. It then computes, for
+ the host and each parent domain, the unseeded hash64 that the native indexes
+ derive their own hashes from and the djb2 / sdbm pair BloomFilter probes.
+ Everything lives inline, building a key never allocates.
+ */
+class HostKey {
+
+public:
+    static constexpr size_t MAX_LENGTH = 253;
+    // Single character labels and their dots
+    static constexpr size_t MAX_LABELS = (MAX_LENGTH + 1) / 2;
+
+    HostKey();
+
+    // Returns false and leaves the key empty for hosts that aren't ASCII
+    // letters, digits, '-', '_' and ':' in non-empty dot separated labels, such
+    // as IDNs not converted to punycode yet. `stripWWW` drops a leading "www.".
+    bool assign(std::string_view rawHost, bool stripWWW = false);
+
+    std::string_view host() const;
+
+    size_t labelCount() const;
+
+    // The host without its first `label` labels, 1 gives "example.com" for "www.example.com"
+    std::string_view suffix(size_t label) const;
+
+    // hash64 of suffix(label)
+    uint64_t hash(size_t label = 0) const;
+
+    // djb2 and sdbm of every suffix, shortest first as BloomFilter::hashSuffixes records them
+    const BloomFilter::SuffixHash *legacyHashes() const;
+
+private:
+    char bytes[MAX_LENGTH + 1];
+    uint8_t length;
+    uint8_t labels;
+    // One more for the label a trailing dot opens before it is stripped
+    uint8_t labelStarts[MAX_LABELS + 1];
+    uint64_t hashes[MAX_LABELS];
+    BloomFilter::SuffixHash legacy[MAX_LABELS];
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef HYPER_LOG_LOG_HPP
+#define HYPER_LOG_LOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*
+ Distinct count estimate over 64-bit hashes, in 2^precision one byte
+ registers. The relative standard error is about 1.04 / sqrt(2^precision),
+ 0.8% at the default precision, and small counts fall back to linear
+ counting. Estimates taken on different threads can be merged.
+ */
+class HyperLogLog {
+
+public:
+    static constexpr unsigned MIN_PRECISION = 4;
+    static constexpr unsigned MAX_PRECISION = 18;
+    static constexpr unsigned DEFAULT_PRECISION = 14;
+
+    // Throws runtime_error for a precision outside [MIN_PRECISION, MAX_PRECISION]
+    explicit HyperLogLog(unsigned precision = DEFAULT_PRECISION);
+
+    void add(uint64_t hash);
+
+    // Hashes `element` with hash64
+    void add(std::string_view element);
+
+    // Throws runtime_error unless both have the same precision
+    void merge(const HyperLogLog &other);
+
+    double estimate() const;
+
+    double relativeError() const;
+
+private:
+    unsigned precision;
+    std::vector<uint8_t> registers;
+};
+
+#endif
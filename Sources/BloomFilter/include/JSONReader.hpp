@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JSON_READER_HPP
+#define JSON_READER_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ Parsed JSON document. Objects keep their members in document order, which
+ is what the specification, reference test and rule list files are read for.
+ */
+class JSONValue {
+
+public:
+    enum class Type { null, boolean, number, string, array, object };
+
+    typedef std::vector<JSONValue> Array;
+    typedef std::vector<std::pair<std::string, JSONValue>> Object;
+
+    JSONValue();
+
+    Type getType() const;
+
+    bool isNull() const;
+
+    bool isBool() const;
+
+    bool isNumber() const;
+
+    bool isString() const;
+
+    bool isArray() const;
+
+    bool isObject() const;
+
+    // The accessors throw runtime_error when the value has a different type
+    bool asBool() const;
+
+    double asNumber() const;
+
+    const std::string &asString() const;
+
+    const Array &asArray() const;
+
+    const Object &asObject() const;
+
+    // Returns nullptr when this is not an object or has no such member
+    const JSONValue *find(std::string_view key) const;
+
+    // Throws runtime_error when the member is missing
+    const JSONValue &at(std::string_view key) const;
+
+private:
+    friend class JSONReader;
+
+    Type type;
+    bool boolValue;
+    double numberValue;
+    std::string stringValue;
+    Array arrayValue;
+    Object objectValue;
+};
+
+class JSONReader {
+
+public:
+    // Throws runtime_error with the byte offset of the first syntax error
+    static JSONValue parse(std::string_view text);
+
+    // Throws if the file can't be read or parsed
+    static JSONValue parseFile(const std::string &path);
+
+private:
+    explicit JSONReader(std::string_view text);
+
+    JSONValue parseValue(size_t depth);
+
+    void parseString(std::string &output);
+
+    void parseNumber(JSONValue &value);
+
+    void skipWhitespace();
+
+    bool consume(char expected);
+
+    void expect(char expected);
+
+    [[noreturn]] void fail(const char *message) const;
+
+    std::string_view text;
+    size_t position;
+};
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PERFECT_DOMAIN_SET_HPP
+#define PERFECT_DOMAIN_SET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class HostKey;
+
+/*
+ Static exact set of domains for lists that are replaced wholesale, like the
+ excluded and unprotected domains. A minimal perfect hash in the style of
+ PTHash maps every domain to its own slot. The slot holds the domain's 64-bit
+ fingerprint, or a 32-bit one and the offset of the domain itself when the
+ strings are kept. A lookup reads one pilot and one slot, plus the string.
+
+ Keys are split into partitions that are built independently and in parallel.
+ Each partition spreads its keys over buckets and stores one pilot per
+ bucket, about 3 bits per key. The pilot picks a collision free slot for every
+ key in the bucket. Tables are 1% larger than the key count, and the few keys
+ landing beyond it are remapped into the free slots below.
+
+ The set is always held in its serialized form, so a file written by
+ writeToFile can be mapped and queried without copying. Without the domain
+ strings two different domains collide with probability about n / 2^64.
+ */
+class PerfectDomainSet {
+
+public:
+    // Version 2 derives the seeded hashes from the unseeded hash64
+    static constexpr uint32_t CURRENT_VERSION = 2;
+
+    // Duplicates are allowed. `threadCount` 0 uses every core.
+    static PerfectDomainSet build(const std::vector<std::string_view> &domains, bool keepStrings = true, size_t threadCount = 0);
+
+    static PerfectDomainSet build(const std::vector<std::string> &domains, bool keepStrings = true, size_t threadCount = 0);
+
+    // Both validate the serialized form and throw runtime_error when it is malformed
+    explicit PerfectDomainSet(std::vector<char> data);
+
+    // `data` stays owned by `owner`, e.g. a mapping, and isn't copied
+    PerfectDomainSet(const char *data, size_t length, std::shared_ptr<const void> owner);
+
+    static PerfectDomainSet mapFile(const std::string &path);
+
+    PerfectDomainSet(PerfectDomainSet &&) = default;
+
+    PerfectDomainSet &operator=(PerfectDomainSet &&) = default;
+
+    PerfectDomainSet(const PerfectDomainSet &) = delete;
+
+    PerfectDomainSet &operator=(const PerfectDomainSet &) = delete;
+
+    bool contains(std::string_view domain) const;
+
+    // Looks up key.suffix(label) with the hash the key already holds
+    bool contains(const HostKey &key, size_t label = 0) const;
+
+    size_t size() const;
+
+    bool hasStrings() const;
+
+    // Bytes of the hash function itself: partitions, pilots and remapped slots
+    size_t indexBytes() const;
+
+    const char *data() const;
+
+    size_t dataLength() const;
+
+    void writeToFile(const std::string &path) const;
+
+private:
+    struct Partition {
+        uint64_t keyOffset;
+        uint64_t bucketOffset;
+        uint32_t keyCount;
+        uint32_t tableSize;
+        uint32_t bucketCount;
+        uint32_t remapOffset;
+    };
+
+    void attach();
+
+    bool contains(std::string_view domain, uint64_t domainHash) const;
+
+    size_t slotFor(uint64_t hash) const;
+
+    std::vector<char> storage;
+    std::shared_ptr<const void> owner;
+    const char *bytes;
+    size_t length;
+
+    uint64_t seed;
+    uint64_t keyCount;
+    uint32_t partitionCount;
+    uint32_t pilotBits;
+    bool strings;
+    const char *partitions;
+    const char *pilots;
+    const char *remap;
+    const char *fingerprints;
+    const char *stringBytes;
+    uint64_t pilotWordCount;
+    uint64_t remapCount;
+    uint64_t stringByteCount;
+};
+
+#endif
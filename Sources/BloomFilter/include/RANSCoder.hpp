@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef RANS_CODER_HPP
+#define RANS_CODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ Order-0 byte coder in the rANS family, used to ship filter payloads. A Bloom
+ filter's bits are close to independent, so byte frequencies capture almost
+ all of their redundancy: a filter with a fraction f of its bits set codes to
+ about H(f) bits per bit. General purpose compressors find little to match in
+ such data.
+
+ Four 32-bit states are interleaved over consecutive bytes, probabilities are
+ quantized to 12 bits and renormalization is bytewise. The encoded form is
+
+   0  u64 decoded length
+   8  u16 frequency of each byte value, 256 of them summing to 4096
+ 520  u32 initial decoder state, 4 of them
+ 536  the renormalization bytes, in the order the decoder reads them
+
+ with all integers little endian.
+ */
+class RANSCoder {
+
+public:
+    static constexpr size_t PREFIX_LENGTH = 536;
+
+    static std::vector<char> encode(const char *data, size_t length);
+
+    // Reads the decoded length from the first PREFIX_LENGTH bytes
+    static uint64_t decodedLength(const char *prefix);
+};
+
+/*
+ Decodes input as it arrives, e.g. from a download, straight into its final
+ storage. Nothing but the 16 KiB decoding table is allocated.
+ */
+class RANSDecoder {
+
+public:
+    // `prefix` is the first RANSCoder::PREFIX_LENGTH encoded bytes and
+    // `output` holds the decoded length. Throws runtime_error when the
+    // frequencies, the states or the length are invalid.
+    RANSDecoder(const char *prefix, char *output, size_t outputLength);
+
+    // Decodes what `input` allows and keeps its place for the next call.
+    // Short data may code to nothing beyond the prefix, so call it at least
+    // once, with no input if need be. Throws runtime_error for input beyond
+    // the end of the encoded data.
+    void decode(const char *input, size_t length);
+
+    // How much of the output is final, e.g. to hash it as it is decoded
+    size_t decodedCount() const;
+
+    // Whether the whole output was decoded and the input ended where the encoder started
+    bool isComplete() const;
+
+private:
+    static constexpr size_t STATE_COUNT = 4;
+
+    std::vector<uint32_t> slots;
+    uint32_t states[STATE_COUNT];
+    char *output;
+    size_t outputLength;
+    size_t position;
+    // The state of the last decoded byte still needs input to renormalize
+    bool renormalizing;
+};
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RIBBON_DOMAIN_MAP_HPP
+#define RIBBON_DOMAIN_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class HostKey;
+
+/*
+ Static function from domains to small integer IDs, e.g. tracker entities,
+ that doesn't store the domains. It is a standard ribbon retrieval structure:
+ every domain picks a 64 slot band and a random 64-bit row within it. The
+ slots solve the banded linear system over GF(2) that makes the XOR of a
+ domain's slots equal its ID followed by a short fingerprint.
+
+ A known domain always gets its own ID back. An unknown domain gets noise,
+ and that noise matches its fingerprint with probability 2^-fingerprintBits,
+ which is then the rate of false hits. The size is about 1.08 x (ID bits +
+ fingerprint bits) per domain, a little more beyond a million domains.
+
+ Solution words are interleaved per block of 64 slots, so a lookup reads two
+ adjacent blocks. Like PerfectDomainSet the map is held in its serialized
+ form and can be mapped from a file.
+ */
+class RibbonDomainMap {
+
+public:
+    // Version 2 derives the seeded hashes from the unseeded hash64
+    static constexpr uint32_t CURRENT_VERSION = 2;
+    static constexpr uint32_t MAX_FINGERPRINT_BITS = 32;
+
+    // Throws runtime_error when a domain is given two different IDs
+    static RibbonDomainMap build(const std::vector<std::pair<std::string_view, uint32_t>> &entries, uint32_t fingerprintBits = 8);
+
+    // Both validate the serialized form and throw runtime_error when it is malformed
+    explicit RibbonDomainMap(std::vector<char> data);
+
+    RibbonDomainMap(const char *data, size_t length, std::shared_ptr<const void> owner);
+
+    static RibbonDomainMap mapFile(const std::string &path);
+
+    RibbonDomainMap(RibbonDomainMap &&) = default;
+
+    RibbonDomainMap &operator=(RibbonDomainMap &&) = default;
+
+    RibbonDomainMap(const RibbonDomainMap &) = delete;
+
+    RibbonDomainMap &operator=(const RibbonDomainMap &) = delete;
+
+    bool find(std::string_view domain, uint32_t &id) const;
+
+    // Tries the host and its parents down to two labels, longest first, and
+    // returns the one found as a view into `host`, or an empty view
+    std::string_view findAnySuffix(std::string_view host, uint32_t &id) const;
+
+    // Same, with the hashes a HostKey already holds; found suffixes are views into key.host()
+    bool find(const HostKey &key, size_t label, uint32_t &id) const;
+
+    std::string_view findAnySuffix(const HostKey &key, uint32_t &id) const;
+
+    size_t size() const;
+
+    uint32_t getValueBits() const;
+
+    uint32_t getFingerprintBits() const;
+
+    const char *data() const;
+
+    size_t dataLength() const;
+
+    void writeToFile(const std::string &path) const;
+
+private:
+    void attach();
+
+    bool findHashed(uint64_t domainHash, uint32_t &id) const;
+
+    std::vector<char> storage;
+    std::shared_ptr<const void> owner;
+    const char *bytes;
+    size_t length;
+
+    uint64_t seed;
+    uint64_t keyCount;
+    uint64_t slotCount;
+    uint32_t valueBits;
+    uint32_t fingerprintBits;
+    const char *solution;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ Incremental SHA-256, used to check filter payloads against the digest
+ published in their specification. Blocks are compressed with the x86 SHA
+ extensions where the CPU has them. The ARMv8 SHA-2 instructions are only
+ used in builds defining BLOOM_FILTER_ARMV8_SHA256; other arm64 builds,
+ including the Swift package, use the portable code.
+ */
+class SHA256 {
+
+public:
+    typedef std::array<uint8_t, 32> Digest;
+
+    enum class Implementation {
+        portable,
+        shaExtensions,
+        armv8
+    };
+
+    // With the fastest implementation this CPU runs
+    SHA256();
+
+    // Throws runtime_error when this build or CPU can't run `implementation`
+    explicit SHA256(Implementation implementation);
+
+    void update(const void *data, size_t length);
+
+    // The hasher can't be updated afterwards
+    Digest finish();
+
+    static Digest hash(const void *data, size_t length);
+
+    static std::string toHex(const Digest &digest);
+
+    // Accepts either case, returns false for anything but 64 hex digits
+    static bool fromHex(const std::string &hex, Digest &digest);
+
+    // "sha-ni", "armv8" or "portable", whichever this CPU runs
+    static const char *implementationName();
+
+    static const char *implementationName(Implementation implementation);
+
+    // Portable first, the one SHA256() picks last
+    static const std::vector<Implementation> &availableImplementations();
+
+private:
+    void (*compress)(uint32_t *state, const uint8_t *blocks, size_t count);
+    std::array<uint32_t, 8> state;
+    std::array<uint8_t, 64> buffer;
+    size_t bufferLength;
+    uint64_t totalLength;
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SCALABLE_BLOOM_FILTER_HPP
+#define SCALABLE_BLOOM_FILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BlockedBloomFilter.hpp"
+#include "BloomFilter.hpp"
+
+class HostKey;
+
+/*
+ A set that grows as keys are learned, e.g. hosts seen serving HTTPS that the
+ upgrade list doesn't have. It chains BlockedBloomFilter slices, each twice
+ the capacity of the one before at half its error rate, so the rate across
+ the chain stays below `errorRate` however many keys are added. A key is
+ hashed once for every slice.
+
+ Only the slices are kept, no copy of the keys. Slices can't be merged
+ without giving up their rates, so compact() forgets the oldest ones, and
+ the keys only they hold, to fit a memory budget. Later slices keep their
+ place in the chain's series of rates, so the bound still holds.
+
+ Not thread safe, callers serialize adds and lookups.
+ */
+class ScalableBloomFilter {
+
+public:
+    static constexpr size_t GROWTH_FACTOR = 2;
+    static constexpr double TIGHTENING_RATIO = 0.5;
+
+    // Throws runtime_error for invalid parameters
+    ScalableBloomFilter(size_t initialCapacity, double errorRate);
+
+    // Keys are expected canonical, e.g. lowercase hosts. Returns false when
+    // the key is already reported as present, learned or a false positive,
+    // and nothing was added.
+    bool add(std::string_view key);
+
+    bool add(const HostKey &key);
+
+    bool addHash(uint64_t hash);
+
+    bool contains(std::string_view key) const;
+
+    bool contains(const HostKey &key) const;
+
+    bool containsHash(uint64_t hash) const;
+
+    // Forgets the oldest slices until byteCount() is within `memoryBudget`
+    void compact(size_t memoryBudget);
+
+    size_t getItemCount() const;
+
+    size_t getSliceCount() const;
+
+    size_t byteCount() const;
+
+    // The bound on the rate across all slices, given how full each one is
+    double falsePositiveRate() const;
+
+    void writeToStream(BinaryOutputStream &out) const;
+
+    // Throws runtime_error for anything that isn't a complete, intact filter
+    static ScalableBloomFilter readFromStream(BinaryInputStream &in);
+
+    void writeToFile(const std::string &path) const;
+
+    static ScalableBloomFilter readFromFile(const std::string &path);
+
+private:
+    struct Slice {
+        BlockedBloomFilter filter;
+        size_t capacity;
+        size_t itemCount;
+    };
+
+    void addSlice(size_t capacity);
+
+    // The error rate of slice `index` in a chain for `errorRate`
+    double sliceErrorRate(size_t index) const;
+
+    size_t initialCapacity;
+    double errorRate;
+    // Oldest first
+    std::vector<Slice> slices;
+    // Slices forgotten by compact(), the position of slices[0] in the chain
+    size_t droppedSlices = 0;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SHARED_BLOOM_FILTER_HPP
+#define SHARED_BLOOM_FILTER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "BloomFilter.hpp"
+#include "BloomFilterView.hpp"
+
+/*
+ Serves one filter to many processes through POSIX shared memory, so each
+ process maps the same physical pages instead of loading its own copy.
+
+ The publisher owns a small control segment `name` holding the current
+ generation, and writes every filter into a fresh data segment
+ `name.<generation>`. A data segment is never modified after the
+ generation is bumped to point at it. Readers attach read-only and move to
+ a new filter when they see the generation change; an old segment stays
+ valid for readers that still map it after the publisher unlinks it.
+
+ Names follow shm_open: a leading slash and no other. Apple platforms
+ limit them to 31 bytes including the generation suffix.
+ */
+
+struct SharedBloomFilterControl {
+    static constexpr uint32_t CURRENT_VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    std::atomic<uint64_t> generation;
+};
+
+struct SharedBloomFilterSegmentHeader {
+    static constexpr uint32_t CURRENT_VERSION = 1;
+    // Payloads start on a cache line
+    static constexpr size_t PAYLOAD_OFFSET = 64;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t hashRounds;
+    uint64_t generation;
+    uint64_t bitCount;
+    uint64_t maxItems;
+    uint64_t payloadLength;
+};
+
+class SharedBloomFilterPublisher {
+
+public:
+    // Creates the control segment, or takes over one left by a previous publisher
+    explicit SharedBloomFilterPublisher(const std::string &name);
+
+    // Unlinks the segments; readers keep what they already mapped
+    ~SharedBloomFilterPublisher();
+
+    SharedBloomFilterPublisher(const SharedBloomFilterPublisher &) = delete;
+
+    SharedBloomFilterPublisher &operator=(const SharedBloomFilterPublisher &) = delete;
+
+    // Returns the generation readers will see the filter under
+    uint64_t publish(const BloomFilter &filter, size_t maxItems);
+
+    uint64_t getGeneration() const;
+
+private:
+    std::string name;
+    SharedBloomFilterControl *control;
+    uint64_t publishedGeneration;
+};
+
+class SharedBloomFilterReader {
+
+public:
+    // Throws runtime_error when nothing is published under `name`
+    explicit SharedBloomFilterReader(const std::string &name);
+
+    ~SharedBloomFilterReader();
+
+    SharedBloomFilterReader(const SharedBloomFilterReader &) = delete;
+
+    SharedBloomFilterReader &operator=(const SharedBloomFilterReader &) = delete;
+
+    // The latest published filter. Costs one atomic load unless the
+    // generation moved, in which case the new segment is mapped first.
+    // Returns nullptr until something is published.
+    std::shared_ptr<const BloomFilterView> current();
+
+    static std::shared_ptr<const BloomFilterView> attach(const std::string &name, uint64_t generation);
+
+private:
+    std::string name;
+    const SharedBloomFilterControl *control;
+    std::mutex attachMutex;
+    std::shared_ptr<const BloomFilterView> view;
+};
+
+#endif
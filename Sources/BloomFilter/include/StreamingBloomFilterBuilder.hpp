@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STREAMING_BLOOM_FILTER_BUILDER_HPP
+#define STREAMING_BLOOM_FILTER_BUILDER_HPP
+
+#include <cstddef>
+#include <string>
+#include "BloomFilter.hpp"
+#include "BloomFilterFile.hpp"
+#include "HyperLogLog.hpp"
+
+/*
+ Builds a filter from a domain list whose length isn't known up front by
+ reading it twice. The first pass counts the distinct domains with a
+ HyperLogLog and sizes the filter for the target error rate, the second fills
+ it from several threads. Only one chunk of the input is held at a time, and
+ duplicates cost neither bits nor capacity.
+ */
+class StreamingBloomFilterBuilder {
+
+public:
+    // `threadCount` 0 uses every core
+    explicit StreamingBloomFilterBuilder(double targetProbability, size_t threadCount = 0);
+
+    // One domain per line, surrounding whitespace and empty lines ignored.
+    // Throws runtime_error for an input without domains or one that can't be
+    // rewound for the second pass.
+    BloomFilterFile build(BinaryInputStream &in);
+
+    BloomFilterFile build(const std::string &path);
+
+    // Of the last build
+    size_t getLineCount() const;
+
+    double getEstimatedItemCount() const;
+
+    // The estimate plus three standard errors, so the error rate holds for nearly every input
+    size_t getMaxItems() const;
+
+private:
+    double targetProbability;
+    size_t threadCount;
+    size_t lineCount;
+    double estimatedItemCount;
+    size_t maxItems;
+};
+
+#endif
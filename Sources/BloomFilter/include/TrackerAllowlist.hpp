@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACKER_ALLOWLIST_HPP
+#define TRACKER_ALLOWLIST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "PerfectDomainSet.hpp"
+#include "RibbonDomainMap.hpp"
+
+class JSONValue;
+
+// One rule of the privacy configuration's trackerAllowlist feature
+struct TrackerAllowlistEntry {
+    std::string trackerDomain;
+    std::string rule;
+    // Sites the rule applies on, with "<all>" for every site
+    std::vector<std::string> domains;
+};
+
+/*
+ Answers whether a tracker request is allowlisted on a site, the question
+ contentblockerrules.js answers with one regex per rule. It is compiled once
+ per privacy configuration and then needs no regex, and no allocation unless
+ the request URL's scheme or host has uppercase letters.
+
+ Tracker domains are kept in the shared DomainArena and found through a
+ RibbonDomainMap, trying the request host and its parents, and the hit is
+ confirmed against the interned domain. The
+ first rule of that tracker matching the URL decides. A rule is matched the
+ way its generated regex ^(https?)?(wss?)?://([a-z0-9-]+\.)*<rule> would be:
+ after the scheme and any number of leading labels, the URL has to start with
+ the rule's literal text, where '*' matches anything. Each rule's site
+ domains are a PerfectDomainSet, probed for the site host and its parents.
+ */
+class TrackerAllowlist {
+
+public:
+    // Rules of one tracker domain are tried in the order given
+    explicit TrackerAllowlist(const std::vector<TrackerAllowlistEntry> &entries);
+
+    // Reads the allowlistedTrackers settings object. Like the Swift parser it
+    // skips rules without a rule string or domains.
+    static TrackerAllowlist fromAllowlistedTrackers(const JSONValue &allowlistedTrackers);
+
+    // Reads a whole privacy configuration; empty when the feature isn't enabled
+    static TrackerAllowlist fromPrivacyConfig(std::string_view json);
+
+    TrackerAllowlist(TrackerAllowlist &&) = default;
+
+    TrackerAllowlist &operator=(TrackerAllowlist &&) = default;
+
+    // `siteHost` is expected lowercase, the request URL's scheme and host are lowercased here
+    bool isAllowlisted(std::string_view requestURL, std::string_view siteHost) const;
+
+    size_t size() const;
+
+private:
+    struct Tracker {
+        // ID in DomainArena::shared()
+        uint32_t domain;
+        uint32_t firstRule;
+        uint32_t ruleCount;
+    };
+
+    struct Rule {
+        // The rule split at each '*', the first part anchored
+        std::vector<std::string> parts;
+        bool allDomains;
+        PerfectDomainSet domains;
+    };
+
+    bool matchesURL(const Rule &rule, std::string_view url) const;
+
+    bool appliesOn(const Rule &rule, std::string_view siteHost) const;
+
+    std::vector<Tracker> trackers;
+    std::vector<Rule> rules;
+    RibbonDomainMap trackerIndex;
+};
+
+#endif
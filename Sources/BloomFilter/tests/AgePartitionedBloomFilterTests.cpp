@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "AgePartitionedBloomFilter.hpp"
+#include "BloomFilterBuilder.hpp"
+#include "HTTPSUpgradeEngine.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+typedef AgePartitionedBloomFilter::Clock Clock;
+
+/*
+ Checks that an age-partitioned filter forgets keys once their time to live
+ has passed, keeps its error rate through bursts, and that the upgrade engine
+ holds back hosts whose upgrade recently failed.
+
+   AgePartitionedBloomFilterTests
+ */
+
+// Forward declarations
+
+static string host(size_t index);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+    const auto ttl = chrono::seconds(60);
+    const Clock::time_point start = Clock::now();
+
+    AgePartitionedBloomFilter filter(1000, 0.001, ttl);
+    failures += expect(!filter.contains("failing.example", start), "empty") ? 0 : 1;
+    filter.add("failing.example", start);
+    failures += expect(filter.contains("failing.example", start), "added") ? 0 : 1;
+
+    // One more add every few seconds keeps generations rotating
+    bool remembered = true;
+    for (int second = 1; second < 60; second++) {
+        filter.add(host((size_t) second), start + chrono::seconds(second));
+        remembered = remembered && filter.contains("failing.example", start + chrono::seconds(second));
+    }
+    failures += expect(remembered, "remembered within ttl") ? 0 : 1;
+    // Generations span 20 seconds, and the first one took adds until second 19
+    failures += expect(filter.contains("failing.example", start + chrono::seconds(78)), "remembered within span") ? 0 : 1;
+    failures += expect(!filter.contains("failing.example", start + chrono::seconds(80)), "forgotten after ttl") ? 0 : 1;
+    failures += expect(filter.contains(host(59), start + chrono::seconds(80)), "newer keys remain") ? 0 : 1;
+
+    // Adding again restarts the time to live
+    filter.add(host(30), start + chrono::seconds(70));
+    failures += expect(filter.contains(host(30), start + chrono::seconds(120)), "renewed") ? 0 : 1;
+    failures += expect(!filter.contains(host(30), start + chrono::seconds(131)), "renewal expires") ? 0 : 1;
+
+    // A burst far over capacity forgets early instead of filling up
+    Clock::time_point burst = start + chrono::hours(1);
+    size_t before = filter.byteCount();
+    for (size_t i = 0; i < 100000; i++) {
+        filter.add(host(i), burst);
+    }
+    size_t falsePositives = 0;
+    for (size_t i = 0; i < 100000; i++) {
+        falsePositives += filter.contains("other" + to_string(i) + ".example", burst) ? 1 : 0;
+    }
+    failures += expect(filter.byteCount() == before, "constant memory") ? 0 : 1;
+    failures += expect(falsePositives <= 200, "error rate through a burst") ? 0 : 1;
+    failures += expect(filter.contains(host(99999), burst), "burst keeps newest") ? 0 : 1;
+
+    bool rejected = false;
+    try {
+        AgePartitionedBloomFilter(1000, 0.001, ttl, 1);
+    } catch (const runtime_error &) {
+        rejected = true;
+    }
+    failures += expect(rejected, "invalid parameters") ? 0 : 1;
+
+    // Checked after the upgrade list, on the same HostKey
+    BloomFilterBuilder upgradeList(100, 0.0001);
+    upgradeList.add("secure.example");
+    upgradeList.add("broken.example");
+    HTTPSUpgradeEngine engine(16);
+    engine.setUpgradeList(make_shared<const FrozenBloomFilter>(upgradeList.freeze()), {});
+    engine.setFeatureState(true, {}, {});
+    failures += expect(!engine.recordUpgradeFailure("broken.example"), "no failure memory") ? 0 : 1;
+    engine.setFailureMemory(make_shared<AgePartitionedBloomFilter>(100, 0.001, chrono::hours(1)));
+    failures += expect(engine.recordUpgradeFailure("Broken.Example"), "recorded") ? 0 : 1;
+    failures += expect(engine.decideHost("broken.example") == HTTPSUpgradeVerdict::recentlyFailed, "recently failed") ? 0 : 1;
+    failures += expect(engine.decideHost("secure.example") == HTTPSUpgradeVerdict::upgrade, "others upgraded") ? 0 : 1;
+    engine.setFailureMemory(nullptr);
+    failures += expect(engine.decideHost("broken.example") == HTTPSUpgradeVerdict::upgrade, "failures forgotten") ? 0 : 1;
+    engine.setExcludedDomains({ "secure.example" });
+    failures += expect(engine.decideHost("secure.example") == HTTPSUpgradeVerdict::excluded
+                       && engine.decideHost("broken.example") == HTTPSUpgradeVerdict::upgrade, "filter kept with new exclusions") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static string host(size_t index) {
+    return "host" + to_string(index) + ".example";
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "BitSlicedBloomIndex.hpp"
+#include "BloomFilter.hpp"
+#include "HostKey.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks every list of a bit sliced index against a BloomFilter built from the
+ same keys: no false negatives, a false positive rate close to the filter's,
+ suffix and HostKey queries, and a round trip through the serialized form.
+
+   BitSlicedBloomIndexTests
+ */
+
+// Forward declarations
+
+static string listKey(size_t list, size_t index);
+
+static bool rejects(vector<char> data);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+    const size_t listCount = 12;
+    const size_t maxItems = 2000;
+    const double probability = 0.01;
+
+    // Lists of different sizes, every tenth key shared with the next list
+    BitSlicedBloomIndex index(listCount, maxItems, probability);
+    vector<unique_ptr<BloomFilter>> filters;
+    vector<size_t> sizes;
+    for (size_t list = 0; list < listCount; list++) {
+        filters.push_back(make_unique<BloomFilter>(maxItems, probability));
+        sizes.push_back(maxItems / (list + 1));
+        for (size_t i = 0; i < sizes[list]; i++) {
+            index.add(list, listKey(list, i));
+            filters[list]->add(listKey(list, i));
+        }
+        if (list > 0) {
+            for (size_t i = 0; i < sizes[list - 1]; i += 10) {
+                index.add(list, listKey(list - 1, i));
+                filters[list]->add(listKey(list - 1, i));
+            }
+        }
+    }
+    failures += expect(index.getListCount() == listCount, "list count") ? 0 : 1;
+
+    bool agrees = true;
+    for (size_t list = 0; list < listCount && agrees; list++) {
+        for (size_t i = 0; i < sizes[list] && agrees; i++) {
+            uint64_t mask = index.query(listKey(list, i));
+            agrees = (mask & (1ull << list)) != 0 && filters[list]->contains(listKey(list, i));
+            if (list + 1 < listCount && i % 10 == 0) {
+                agrees = agrees && (mask & (1ull << (list + 1))) != 0;
+            }
+        }
+    }
+    failures += expect(agrees, "no false negatives") ? 0 : 1;
+
+    // Per list, the index may answer differently for a key than the filter
+    // does, but not more often wrongly
+    const size_t probes = 100000;
+    vector<size_t> indexPositives(listCount);
+    vector<size_t> filterPositives(listCount);
+    for (size_t i = 0; i < probes; i++) {
+        string key = "absent" + to_string(i) + ".example";
+        uint64_t mask = index.query(key);
+        for (size_t list = 0; list < listCount; list++) {
+            indexPositives[list] += (mask >> list) & 1;
+            filterPositives[list] += filters[list]->contains(key) ? 1 : 0;
+        }
+    }
+    bool nearFilter = true;
+    for (size_t list = 0; list < listCount; list++) {
+        double indexRate = (double) indexPositives[list] / probes;
+        double filterRate = (double) filterPositives[list] / probes;
+        if (indexRate > 2 * probability || indexRate > 2 * filterRate + 0.002) {
+            printf("list %zu: index %f, filter %f\n", list, indexRate, filterRate);
+            nearFilter = false;
+        }
+    }
+    failures += expect(nearFilter, "false positive rate") ? 0 : 1;
+
+    HostKey key;
+    key.assign("www.Shop." + listKey(3, 7));
+    uint64_t suffixMask = index.queryAnySuffix(key);
+    failures += expect((suffixMask & (1ull << 3)) != 0 && suffixMask == index.queryAnySuffix("www.shop." + listKey(3, 7)),
+                       "any suffix") ? 0 : 1;
+    failures += expect(index.query(key, 2) == index.query(listKey(3, 7)), "host key label") ? 0 : 1;
+
+    BitSlicedBloomIndex restored(vector<char>(index.data(), index.data() + index.dataLength()));
+    bool sameMasks = restored.getSlotCount() == index.getSlotCount() && restored.getHashRounds() == index.getHashRounds();
+    for (size_t i = 0; i < 1000 && sameMasks; i++) {
+        sameMasks = restored.query(listKey(i % listCount, i)) == index.query(listKey(i % listCount, i));
+    }
+    failures += expect(sameMasks, "round trip") ? 0 : 1;
+
+    vector<char> data(index.data(), index.data() + index.dataLength());
+    failures += expect(rejects(vector<char>(data.begin(), data.end() - 1)), "truncated") ? 0 : 1;
+    data[0] ^= 1;
+    failures += expect(rejects(data), "bad magic") ? 0 : 1;
+    failures += expect(rejects(vector<char>()), "empty") ? 0 : 1;
+
+    // 64 lists take the widest words
+    BitSlicedBloomIndex wide(BitSlicedBloomIndex::MAX_LISTS, 100, probability);
+    for (size_t list = 0; list < BitSlicedBloomIndex::MAX_LISTS; list++) {
+        wide.add(list, listKey(list, 0));
+    }
+    bool wideMembers = true;
+    for (size_t list = 0; list < BitSlicedBloomIndex::MAX_LISTS && wideMembers; list++) {
+        wideMembers = (wide.query(listKey(list, 0)) >> list & 1) != 0;
+    }
+    failures += expect(wideMembers, "64 lists") ? 0 : 1;
+
+    bool rejected = false;
+    try {
+        BitSlicedBloomIndex(BitSlicedBloomIndex::MAX_LISTS + 1, 100, probability);
+    } catch (const runtime_error &) {
+        rejected = true;
+    }
+    failures += expect(rejected, "invalid parameters") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static string listKey(size_t list, size_t index) {
+    return "list" + to_string(list) + "-" + to_string(index) + ".example";
+}
+
+static bool rejects(vector<char> data) {
+    try {
+        BitSlicedBloomIndex index(move(data));
+    } catch (const runtime_error &) {
+        return true;
+    }
+    return false;
+}
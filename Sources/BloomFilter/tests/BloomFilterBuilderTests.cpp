@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "BloomFilter.hpp"
+#include "BloomFilterBuilder.hpp"
+#include "FrozenBloomFilter.hpp"
+#include "HostKey.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+static_assert(!is_copy_constructible_v<FrozenBloomFilter> && !is_copy_assignable_v<FrozenBloomFilter>,
+              "Frozen filters are never copied");
+static_assert(is_nothrow_move_constructible_v<FrozenBloomFilter>, "Frozen filters move without throwing");
+static_assert(noexcept(declval<const FrozenBloomFilter &>().contains(string_view())), "Lookups don't throw");
+
+/*
+ Checks that a filter built concurrently and frozen has the bits of a
+ BloomFilter given the same domains, and answers every lookup like it.
+
+   BloomFilterBuilderTests
+ */
+
+// Forward declarations
+
+static bool throwsRuntimeError(void (*body)());
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+
+    vector<string> domains;
+    for (size_t i = 0; i < 100000; i++) {
+        domains.push_back("domain" + to_string(i) + ".example");
+    }
+    vector<string_view> views(domains.begin(), domains.end());
+
+    BloomFilter filter(domains.size(), 0.0001);
+    filter.addAll(views, 1);
+    BloomFilterBuilder builder(domains.size(), 0.0001);
+    builder.addAll(views, 4);
+    failures += expect(builder.getBitCount() == filter.getBitCount() && builder.getHashRounds() == filter.getHashRounds(), "shape") ? 0 : 1;
+    FrozenBloomFilter frozen = builder.freeze();
+    failures += expect(frozen.blocks() == filter.getBlocks(), "same bits") ? 0 : 1;
+
+    // Hits, misses and parent domains all answered like the mutable filter
+    bool same = true;
+    HostKey key;
+    for (size_t i = 0; i < 200000 && same; i++) {
+        string host = i % 2 == 0 ? "www.domain" + to_string(i / 2) + ".example" : "other" + to_string(i) + ".example";
+        key.assign(host);
+        same = frozen.contains(host) == filter.contains(host)
+            && frozen.contains(key) == filter.contains(key)
+            && frozen.containsAnySuffix(key) == filter.containsAnySuffix(key);
+    }
+    failures += expect(same, "same answers") ? 0 : 1;
+
+    // Loaded bits and an odd bit count, which the precomputed reduction must match exactly
+    vector<BlockType> blocks(125001);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i] = (BlockType) (i * 2654435761u >> 13);
+    }
+    BloomFilter loaded(blocks, 1000003, 40000);
+    FrozenBloomFilter frozenLoaded = BloomFilterBuilder(loaded).freeze();
+    same = frozenLoaded.getHashRounds() == loaded.getHashRounds();
+    for (size_t i = 0; i < 100000 && same; i++) {
+        string element = to_string(i);
+        same = frozenLoaded.contains(element) == loaded.contains(element);
+    }
+    failures += expect(same, "loaded bits") ? 0 : 1;
+
+    failures += expect(throwsRuntimeError([]() {
+        BloomFilterBuilder frozenBuilder(10, 0.01);
+        frozenBuilder.freeze();
+        frozenBuilder.add("late.example");
+    }), "add after freeze") ? 0 : 1;
+    failures += expect(throwsRuntimeError([]() {
+        BloomFilterBuilder(0, 0.01);
+    }), "invalid parameters") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static bool throwsRuntimeError(void (*body)()) {
+    try {
+        body();
+    } catch (const runtime_error &) {
+        return true;
+    }
+    return false;
+}
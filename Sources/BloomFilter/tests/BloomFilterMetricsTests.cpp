@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "BloomFilterMetrics.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks the latency histogram's bucket boundaries, that counters recorded on
+ several threads all reach the snapshot, both while the threads run and once
+ they have exited, and that latency is sampled at the configured interval.
+
+   BloomFilterMetricsTests
+ */
+
+static const size_t THREAD_COUNT = 4;
+static const size_t LOOKUPS_PER_THREAD = 10000;
+static const uint32_t SAMPLE_INTERVAL = 16;
+
+// Forward declarations
+
+static bool bucketsCover(uint64_t value);
+
+static void recordLookups(size_t threadIndex);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+
+    bool exact = true;
+    for (uint64_t value = 0; value < LatencyHistogram::SUB_BUCKETS * 2; value++) {
+        exact = exact && LatencyHistogram::bucketIndex(value) == value && LatencyHistogram::bucketLowerBound(value) == value;
+    }
+    failures += expect(exact, "small values get their own bucket") ? 0 : 1;
+    failures += expect(LatencyHistogram::bucketIndex(17) == 16 && LatencyHistogram::bucketIndex(18) == 17
+                       && LatencyHistogram::bucketLowerBound(17) == 18, "sub-buckets double in width") ? 0 : 1;
+    failures += expect(LatencyHistogram::bucketIndex(1000) == LatencyHistogram::bucketIndex(1023)
+                       && LatencyHistogram::bucketIndex(1024) == LatencyHistogram::bucketIndex(1023) + 1
+                       && LatencyHistogram::bucketLowerBound(LatencyHistogram::bucketIndex(1024)) == 1024, "power of two boundary") ? 0 : 1;
+    bool covered = true;
+    for (uint64_t value = 1; value < (1ull << 40); value = value * 3 + 1) {
+        covered = covered && bucketsCover(value);
+    }
+    failures += expect(covered, "buckets within 12.5%") ? 0 : 1;
+    failures += expect(LatencyHistogram::bucketIndex(UINT64_MAX) == LatencyHistogram::BUCKET_COUNT - 1, "overflow bucket") ? 0 : 1;
+
+    LatencyHistogram histogram;
+    histogram.counts[LatencyHistogram::bucketIndex(100)] = 90;
+    histogram.counts[LatencyHistogram::bucketIndex(10000)] = 10;
+    failures += expect(histogram.totalCount() == 100 && histogram.valueAtPercentile(50) == 96
+                       && histogram.valueAtPercentile(99) == LatencyHistogram::bucketLowerBound(LatencyHistogram::bucketIndex(10000)), "percentiles") ? 0 : 1;
+
+    BloomFilterMetrics::setEnabled(true);
+    BloomFilterMetrics::setLatencySampleInterval(SAMPLE_INTERVAL);
+    failures += expect(BloomFilterMetrics::isEnabled(), "enabled") ? 0 : 1;
+
+    // Recorded while the threads are alive, then again once they have retired their counters
+    vector<thread> threads;
+    for (size_t t = 0; t < THREAD_COUNT; t++) {
+        threads.emplace_back(recordLookups, t);
+    }
+    for (thread &worker : threads) {
+        worker.join();
+    }
+    recordLookups(THREAD_COUNT);
+    BloomFilterMetricsSnapshot snapshot = BloomFilterMetrics::snapshot();
+
+    const size_t lookups = (THREAD_COUNT + 1) * LOOKUPS_PER_THREAD;
+    failures += expect(snapshot.lookups == lookups, "lookups") ? 0 : 1;
+    failures += expect(snapshot.positives == lookups / 2 && snapshot.hitRatio() == 0.5, "positives") ? 0 : 1;
+    failures += expect(snapshot.roundsHistogram[1] == lookups / 2 && snapshot.roundsHistogram[3] == lookups / 4
+                       && snapshot.roundsHistogram[BloomFilterMetricsSnapshot::MAX_TRACKED_ROUNDS] == lookups / 4, "rounds histogram") ? 0 : 1;
+    failures += expect(snapshot.roundsProbed == lookups / 2 + lookups / 4 * 3 + lookups / 4 * 40, "rounds probed") ? 0 : 1;
+
+    // Every thread timed exactly one lookup in SAMPLE_INTERVAL, at a latency that depends on the thread
+    bool sampled = snapshot.probeLatency.totalCount() == lookups / SAMPLE_INTERVAL;
+    for (size_t t = 0; t <= THREAD_COUNT; t++) {
+        size_t bucket = LatencyHistogram::bucketIndex(1000 * (t + 1));
+        sampled = sampled && snapshot.probeLatency.counts[bucket] == LOOKUPS_PER_THREAD / SAMPLE_INTERVAL;
+    }
+    failures += expect(sampled, "sampled probe latency") ? 0 : 1;
+    failures += expect(snapshot.wrapperLatency.totalCount() == lookups
+                       && snapshot.wrapperLatency.counts[LatencyHistogram::bucketIndex(50)] == lookups, "wrapper latency") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static bool bucketsCover(uint64_t value) {
+    size_t index = LatencyHistogram::bucketIndex(value);
+    uint64_t lower = LatencyHistogram::bucketLowerBound(index);
+    uint64_t upper = LatencyHistogram::bucketLowerBound(index + 1);
+    return lower <= value && value < upper && (double) (upper - lower) <= lower / 8.0 + 1;
+}
+
+static void recordLookups(size_t threadIndex) {
+    for (size_t i = 0; i < LOOKUPS_PER_THREAD; i++) {
+        // Half are hits after one round, a quarter probe 3 rounds and a quarter more rounds than are tracked
+        size_t rounds = i % 2 == 0 ? 1 : (i % 4 == 1 ? 3 : 40);
+        BloomFilterMetrics::recordLookup(i % 2 == 0, rounds);
+        if (BloomFilterMetrics::shouldSampleProbeLatency()) {
+            BloomFilterMetrics::recordProbeLatency(1000 * (threadIndex + 1));
+        }
+        BloomFilterMetrics::recordWrapperLatency(50);
+    }
+}
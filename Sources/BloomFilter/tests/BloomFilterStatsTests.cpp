@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "BloomFilter.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks the fill ratio, false positive rate and byte entropy reported for bit
+ arrays with a known fill, for a filter filled to capacity, and for payloads
+ that are not a filter.
+
+   BloomFilterStatsTests
+ */
+
+static const size_t ITEM_COUNT = 20000;
+static const double ERROR_RATE = 0.001;
+
+// Forward declarations
+
+static vector<BlockType> randomBits(size_t byteCount, double fill, uint32_t seed);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+
+    // Independent bits at half fill are what an ideal filter at capacity looks like
+    size_t bitCount = BloomFilter::bitCountFor(ITEM_COUNT, ERROR_RATE);
+    size_t byteCount = (bitCount + 7) / 8;
+    BloomFilterStats ideal = BloomFilter(randomBits(byteCount, 0.5, 1), bitCount, ITEM_COUNT).stats();
+    failures += expect(ideal.fillRatio == (double) ideal.setBits / bitCount && fabs(ideal.fillRatio - 0.5) < 0.01, "fill ratio") ? 0 : 1;
+    failures += expect(ideal.falsePositiveRate == pow(ideal.fillRatio, (double) ideal.hashRounds), "false positive rate") ? 0 : 1;
+    failures += expect(fabs(ideal.estimatedItemCount - ITEM_COUNT) < ITEM_COUNT * 0.02, "estimated items") ? 0 : 1;
+    failures += expect(ideal.isWithinErrorRate(ERROR_RATE) && ideal.falsePositiveRateMargin() < 0.1, "within error rate") ? 0 : 1;
+    failures += expect(ideal.hasExpectedEntropy() && fabs(ideal.expectedByteEntropy - 8.0) < 0.01, "entropy") ? 0 : 1;
+
+    // The fill a tenth over capacity nearly doubles the rate, which the old 2x tolerance let through
+    double overFill = 1.0 - exp(-(double) ideal.hashRounds * 1.1 * ITEM_COUNT / bitCount);
+    BloomFilterStats over = BloomFilter(randomBits(byteCount, overFill, 2), bitCount, ITEM_COUNT).stats();
+    failures += expect(over.falsePositiveRate < ERROR_RATE * 2 && !over.isWithinErrorRate(ERROR_RATE), "rejected a tenth over") ? 0 : 1;
+    failures += expect(over.isWithinErrorRate(ERROR_RATE, 2.0) && over.hasExpectedEntropy(), "explicit tolerance") ? 0 : 1;
+
+    BloomFilter full(ITEM_COUNT, ERROR_RATE);
+    BloomFilterStats empty = full.stats();
+    failures += expect(empty.setBits == 0 && empty.falsePositiveRate == 0 && empty.isWithinErrorRate(ERROR_RATE), "empty") ? 0 : 1;
+    for (size_t i = 0; i < ITEM_COUNT; i++) {
+        full.add("domain" + to_string(i) + ".example");
+    }
+    BloomFilterStats stats = full.stats();
+    failures += expect(stats.isWithinErrorRate(ERROR_RATE) && stats.hasExpectedEntropy(), "filled to capacity") ? 0 : 1;
+
+    // A payload whose second half is zero padding: a plausible fill, but little entropy
+    vector<BlockType> padded = full.getBlocks();
+    for (size_t i = padded.size() / 2; i < padded.size(); i++) {
+        padded[i] = 0;
+    }
+    BloomFilterStats zeroed = BloomFilter(padded, bitCount, ITEM_COUNT).stats();
+    failures += expect(zeroed.fillRatio < 0.3 && !zeroed.hasExpectedEntropy(), "zero padded") ? 0 : 1;
+
+    // An error page instead of filter bits has a fill the rate alone would accept
+    string page = "<html><body>503 Service Unavailable</body></html>\n";
+    vector<BlockType> text(byteCount);
+    for (size_t i = 0; i < text.size(); i++) {
+        text[i] = page[i % page.size()];
+    }
+    BloomFilterStats html = BloomFilter(text, bitCount, ITEM_COUNT).stats();
+    failures += expect(html.isWithinErrorRate(ERROR_RATE) && !html.hasExpectedEntropy(), "error page") ? 0 : 1;
+
+    vector<BlockType> ones(byteCount, (BlockType) 0xff);
+    BloomFilterStats saturated = BloomFilter(ones, bitCount, ITEM_COUNT).stats();
+    failures += expect(saturated.fillRatio == 1.0 && saturated.falsePositiveRate == 1.0
+                       && !saturated.isWithinErrorRate(ERROR_RATE), "saturated") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static vector<BlockType> randomBits(size_t byteCount, double fill, uint32_t seed) {
+    mt19937 generator(seed);
+    bernoulli_distribution bit(fill);
+    vector<BlockType> blocks(byteCount);
+    for (auto &block : blocks) {
+        unsigned char value = 0;
+        for (size_t i = 0; i < 8; i++) {
+            value |= (unsigned char) (bit(generator) ? 1 : 0) << i;
+        }
+        block = (BlockType) value;
+    }
+    return blocks;
+}
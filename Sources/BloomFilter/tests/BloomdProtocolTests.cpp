@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+#include "BloomdProtocol.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks that bloomd frames survive a round trip, that pipelined frames split
+ cleanly and that malformed payloads are rejected.
+
+   BloomdProtocolTests
+ */
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+
+    // Two requests pipelined into one buffer
+    vector<char> stream;
+    BloomdProtocol::appendRequest(stream, 7, BloomdOperation::upgrade, { "example.com", "", "a.b.c" });
+    BloomdProtocol::appendRequest(stream, 8, BloomdOperation::trackerAllowlisted, { "https://t.example/x", "site.example" });
+
+    size_t first = BloomdProtocol::frameLength(stream.data(), stream.size());
+    failures += expect(first > 0 && first < stream.size(), "the first frame ends before the second") ? 0 : 1;
+    failures += expect(BloomdProtocol::frameLength(stream.data(), first - 1) == 0, "partial frames need more bytes") ? 0 : 1;
+    failures += expect(BloomdProtocol::frameLength(stream.data(), 3) == 0, "partial prefixes need more bytes") ? 0 : 1;
+
+    BloomdRequest request;
+    bool decoded = BloomdProtocol::decodeRequest(stream.data() + BloomdProtocol::FRAME_PREFIX_LENGTH,
+                                                 first - BloomdProtocol::FRAME_PREFIX_LENGTH, request);
+    failures += expect(decoded && request.requestID == 7 && request.operation == BloomdOperation::upgrade
+                       && request.items == vector<string_view> { "example.com", "", "a.b.c" }, "request round trip") ? 0 : 1;
+
+    size_t second = BloomdProtocol::frameLength(stream.data() + first, stream.size() - first);
+    decoded = BloomdProtocol::decodeRequest(stream.data() + first + BloomdProtocol::FRAME_PREFIX_LENGTH,
+                                            second - BloomdProtocol::FRAME_PREFIX_LENGTH, request);
+    failures += expect(decoded && first + second == stream.size() && request.requestID == 8
+                       && request.items.size() == 2 && request.items[1] == "site.example", "pipelined request") ? 0 : 1;
+
+    // Responses, with the result width depending on the operation
+    for (BloomdOperation operation : { BloomdOperation::upgrade, BloomdOperation::trackerEntity, BloomdOperation::domainLists }) {
+        vector<char> encoded;
+        uint64_t largest = operation == BloomdOperation::upgrade ? 255 : operation == BloomdOperation::trackerEntity ? BloomdProtocol::NO_ENTITY : UINT64_MAX;
+        BloomdResponse response { 9, operation, BloomdStatus::ok, { 0, 5, largest } };
+        BloomdProtocol::appendResponse(encoded, response);
+        BloomdResponse result;
+        size_t length = BloomdProtocol::frameLength(encoded.data(), encoded.size());
+        decoded = BloomdProtocol::decodeResponse(encoded.data() + BloomdProtocol::FRAME_PREFIX_LENGTH,
+                                                 length - BloomdProtocol::FRAME_PREFIX_LENGTH, result);
+        failures += expect(decoded && length == encoded.size() && result.requestID == 9 && result.operation == operation
+                           && result.results == response.results, "response round trip") ? 0 : 1;
+    }
+
+    vector<char> failed;
+    BloomdProtocol::appendResponse(failed, BloomdResponse { 3, BloomdOperation::upgrade, BloomdStatus::notLoaded, { 1, 1 } });
+    BloomdResponse result;
+    decoded = BloomdProtocol::decodeResponse(failed.data() + BloomdProtocol::FRAME_PREFIX_LENGTH,
+                                             failed.size() - BloomdProtocol::FRAME_PREFIX_LENGTH, result);
+    failures += expect(decoded && result.status == BloomdStatus::notLoaded && result.results.empty(), "failures carry no results") ? 0 : 1;
+
+    // Malformed payloads: too short, an item running past the end, trailing bytes and an impossible count
+    const char *payload = stream.data() + BloomdProtocol::FRAME_PREFIX_LENGTH;
+    size_t payloadLength = first - BloomdProtocol::FRAME_PREFIX_LENGTH;
+    failures += expect(!BloomdProtocol::decodeRequest(payload, BloomdProtocol::HEADER_LENGTH - 1, request)
+                       && request.requestID == 0 && request.operation == BloomdOperation(), "short header") ? 0 : 1;
+    failures += expect(!BloomdProtocol::decodeRequest(payload, payloadLength - 1, request), "truncated item") ? 0 : 1;
+    vector<char> trailing(payload, payload + payloadLength);
+    trailing.push_back(0);
+    failures += expect(!BloomdProtocol::decodeRequest(trailing.data(), trailing.size(), request), "trailing bytes") ? 0 : 1;
+    vector<char> counted(payload, payload + payloadLength);
+    memset(counted.data() + 8, 0xff, 4);
+    failures += expect(!BloomdProtocol::decodeRequest(counted.data(), counted.size(), request), "impossible item count") ? 0 : 1;
+
+    char oversized[4] = { 0, 0, 0x20, 0 };
+    bool threw = false;
+    try {
+        BloomdProtocol::frameLength(oversized, sizeof(oversized));
+    } catch (const runtime_error &) {
+        threw = true;
+    }
+    failures += expect(threw, "oversized frames throw") ? 0 : 1;
+
+    // A full request of empty items, two bytes each, asks for more u32 or u64 results than a frame holds
+    size_t itemCount = (BloomdProtocol::MAX_PAYLOAD_LENGTH - BloomdProtocol::HEADER_LENGTH) / 2;
+    vector<string_view> shortItems(itemCount, "");
+    vector<char> full;
+    BloomdProtocol::appendRequest(full, 1, BloomdOperation::trackerEntity, shortItems);
+    failures += expect(full.size() == BloomdProtocol::FRAME_PREFIX_LENGTH + BloomdProtocol::MAX_PAYLOAD_LENGTH, "full request") ? 0 : 1;
+    bool fits = true;
+    for (BloomdOperation operation : { BloomdOperation::upgrade, BloomdOperation::trackerEntity, BloomdOperation::domainLists }) {
+        vector<char> largest;
+        BloomdProtocol::appendResponse(largest, BloomdResponse { 1, operation, BloomdStatus::ok, vector<uint64_t>(BloomdProtocol::maxResults(operation)) });
+        fits = fits && largest.size() <= BloomdProtocol::FRAME_PREFIX_LENGTH + BloomdProtocol::MAX_PAYLOAD_LENGTH
+            && BloomdProtocol::frameLength(largest.data(), largest.size()) == largest.size();
+    }
+    failures += expect(fits, "largest responses fit a frame") ? 0 : 1;
+    failures += expect(itemCount > BloomdProtocol::maxResults(BloomdOperation::trackerEntity)
+                       && itemCount <= BloomdProtocol::maxResults(BloomdOperation::upgrade), "result limits") ? 0 : 1;
+
+    threw = false;
+    try {
+        vector<char> oversizedResponse;
+        BloomdResponse response { 1, BloomdOperation::trackerEntity, BloomdStatus::ok, vector<uint64_t>(itemCount) };
+        BloomdProtocol::appendResponse(oversizedResponse, response);
+    } catch (const runtime_error &) {
+        threw = true;
+    }
+    failures += expect(threw, "oversized responses throw") ? 0 : 1;
+
+    // Errors carry no results, so a refused request still gets its answer
+    vector<char> refused;
+    BloomdProtocol::appendResponse(refused, BloomdResponse { 1, BloomdOperation::trackerEntity, BloomdStatus::tooLarge, vector<uint64_t>(itemCount) });
+    decoded = BloomdProtocol::decodeResponse(refused.data() + BloomdProtocol::FRAME_PREFIX_LENGTH,
+                                             refused.size() - BloomdProtocol::FRAME_PREFIX_LENGTH, result);
+    failures += expect(decoded && result.status == BloomdStatus::tooLarge && result.results.empty(), "too large") ? 0 : 1;
+
+    return reportFailures(failures);
+}
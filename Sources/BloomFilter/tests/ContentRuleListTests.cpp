@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ContentRuleList.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks the content rule list evaluator against hand written rules covering
+ each supported trigger field and the ordering WebKit applies.
+
+   ContentRuleListTests
+ */
+
+static const char RULES[] = R"([
+    { "trigger": { "url-filter": "tracker\\.example/.*\\.js" }, "action": { "type": "block" } },
+    { "trigger": { "url-filter": "tracker\\.example/allowed\\.js", "if-domain": ["*news.example"] },
+      "action": { "type": "ignore-previous-rules" } },
+    { "trigger": { "url-filter": "pixel", "resource-type": ["image"], "load-type": ["third-party"] },
+      "action": { "type": "block" } },
+    { "trigger": { "url-filter": ".*", "if-domain": ["shop.example"] }, "action": { "type": "block-cookies" } },
+    { "trigger": { "url-filter": "^http://secure\\.example/" }, "action": { "type": "make-https" } },
+    { "trigger": { "url-filter": "CaseSensitive", "url-filter-is-case-sensitive": true },
+      "action": { "type": "block" } },
+    { "trigger": { "url-filter": "ads?/banner", "unless-domain": ["*ads.example"] }, "action": { "type": "block" } },
+    { "trigger": { "url-filter": "beacon", "if-top-url": ["https://top.example"] }, "action": { "type": "block" } },
+    { "trigger": { "url-filter": "(foo|bar)baz" }, "action": { "type": "css-display-none", "selector": ".ad" } }
+])";
+
+struct TestCase {
+    const char *name;
+    ContentRuleRequest request;
+    vector<size_t> expectedRules;
+    bool block;
+};
+
+// Forward declarations
+
+static bool check(const ContentRuleList &rules, const TestCase &testCase);
+
+static bool expectThrows(const char *name, const char *json);
+
+
+// Implementation
+
+int main() {
+    ContentRuleList rules = ContentRuleList::parse(RULES);
+
+    const TestCase cases[] = {
+        { "script is blocked", { "https://tracker.example/a.js", "site.example", ContentRuleResourceScript, true }, { 0 }, true },
+        { "other hosts are allowed", { "https://cdn.example/a.js", "site.example", ContentRuleResourceScript, true }, {}, false },
+        { "ignore-previous-rules drops the block", { "https://tracker.example/allowed.js", "news.example", ContentRuleResourceScript, true }, {}, false },
+        { "ignore-previous-rules covers subdomains", { "https://tracker.example/allowed.js", "www.news.example", ContentRuleResourceScript, true }, {}, false },
+        { "ignore-previous-rules only on its domains", { "https://tracker.example/allowed.js", "othernews.example", ContentRuleResourceScript, true }, { 0 }, true },
+        { "resource type and load type match", { "https://a.example/pixel.gif", "site.example", ContentRuleResourceImage, true }, { 2 }, true },
+        { "resource type mismatch", { "https://a.example/pixel.gif", "site.example", ContentRuleResourceScript, true }, {}, false },
+        { "load type mismatch", { "https://a.example/pixel.gif", "site.example", ContentRuleResourceImage, false }, {}, false },
+        { "if-domain without wildcard is exact", { "https://shop.example/", "shop.example", ContentRuleResourceDocument, false }, { 3 }, false },
+        { "if-domain without wildcard skips subdomains", { "https://shop.example/", "www.shop.example", ContentRuleResourceDocument, false }, {}, false },
+        { "anchored filter", { "http://secure.example/login", "secure.example", ContentRuleResourceDocument, false }, { 4 }, false },
+        { "anchored filter mismatch", { "https://secure.example/login", "secure.example", ContentRuleResourceDocument, false }, {}, false },
+        { "case sensitive match", { "https://a.example/CaseSensitive", "site.example", ContentRuleResourceFetch, true }, { 5 }, true },
+        { "case sensitive mismatch", { "https://a.example/casesensitive", "site.example", ContentRuleResourceFetch, true }, {}, false },
+        { "optional character", { "https://a.example/ad/banner.png", "site.example", ContentRuleResourceImage, false }, { 6 }, true },
+        { "unless-domain", { "https://a.example/ads/banner.png", "www.ads.example", ContentRuleResourceImage, false }, {}, false },
+        { "unsupported trigger never matches", { "https://a.example/beacon", "top.example", ContentRuleResourcePing, true }, {}, false },
+        { "alternation", { "https://a.example/barbaz", "site.example", ContentRuleResourceDocument, false }, { 8 }, false }
+    };
+
+    size_t failures = 0;
+    for (const auto &testCase : cases) {
+        failures += !check(rules, testCase);
+    }
+    failures += !expectThrows("invalid regex", R"([{ "trigger": { "url-filter": "(" }, "action": { "type": "block" } }])");
+    failures += !expectThrows("unknown action", R"([{ "trigger": { "url-filter": "a" }, "action": { "type": "allow" } }])");
+    failures += !expectThrows("unknown resource type", R"([{ "trigger": { "url-filter": "a", "resource-type": ["gif"] }, "action": { "type": "block" } }])");
+    failures += !expectThrows("missing url-filter", R"([{ "trigger": {}, "action": { "type": "block" } }])");
+
+    if (rules.unsupportedRuleCount() != 1) {
+        printf("FAIL unsupported rules: %zu\n", rules.unsupportedRuleCount());
+        failures++;
+    }
+    // Only the rule without literals or domains is tried for every request
+    if (rules.unindexedRuleCount() != 1) {
+        printf("FAIL unindexed rules: %zu\n", rules.unindexedRuleCount());
+        failures++;
+    }
+
+    return reportFailures(failures, size(cases) + 4);
+}
+
+static bool check(const ContentRuleList &rules, const TestCase &testCase) {
+    ContentRuleDecision decision = rules.evaluate(testCase.request);
+    if (decision.rules == testCase.expectedRules && decision.block == testCase.block) {
+        return true;
+    }
+    printf("FAIL %s: matched", testCase.name);
+    for (size_t rule : decision.rules) {
+        printf(" %zu", rule);
+    }
+    printf("\n");
+    return false;
+}
+
+static bool expectThrows(const char *name, const char *json) {
+    try {
+        ContentRuleList::parse(json);
+    } catch (const runtime_error &) {
+        return true;
+    }
+    printf("FAIL %s: parsed\n", name);
+    return false;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DomainArena.hpp"
+#include "HostKey.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks that the domain arena hands out one dense ID per distinct domain,
+ also when several threads intern overlapping lists at once.
+
+   DomainArenaTests
+ */
+
+static const size_t THREAD_COUNT = 4;
+static const size_t DOMAIN_COUNT = 50000;
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+    DomainArena arena;
+
+    uint32_t first = arena.intern("example.com");
+    failures += expect(first == 0, "first ID is 0") ? 0 : 1;
+    failures += expect(arena.intern("example.com") == first, "interning again returns the same ID") ? 0 : 1;
+    failures += expect(arena.intern("") == 1, "the empty domain gets an ID") ? 0 : 1;
+    string longDomain(100000, 'a');
+    uint32_t longID = arena.intern(longDomain);
+    failures += expect(arena.domain(longID) == longDomain, "domains longer than a chunk are kept") ? 0 : 1;
+
+    uint32_t id = 0;
+    failures += expect(!arena.find("missing.com", id), "missing domains are not found") ? 0 : 1;
+    HostKey key;
+    key.assign("www.example.com");
+    failures += expect(arena.find(key, 1, id) && id == first, "HostKey lookups find the suffix") ? 0 : 1;
+
+    // Every thread interns the same domains in a different order
+    vector<string> domains;
+    for (size_t i = 0; i < DOMAIN_COUNT; i++) {
+        domains.push_back("host" + to_string(i) + ".example.org");
+    }
+    vector<vector<uint32_t>> ids(THREAD_COUNT, vector<uint32_t>(DOMAIN_COUNT));
+    vector<thread> threads;
+    for (size_t t = 0; t < THREAD_COUNT; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < DOMAIN_COUNT; i++) {
+                size_t index = t % 2 == 0 ? i : DOMAIN_COUNT - 1 - i;
+                ids[t][index] = arena.intern(domains[index]);
+            }
+        });
+    }
+    for (thread &worker : threads) {
+        worker.join();
+    }
+
+    bool consistent = true;
+    for (size_t i = 0; i < DOMAIN_COUNT; i++) {
+        for (size_t t = 1; t < THREAD_COUNT; t++) {
+            consistent = consistent && ids[t][i] == ids[0][i];
+        }
+        consistent = consistent && arena.domain(ids[0][i]) == domains[i] && arena.find(domains[i], id) && id == ids[0][i];
+    }
+    failures += expect(consistent, "threads agree on every ID") ? 0 : 1;
+    failures += expect(arena.size() == DOMAIN_COUNT + 3, "IDs are dense") ? 0 : 1;
+
+    return reportFailures(failures);
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "BloomFilterBuilder.hpp"
+#include "BloomFilterFile.hpp"
+#include "BloomFilterMetrics.hpp"
+#include "HTTPSUpgradeEngine.hpp"
+#include "JSONReader.hpp"
+
+using namespace std;
+
+/*
+ Replays the shared privacy-reference-tests for HTTPS upgrades against the
+ native engine and reports how long each decision takes.
+
+   HTTPSUpgradeReferenceTests <https-upgrades directory> [--iterations N] [--platform NAME]
+
+ Exits 77, which CTest reports as skipped, when the reference files are not
+ checked out.
+ */
+
+static const int EXIT_SKIPPED = 77;
+static const size_t DEFAULT_ITERATIONS = 100;
+static const char DEFAULT_PLATFORM[] = "ios-browser";
+static const char HTTPS_FEATURE[] = "https";
+
+struct ReferenceCase {
+    string suite;
+    string name;
+    string requestURL;
+    string expectURL;
+};
+
+struct CaseResult {
+    bool passed;
+    string actualURL;
+    uint64_t coldNanoseconds;
+    uint64_t medianNanoseconds;
+};
+
+// Forward declarations
+
+static bool fileExists(const string &path);
+
+static vector<string> readDomainArray(const JSONValue *entries);
+
+static void configureEngine(HTTPSUpgradeEngine &engine, const string &directory);
+
+static vector<ReferenceCase> readCases(const string &path, const string &platform, size_t &skipped);
+
+static CaseResult replay(HTTPSUpgradeEngine &engine, const ReferenceCase &referenceCase, size_t iterations, LatencyHistogram &latency);
+
+static uint64_t now();
+
+
+// Implementation
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <https-upgrades directory> [--iterations N] [--platform NAME]\n", argv[0]);
+        return 2;
+    }
+
+    string directory = argv[1];
+    size_t iterations = DEFAULT_ITERATIONS;
+    string platform = DEFAULT_PLATFORM;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--iterations") {
+            iterations = max<size_t>(strtoull(argv[i + 1], nullptr, 10), 1);
+        } else if (option == "--platform") {
+            platform = argv[i + 1];
+        }
+    }
+
+    if (!fileExists(directory + "/tests.json")) {
+        printf("SKIP  reference tests not found in %s\n", directory.c_str());
+        return EXIT_SKIPPED;
+    }
+
+    try {
+        HTTPSUpgradeEngine engine(4096);
+        configureEngine(engine, directory);
+
+        size_t skipped = 0;
+        vector<ReferenceCase> cases = readCases(directory + "/tests.json", platform, skipped);
+
+        LatencyHistogram latency;
+        size_t failures = 0;
+        uint64_t start = now();
+        for (const auto &referenceCase : cases) {
+            CaseResult result = replay(engine, referenceCase, iterations, latency);
+            printf("%s  %s / %s  cold %llu ns, median %llu ns\n",
+                   result.passed ? "PASS" : "FAIL",
+                   referenceCase.suite.c_str(),
+                   referenceCase.name.c_str(),
+                   (unsigned long long) result.coldNanoseconds,
+                   (unsigned long long) result.medianNanoseconds);
+            if (!result.passed) {
+                printf("      %s\n      expected %s\n      got      %s\n",
+                       referenceCase.requestURL.c_str(), referenceCase.expectURL.c_str(), result.actualURL.c_str());
+                failures++;
+            }
+        }
+        double elapsed = (now() - start) / 1e9;
+
+        size_t decisions = cases.size() * iterations;
+        printf("\n%zu passed, %zu failed, %zu skipped\n", cases.size() - failures, failures, skipped);
+        printf("%zu decisions in %.3f s, %.0f decisions/s, p50 %llu ns, p99 %llu ns\n",
+               decisions,
+               elapsed,
+               elapsed > 0 ? decisions / elapsed : 0.0,
+               (unsigned long long) latency.valueAtPercentile(50),
+               (unsigned long long) latency.valueAtPercentile(99));
+        return failures == 0 ? 0 : 1;
+    } catch (const exception &error) {
+        fprintf(stderr, "FAIL  %s\n", error.what());
+        return 1;
+    }
+}
+
+static bool fileExists(const string &path) {
+    return ifstream(path).good();
+}
+
+static vector<string> readDomainArray(const JSONValue *entries) {
+    vector<string> domains;
+    if (entries == nullptr || !entries->isArray()) {
+        return domains;
+    }
+    for (const auto &entry : entries->asArray()) {
+        const JSONValue *domain = entry.isString() ? &entry : entry.find("domain");
+        if (domain == nullptr || !domain->isString()) {
+            continue;
+        }
+        string lowercased = domain->asString();
+        transform(lowercased.begin(), lowercased.end(), lowercased.begin(), [](unsigned char c) { return (char) tolower(c); });
+        if (lowercased.find_first_not_of(" \t") != string::npos) {
+            domains.push_back(lowercased);
+        }
+    }
+    return domains;
+}
+
+static void configureEngine(HTTPSUpgradeEngine &engine, const string &directory) {
+    JSONValue spec = JSONReader::parseFile(directory + "/https_bloomfilter_spec_reference.json");
+    auto file = BloomFilterFile::readLegacy(directory + "/https_bloomfilter_reference.bin",
+                                            (size_t) spec.at("bitCount").asNumber(),
+                                            (size_t) spec.at("totalEntries").asNumber());
+    BloomFilterBuilder builder(file.makeFilter());
+    auto filter = make_shared<const FrozenBloomFilter>(builder.freeze());
+
+    JSONValue allowlist = JSONReader::parseFile(directory + "/https_allowlist_reference.json");
+    engine.setUpgradeList(filter, readDomainArray(allowlist.find("data")));
+
+    JSONValue config = JSONReader::parseFile(directory + "/config_reference.json");
+    bool enabled = false;
+    vector<string> exceptions = readDomainArray(config.find("unprotectedTemporary"));
+    const JSONValue *features = config.find("features");
+    const JSONValue *feature = features == nullptr ? nullptr : features->find(HTTPS_FEATURE);
+    if (feature != nullptr) {
+        const JSONValue *state = feature->find("state");
+        enabled = state != nullptr && state->isString() && state->asString() == "enabled";
+        vector<string> featureExceptions = readDomainArray(feature->find("exceptions"));
+        exceptions.insert(exceptions.end(), featureExceptions.begin(), featureExceptions.end());
+    }
+    engine.setFeatureState(enabled, exceptions, {});
+}
+
+static vector<ReferenceCase> readCases(const string &path, const string &platform, size_t &skipped) {
+    JSONValue tests = JSONReader::parseFile(path);
+    vector<ReferenceCase> cases;
+    skipped = 0;
+
+    for (const char *suite : { "navigations", "subrequests" }) {
+        const JSONValue *group = tests.find(suite);
+        if (group == nullptr) {
+            continue;
+        }
+        for (const auto &test : group->at("tests").asArray()) {
+            bool excluded = false;
+            if (const JSONValue *exceptPlatforms = test.find("exceptPlatforms")) {
+                for (const auto &excludedPlatform : exceptPlatforms->asArray()) {
+                    excluded = excluded || excludedPlatform.asString() == platform;
+                }
+            }
+            if (excluded) {
+                skipped++;
+                continue;
+            }
+            cases.push_back(ReferenceCase {
+                suite,
+                test.at("name").asString(),
+                test.at("requestURL").asString(),
+                test.at("expectURL").asString()
+            });
+        }
+    }
+    return cases;
+}
+
+static CaseResult replay(HTTPSUpgradeEngine &engine, const ReferenceCase &referenceCase, size_t iterations, LatencyHistogram &latency) {
+    const string &url = referenceCase.requestURL;
+    vector<char> output(url.size() + 2);
+    vector<uint64_t> samples;
+    samples.reserve(iterations);
+
+    HTTPSUpgradeVerdict verdict = HTTPSUpgradeVerdict::notHTTP;
+    size_t outputLength = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = now();
+        verdict = engine.decide(url.data(), url.size(), output.data(), output.size(), outputLength);
+        uint64_t elapsed = now() - start;
+        samples.push_back(elapsed);
+        latency.counts[LatencyHistogram::bucketIndex(elapsed)]++;
+    }
+
+    CaseResult result;
+    result.actualURL = verdict == HTTPSUpgradeVerdict::upgrade ? string(output.data(), outputLength) : url;
+    result.passed = result.actualURL == referenceCase.expectURL;
+    result.coldNanoseconds = samples.front();
+    nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    result.medianNanoseconds = samples[samples.size() / 2];
+    return result;
+}
+
+static uint64_t now() {
+    return BloomFilterMetrics::now();
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "HostDecisionCache.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks hits and misses, that invalidation retires stored verdicts and drops
+ ones computed before it, two-way eviction, and that counters from several
+ threads all reach stats().
+
+   HostDecisionCacheTests
+ */
+
+static const size_t THREAD_COUNT = 8;
+static const size_t LOOKUPS_PER_THREAD = 10000;
+
+// Hashes that share the only bucket of a two slot cache. The tags differ in
+// their high bits, and bit 26 picks the way a third host evicts.
+static const uint64_t FIRST_HOST = 1ull << 40;
+static const uint64_t SECOND_HOST = 2ull << 40;
+static const uint64_t THIRD_HOST = (3ull << 40) | (1ull << 26);
+
+// Forward declarations
+
+static bool isCached(HostDecisionCache &cache, uint64_t hostHash, bool expectedVerdict);
+
+static void lookUpHosts(HostDecisionCache *cache, size_t threadIndex);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+
+    failures += expect(HostDecisionCache(1).getCapacity() == 2 && HostDecisionCache(100).getCapacity() == 128, "capacity") ? 0 : 1;
+
+    HostDecisionCache cache(2);
+    bool verdict;
+    HostDecisionCache::Generation generation;
+    failures += expect(!cache.lookup(FIRST_HOST, verdict, generation), "miss") ? 0 : 1;
+    cache.store(FIRST_HOST, true, generation);
+    cache.store(SECOND_HOST, false, generation);
+    failures += expect(isCached(cache, FIRST_HOST, true) && isCached(cache, SECOND_HOST, false), "hits") ? 0 : 1;
+
+    // Storing a host again replaces its verdict in place
+    cache.store(SECOND_HOST, true, generation);
+    failures += expect(isCached(cache, FIRST_HOST, true) && isCached(cache, SECOND_HOST, true), "replace") ? 0 : 1;
+
+    cache.store(THIRD_HOST, false, generation);
+    failures += expect(isCached(cache, FIRST_HOST, true) && isCached(cache, THIRD_HOST, false)
+                       && !cache.lookup(SECOND_HOST, verdict, generation), "two way eviction") ? 0 : 1;
+
+    HostDecisionCacheStats stats = cache.stats();
+    failures += expect(stats.hits == 6 && stats.misses == 2 && stats.invalidations == 0, "stats") ? 0 : 1;
+
+    // A verdict computed before invalidate() is dropped, one computed after is kept
+    HostDecisionCache::Generation before;
+    cache.lookup(SECOND_HOST, verdict, before);
+    cache.invalidate();
+    failures += expect(!cache.lookup(FIRST_HOST, verdict, generation) && !cache.lookup(THIRD_HOST, verdict, generation), "invalidated") ? 0 : 1;
+    cache.store(SECOND_HOST, true, before);
+    failures += expect(!cache.lookup(SECOND_HOST, verdict, generation), "stale store dropped") ? 0 : 1;
+    cache.store(SECOND_HOST, false, generation);
+    failures += expect(isCached(cache, SECOND_HOST, false) && cache.stats().invalidations == 1, "store after invalidation") ? 0 : 1;
+
+    HostDecisionCache shared(1024);
+    vector<thread> threads;
+    for (size_t t = 0; t < THREAD_COUNT; t++) {
+        threads.emplace_back(lookUpHosts, &shared, t);
+    }
+    for (thread &worker : threads) {
+        worker.join();
+    }
+    stats = shared.stats();
+    failures += expect(stats.hits + stats.misses == THREAD_COUNT * LOOKUPS_PER_THREAD, "counted across threads") ? 0 : 1;
+    failures += expect(stats.misses >= 64 && stats.hitRatio() > 0.9, "hit ratio") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static bool isCached(HostDecisionCache &cache, uint64_t hostHash, bool expectedVerdict) {
+    bool verdict;
+    HostDecisionCache::Generation generation;
+    return cache.lookup(hostHash, verdict, generation) && verdict == expectedVerdict;
+}
+
+static void lookUpHosts(HostDecisionCache *cache, size_t threadIndex) {
+    // 64 hosts spread over distinct buckets, shared by every thread
+    for (size_t i = 0; i < LOOKUPS_PER_THREAD; i++) {
+        uint64_t host = (i + threadIndex) % 64;
+        uint64_t hostHash = host * 2 | ((host + 1) << 40);
+        bool verdict;
+        HostDecisionCache::Generation generation;
+        if (!cache->lookup(hostHash, verdict, generation)) {
+            cache->store(hostHash, hostHash % 3 == 0, generation);
+        }
+    }
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "BloomFilter.hpp"
+#include "Hash64.hpp"
+#include "HostKey.hpp"
+#include "PerfectDomainSet.hpp"
+#include "RibbonDomainMap.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks host canonicalization and that lookups through a HostKey agree with
+ the same lookups by string.
+
+   HostKeyTests
+ */
+
+struct TestCase {
+    const char *name;
+    string host;
+    bool stripWWW;
+    // Empty when the host is rejected
+    const char *expectedHost;
+    size_t expectedLabels;
+};
+
+// Forward declarations
+
+static bool check(const TestCase &testCase);
+
+static bool checkLookups(const vector<string> &listed, const vector<string> &hosts);
+
+
+// Implementation
+
+int main() {
+    string longest;
+    while (longest.size() + 2 <= HostKey::MAX_LENGTH) {
+        longest += "a.";
+    }
+    longest += "b";
+
+    const TestCase cases[] = {
+        { "lowercases", "WWW.Example.COM", false, "www.example.com", 3 },
+        { "strips a trailing dot", "example.com.", false, "example.com", 2 },
+        { "strips www", "www.example.com", true, "example.com", 2 },
+        { "keeps www without stripWWW", "www.example.com", false, "www.example.com", 3 },
+        { "keeps a lone www label", "www", true, "www", 1 },
+        { "allows digits, '-', '_' and ':'", "a-1_b.2:3", false, "a-1_b.2:3", 2 },
+        { "longest host", longest, false, longest.c_str(), HostKey::MAX_LABELS },
+        { "longest host with a trailing dot", longest + ".", false, longest.c_str(), HostKey::MAX_LABELS },
+        { "rejects an empty host", "", false, "", 0 },
+        { "rejects a lone dot", ".", false, "", 0 },
+        { "rejects a leading dot", ".example.com", false, "", 0 },
+        { "rejects empty labels", "example..com", false, "", 0 },
+        { "rejects spaces", "exa mple.com", false, "", 0 },
+        { "rejects a slash", "example.com/", false, "", 0 },
+        { "rejects non-ASCII", "b\xc3\xbc" "cher.de", false, "", 0 },
+        { "rejects hosts over the limit", longest + "c", false, "", 0 },
+    };
+
+    size_t failures = 0;
+    for (const TestCase &testCase : cases) {
+        failures += check(testCase) ? 0 : 1;
+    }
+
+    vector<string> listed = { "example.com", "sub.example.org", "tracker.net", "a.b.c.d" };
+    vector<string> hosts = { "example.com", "www.example.com", "sub.example.org", "example.org", "x.tracker.net",
+                             "a.b.c.d", "b.c.d", "unrelated.com", "com" };
+    failures += checkLookups(listed, hosts) ? 0 : 1;
+
+    return reportFailures(failures, size(cases) + 1);
+}
+
+static bool check(const TestCase &testCase) {
+    HostKey key;
+    bool assigned = key.assign(testCase.host, testCase.stripWWW);
+    string_view expectedHost(testCase.expectedHost);
+    if (assigned != !expectedHost.empty() || key.host() != expectedHost || key.labelCount() != testCase.expectedLabels) {
+        printf("FAIL %s: %s, \"%.*s\", %zu labels\n", testCase.name, assigned ? "assigned" : "rejected",
+               (int) key.host().size(), key.host().data(), key.labelCount());
+        return false;
+    }
+
+    // Every suffix starts after a dot and hashes as the string would
+    for (size_t label = 0; label < key.labelCount(); label++) {
+        string_view suffix = key.suffix(label);
+        bool startsAtLabel = label == 0 ? suffix == key.host() : key.host()[key.host().size() - suffix.size() - 1] == '.';
+        if (!startsAtLabel || key.hash(label) != hash64(suffix.data(), suffix.size())) {
+            printf("FAIL %s: suffix %zu \"%.*s\"\n", testCase.name, label, (int) suffix.size(), suffix.data());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkLookups(const vector<string> &listed, const vector<string> &hosts) {
+    BloomFilter filter(listed.size(), 0.001);
+    vector<pair<string_view, uint32_t>> entries;
+    for (size_t i = 0; i < listed.size(); i++) {
+        filter.add(listed[i]);
+        entries.emplace_back(listed[i], (uint32_t) i);
+    }
+    PerfectDomainSet set = PerfectDomainSet::build(listed);
+    RibbonDomainMap map = RibbonDomainMap::build(entries);
+
+    bool passed = true;
+    for (const string &host : hosts) {
+        HostKey key;
+        key.assign(host);
+        if (filter.contains(key) != filter.contains(host) || filter.containsAnySuffix(key) != filter.containsAnySuffix(host)) {
+            printf("FAIL BloomFilter disagrees on %s\n", host.c_str());
+            passed = false;
+        }
+        for (size_t label = 0; label < key.labelCount(); label++) {
+            uint32_t keyID = 0;
+            uint32_t stringID = 0;
+            bool keyFound = map.find(key, label, keyID);
+            bool stringFound = map.find(key.suffix(label), stringID);
+            if (set.contains(key, label) != set.contains(key.suffix(label)) || keyFound != stringFound || keyID != stringID) {
+                printf("FAIL exact lookups disagree on suffix %zu of %s\n", label, host.c_str());
+                passed = false;
+            }
+        }
+    }
+    return passed;
+}
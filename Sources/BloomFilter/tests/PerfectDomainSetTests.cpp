@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "HostKey.hpp"
+#include "PerfectDomainSet.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks that a perfect domain set, with and without its strings, finds every
+ member and nothing else, answers HostKey lookups like string ones, survives
+ a round trip through a file and rejects corrupted or version 1 data.
+
+   PerfectDomainSetTests
+ */
+
+static const size_t DOMAIN_COUNT = 20000;
+static const size_t VERSION_OFFSET = 8;
+static const size_t KEY_COUNT_OFFSET = 24;
+
+// Forward declarations
+
+static string domain(size_t index);
+
+static bool containsExactly(const PerfectDomainSet &set, const vector<string> &domains);
+
+static bool rejects(vector<char> data);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+
+    vector<string> domains;
+    for (size_t i = 0; i < DOMAIN_COUNT; i++) {
+        domains.push_back(domain(i));
+    }
+    // Duplicates collapse into one member
+    vector<string> withDuplicates = domains;
+    withDuplicates.push_back(domain(3));
+    withDuplicates.push_back(domain(DOMAIN_COUNT - 1));
+
+    for (bool keepStrings : { true, false }) {
+        PerfectDomainSet set = PerfectDomainSet::build(withDuplicates, keepStrings);
+        failures += expect(set.size() == DOMAIN_COUNT && set.hasStrings() == keepStrings, "size") ? 0 : 1;
+        failures += expect(containsExactly(set, domains), keepStrings ? "members with strings" : "members without strings") ? 0 : 1;
+    }
+
+    PerfectDomainSet empty = PerfectDomainSet::build(vector<string>());
+    failures += expect(empty.size() == 0 && !empty.contains(domain(0)) && !empty.contains(""), "empty") ? 0 : 1;
+
+    PerfectDomainSet set = PerfectDomainSet::build(domains);
+    HostKey key;
+    key.assign("WWW." + domain(42));
+    failures += expect(!set.contains(key) && set.contains(key, 1) && !set.contains(key, 2), "host key labels") ? 0 : 1;
+
+    uint32_t version;
+    memcpy(&version, set.data() + VERSION_OFFSET, sizeof(version));
+    failures += expect(version == 2 && version == PerfectDomainSet::CURRENT_VERSION, "version 2") ? 0 : 1;
+
+    PerfectDomainSet copied(vector<char>(set.data(), set.data() + set.dataLength()));
+    failures += expect(containsExactly(copied, domains), "round trip") ? 0 : 1;
+
+    const char *path = "PerfectDomainSetTests.set";
+    set.writeToFile(path);
+    bool mapped = false;
+    try {
+        mapped = containsExactly(PerfectDomainSet::mapFile(path), domains);
+    } catch (const runtime_error &) {
+    }
+    remove(path);
+    failures += expect(mapped, "mapped file") ? 0 : 1;
+
+    vector<char> data(set.data(), set.data() + set.dataLength());
+    failures += expect(rejects(vector<char>()), "no data") ? 0 : 1;
+    failures += expect(rejects(vector<char>(data.begin(), data.end() - 1)), "truncated") ? 0 : 1;
+    vector<char> corrupted = data;
+    corrupted[0] ^= 1;
+    failures += expect(rejects(corrupted), "bad magic") ? 0 : 1;
+    corrupted = data;
+    uint32_t previousVersion = 1;
+    memcpy(corrupted.data() + VERSION_OFFSET, &previousVersion, sizeof(previousVersion));
+    failures += expect(rejects(corrupted), "version 1") ? 0 : 1;
+    corrupted = data;
+    corrupted[KEY_COUNT_OFFSET] ^= 1;
+    failures += expect(rejects(corrupted), "key count") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static string domain(size_t index) {
+    return "site" + to_string(index) + ".example";
+}
+
+static bool containsExactly(const PerfectDomainSet &set, const vector<string> &domains) {
+    for (const string &member : domains) {
+        if (!set.contains(member)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < domains.size(); i++) {
+        if (set.contains("absent" + to_string(i) + ".example") || set.contains("www." + domains[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool rejects(vector<char> data) {
+    try {
+        PerfectDomainSet set(move(data));
+    } catch (const runtime_error &) {
+        return true;
+    }
+    return false;
+}
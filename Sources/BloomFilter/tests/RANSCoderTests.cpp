@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "BloomFilter.hpp"
+#include "BloomFilterFile.hpp"
+#include "RANSCoder.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks that coded payloads survive a round trip however the input is split,
+ that corrupt or truncated ones are rejected and that compressed containers
+ load to the same filter as plain ones, parsed or streamed. Headers claiming
+ more payload than follows are rejected before anything is sized from them.
+
+   RANSCoderTests
+ */
+
+// Hands out the bytes of a string but can't seek, like a pipe
+class PipeBuffer : public basic_streambuf<char> {
+
+public:
+    explicit PipeBuffer(string bytes) : bytes(move(bytes)) {
+        setg(this->bytes.data(), this->bytes.data(), this->bytes.data() + this->bytes.size());
+    }
+
+private:
+    string bytes;
+};
+
+// Forward declarations
+
+static bool streamRejects(const string &container, bool seekable);
+
+static string withHeader(const BloomFilterFileHeader &header, const string &payload);
+
+static bool roundTrips(const vector<char> &data, size_t chunkSize);
+
+static bool rejects(const vector<char> &encoded, size_t outputLength);
+
+static vector<char> randomBytes(size_t length, double fill, mt19937_64 &random);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+    mt19937_64 random(7);
+
+    for (size_t length : { 0, 1, 3, 4, 5, 4097, 100000 }) {
+        for (size_t chunkSize : { 1, 3, 64, 1 << 20 }) {
+            failures += expect(roundTrips(randomBytes(length, 0.5, random), chunkSize), "uniform bytes") ? 0 : 1;
+            failures += expect(roundTrips(randomBytes(length, 0.05, random), chunkSize), "sparse bits") ? 0 : 1;
+            failures += expect(roundTrips(vector<char>(length, 'a'), chunkSize), "a single symbol") ? 0 : 1;
+        }
+    }
+
+    // Sparse filters code close to the entropy of their fill
+    vector<char> sparse = randomBytes(1 << 20, 0.05, random);
+    failures += expect(RANSCoder::encode(sparse.data(), sparse.size()).size() < sparse.size() * 0.3, "sparse bits shrink") ? 0 : 1;
+
+    vector<char> encoded = RANSCoder::encode(sparse.data(), 4096);
+    failures += expect(rejects(vector<char>(encoded.begin(), encoded.end() - 1), 4096), "truncated stream") ? 0 : 1;
+    vector<char> longer = encoded;
+    longer.push_back(0);
+    failures += expect(rejects(longer, 4096), "trailing input") ? 0 : 1;
+    vector<char> badFrequencies = encoded;
+    badFrequencies[8] ^= 1;
+    failures += expect(rejects(badFrequencies, 4096), "frequencies not summing to 4096") ? 0 : 1;
+
+    // A compressed container parses and streams to the same filter as a plain one
+    BloomFilter filter(20000, 0.0001);
+    for (size_t i = 0; i < 5000; i++) {
+        filter.add("domain" + to_string(i) + ".example");
+    }
+    BloomFilterFile file = BloomFilterFile::fromFilter(filter, 20000);
+    const char *path = "RANSCoderTests.bloom";
+    file.write(path, BloomFilterFileFormat::compressed);
+
+    BloomFilterFile compressed = BloomFilterFile::readContainer(path);
+    failures += expect(compressed.format == BloomFilterFileFormat::compressed && compressed.header.isPayloadCoded()
+                       && compressed.header.version == BloomFilterFileHeader::CURRENT_VERSION, "compressed header") ? 0 : 1;
+    failures += expect(compressed.payload == file.payload && compressed.header.payloadLength < file.payload.size(), "compressed payload") ? 0 : 1;
+    failures += expect(compressed.takeFilter().contains("domain42.example"), "compressed filter") ? 0 : 1;
+
+    vector<char> contents;
+    {
+        ifstream in(path, ifstream::binary);
+        contents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    failures += expect(BloomFilterFile::parseContainer(contents.data(), contents.size()).payload == file.payload, "parsed in memory") ? 0 : 1;
+
+    // Streams that can't be measured up front load the same
+    PipeBuffer pipe(string(contents.data(), contents.size()));
+    BinaryInputStream piped(&pipe);
+    failures += expect(BloomFilterFile::readContainer(piped).payload == file.payload, "compressed from a pipe") ? 0 : 1;
+
+    // Headers whose lengths the data doesn't back: a plain terabyte, a gigabyte
+    // coded into a few hundred bytes, and a plain payload cut short
+    string stored(contents.begin() + BloomFilterFileHeader::ENCODED_SIZE, contents.end());
+    BloomFilterFileHeader huge = compressed.header;
+    huge.version = BloomFilterFileHeader::PLAIN_VERSION;
+    huge.flags = 0;
+    huge.payloadLength = 1ull << 40;
+    failures += expect(streamRejects(withHeader(huge, stored), true) && streamRejects(withHeader(huge, stored), false), "terabyte plain payload") ? 0 : 1;
+    BloomFilterFileHeader expanding = compressed.header;
+    expanding.bitCount = BloomFilterFileHeader::MAX_DECODED_PAYLOAD_LENGTH * 8;
+    expanding.hashRounds = (uint32_t) BloomFilter::hashRoundsFor(expanding.bitCount, expanding.maxItems);
+    expanding.payloadLength = RANSCoder::PREFIX_LENGTH + 64;
+    failures += expect(streamRejects(withHeader(expanding, string(expanding.payloadLength, '\0')), true), "gigabyte coded payload") ? 0 : 1;
+    BloomFilterFileHeader shortened = file.header;
+    failures += expect(streamRejects(withHeader(shortened, string(file.payload.begin(), file.payload.end() - 1)), false)
+                       && streamRejects(withHeader(shortened, string(file.payload.begin(), file.payload.end() - 1)), true), "truncated plain payload") ? 0 : 1;
+    PipeBuffer plainPipe(withHeader(shortened, string(file.payload.begin(), file.payload.end())));
+    BinaryInputStream plainPiped(&plainPipe);
+    failures += expect(BloomFilterFile::readContainer(plainPiped).payload == file.payload, "plain from a pipe") ? 0 : 1;
+
+    // A large empty filter codes to almost nothing, more than readers accept
+    BloomFilterFile empty = BloomFilterFile::fromFilter(BloomFilter(10000000, 0.0001), 10000000);
+    bool refused = false;
+    try {
+        empty.write(path, BloomFilterFileFormat::compressed);
+    } catch (const runtime_error &) {
+        refused = true;
+    }
+    failures += expect(refused, "ratio refused on write") ? 0 : 1;
+
+    // Rewritten plain, the container is version 1 again
+    compressed = BloomFilterFile::readContainer(path);
+    compressed.write(path, BloomFilterFileFormat::container);
+    BloomFilterFile plain = BloomFilterFile::readContainer(path);
+    failures += expect(plain.format == BloomFilterFileFormat::container && plain.header.version == BloomFilterFileHeader::PLAIN_VERSION
+                       && plain.header.flags == 0 && plain.payload == file.payload, "rewritten plain") ? 0 : 1;
+    remove(path);
+
+    contents[BloomFilterFileHeader::ENCODED_SIZE + RANSCoder::PREFIX_LENGTH + 10] ^= 0x10;
+    bool rejected = false;
+    try {
+        istringstream in(string(contents.data(), contents.size()));
+        BloomFilterFile::readContainer(in);
+    } catch (const runtime_error &) {
+        rejected = true;
+    }
+    failures += expect(rejected, "corrupt coded payload") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static bool streamRejects(const string &container, bool seekable) {
+    try {
+        if (seekable) {
+            istringstream in(container);
+            BloomFilterFile::readContainer(in);
+        } else {
+            PipeBuffer pipe(container);
+            BinaryInputStream in(&pipe);
+            BloomFilterFile::readContainer(in);
+        }
+        return false;
+    } catch (const runtime_error &) {
+        return true;
+    }
+}
+
+static string withHeader(const BloomFilterFileHeader &header, const string &payload) {
+    char encoded[BloomFilterFileHeader::ENCODED_SIZE];
+    header.encode(encoded);
+    return string(encoded, sizeof(encoded)) + payload;
+}
+
+static bool roundTrips(const vector<char> &data, size_t chunkSize) {
+    vector<char> encoded = RANSCoder::encode(data.data(), data.size());
+    if (RANSCoder::decodedLength(encoded.data()) != data.size()) {
+        return false;
+    }
+    vector<char> output(data.size());
+    RANSDecoder decoder(encoded.data(), output.data(), output.size());
+    size_t offset = RANSCoder::PREFIX_LENGTH;
+    do {
+        size_t length = min(chunkSize, encoded.size() - offset);
+        decoder.decode(encoded.data() + offset, length);
+        offset += length;
+    } while (offset < encoded.size());
+    return decoder.isComplete() && output == data;
+}
+
+static bool rejects(const vector<char> &encoded, size_t outputLength) {
+    vector<char> output(outputLength);
+    try {
+        RANSDecoder decoder(encoded.data(), output.data(), output.size());
+        decoder.decode(encoded.data() + RANSCoder::PREFIX_LENGTH, encoded.size() - RANSCoder::PREFIX_LENGTH);
+        return !decoder.isComplete();
+    } catch (const runtime_error &) {
+        return true;
+    }
+}
+
+static vector<char> randomBytes(size_t length, double fill, mt19937_64 &random) {
+    bernoulli_distribution bit(fill);
+    vector<char> bytes(length);
+    for (auto &byte : bytes) {
+        unsigned int value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= (unsigned int) bit(random) << i;
+        }
+        byte = (char) value;
+    }
+    return bytes;
+}
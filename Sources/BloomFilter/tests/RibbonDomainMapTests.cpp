@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "HostKey.hpp"
+#include "RibbonDomainMap.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks that a ribbon map gives every known domain its ID, gives unknown
+ ones a false hit no more often than its fingerprint allows, finds parent
+ domains, survives a round trip through a file and rejects corrupted or
+ version 1 data.
+
+   RibbonDomainMapTests
+ */
+
+static const size_t DOMAIN_COUNT = 20000;
+static const uint32_t ENTITY_COUNT = 700;
+static const size_t VERSION_OFFSET = 8;
+static const size_t FINGERPRINT_BITS_OFFSET = 16;
+
+// Forward declarations
+
+static string domain(size_t index);
+
+static uint32_t entityOf(size_t index);
+
+static bool findsAll(const RibbonDomainMap &map);
+
+static double falseHitRate(const RibbonDomainMap &map);
+
+static bool rejects(vector<char> data);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+
+    vector<string> domains;
+    for (size_t i = 0; i < DOMAIN_COUNT; i++) {
+        domains.push_back(domain(i));
+    }
+    vector<pair<string_view, uint32_t>> entries;
+    for (size_t i = 0; i < DOMAIN_COUNT; i++) {
+        entries.emplace_back(domains[i], entityOf(i));
+    }
+    // The same domain with the same ID again is fine
+    entries.emplace_back(domains[5], entityOf(5));
+
+    for (uint32_t fingerprintBits : { 0u, 8u, 16u }) {
+        RibbonDomainMap map = RibbonDomainMap::build(entries, fingerprintBits);
+        failures += expect(map.size() == DOMAIN_COUNT && map.getFingerprintBits() == fingerprintBits, "size") ? 0 : 1;
+        failures += expect(findsAll(map), "known domains") ? 0 : 1;
+        if (fingerprintBits > 0) {
+            double rate = falseHitRate(map);
+            failures += expect(rate <= 2.0 / (1u << fingerprintBits), "false hits") ? 0 : 1;
+        }
+    }
+
+    RibbonDomainMap map = RibbonDomainMap::build(entries, 16);
+    uint32_t id = 0;
+    string host = "cdn.static." + domains[77];
+    string_view found = map.findAnySuffix(host, id);
+    failures += expect(found == domains[77] && id == entityOf(77), "parent domain") ? 0 : 1;
+    HostKey key;
+    key.assign("CDN.Static." + domains[77]);
+    id = 0;
+    found = map.findAnySuffix(key, id);
+    failures += expect(found == domains[77] && id == entityOf(77), "host key parent") ? 0 : 1;
+    failures += expect(map.find(key, 2, id) && id == entityOf(77), "host key label") ? 0 : 1;
+
+    bool conflicting = false;
+    try {
+        entries.emplace_back(domains[6], entityOf(6) + 1);
+        RibbonDomainMap::build(entries);
+    } catch (const runtime_error &) {
+        conflicting = true;
+    }
+    failures += expect(conflicting, "conflicting IDs") ? 0 : 1;
+
+    uint32_t version;
+    memcpy(&version, map.data() + VERSION_OFFSET, sizeof(version));
+    failures += expect(version == 2 && version == RibbonDomainMap::CURRENT_VERSION, "version 2") ? 0 : 1;
+
+    RibbonDomainMap copied(vector<char>(map.data(), map.data() + map.dataLength()));
+    failures += expect(findsAll(copied), "round trip") ? 0 : 1;
+
+    const char *path = "RibbonDomainMapTests.map";
+    map.writeToFile(path);
+    bool mapped = false;
+    try {
+        mapped = findsAll(RibbonDomainMap::mapFile(path));
+    } catch (const runtime_error &) {
+    }
+    remove(path);
+    failures += expect(mapped, "mapped file") ? 0 : 1;
+
+    vector<char> data(map.data(), map.data() + map.dataLength());
+    failures += expect(rejects(vector<char>()), "no data") ? 0 : 1;
+    failures += expect(rejects(vector<char>(data.begin(), data.end() - 1)), "truncated") ? 0 : 1;
+    vector<char> corrupted = data;
+    corrupted[0] ^= 1;
+    failures += expect(rejects(corrupted), "bad magic") ? 0 : 1;
+    corrupted = data;
+    uint32_t previousVersion = 1;
+    memcpy(corrupted.data() + VERSION_OFFSET, &previousVersion, sizeof(previousVersion));
+    failures += expect(rejects(corrupted), "version 1") ? 0 : 1;
+    corrupted = data;
+    uint32_t tooManyBits = RibbonDomainMap::MAX_FINGERPRINT_BITS + 1;
+    memcpy(corrupted.data() + FINGERPRINT_BITS_OFFSET, &tooManyBits, sizeof(tooManyBits));
+    failures += expect(rejects(corrupted), "fingerprint bits") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static string domain(size_t index) {
+    return "tracker" + to_string(index) + ".example";
+}
+
+// Many domains per entity, like the tracker data
+static uint32_t entityOf(size_t index) {
+    return (uint32_t) (index * 7919 % ENTITY_COUNT);
+}
+
+static bool findsAll(const RibbonDomainMap &map) {
+    for (size_t i = 0; i < DOMAIN_COUNT; i++) {
+        uint32_t id;
+        if (!map.find(domain(i), id) || id != entityOf(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static double falseHitRate(const RibbonDomainMap &map) {
+    size_t hits = 0;
+    const size_t probes = 100000;
+    for (size_t i = 0; i < probes; i++) {
+        uint32_t id;
+        hits += map.find("absent" + to_string(i) + ".example", id) ? 1 : 0;
+    }
+    return (double) hits / probes;
+}
+
+static bool rejects(vector<char> data) {
+    try {
+        RibbonDomainMap map(move(data));
+    } catch (const runtime_error &) {
+        return true;
+    }
+    return false;
+}
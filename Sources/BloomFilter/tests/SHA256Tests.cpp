@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "BloomFilter.hpp"
+#include "BloomFilterFile.hpp"
+#include "SHA256.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks SHA-256 against published vectors with every implementation the CPU
+ runs, across block boundaries, and that filter loads reject data whose
+ digest they verify on the way in. The implementations that aren't
+ available must refuse to be forced.
+
+   SHA256Tests
+ */
+
+// Forward declarations
+
+static string hashWith(SHA256::Implementation implementation, const void *data, size_t length);
+
+static bool rejectsLegacy(const char *path, size_t bitCount, size_t maxItems, const SHA256::Digest &expected);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+    printf("implementation %s\n", SHA256::implementationName());
+
+    string twoBlocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    string million(1000000, 'a');
+    // Uneven updates go through the buffer and the multi block path alike
+    vector<char> data(10000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (char) (i * 131 + (i >> 7));
+    }
+    SHA256::Digest whole = SHA256::hash(data.data(), data.size());
+
+    const auto &available = SHA256::availableImplementations();
+    for (auto implementation : available) {
+        printf("checking %s\n", SHA256::implementationName(implementation));
+        failures += expect(hashWith(implementation, "", 0) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", "empty") ? 0 : 1;
+        failures += expect(hashWith(implementation, "abc", 3) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", "abc") ? 0 : 1;
+        failures += expect(hashWith(implementation, twoBlocks.data(), twoBlocks.size())
+                           == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", "448 bits") ? 0 : 1;
+        failures += expect(hashWith(implementation, million.data(), million.size())
+                           == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0", "a million a") ? 0 : 1;
+
+        for (size_t step : { 1, 7, 63, 64, 65, 200, 4096 }) {
+            SHA256 hasher(implementation);
+            for (size_t offset = 0; offset < data.size(); offset += step) {
+                hasher.update(data.data() + offset, min(step, data.size() - offset));
+            }
+            failures += expect(hasher.finish() == whole, "split updates") ? 0 : 1;
+        }
+    }
+    failures += expect(available.front() == SHA256::Implementation::portable
+                       && SHA256::implementationName() == SHA256::implementationName(available.back()), "selection") ? 0 : 1;
+
+    for (auto implementation : { SHA256::Implementation::shaExtensions, SHA256::Implementation::armv8 }) {
+        if (find(available.begin(), available.end(), implementation) != available.end()) {
+            continue;
+        }
+        bool refused = false;
+        try {
+            SHA256 hasher(implementation);
+        } catch (const runtime_error &) {
+            refused = true;
+        }
+        failures += expect(refused, "unavailable implementation") ? 0 : 1;
+    }
+
+    SHA256::Digest parsed;
+    failures += expect(SHA256::fromHex(SHA256::toHex(whole), parsed) && parsed == whole, "hex round trip") ? 0 : 1;
+    failures += expect(SHA256::fromHex("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD", parsed)
+                       && parsed == SHA256::hash("abc", 3), "uppercase hex") ? 0 : 1;
+    failures += expect(!SHA256::fromHex("ba7816bf", parsed) && !SHA256::fromHex(string(64, 'g'), parsed), "invalid hex") ? 0 : 1;
+
+    // Loads hash what they read, so a wrong or damaged file is rejected without a second pass
+    BloomFilter filter(1000, 0.001);
+    filter.add("example.com");
+    BloomFilterFile file = BloomFilterFile::fromFilter(filter, 1000);
+    const char *path = "SHA256Tests.bloom";
+    file.write(path, BloomFilterFileFormat::legacy);
+    BloomFilterFile verified = BloomFilterFile::readLegacy(path, file.header.bitCount, 1000, file.header.payloadSHA256);
+    failures += expect(verified.header.payloadSHA256 == file.header.payloadSHA256 && verified.takeFilter().contains("example.com"), "verified legacy") ? 0 : 1;
+    SHA256::Digest wrong = file.header.payloadSHA256;
+    wrong[31] ^= 1;
+    failures += expect(rejectsLegacy(path, file.header.bitCount, 1000, wrong), "legacy mismatch") ? 0 : 1;
+
+    for (auto format : { BloomFilterFileFormat::container, BloomFilterFileFormat::compressed }) {
+        file.write(path, format);
+        {
+            // Damages the digest in the header, which both formats check the decoded payload against
+            fstream out(path, fstream::in | fstream::out | fstream::binary);
+            out.seekp(48);
+            out.put((char) (file.header.payloadSHA256[0] ^ 1));
+        }
+        bool rejected = false;
+        try {
+            BloomFilterFile::readContainer(path);
+        } catch (const runtime_error &) {
+            rejected = true;
+        }
+        failures += expect(rejected, "container mismatch") ? 0 : 1;
+    }
+    remove(path);
+
+    return reportFailures(failures);
+}
+
+static string hashWith(SHA256::Implementation implementation, const void *data, size_t length) {
+    SHA256 hasher(implementation);
+    hasher.update(data, length);
+    return SHA256::toHex(hasher.finish());
+}
+
+static bool rejectsLegacy(const char *path, size_t bitCount, size_t maxItems, const SHA256::Digest &expected) {
+    try {
+        BloomFilterFile::readLegacy(path, bitCount, maxItems, expected);
+        return false;
+    } catch (const runtime_error &) {
+        return true;
+    }
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "HostKey.hpp"
+#include "ScalableBloomFilter.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Checks that a scalable filter grows without false negatives, stays near its
+ error rate, forgets its oldest slices under a memory budget and survives a
+ round trip.
+
+   ScalableBloomFilterTests
+ */
+
+// Forward declarations
+
+static string domain(size_t index);
+
+static bool rejects(const string &encoded);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+    const double errorRate = 0.001;
+
+    ScalableBloomFilter filter(1000, errorRate);
+    failures += expect(filter.getSliceCount() == 0 && !filter.contains("a.example"), "empty") ? 0 : 1;
+    size_t added = 0;
+    for (size_t i = 0; i < 50000; i++) {
+        added += filter.add(domain(i)) ? 1 : 0;
+    }
+    failures += expect(filter.getSliceCount() == 6, "grows by doubling") ? 0 : 1;
+    // Keys that were already false positives aren't counted
+    failures += expect(filter.getItemCount() == added && added >= 50000 * (1 - errorRate), "item count") ? 0 : 1;
+    failures += expect(!filter.add(domain(7)) && filter.getItemCount() == added, "duplicate") ? 0 : 1;
+
+    bool containsAll = true;
+    for (size_t i = 0; i < 50000 && containsAll; i++) {
+        containsAll = filter.contains(domain(i));
+    }
+    failures += expect(containsAll, "no false negatives") ? 0 : 1;
+
+    HostKey key;
+    key.assign("Learned.Example");
+    filter.add(key);
+    failures += expect(filter.contains("learned.example") && filter.contains(key), "host keys") ? 0 : 1;
+
+    size_t falsePositives = 0;
+    for (size_t i = 0; i < 200000; i++) {
+        falsePositives += filter.contains("other" + to_string(i) + ".example") ? 1 : 0;
+    }
+    double measured = (double) falsePositives / 200000;
+    failures += expect(filter.falsePositiveRate() <= errorRate, "bound") ? 0 : 1;
+    failures += expect(measured <= 2 * errorRate, "measured rate") ? 0 : 1;
+
+    // Round trip, then a flipped bit anywhere is rejected
+    ostringstream out;
+    filter.writeToStream(out);
+    string encoded = out.str();
+    istringstream in(encoded);
+    ScalableBloomFilter restored = ScalableBloomFilter::readFromStream(in);
+    failures += expect(restored.getItemCount() == filter.getItemCount() && restored.getSliceCount() == filter.getSliceCount()
+                       && restored.contains(domain(49999)) && restored.contains(key), "round trip") ? 0 : 1;
+    string corrupt = encoded;
+    corrupt[corrupt.size() / 2] ^= 1;
+    failures += expect(rejects(corrupt), "corrupt") ? 0 : 1;
+    failures += expect(rejects(encoded.substr(0, encoded.size() - 1)), "truncated") ? 0 : 1;
+    failures += expect(rejects(""), "empty stream") ? 0 : 1;
+
+    // Compacting with room for everything keeps every slice
+    size_t itemCount = filter.getItemCount();
+    size_t sliceCount = filter.getSliceCount();
+    filter.compact(filter.byteCount());
+    containsAll = filter.getSliceCount() == sliceCount && filter.getItemCount() == itemCount && filter.contains(key);
+    for (size_t i = 0; i < 50000 && containsAll; i++) {
+        containsAll = filter.contains(domain(i));
+    }
+    failures += expect(containsAll, "compact") ? 0 : 1;
+
+    // A tight budget forgets the oldest slices and keeps the newest
+    size_t budget = filter.byteCount() * 3 / 4;
+    filter.compact(budget);
+    failures += expect(filter.byteCount() <= budget && filter.getSliceCount() < sliceCount
+                       && filter.getItemCount() < itemCount, "budget") ? 0 : 1;
+    failures += expect(filter.contains(key) && filter.contains(domain(49999)) && !filter.contains(domain(0)), "keeps newest") ? 0 : 1;
+    failures += expect(filter.falsePositiveRate() <= errorRate, "compacted bound") ? 0 : 1;
+
+    // The dropped slices' place in the chain survives a round trip
+    ostringstream compactedOut;
+    filter.writeToStream(compactedOut);
+    istringstream compactedIn(compactedOut.str());
+    ScalableBloomFilter compacted = ScalableBloomFilter::readFromStream(compactedIn);
+    failures += expect(compacted.getSliceCount() == filter.getSliceCount()
+                       && compacted.falsePositiveRate() == filter.falsePositiveRate(), "compacted round trip") ? 0 : 1;
+
+    // Nothing fits, so everything is forgotten
+    compacted.compact(0);
+    failures += expect(compacted.getSliceCount() == 0 && compacted.getItemCount() == 0 && !compacted.contains(key), "empty budget") ? 0 : 1;
+
+    // And grows again from there
+    sliceCount = filter.getSliceCount();
+    for (size_t i = 0; i < 40000; i++) {
+        filter.add("again" + to_string(i) + ".example");
+    }
+    failures += expect(filter.getSliceCount() > sliceCount && filter.contains("again0.example")
+                       && filter.falsePositiveRate() <= errorRate, "grows after compaction") ? 0 : 1;
+
+    bool rejected = false;
+    try {
+        ScalableBloomFilter(0, errorRate);
+    } catch (const runtime_error &) {
+        rejected = true;
+    }
+    failures += expect(rejected, "invalid parameters") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static string domain(size_t index) {
+    return "host" + to_string(index) + ".example";
+}
+
+static bool rejects(const string &encoded) {
+    istringstream in(encoded);
+    try {
+        ScalableBloomFilter::readFromStream(in);
+    } catch (const runtime_error &) {
+        return true;
+    }
+    return false;
+}
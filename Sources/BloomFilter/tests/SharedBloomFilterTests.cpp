@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include "BloomFilter.hpp"
+#include "BloomFilterView.hpp"
+#include "SharedBloomFilter.hpp"
+#include "TestSupport.hpp"
+
+using namespace std;
+
+/*
+ Publishes filters through shared memory and checks that readers answer like
+ the source filter, follow a republish, can't attach a retired generation and
+ keep a view alive after the reader and publisher are gone. Exits with 77
+ where shared memory is unavailable.
+
+   SharedBloomFilterTests
+ */
+
+static const int SKIPPED = 77;
+static const size_t MAX_ITEMS = 5000;
+
+// Forward declarations
+
+static unique_ptr<BloomFilter> makeFilter(const string &prefix);
+
+static bool answersLike(const BloomFilterView &view, BloomFilter &filter, const string &prefix);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+    string name = "/ddgbloomtest" + to_string(getpid());
+
+    bool missing = false;
+    try {
+        SharedBloomFilterReader reader(name);
+    } catch (const runtime_error &) {
+        missing = true;
+    }
+    failures += expect(missing, "nothing published") ? 0 : 1;
+
+    unique_ptr<SharedBloomFilterPublisher> publisher;
+    try {
+        publisher = make_unique<SharedBloomFilterPublisher>(name);
+    } catch (const runtime_error &error) {
+        printf("Skipping, %s\n", error.what());
+        return SKIPPED;
+    }
+    auto reader = make_unique<SharedBloomFilterReader>(name);
+    failures += expect(reader->current() == nullptr, "before publish") ? 0 : 1;
+
+    auto first = makeFilter("first");
+    uint64_t generation = publisher->publish(*first, MAX_ITEMS);
+    auto view = reader->current();
+    failures += expect(view != nullptr && view->getGeneration() == generation && generation == 1, "attach") ? 0 : 1;
+    failures += expect(view != nullptr && answersLike(*view, *first, "first"), "lookups") ? 0 : 1;
+    failures += expect(reader->current() == view, "same generation") ? 0 : 1;
+
+    auto second = makeFilter("second");
+    generation = publisher->publish(*second, MAX_ITEMS);
+    auto republished = reader->current();
+    failures += expect(republished != nullptr && republished != view && republished->getGeneration() == 2, "generation change") ? 0 : 1;
+    failures += expect(republished != nullptr && answersLike(*republished, *second, "second"), "republished lookups") ? 0 : 1;
+    failures += expect(SharedBloomFilterReader::attach(name, 1) == nullptr, "detached after republish") ? 0 : 1;
+    failures += expect(view != nullptr && answersLike(*view, *first, "first"), "retired view") ? 0 : 1;
+
+    // The mapping belongs to the view, not to the reader or the publisher
+    reader.reset();
+    publisher.reset();
+    failures += expect(republished != nullptr && answersLike(*republished, *second, "second"), "view outlives reader") ? 0 : 1;
+
+    missing = false;
+    try {
+        SharedBloomFilterReader reader(name);
+    } catch (const runtime_error &) {
+        missing = true;
+    }
+    failures += expect(missing, "unlinked") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static unique_ptr<BloomFilter> makeFilter(const string &prefix) {
+    auto filter = make_unique<BloomFilter>(MAX_ITEMS, 0.001);
+    for (size_t i = 0; i < MAX_ITEMS; i++) {
+        filter->add(prefix + to_string(i) + ".example");
+    }
+    return filter;
+}
+
+// Members, non-members and suffix matches, all answered like the source filter
+static bool answersLike(const BloomFilterView &view, BloomFilter &filter, const string &prefix) {
+    for (size_t i = 0; i < MAX_ITEMS; i++) {
+        string member = prefix + to_string(i) + ".example";
+        string absent = "absent" + to_string(i) + ".example";
+        string subdomain = "www." + member;
+        if (!view.contains(member)
+            || view.contains(absent) != filter.contains(absent)
+            || view.containsAnySuffix(subdomain) != filter.containsAnySuffix(subdomain)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "StreamingBloomFilterBuilder.hpp"
+#include "TestSupport.hpp"
+#include "HyperLogLog.hpp"
+
+using namespace std;
+
+/*
+ Checks HyperLogLog estimates against known distinct counts and that the
+ streaming builder sizes its filter from them and contains every domain.
+
+   StreamingBloomFilterBuilderTests
+ */
+
+// Forward declarations
+
+static bool isWithin(double estimate, size_t actual, double relativeError);
+
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+
+    for (size_t count : { 0, 10, 1000, 200000 }) {
+        HyperLogLog counter;
+        for (size_t i = 0; i < count; i++) {
+            string domain = "domain" + to_string(i) + ".example";
+            counter.add(domain);
+            counter.add(domain);
+        }
+        failures += expect(isWithin(counter.estimate(), count, counter.relativeError()), "estimate") ? 0 : 1;
+    }
+
+    // Halves counted apart merge to the estimate of the whole
+    HyperLogLog first, second;
+    for (size_t i = 0; i < 100000; i++) {
+        (i % 2 == 0 ? first : second).add("domain" + to_string(i) + ".example");
+    }
+    first.merge(second);
+    failures += expect(isWithin(first.estimate(), 100000, first.relativeError()), "merged estimate") ? 0 : 1;
+
+    bool rejected = false;
+    try {
+        first.merge(HyperLogLog(10));
+    } catch (const runtime_error &) {
+        rejected = true;
+    }
+    failures += expect(rejected, "merging different precisions") ? 0 : 1;
+
+    // Duplicates, padding, a line longer than any chunk and no final newline
+    string longDomain = string(9 * 1024 * 1024, 'a') + ".example";
+    string list;
+    for (size_t i = 0; i < 30000; i++) {
+        list += "  domain" + to_string(i % 20000) + ".example\r\n\n";
+    }
+    list += longDomain + "\nlast.example";
+    istringstream in(list);
+    StreamingBloomFilterBuilder builder(0.0001, 2);
+    BloomFilterFile file = builder.build(in);
+    BloomFilter filter = file.takeFilter();
+
+    failures += expect(builder.getLineCount() == 30002, "line count") ? 0 : 1;
+    failures += expect(isWithin(builder.getEstimatedItemCount(), 20002, 1.04 / sqrt(1 << HyperLogLog::DEFAULT_PRECISION)), "distinct estimate") ? 0 : 1;
+    failures += expect(builder.getMaxItems() > builder.getEstimatedItemCount() && file.header.maxItems == builder.getMaxItems(), "max items") ? 0 : 1;
+    bool containsAll = filter.contains("last.example") && filter.contains(longDomain) && filter.contains("domain19999.example");
+    for (size_t i = 0; i < 20000 && containsAll; i++) {
+        containsAll = filter.contains("domain" + to_string(i) + ".example");
+    }
+    failures += expect(containsAll, "contains every domain") ? 0 : 1;
+    failures += expect(filter.stats().isWithinErrorRate(0.0001), "error rate") ? 0 : 1;
+
+    rejected = false;
+    try {
+        istringstream empty(" \n\n");
+        StreamingBloomFilterBuilder(0.0001).build(empty);
+    } catch (const runtime_error &) {
+        rejected = true;
+    }
+    failures += expect(rejected, "empty list") ? 0 : 1;
+
+    return reportFailures(failures);
+}
+
+static bool isWithin(double estimate, size_t actual, double relativeError) {
+    // Four standard errors, the seeds are fixed so this can't flake
+    return fabs(estimate - (double) actual) <= 4 * relativeError * (double) actual + 1;
+}
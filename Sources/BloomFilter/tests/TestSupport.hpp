@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TEST_SUPPORT_HPP
+#define TEST_SUPPORT_HPP
+
+#include <cstddef>
+#include <cstdio>
+
+/*
+ Shared by the test programs, which count failed checks in main and report
+ them on the last line of their output.
+ */
+
+// Prints the name of a failed check, returns the condition
+inline bool expect(bool condition, const char *name) {
+    if (!condition) {
+        printf("FAIL %s\n", name);
+    }
+    return condition;
+}
+
+// Prints the summary line and returns the exit status for it. `cases` is
+// included when the program runs a table of cases.
+inline int reportFailures(size_t failures, size_t cases = 0) {
+    if (cases > 0) {
+        printf("%zu cases, %zu failed\n", cases, failures);
+    } else {
+        printf("%zu failed\n", failures);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "JSONReader.hpp"
+#include "TrackerAllowlist.hpp"
+
+using namespace std;
+
+/*
+ Replays the shared privacy-reference-tests for the tracker allowlist against
+ the native matcher.
+
+   TrackerAllowlistReferenceTests <TR-domain-matching directory>
+
+ Exits 77, which CTest reports as skipped, when the reference files are not
+ checked out.
+ */
+
+static const int EXIT_SKIPPED = 77;
+static const char ALLOWLIST_FILE[] = "/tracker_allowlist_reference.json";
+static const char TESTS_FILE[] = "/tracker_allowlist_matching_tests.json";
+
+// Forward declarations
+
+static bool fileExists(const string &path);
+
+static string hostOf(const string &url);
+
+
+// Implementation
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <TR-domain-matching directory>\n", argv[0]);
+        return 2;
+    }
+
+    string directory = argv[1];
+    if (!fileExists(directory + TESTS_FILE)) {
+        printf("SKIP  reference tests not found in %s\n", directory.c_str());
+        return EXIT_SKIPPED;
+    }
+
+    try {
+        TrackerAllowlist allowlist = TrackerAllowlist::fromAllowlistedTrackers(JSONReader::parseFile(directory + ALLOWLIST_FILE));
+        JSONValue tests = JSONReader::parseFile(directory + TESTS_FILE);
+
+        size_t failures = 0;
+        auto start = chrono::steady_clock::now();
+        for (const auto &test : tests.asArray()) {
+            const string &request = test.at("request").asString();
+            bool expected = test.at("isAllowlisted").asBool();
+            bool actual = allowlist.isAllowlisted(request, hostOf(test.at("site").asString()));
+            printf("%s  %s\n", actual == expected ? "PASS" : "FAIL", test.at("description").asString().c_str());
+            if (actual != expected) {
+                printf("      %s on %s\n      expected %d, got %d\n",
+                       request.c_str(), test.at("site").asString().c_str(), expected, actual);
+                failures++;
+            }
+        }
+        auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        printf("\n%zu passed, %zu failed in %.3f ms\n", tests.asArray().size() - failures, failures, elapsed * 1000);
+        return failures == 0 ? 0 : 1;
+    } catch (const exception &error) {
+        fprintf(stderr, "FAIL  %s\n", error.what());
+        return 1;
+    }
+}
+
+static bool fileExists(const string &path) {
+    return ifstream(path).good();
+}
+
+static string hostOf(const string &url) {
+    size_t start = url.find("://");
+    start = start == string::npos ? 0 : start + 3;
+    size_t end = url.find_first_of(":/?#", start);
+    string host = url.substr(start, end == string::npos ? string::npos : end - start);
+    for (auto &character : host) {
+        character = (char) tolower((unsigned char) character);
+    }
+    return host;
+}
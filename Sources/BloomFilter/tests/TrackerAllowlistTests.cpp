@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <cstdio>
+#include <vector>
+#include "TestSupport.hpp"
+#include "TrackerAllowlist.hpp"
+
+using namespace std;
+
+/*
+ Checks tracker allowlist rules on hand-written URLs, including ones with
+ uppercase schemes and hosts, which the rules' regexes match after the
+ browser has lowercased them.
+
+   TrackerAllowlistTests
+ */
+
+// Implementation
+
+int main() {
+    size_t failures = 0;
+    TrackerAllowlist allowlist({
+        { "tracker.example", "tracker.example/script.js", { "site.example" } },
+        { "tracker.example", "tracker.example/*/Pixel", { "<all>" } },
+    });
+
+    failures += expect(allowlist.isAllowlisted("https://tracker.example/script.js", "site.example"), "rule") ? 0 : 1;
+    failures += expect(allowlist.isAllowlisted("https://cdn.tracker.example/script.js", "www.site.example"), "subdomains") ? 0 : 1;
+    failures += expect(!allowlist.isAllowlisted("https://tracker.example/script.js", "other.example"), "other site") ? 0 : 1;
+    failures += expect(allowlist.isAllowlisted("https://tracker.example/a/b/Pixel", "other.example"), "wildcard") ? 0 : 1;
+
+    // Scheme and host are case insensitive, the path is not
+    failures += expect(allowlist.isAllowlisted("HTTPS://Tracker.Example/script.js", "site.example"), "uppercase host") ? 0 : 1;
+    failures += expect(allowlist.isAllowlisted("https://CDN.tracker.example/script.js", "site.example"), "uppercase label") ? 0 : 1;
+    failures += expect(allowlist.isAllowlisted("Https://CDN.TRACKER.example/x/Pixel", "other.example"), "uppercase wildcard") ? 0 : 1;
+    failures += expect(!allowlist.isAllowlisted("https://tracker.example/SCRIPT.js", "site.example"), "path case") ? 0 : 1;
+
+    return reportFailures(failures);
+}
@@ -0,0 +1,606 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "BitSlicedBloomIndex.hpp"
+#include "BloomFilterBuilder.hpp"
+#include "BloomFilterFile.hpp"
+#include "BloomdProtocol.hpp"
+#include "HTTPSUpgradeEngine.hpp"
+#include "HostKey.hpp"
+#include "JSONReader.hpp"
+#include "RibbonDomainMap.hpp"
+#include "SHA256.hpp"
+#include "TrackerAllowlist.hpp"
+
+using namespace std;
+
+static const size_t DEFAULT_DECISION_CACHE_CAPACITY = 1 << 16;
+// Failing hosts remembered within the time to live, and how long
+static const size_t DEFAULT_FAILURE_CAPACITY = 1 << 14;
+static const size_t DEFAULT_FAILURE_TTL_SECONDS = 300;
+static const double FAILURE_ERROR_RATE = 0.0001;
+static const size_t READ_CHUNK_SIZE = 64 * 1024;
+static const size_t MAX_EVENTS = 64;
+// A connection that doesn't read its responses stops being read from beyond this
+static const size_t MAX_PENDING_OUTPUT = 4 << 20;
+
+static const char USAGE[] =
+    "usage: bloomd <socket> [options]\n"
+    "\n"
+    "  --filter <filter> [--spec <spec.json> | --bit-count N --max-items N]\n"
+    "      HTTPS upgrade filter, in either format.\n"
+    "  --excluded <domains>\n"
+    "      Newline separated domains never upgraded.\n"
+    "  --privacy-config <config.json>\n"
+    "      HTTPS feature state and exceptions, and the tracker allowlist.\n"
+    "  --tds-map <map>\n"
+    "      Tracker domain to entity map written by bloomtool build-map.\n"
+    "  --index <index>\n"
+    "      Bit sliced index over domain lists written by bloomtool build-index.\n"
+    "  --threads N\n"
+    "      Event loop threads, 0 (the default) runs one per core.\n"
+    "  --decision-cache N\n"
+    "      Hosts whose upgrade decision is cached.\n"
+    "  --failure-ttl SECONDS [--failure-capacity N]\n"
+    "      How long a host reported by upgrade-failed isn't upgraded, 0 forgets\n"
+    "      failures. Kept across reloads.\n"
+    "\n"
+    "Serves the bloomd protocol (see BloomdProtocol.hpp) on a Unix socket.\n"
+    "SIGHUP reloads every file; when that fails the previous data keeps serving.\n";
+
+/*
+ Everything a tracker or domain list lookup reads, replaced as a whole on
+ reload. The upgrade decisions live in the HTTPSUpgradeEngine, which swaps
+ its own snapshots.
+ */
+struct TrackerData {
+    shared_ptr<const RibbonDomainMap> entities;
+    shared_ptr<const TrackerAllowlist> allowlist;
+    shared_ptr<const BitSlicedBloomIndex> domainLists;
+};
+
+struct Connection {
+    int fd;
+    vector<char> input;
+    size_t inputLength;
+    vector<char> output;
+    size_t outputSent;
+    uint32_t events;
+    // The peer has shut down its side, the connection closes once the responses are out
+    bool inputClosed;
+};
+
+struct Daemon {
+    map<string, string> options;
+    HTTPSUpgradeEngine engine;
+    shared_ptr<const TrackerData> trackers;
+    int listener;
+    int stopEvent;
+
+    explicit Daemon(size_t decisionCacheCapacity) : engine(decisionCacheCapacity), listener(-1), stopEvent(-1) {
+    }
+};
+
+// Forward declarations
+
+static map<string, string> parseOptions(int argc, char **argv, string &socketPath);
+
+static size_t sizeOption(const map<string, string> &options, const string &name, size_t fallback);
+
+static void reload(Daemon &daemon);
+
+static BloomFilterFile loadFilterFile(const map<string, string> &options);
+
+static vector<string> readDomains(const string &path);
+
+static vector<string> domainsOf(const JSONValue *entries);
+
+static string readText(const string &path);
+
+static int listenOn(const string &path);
+
+static void serve(Daemon &daemon);
+
+static bool readRequests(Daemon &daemon, Connection &connection, BloomdRequest &request, BloomdResponse &response);
+
+static void handle(Daemon &daemon, const BloomdRequest &request, BloomdResponse &response);
+
+static bool flush(Connection &connection);
+
+static void closeConnection(int epoll, Connection *connection);
+
+
+// Implementation
+
+int main(int argc, char **argv) {
+    string socketPath;
+    map<string, string> options;
+    try {
+        options = parseOptions(argc - 1, argv + 1, socketPath);
+    } catch (const exception &error) {
+        fprintf(stderr, "bloomd: %s\n\n%s", error.what(), USAGE);
+        return 2;
+    }
+
+    // Signals go to the main thread only, which waits for them below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    Daemon daemon(sizeOption(options, "decision-cache", DEFAULT_DECISION_CACHE_CAPACITY));
+    daemon.options = move(options);
+    try {
+        size_t failureTTL = sizeOption(daemon.options, "failure-ttl", DEFAULT_FAILURE_TTL_SECONDS);
+        if (failureTTL > 0) {
+            daemon.engine.setFailureMemory(make_shared<AgePartitionedBloomFilter>(
+                sizeOption(daemon.options, "failure-capacity", DEFAULT_FAILURE_CAPACITY),
+                FAILURE_ERROR_RATE, chrono::seconds(failureTTL)));
+        }
+    } catch (const exception &error) {
+        fprintf(stderr, "bloomd: %s\n\n%s", error.what(), USAGE);
+        return 2;
+    }
+    size_t threadCount = sizeOption(daemon.options, "threads", 0);
+    if (threadCount == 0) {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+    try {
+        reload(daemon);
+        daemon.listener = listenOn(socketPath);
+    } catch (const exception &error) {
+        fprintf(stderr, "bloomd: %s\n", error.what());
+        return 1;
+    }
+    daemon.stopEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    vector<thread> workers;
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(serve, ref(daemon));
+    }
+    fprintf(stderr, "bloomd: serving %s on %zu threads\n", socketPath.c_str(), threadCount);
+
+    int received = 0;
+    while (sigwait(&signals, &received) == 0 && received == SIGHUP) {
+        try {
+            reload(daemon);
+        } catch (const exception &error) {
+            fprintf(stderr, "bloomd: reload failed, keeping the previous data: %s\n", error.what());
+        }
+    }
+
+    // Not EPOLLEXCLUSIVE, so every worker wakes up and returns
+    uint64_t one = 1;
+    if (write(daemon.stopEvent, &one, sizeof(one)) != sizeof(one)) {
+        return 1;
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    close(daemon.listener);
+    unlink(socketPath.c_str());
+    return 0;
+}
+
+static map<string, string> parseOptions(int argc, char **argv, string &socketPath) {
+    map<string, string> options;
+    for (int i = 0; i < argc; i++) {
+        string argument = argv[i];
+        if (argument.rfind("--", 0) != 0) {
+            if (!socketPath.empty()) {
+                throw runtime_error("Unexpected argument " + argument);
+            }
+            socketPath = argument;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw runtime_error("Missing value for " + argument);
+        }
+        options[argument.substr(2)] = argv[++i];
+    }
+    if (socketPath.empty()) {
+        throw runtime_error("Missing socket path");
+    }
+    return options;
+}
+
+static size_t sizeOption(const map<string, string> &options, const string &name, size_t fallback) {
+    auto option = options.find(name);
+    if (option == options.end()) {
+        return fallback;
+    }
+    char *end;
+    unsigned long long parsed = strtoull(option->second.c_str(), &end, 10);
+    if (option->second.empty() || *end != '\0') {
+        throw runtime_error("--" + name + " expects a number");
+    }
+    return (size_t) parsed;
+}
+
+// Loads everything before publishing anything, so a failed reload changes nothing
+static void reload(Daemon &daemon) {
+    const map<string, string> &options = daemon.options;
+    // Frozen, the worker threads probe it without locks
+    shared_ptr<const FrozenBloomFilter> filter;
+    if (options.count("filter") != 0) {
+        BloomFilterBuilder builder(loadFilterFile(options).takeFilter());
+        filter = make_shared<const FrozenBloomFilter>(builder.freeze());
+    }
+    vector<string> excluded = options.count("excluded") != 0 ? readDomains(options.at("excluded")) : vector<string>();
+
+    bool httpsEnabled = true;
+    vector<string> exceptions;
+    auto trackers = make_shared<TrackerData>();
+    if (options.count("privacy-config") != 0) {
+        string config = readText(options.at("privacy-config"));
+        JSONValue root = JSONReader::parse(config);
+        const JSONValue *features = root.find("features");
+        const JSONValue *https = features == nullptr ? nullptr : features->find("https");
+        const JSONValue *state = https == nullptr ? nullptr : https->find("state");
+        httpsEnabled = state != nullptr && state->isString() && state->asString() == "enabled";
+        // The same exceptions HTTPSUpgrade passes: temporarily unprotected sites and the feature's own
+        exceptions = domainsOf(root.find("unprotectedTemporary"));
+        vector<string> featureExceptions = domainsOf(https == nullptr ? nullptr : https->find("exceptions"));
+        exceptions.insert(exceptions.end(), featureExceptions.begin(), featureExceptions.end());
+        trackers->allowlist = make_shared<const TrackerAllowlist>(TrackerAllowlist::fromPrivacyConfig(config));
+    }
+    if (options.count("tds-map") != 0) {
+        trackers->entities = make_shared<const RibbonDomainMap>(RibbonDomainMap::mapFile(options.at("tds-map")));
+    }
+    if (options.count("index") != 0) {
+        trackers->domainLists = make_shared<const BitSlicedBloomIndex>(BitSlicedBloomIndex::readFromFile(options.at("index")));
+    }
+
+    daemon.engine.setUpgradeList(filter, excluded);
+    daemon.engine.setFeatureState(httpsEnabled, exceptions, {});
+    atomic_store(&daemon.trackers, shared_ptr<const TrackerData>(trackers));
+    fprintf(stderr, "bloomd: loaded%s%s%s%s%s\n",
+            filter != nullptr ? " filter" : "",
+            trackers->allowlist != nullptr ? " privacy-config" : "",
+            trackers->entities != nullptr ? " tds-map" : "",
+            trackers->domainLists != nullptr ? " index" : "",
+            excluded.empty() ? "" : " excluded");
+}
+
+static BloomFilterFile loadFilterFile(const map<string, string> &options) {
+    const string &path = options.at("filter");
+    if (BloomFilterFile::isContainer(path)) {
+        return BloomFilterFile::readContainer(path);
+    }
+    if (options.count("spec") != 0) {
+        JSONValue spec = JSONReader::parseFile(options.at("spec"));
+        SHA256::Digest sha256;
+        if (!SHA256::fromHex(spec.at("sha256").asString(), sha256)) {
+            throw runtime_error(options.at("spec") + " has no valid sha256");
+        }
+        // Verified while it is read, a filter that doesn't match is never served
+        return BloomFilterFile::readLegacy(path, (size_t) spec.at("bitCount").asNumber(), (size_t) spec.at("totalEntries").asNumber(), sha256);
+    }
+    if (options.count("bit-count") == 0 || options.count("max-items") == 0) {
+        throw runtime_error(path + " is a legacy filter, pass --spec or --bit-count and --max-items");
+    }
+    return BloomFilterFile::readLegacy(path, sizeOption(options, "bit-count", 0), sizeOption(options, "max-items", 0));
+}
+
+static vector<string> readDomains(const string &path) {
+    string text = readText(path);
+    vector<string> domains;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == string::npos) {
+            end = text.size();
+        }
+        string domain = text.substr(start, end - start);
+        while (!domain.empty() && isspace((unsigned char) domain.back())) {
+            domain.pop_back();
+        }
+        if (!domain.empty()) {
+            domains.push_back(move(domain));
+        }
+        start = end + 1;
+    }
+    return domains;
+}
+
+// The "domain" of every entry of an exceptions style list
+static vector<string> domainsOf(const JSONValue *entries) {
+    vector<string> domains;
+    if (entries == nullptr || !entries->isArray()) {
+        return domains;
+    }
+    for (const JSONValue &entry : entries->asArray()) {
+        const JSONValue *domain = entry.find("domain");
+        if (domain != nullptr && domain->isString() && !domain->asString().empty()) {
+            domains.push_back(domain->asString());
+        }
+    }
+    return domains;
+}
+
+static string readText(const string &path) {
+    ifstream in(path, ifstream::binary);
+    if (!in) {
+        throw runtime_error("Can't read " + path);
+    }
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static int listenOn(const string &path) {
+    sockaddr_un address {};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("Socket path too long: " + path);
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw runtime_error(string("socket: ") + strerror(errno));
+    }
+    // A socket left behind by a previous run
+    unlink(path.c_str());
+    if (::bind(fd, (const sockaddr *) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        int error = errno;
+        close(fd);
+        throw runtime_error("Can't listen on " + path + ": " + strerror(error));
+    }
+    return fd;
+}
+
+/*
+ One event loop per thread, each with its own epoll instance. The listening
+ socket is in all of them with EPOLLEXCLUSIVE, so a new connection wakes one
+ worker, which then owns it for its lifetime. Nothing is shared between
+ workers but the engines, which are lock-free to query.
+ */
+static void serve(Daemon &daemon) {
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event {};
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = &daemon.listener;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, daemon.listener, &event);
+    event.events = EPOLLIN;
+    event.data.ptr = &daemon.stopEvent;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, daemon.stopEvent, &event);
+
+    // Reused for every request of every connection, so steady state lookups don't allocate
+    BloomdRequest request;
+    BloomdResponse response;
+    unordered_set<Connection *> connections;
+    epoll_event events[MAX_EVENTS];
+    bool stopping = false;
+    while (!stopping) {
+        int count = epoll_wait(epoll, events, MAX_EVENTS, -1);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            void *source = events[i].data.ptr;
+            if (source == &daemon.stopEvent) {
+                stopping = true;
+                continue;
+            }
+            if (source == &daemon.listener) {
+                int fd;
+                while ((fd = accept4(daemon.listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    auto connection = new Connection { fd, vector<char>(READ_CHUNK_SIZE), 0, {}, 0, EPOLLIN, false };
+                    epoll_event added {};
+                    added.events = connection->events;
+                    added.data.ptr = connection;
+                    epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &added);
+                    connections.insert(connection);
+                }
+                continue;
+            }
+
+            auto connection = (Connection *) source;
+            bool open = (events[i].events & EPOLLERR) == 0;
+            if (open && (events[i].events & (EPOLLIN | EPOLLHUP)) != 0 && !connection->inputClosed) {
+                open = readRequests(daemon, *connection, request, response);
+            }
+            open = open && flush(*connection);
+            size_t pending = connection->output.size() - connection->outputSent;
+            if (!open || (connection->inputClosed && pending == 0)) {
+                connections.erase(connection);
+                closeConnection(epoll, connection);
+                continue;
+            }
+
+            // Waits for room to write while responses are pending, and stops reading when too many are
+            bool reading = !connection->inputClosed && pending < MAX_PENDING_OUTPUT;
+            uint32_t wanted = (reading ? (uint32_t) EPOLLIN : 0) | (pending > 0 ? (uint32_t) EPOLLOUT : 0);
+            if (wanted != connection->events) {
+                connection->events = wanted;
+                epoll_event modified {};
+                modified.events = wanted;
+                modified.data.ptr = connection;
+                epoll_ctl(epoll, EPOLL_CTL_MOD, connection->fd, &modified);
+            }
+        }
+    }
+
+    for (Connection *connection : connections) {
+        closeConnection(epoll, connection);
+    }
+    close(epoll);
+}
+
+// Reads what is available and answers every complete frame. Returns false when the stream is unusable.
+static bool readRequests(Daemon &daemon, Connection &connection, BloomdRequest &request, BloomdResponse &response) {
+    while (!connection.inputClosed) {
+        if (connection.input.size() - connection.inputLength < READ_CHUNK_SIZE) {
+            connection.input.resize(connection.inputLength + READ_CHUNK_SIZE);
+        }
+        ssize_t received = recv(connection.fd, connection.input.data() + connection.inputLength,
+                                connection.input.size() - connection.inputLength, 0);
+        if (received < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        connection.inputClosed = received == 0;
+        connection.inputLength += (size_t) received;
+
+        size_t consumed = 0;
+        size_t frameLength;
+        try {
+            while ((frameLength = BloomdProtocol::frameLength(connection.input.data() + consumed, connection.inputLength - consumed)) != 0) {
+                const char *payload = connection.input.data() + consumed + BloomdProtocol::FRAME_PREFIX_LENGTH;
+                size_t payloadLength = frameLength - BloomdProtocol::FRAME_PREFIX_LENGTH;
+                response.results.clear();
+                if (!BloomdProtocol::decodeRequest(payload, payloadLength, request)) {
+                    response.requestID = request.requestID;
+                    response.operation = request.operation;
+                    response.status = BloomdStatus::malformed;
+                } else {
+                    handle(daemon, request, response);
+                }
+                BloomdProtocol::appendResponse(connection.output, response);
+                consumed += frameLength;
+            }
+        } catch (const runtime_error &) {
+            // An oversized frame, the stream can't be resynchronized
+            return false;
+        }
+        memmove(connection.input.data(), connection.input.data() + consumed, connection.inputLength - consumed);
+        connection.inputLength -= consumed;
+
+        if (connection.output.size() - connection.outputSent >= MAX_PENDING_OUTPUT) {
+            return true;
+        }
+    }
+    return true;
+}
+
+static void handle(Daemon &daemon, const BloomdRequest &request, BloomdResponse &response) {
+    response.requestID = request.requestID;
+    response.operation = request.operation;
+    response.status = BloomdStatus::ok;
+    // Checked before any work, the answer has to fit in one frame
+    if (request.items.size() > BloomdProtocol::maxResults(request.operation)) {
+        response.status = BloomdStatus::tooLarge;
+        return;
+    }
+
+    switch (request.operation) {
+        case BloomdOperation::upgrade:
+            for (string_view host : request.items) {
+                response.results.push_back((uint32_t) daemon.engine.decideHost(host));
+            }
+            return;
+
+        case BloomdOperation::upgradeFailed:
+            for (string_view host : request.items) {
+                response.results.push_back(daemon.engine.recordUpgradeFailure(host) ? 1 : 0);
+            }
+            return;
+
+        case BloomdOperation::trackerEntity: {
+            auto trackers = atomic_load(&daemon.trackers);
+            if (trackers->entities == nullptr) {
+                response.status = BloomdStatus::notLoaded;
+                return;
+            }
+            HostKey key;
+            for (string_view host : request.items) {
+                uint32_t entity = BloomdProtocol::NO_ENTITY;
+                if (!key.assign(host) || trackers->entities->findAnySuffix(key, entity).empty()) {
+                    entity = BloomdProtocol::NO_ENTITY;
+                }
+                response.results.push_back(entity);
+            }
+            return;
+        }
+
+        case BloomdOperation::domainLists: {
+            auto trackers = atomic_load(&daemon.trackers);
+            if (trackers->domainLists == nullptr) {
+                response.status = BloomdStatus::notLoaded;
+                return;
+            }
+            // One hash pass per label for all lists at once
+            HostKey key;
+            for (string_view host : request.items) {
+                response.results.push_back(key.assign(host) ? trackers->domainLists->queryAnySuffix(key) : 0);
+            }
+            return;
+        }
+
+        case BloomdOperation::trackerAllowlisted: {
+            auto trackers = atomic_load(&daemon.trackers);
+            if (trackers->allowlist == nullptr) {
+                response.status = BloomdStatus::notLoaded;
+                return;
+            }
+            if (request.items.size() % 2 != 0) {
+                response.status = BloomdStatus::malformed;
+                return;
+            }
+            for (size_t i = 0; i < request.items.size(); i += 2) {
+                response.results.push_back(trackers->allowlist->isAllowlisted(request.items[i], request.items[i + 1]) ? 1 : 0);
+            }
+            return;
+        }
+    }
+    response.status = BloomdStatus::unknownOperation;
+}
+
+// Writes as much pending output as the socket takes. Returns false when the peer is gone.
+static bool flush(Connection &connection) {
+    while (connection.outputSent < connection.output.size()) {
+        ssize_t sent = send(connection.fd, connection.output.data() + connection.outputSent,
+                            connection.output.size() - connection.outputSent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        connection.outputSent += (size_t) sent;
+    }
+    connection.output.clear();
+    connection.outputSent = 0;
+    return true;
+}
+
+static void closeConnection(int epoll, Connection *connection) {
+    epoll_ctl(epoll, EPOLL_CTL_DEL, connection->fd, nullptr);
+    close(connection->fd);
+    delete connection;
+}
@@ -0,0 +1,1049 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "BitSlicedBloomIndex.hpp"
+#include "BloomFilter.hpp"
+#include "BloomFilterBuilder.hpp"
+#include "BloomFilterFile.hpp"
+#include "BloomdProtocol.hpp"
+#include "ContentRuleList.hpp"
+#include "FrozenBloomFilter.hpp"
+#include "JSONReader.hpp"
+#include "PerfectDomainSet.hpp"
+#include "RANSCoder.hpp"
+#include "RibbonDomainMap.hpp"
+#include "SHA256.hpp"
+#include "SharedBloomFilter.hpp"
+#include "StreamingBloomFilterBuilder.hpp"
+
+using namespace std;
+
+static const double DEFAULT_ERROR_RATE = 0.00001;
+static const size_t QUERY_BATCH_SIZE = 1 << 16;
+static const size_t READ_CHUNK_SIZE = 1 << 20;
+static const size_t ASK_BATCH_SIZE = 256;
+static const size_t DEFAULT_BENCHMARK_ITERATIONS = 5;
+static const char *const VERDICT_NAMES[] = {
+    "upgrade", "notHTTP", "invalidHost", "featureDisabled", "excluded", "notInUpgradeList", "bufferTooSmall",
+    "recentlyFailed"
+};
+
+static const char USAGE[] =
+    "usage: bloomtool <command> [options]\n"
+    "\n"
+    "  build <domains> <output> [--error-rate R] [--max-items N] [--threads N]\n"
+    "        [--format legacy|container|compressed] [--spec-out <spec.json>]\n"
+    "      Builds a filter from a newline separated domain list.\n"
+    "  build-streaming <domains> <output> [--error-rate R] [--threads N]\n"
+    "        [--format legacy|container|compressed] [--spec-out <spec.json>]\n"
+    "      Same for lists of unknown size, read twice: once to count the distinct domains\n"
+    "      and size the filter, once to fill it. Writes a container by default.\n"
+    "  inspect <filter> [parameters]\n"
+    "      Prints the header and the statistics of the bits actually set.\n"
+    "  verify <filter> <spec.json> [--tolerance T]\n"
+    "      Checks size, SHA-256 and false positive rate against a specification.\n"
+    "  convert <input> <output> --to legacy|container|compressed [parameters]\n"
+    "      Rewrites a filter in another format.\n"
+    "  benchmark-transport <filter> [parameters] [--iterations N]\n"
+    "      Compares download size and load time of a plain and a compressed container.\n"
+    "  query <filter> [parameters] [--threads N] [--positives-only]\n"
+    "  query --shared <name> [--threads N] [--positives-only]\n"
+    "  query --set <set> [--threads N] [--positives-only]\n"
+    "  query --map <map> [--threads N] [--positives-only]\n"
+    "      Looks up every line of stdin, printing \"1\\t<domain>\" or \"0\\t<domain>\",\n"
+    "      or \"<id>\\t<domain>\" and \"-\\t<domain>\" for a map.\n"
+    "  query --index <index> [--threads N] [--positives-only]\n"
+    "      Prints the hexadecimal mask of lists that may contain each domain.\n"
+    "  build-set <domains> <output> [--threads N] [--hashes-only]\n"
+    "      Builds an exact perfect hash set, keeping the domains unless --hashes-only.\n"
+    "  build-map <tds.json> <output> [--fingerprint-bits N] [--names-out <names>]\n"
+    "      Maps every tracker domain to the index of its entity, names-out lists the entities.\n"
+    "  build-index <output> <domains>... [--error-rate R] [--max-items N]\n"
+    "      Builds one bit sliced index over up to 64 domain lists.\n"
+    "  evaluate-rules <rules.json>\n"
+    "      Evaluates a content blocker rule list for every \"<url>\\t<page host>\\t<resource type>\\t\n"
+    "      first-party|third-party\" line of stdin, printing \"block|allow\\t<rules>\\t<url>\".\n"
+    "  publish <filter> <name> [parameters]\n"
+    "      Serves a filter from shared memory until stdin is closed.\n"
+    "  ask <socket> [--operation upgrade|upgrade-failed|tracker-entity|tracker-allowlisted|domain-lists]\n"
+    "        [--batch N]\n"
+    "      Sends every line of stdin to bloomd in pipelined batches, printing \"<result>\\t<line>\".\n"
+    "      Lines are hosts, or \"<url>\\t<site host>\" for tracker-allowlisted.\n"
+    "\n"
+    "Legacy filters don't carry their parameters, pass them as [parameters]:\n"
+    "  --spec <spec.json>  or  --bit-count N --max-items N\n";
+
+struct Arguments {
+    vector<string> positional;
+    map<string, string> options;
+
+    bool has(const string &name) const;
+
+    string get(const string &name, const string &fallback = "") const;
+
+    size_t getSize(const string &name, size_t fallback) const;
+
+    double getDouble(const string &name, double fallback) const;
+};
+
+struct Specification {
+    size_t bitCount;
+    double errorRate;
+    size_t totalEntries;
+    string sha256;
+};
+
+// Forward declarations
+
+static Arguments parseArguments(int argc, char **argv);
+
+static Specification readSpecification(const string &path);
+
+static BloomFilterFile loadFilterFile(const string &path, const Arguments &arguments);
+
+static BloomFilterFileFormat parseFormat(const string &name);
+
+static const char *formatName(BloomFilterFileFormat format);
+
+static string readText(const string &path);
+
+// An empty file of its own in TMPDIR, or /tmp; the caller removes it
+static string createTemporaryFile();
+
+static vector<string_view> splitLines(const string &text);
+
+static size_t threadCountOption(const Arguments &arguments);
+
+static void printStats(const BloomFilterStats &stats);
+
+static int build(const Arguments &arguments);
+
+static int buildStreaming(const Arguments &arguments);
+
+static void writeSpecification(const string &path, size_t bitCount, double errorRate, size_t maxItems, const string &sha256);
+
+static int inspect(const Arguments &arguments);
+
+static int verify(const Arguments &arguments);
+
+static int convert(const Arguments &arguments);
+
+static int benchmarkTransport(const Arguments &arguments);
+
+static int buildSet(const Arguments &arguments);
+
+static int buildMap(const Arguments &arguments);
+
+static int buildIndex(const Arguments &arguments);
+
+static int query(const Arguments &arguments);
+
+static int publish(const Arguments &arguments);
+
+static int evaluateRules(const Arguments &arguments);
+
+static int ask(const Arguments &arguments);
+
+static BloomdOperation parseOperation(const string &name);
+
+static int connectTo(const string &path);
+
+static void sendAll(int fd, const vector<char> &data);
+
+
+// Implementation
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fputs(USAGE, stderr);
+        return 2;
+    }
+
+    string command = argv[1];
+    try {
+        Arguments arguments = parseArguments(argc - 2, argv + 2);
+        if (command == "build" && arguments.positional.size() == 2) {
+            return build(arguments);
+        } else if (command == "build-streaming" && arguments.positional.size() == 2) {
+            return buildStreaming(arguments);
+        } else if (command == "build-set" && arguments.positional.size() == 2) {
+            return buildSet(arguments);
+        } else if (command == "build-map" && arguments.positional.size() == 2) {
+            return buildMap(arguments);
+        } else if (command == "build-index" && arguments.positional.size() >= 2) {
+            return buildIndex(arguments);
+        } else if (command == "inspect" && arguments.positional.size() == 1) {
+            return inspect(arguments);
+        } else if (command == "verify" && arguments.positional.size() == 2) {
+            return verify(arguments);
+        } else if (command == "convert" && arguments.positional.size() == 2 && arguments.has("to")) {
+            return convert(arguments);
+        } else if (command == "benchmark-transport" && arguments.positional.size() == 1) {
+            return benchmarkTransport(arguments);
+        } else if (command == "query" && arguments.positional.size() == (arguments.has("shared") || arguments.has("set") || arguments.has("map") || arguments.has("index") ? 0 : 1)) {
+            return query(arguments);
+        } else if (command == "publish" && arguments.positional.size() == 2) {
+            return publish(arguments);
+        } else if (command == "evaluate-rules" && arguments.positional.size() == 1) {
+            return evaluateRules(arguments);
+        } else if (command == "ask" && arguments.positional.size() == 1) {
+            return ask(arguments);
+        }
+    } catch (const exception &error) {
+        fprintf(stderr, "bloomtool: %s\n", error.what());
+        return 1;
+    }
+
+    fputs(USAGE, stderr);
+    return 2;
+}
+
+static int build(const Arguments &arguments) {
+    const string &domainsPath = arguments.positional[0];
+    const string &outputPath = arguments.positional[1];
+
+    string text = readText(domainsPath);
+    vector<string_view> domains = splitLines(text);
+    if (domains.empty()) {
+        throw runtime_error(domainsPath + " has no domains");
+    }
+
+    double errorRate = arguments.getDouble("error-rate", DEFAULT_ERROR_RATE);
+    size_t maxItems = arguments.getSize("max-items", domains.size());
+    if (maxItems < domains.size()) {
+        fprintf(stderr, "warning: %zu domains exceed --max-items %zu\n", domains.size(), maxItems);
+    }
+
+    auto start = chrono::steady_clock::now();
+    BloomFilter filter(maxItems, errorRate);
+    filter.addAll(domains, threadCountOption(arguments));
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    BloomFilterFile file = BloomFilterFile::fromFilter(filter, maxItems);
+    BloomFilterFileFormat format = parseFormat(arguments.get("format", "legacy"));
+    file.write(outputPath, format);
+
+    string sha256 = SHA256::toHex(file.header.payloadSHA256);
+    printf("domains        %zu\n", domains.size());
+    printf("max items      %zu\n", maxItems);
+    printf("bit count      %zu\n", filter.getBitCount());
+    printf("hash rounds    %zu\n", filter.getHashRounds());
+    printf("format         %s\n", formatName(format));
+    printf("sha256         %s\n", sha256.c_str());
+    printf("build time     %.3f s\n", elapsed);
+
+    if (arguments.has("spec-out")) {
+        writeSpecification(arguments.get("spec-out"), filter.getBitCount(), errorRate, maxItems, sha256);
+    }
+    return 0;
+}
+
+static int buildStreaming(const Arguments &arguments) {
+    double errorRate = arguments.getDouble("error-rate", DEFAULT_ERROR_RATE);
+    StreamingBloomFilterBuilder builder(errorRate, threadCountOption(arguments));
+
+    auto start = chrono::steady_clock::now();
+    BloomFilterFile file = builder.build(arguments.positional[0]);
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    BloomFilterFileFormat format = parseFormat(arguments.get("format", "container"));
+    file.write(arguments.positional[1], format);
+
+    string sha256 = SHA256::toHex(file.header.payloadSHA256);
+    printf("lines          %zu\n", builder.getLineCount());
+    printf("est. distinct  %.0f\n", builder.getEstimatedItemCount());
+    printf("max items      %zu\n", builder.getMaxItems());
+    printf("bit count      %llu\n", (unsigned long long) file.header.bitCount);
+    printf("hash rounds    %u\n", file.header.hashRounds);
+    printf("format         %s\n", formatName(format));
+    printf("sha256         %s\n", sha256.c_str());
+    printf("build time     %.3f s\n", elapsed);
+
+    if (arguments.has("spec-out")) {
+        writeSpecification(arguments.get("spec-out"), file.header.bitCount, errorRate, builder.getMaxItems(), sha256);
+    }
+    return 0;
+}
+
+static void writeSpecification(const string &path, size_t bitCount, double errorRate, size_t maxItems, const string &sha256) {
+    ofstream spec(path, ofstream::trunc);
+    spec << "{\n"
+         << "    \"bitCount\": " << bitCount << ",\n"
+         << "    \"errorRate\": " << errorRate << ",\n"
+         << "    \"totalEntries\": " << maxItems << ",\n"
+         << "    \"sha256\": \"" << sha256 << "\"\n"
+         << "}\n";
+    if (!spec) {
+        throw runtime_error("Can't write " + path);
+    }
+}
+
+static int buildSet(const Arguments &arguments) {
+    string text = readText(arguments.positional[0]);
+    vector<string_view> domains = splitLines(text);
+
+    auto start = chrono::steady_clock::now();
+    PerfectDomainSet set = PerfectDomainSet::build(domains, !arguments.has("hashes-only"), threadCountOption(arguments));
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    set.writeToFile(arguments.positional[1]);
+
+    double keys = max<size_t>(set.size(), 1);
+    printf("domains        %zu\n", set.size());
+    printf("strings        %s\n", set.hasStrings() ? "kept" : "hashes only");
+    printf("index          %.2f bits/key\n", set.indexBytes() * 8 / keys);
+    printf("total          %.2f bytes/key, %zu bytes\n", set.dataLength() / keys, set.dataLength());
+    printf("build time     %.3f s\n", elapsed);
+    return 0;
+}
+
+static int buildMap(const Arguments &arguments) {
+    JSONValue trackerData = JSONReader::parseFile(arguments.positional[0]);
+    const auto &domainEntities = trackerData.at("domains").asObject();
+
+    vector<string> names;
+    for (const auto &member : domainEntities) {
+        names.push_back(member.second.asString());
+    }
+    sort(names.begin(), names.end());
+    names.erase(unique(names.begin(), names.end()), names.end());
+
+    vector<pair<string_view, uint32_t>> entries;
+    entries.reserve(domainEntities.size());
+    for (const auto &member : domainEntities) {
+        auto name = lower_bound(names.begin(), names.end(), member.second.asString());
+        entries.emplace_back(member.first, (uint32_t) (name - names.begin()));
+    }
+
+    auto start = chrono::steady_clock::now();
+    uint32_t fingerprintBits = (uint32_t) arguments.getSize("fingerprint-bits", 8);
+    RibbonDomainMap map = RibbonDomainMap::build(entries, fingerprintBits);
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    map.writeToFile(arguments.positional[1]);
+
+    if (arguments.has("names-out")) {
+        ofstream out(arguments.get("names-out"), ofstream::trunc);
+        for (const auto &name : names) {
+            out << name << "\n";
+        }
+        if (!out) {
+            throw runtime_error("Can't write " + arguments.get("names-out"));
+        }
+    }
+
+    double keys = max<size_t>(map.size(), 1);
+    printf("domains        %zu\n", map.size());
+    printf("entities       %zu\n", names.size());
+    printf("id bits        %u\n", map.getValueBits());
+    printf("fingerprint    %u bits, false hit rate %.3g\n", map.getFingerprintBits(), pow(2.0, -(double) map.getFingerprintBits()));
+    printf("total          %.2f bits/key, %zu bytes\n", map.dataLength() * 8 / keys, map.dataLength());
+    printf("build time     %.3f s\n", elapsed);
+    return 0;
+}
+
+static int buildIndex(const Arguments &arguments) {
+    vector<string> texts;
+    vector<vector<string_view>> lists;
+    size_t largestList = 0;
+    for (size_t i = 1; i < arguments.positional.size(); i++) {
+        texts.push_back(readText(arguments.positional[i]));
+    }
+    for (const auto &text : texts) {
+        lists.push_back(splitLines(text));
+        largestList = max(largestList, lists.back().size());
+    }
+
+    double errorRate = arguments.getDouble("error-rate", DEFAULT_ERROR_RATE);
+    size_t maxItems = arguments.getSize("max-items", max<size_t>(largestList, 1));
+    BitSlicedBloomIndex index(lists.size(), maxItems, errorRate);
+    for (size_t list = 0; list < lists.size(); list++) {
+        for (auto domain : lists[list]) {
+            index.add(list, domain);
+        }
+    }
+    index.writeToFile(arguments.positional[0]);
+
+    for (size_t list = 0; list < lists.size(); list++) {
+        printf("list %-2zu        %zu domains, %s\n", list, lists[list].size(), arguments.positional[list + 1].c_str());
+    }
+    printf("slots          %zu\n", index.getSlotCount());
+    printf("hash rounds    %zu\n", index.getHashRounds());
+    printf("size           %zu bytes\n", index.dataLength());
+    return 0;
+}
+
+static int inspect(const Arguments &arguments) {
+    BloomFilterFile file = loadFilterFile(arguments.positional[0], arguments);
+    const auto &header = file.header;
+
+    printf("format         %s\n", formatName(file.format));
+    if (file.format != BloomFilterFileFormat::legacy) {
+        printf("version        %u\n", header.version);
+        printf("flags          0x%x\n", header.flags);
+        printf("hash scheme    %u\n", header.hashScheme);
+    }
+    printf("bit count      %llu\n", (unsigned long long) header.bitCount);
+    printf("max items      %llu\n", (unsigned long long) header.maxItems);
+    printf("hash rounds    %u\n", header.hashRounds);
+    printf("payload        %llu bytes\n", (unsigned long long) header.payloadLength);
+    if (header.isPayloadCoded()) {
+        printf("decoded        %llu bytes\n", (unsigned long long) header.decodedPayloadLength());
+    }
+    printf("sha256         %s\n", SHA256::toHex(header.payloadSHA256).c_str());
+    printStats(file.makeFilter().stats());
+    return 0;
+}
+
+static int verify(const Arguments &arguments) {
+    Specification spec = readSpecification(arguments.positional[1]);
+    Arguments loadArguments = arguments;
+    loadArguments.options["spec"] = arguments.positional[1];
+    BloomFilterFile file = loadFilterFile(arguments.positional[0], loadArguments);
+
+    bool passed = true;
+    auto check = [&passed](bool condition, const string &description) {
+        printf("%s  %s\n", condition ? "PASS" : "FAIL", description.c_str());
+        passed = passed && condition;
+    };
+
+    check(file.header.bitCount == spec.bitCount && file.header.maxItems == spec.totalEntries,
+          "parameters match the specification");
+    check(file.payload.size() == (spec.bitCount + 7) / 8,
+          "payload is " + to_string(file.payload.size()) + " bytes for " + to_string(spec.bitCount) + " bits");
+
+    string sha256 = SHA256::toHex(file.header.payloadSHA256);
+    string expectedSHA256 = spec.sha256;
+    for (auto &character : expectedSHA256) {
+        character = (char) tolower((unsigned char) character);
+    }
+    check(sha256 == expectedSHA256, "sha256 " + sha256);
+
+    BloomFilterStats stats = file.makeFilter().stats();
+    double tolerance = arguments.getDouble("tolerance", 1.0);
+    char description[128];
+    snprintf(description, sizeof(description), "false positive rate %.3g within %.3g x %.3g (margin %.1f%%)",
+             stats.falsePositiveRate, tolerance, spec.errorRate, stats.falsePositiveRateMargin() * 100);
+    check(stats.isWithinErrorRate(spec.errorRate, tolerance), description);
+    snprintf(description, sizeof(description), "byte entropy %.3f, expected %.3f",
+             stats.byteEntropy, stats.expectedByteEntropy);
+    check(stats.hasExpectedEntropy(), description);
+
+    return passed ? 0 : 1;
+}
+
+static int convert(const Arguments &arguments) {
+    BloomFilterFile file = loadFilterFile(arguments.positional[0], arguments);
+    BloomFilterFileFormat format = parseFormat(arguments.get("to"));
+    file.write(arguments.positional[1], format);
+    printf("%s -> %s, %llu bits\n", formatName(file.format), formatName(format), (unsigned long long) file.header.bitCount);
+    return 0;
+}
+
+static int benchmarkTransport(const Arguments &arguments) {
+    BloomFilterFile file = loadFilterFile(arguments.positional[0], arguments);
+    size_t iterations = max<size_t>(arguments.getSize("iterations", DEFAULT_BENCHMARK_ITERATIONS), 1);
+    BloomFilterStats stats = file.makeFilter().stats();
+
+    // Both containers as they would arrive over the network
+    string temporaryPath = createTemporaryFile();
+    vector<string> containers;
+    try {
+        for (auto format : { BloomFilterFileFormat::container, BloomFilterFileFormat::compressed }) {
+            file.write(temporaryPath, format);
+            containers.push_back(readText(temporaryPath));
+        }
+    } catch (...) {
+        remove(temporaryPath.c_str());
+        throw;
+    }
+    remove(temporaryPath.c_str());
+
+    auto start = chrono::steady_clock::now();
+    RANSCoder::encode(file.payload.data(), file.payload.size());
+    double encodeTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Independent bits at fill f carry H(f) bits each. The legacy hashes set
+    // bytes less evenly than that, which a byte coder can exploit on top.
+    double fill = min(max(stats.fillRatio, 1e-12), 1 - 1e-12);
+    double bitEntropy = -(fill * log2(fill) + (1 - fill) * log2(1 - fill));
+    double rawLength = (double) containers[0].size();
+
+    printf("fill ratio     %.4f\n", stats.fillRatio);
+    printf("bit entropy    %.4f of raw\n", bitEntropy);
+    printf("byte entropy   %.4f of raw\n", stats.byteEntropy / 8);
+    printf("encode         %.3f s\n", encodeTime);
+    const char *names[] = { "container", "compressed" };
+    for (size_t i = 0; i < containers.size(); i++) {
+        // Streams through the same path a download takes, into the filter's own storage
+        double best = INFINITY;
+        for (size_t iteration = 0; iteration < iterations; iteration++) {
+            istringstream in(containers[i]);
+            start = chrono::steady_clock::now();
+            BloomFilter filter = BloomFilterFile::readContainer(in).takeFilter();
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        printf("%-14s %zu bytes, %.4f of raw, load %.2f ms, %.0f MB/s decoded\n", names[i], containers[i].size(),
+               containers[i].size() / rawLength, best * 1000, file.payload.size() / best / 1e6);
+    }
+    return 0;
+}
+
+static int query(const Arguments &arguments) {
+    // A filter loaded into this process, one attached from a publisher, or an exact set
+    unique_ptr<const FrozenBloomFilter> filter;
+    unique_ptr<SharedBloomFilterReader> reader;
+    shared_ptr<const BloomFilterView> sharedFilter;
+    unique_ptr<PerfectDomainSet> set;
+    unique_ptr<RibbonDomainMap> map;
+    unique_ptr<BitSlicedBloomIndex> index;
+    if (arguments.has("index")) {
+        index = make_unique<BitSlicedBloomIndex>(BitSlicedBloomIndex::readFromFile(arguments.get("index")));
+    } else if (arguments.has("map")) {
+        map = make_unique<RibbonDomainMap>(RibbonDomainMap::mapFile(arguments.get("map")));
+    } else if (arguments.has("set")) {
+        set = make_unique<PerfectDomainSet>(PerfectDomainSet::mapFile(arguments.get("set")));
+    } else if (arguments.has("shared")) {
+        reader = make_unique<SharedBloomFilterReader>(arguments.get("shared"));
+        sharedFilter = reader->current();
+        if (sharedFilter == nullptr) {
+            throw runtime_error("Nothing is published under " + arguments.get("shared"));
+        }
+    } else {
+        // Frozen, so the probing threads share it without copies or metrics
+        BloomFilterBuilder builder(loadFilterFile(arguments.positional[0], arguments).takeFilter());
+        filter = make_unique<const FrozenBloomFilter>(builder.freeze());
+    }
+    size_t threadCount = threadCountOption(arguments);
+    if (threadCount == 0) {
+        threadCount = max<size_t>(thread::hardware_concurrency(), 1);
+    }
+    bool positivesOnly = arguments.has("positives-only");
+
+    size_t queried = 0;
+    size_t positives = 0;
+    auto start = chrono::steady_clock::now();
+
+    string pending;
+    string output;
+    vector<char> chunk(READ_CHUNK_SIZE);
+    vector<string_view> batch;
+    // 0 for a miss, otherwise 1, for a map the ID + 1 and for an index the mask
+    vector<uint64_t> results;
+    batch.reserve(QUERY_BATCH_SIZE);
+
+    auto flush = [&]() {
+        results.assign(batch.size(), 0);
+        size_t workers = min(threadCount, max<size_t>(batch.size() / 4096, 1));
+        auto probe = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                uint32_t id;
+                if (index != nullptr) {
+                    results[i] = index->query(batch[i]);
+                } else if (map != nullptr) {
+                    results[i] = map->find(batch[i], id) ? (uint64_t) id + 1 : 0;
+                } else if (set != nullptr) {
+                    results[i] = set->contains(batch[i]);
+                } else {
+                    results[i] = sharedFilter != nullptr ? sharedFilter->contains(batch[i]) : filter->contains(batch[i]);
+                }
+            }
+        };
+        if (workers == 1) {
+            probe(0, batch.size());
+        } else {
+            vector<thread> threads;
+            size_t share = (batch.size() + workers - 1) / workers;
+            for (size_t begin = 0; begin < batch.size(); begin += share) {
+                threads.emplace_back(probe, begin, min(begin + share, batch.size()));
+            }
+            for (auto &worker : threads) {
+                worker.join();
+            }
+        }
+
+        output.clear();
+        for (size_t i = 0; i < batch.size(); i++) {
+            positives += results[i] != 0;
+            if (positivesOnly && !results[i]) {
+                continue;
+            }
+            if (index != nullptr) {
+                char mask[17];
+                snprintf(mask, sizeof(mask), "%llx", (unsigned long long) results[i]);
+                output.append(mask);
+                output.push_back('\t');
+            } else if (map != nullptr) {
+                output.append(results[i] != 0 ? to_string(results[i] - 1) : "-");
+                output.push_back('\t');
+            } else if (!positivesOnly) {
+                output.push_back(results[i] ? '1' : '0');
+                output.push_back('\t');
+            }
+            output.append(batch[i].data(), batch[i].size());
+            output.push_back('\n');
+        }
+        fwrite(output.data(), 1, output.size(), stdout);
+        queried += batch.size();
+        batch.clear();
+    };
+
+    size_t bytesRead;
+    do {
+        bytesRead = fread(chunk.data(), 1, chunk.size(), stdin);
+        pending.append(chunk.data(), bytesRead);
+
+        // Lines are views into `pending`, so it is only compacted after a flush
+        size_t lineStart = 0;
+        size_t lineEnd;
+        while ((lineEnd = pending.find('\n', lineStart)) != string::npos || (bytesRead == 0 && lineStart < pending.size())) {
+            if (lineEnd == string::npos) {
+                lineEnd = pending.size();
+            }
+            string_view line(pending.data() + lineStart, lineEnd - lineStart);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!line.empty()) {
+                batch.push_back(line);
+            }
+            lineStart = min(lineEnd + 1, pending.size());
+            if (batch.size() == QUERY_BATCH_SIZE) {
+                flush();
+            }
+        }
+        flush();
+        pending.erase(0, lineStart);
+    } while (bytesRead > 0);
+
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%zu queried, %zu positive, %.3f s, %.0f lookups/s\n",
+            queried, positives, elapsed, elapsed > 0 ? queried / elapsed : 0.0);
+    return 0;
+}
+
+static int publish(const Arguments &arguments) {
+    BloomFilterFile file = loadFilterFile(arguments.positional[0], arguments);
+    SharedBloomFilterPublisher publisher(arguments.positional[1]);
+    uint64_t generation = publisher.publish(file.makeFilter(), file.header.maxItems);
+    printf("published %s generation %llu, %llu bytes\n", arguments.positional[1].c_str(),
+           (unsigned long long) generation, (unsigned long long) file.header.payloadLength);
+    fflush(stdout);
+
+    // The segments go away with the publisher
+    while (fgetc(stdin) != EOF) {
+    }
+    return 0;
+}
+
+static Arguments parseArguments(int argc, char **argv) {
+    Arguments arguments;
+    for (int i = 0; i < argc; i++) {
+        string argument = argv[i];
+        if (argument.rfind("--", 0) != 0) {
+            arguments.positional.push_back(argument);
+            continue;
+        }
+
+        string name = argument.substr(2);
+        // Flags without a value
+        if (name == "positives-only" || name == "hashes-only") {
+            arguments.options[name] = "";
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw runtime_error("Missing value for " + argument);
+        }
+        arguments.options[name] = argv[++i];
+    }
+    return arguments;
+}
+
+bool Arguments::has(const string &name) const {
+    return options.count(name) != 0;
+}
+
+string Arguments::get(const string &name, const string &fallback) const {
+    auto option = options.find(name);
+    return option == options.end() ? fallback : option->second;
+}
+
+size_t Arguments::getSize(const string &name, size_t fallback) const {
+    if (!has(name)) {
+        return fallback;
+    }
+    string value = get(name);
+    char *end;
+    unsigned long long parsed = strtoull(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0') {
+        throw runtime_error("--" + name + " expects a number");
+    }
+    return (size_t) parsed;
+}
+
+double Arguments::getDouble(const string &name, double fallback) const {
+    if (!has(name)) {
+        return fallback;
+    }
+    string value = get(name);
+    char *end;
+    double parsed = strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0') {
+        throw runtime_error("--" + name + " expects a number");
+    }
+    return parsed;
+}
+
+static Specification readSpecification(const string &path) {
+    JSONValue json = JSONReader::parseFile(path);
+    Specification spec;
+    spec.bitCount = (size_t) json.at("bitCount").asNumber();
+    spec.errorRate = json.at("errorRate").asNumber();
+    spec.totalEntries = (size_t) json.at("totalEntries").asNumber();
+    spec.sha256 = json.at("sha256").asString();
+    return spec;
+}
+
+static BloomFilterFile loadFilterFile(const string &path, const Arguments &arguments) {
+    if (BloomFilterFile::isContainer(path)) {
+        return BloomFilterFile::readContainer(path);
+    }
+
+    if (arguments.has("spec")) {
+        Specification spec = readSpecification(arguments.get("spec"));
+        return BloomFilterFile::readLegacy(path, spec.bitCount, spec.totalEntries);
+    }
+    if (!arguments.has("bit-count") || !arguments.has("max-items")) {
+        throw runtime_error(path + " is a legacy filter, pass --spec or --bit-count and --max-items");
+    }
+    return BloomFilterFile::readLegacy(path, arguments.getSize("bit-count", 0), arguments.getSize("max-items", 0));
+}
+
+static BloomFilterFileFormat parseFormat(const string &name) {
+    if (name == "legacy") {
+        return BloomFilterFileFormat::legacy;
+    }
+    if (name == "container") {
+        return BloomFilterFileFormat::container;
+    }
+    if (name == "compressed") {
+        return BloomFilterFileFormat::compressed;
+    }
+    throw runtime_error("Unknown format " + name);
+}
+
+static const char *formatName(BloomFilterFileFormat format) {
+    switch (format) {
+    case BloomFilterFileFormat::legacy:
+        return "legacy";
+    case BloomFilterFileFormat::container:
+        return "container";
+    case BloomFilterFileFormat::compressed:
+        return "compressed";
+    }
+    return "unknown";
+}
+
+static string readText(const string &path) {
+    ifstream in(path, ifstream::binary);
+    if (!in) {
+        throw runtime_error("Can't read " + path);
+    }
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static string createTemporaryFile() {
+    const char *directory = getenv("TMPDIR");
+    string path = string(directory != nullptr && *directory != '\0' ? directory : "/tmp") + "/bloomtool-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        throw runtime_error("Can't create a temporary file in " + path.substr(0, path.rfind('/')) + ": " + strerror(errno));
+    }
+    close(fd);
+    return path;
+}
+
+static vector<string_view> splitLines(const string &text) {
+    vector<string_view> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == string::npos) {
+            end = text.size();
+        }
+        string_view line(text.data() + start, end - start);
+        while (!line.empty() && isspace((unsigned char) line.back())) {
+            line.remove_suffix(1);
+        }
+        while (!line.empty() && isspace((unsigned char) line.front())) {
+            line.remove_prefix(1);
+        }
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+        start = end + 1;
+    }
+    return lines;
+}
+
+static size_t threadCountOption(const Arguments &arguments) {
+    return arguments.getSize("threads", 0);
+}
+
+static void printStats(const BloomFilterStats &stats) {
+    printf("set bits       %zu\n", stats.setBits);
+    printf("fill ratio     %.4f\n", stats.fillRatio);
+    printf("est. FPR       %.3g\n", stats.falsePositiveRate);
+    printf("est. items     %.0f\n", stats.estimatedItemCount);
+    printf("byte entropy   %.3f (expected %.3f)\n", stats.byteEntropy, stats.expectedByteEntropy);
+    if (stats.hashRounds == 0) {
+        printf("warning: zero hash rounds, every lookup is positive\n");
+    }
+}
+
+static int evaluateRules(const Arguments &arguments) {
+    auto start = chrono::steady_clock::now();
+    ContentRuleList rules = ContentRuleList::parseFile(arguments.positional[0]);
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%zu rules, %zu unsupported, %zu unindexed, parsed in %.3f s\n",
+            rules.size(), rules.unsupportedRuleCount(), rules.unindexedRuleCount(), elapsed);
+
+    size_t evaluated = 0;
+    size_t blocked = 0;
+    size_t regexesTested = 0;
+    string line;
+    string output;
+    start = chrono::steady_clock::now();
+    while (getline(cin, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+
+        // Missing fields leave the request first party with no resource type
+        vector<string_view> fields;
+        string_view rest(line);
+        size_t tab;
+        while ((tab = rest.find('\t')) != string_view::npos) {
+            fields.push_back(rest.substr(0, tab));
+            rest.remove_prefix(tab + 1);
+        }
+        fields.push_back(rest);
+        fields.resize(4);
+
+        ContentRuleRequest request { fields[0], fields[1], ContentRuleList::resourceTypeNamed(fields[2]), fields[3] == "third-party" };
+        if (!fields[2].empty() && request.resourceType == 0) {
+            throw runtime_error("Unknown resource type " + string(fields[2]));
+        }
+        ContentRuleDecision decision = rules.evaluate(request);
+        evaluated++;
+        blocked += decision.block;
+        regexesTested += decision.regexesTested;
+
+        output.assign(decision.block ? "block\t" : "allow\t");
+        for (size_t i = 0; i < decision.rules.size(); i++) {
+            output.append(i > 0 ? "," : "");
+            output.append(to_string(decision.rules[i]));
+        }
+        output.push_back('\t');
+        output.append(fields[0]);
+        output.push_back('\n');
+        fwrite(output.data(), 1, output.size(), stdout);
+    }
+
+    elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%zu evaluated, %zu blocked, %.1f regexes per request, %.3f s, %.0f requests/s\n",
+            evaluated, blocked, evaluated > 0 ? (double) regexesTested / evaluated : 0.0,
+            elapsed, elapsed > 0 ? evaluated / elapsed : 0.0);
+    return 0;
+}
+
+static int ask(const Arguments &arguments) {
+    BloomdOperation operation = parseOperation(arguments.get("operation", "upgrade"));
+    size_t batchSize = max<size_t>(arguments.getSize("batch", ASK_BATCH_SIZE), 1);
+    string text((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+    vector<string_view> lines = splitLines(text);
+
+    // Each line is one item, or a URL and a site host for the allowlist
+    vector<string_view> items;
+    for (string_view line : lines) {
+        if (operation != BloomdOperation::trackerAllowlisted) {
+            items.push_back(line);
+            continue;
+        }
+        size_t tab = line.find('\t');
+        if (tab == string_view::npos) {
+            throw runtime_error("Expected \"<url>\\t<site host>\": " + string(line));
+        }
+        items.push_back(line.substr(0, tab));
+        items.push_back(line.substr(tab + 1));
+    }
+    size_t itemsPerLine = operation == BloomdOperation::trackerAllowlisted ? 2 : 1;
+    size_t batchCount = (lines.size() + batchSize - 1) / batchSize;
+
+    signal(SIGPIPE, SIG_IGN);
+    int fd = connectTo(arguments.positional[0]);
+    auto start = chrono::steady_clock::now();
+
+    // Every batch is sent without waiting for answers, which are read here meanwhile
+    thread writer([&]() {
+        vector<char> frames;
+        for (size_t batch = 0; batch < batchCount; batch++) {
+            auto first = items.begin() + batch * batchSize * itemsPerLine;
+            auto last = items.begin() + min(lines.size(), (batch + 1) * batchSize) * itemsPerLine;
+            BloomdProtocol::appendRequest(frames, (uint32_t) batch, operation, vector<string_view>(first, last));
+            if (frames.size() >= READ_CHUNK_SIZE || batch + 1 == batchCount) {
+                sendAll(fd, frames);
+                frames.clear();
+            }
+        }
+        shutdown(fd, SHUT_WR);
+    });
+
+    vector<char> input;
+    size_t inputLength = 0;
+    BloomdResponse response;
+    size_t answered = 0;
+    string output;
+    bool failed = false;
+    while (answered < batchCount && !failed) {
+        input.resize(inputLength + READ_CHUNK_SIZE);
+        ssize_t received = recv(fd, input.data() + inputLength, READ_CHUNK_SIZE, 0);
+        if (received <= 0) {
+            fprintf(stderr, "bloomtool: connection closed after %zu of %zu batches\n", answered, batchCount);
+            failed = true;
+            break;
+        }
+        inputLength += (size_t) received;
+
+        size_t consumed = 0;
+        size_t frameLength;
+        while ((frameLength = BloomdProtocol::frameLength(input.data() + consumed, inputLength - consumed)) != 0) {
+            const char *payload = input.data() + consumed + BloomdProtocol::FRAME_PREFIX_LENGTH;
+            consumed += frameLength;
+            if (!BloomdProtocol::decodeResponse(payload, frameLength - BloomdProtocol::FRAME_PREFIX_LENGTH, response)
+                || response.status != BloomdStatus::ok) {
+                fprintf(stderr, "bloomtool: batch %u failed with status %d\n", response.requestID, (int) response.status);
+                failed = true;
+                break;
+            }
+            size_t firstLine = (size_t) response.requestID * batchSize;
+            for (size_t i = 0; i < response.results.size() && firstLine + i < lines.size(); i++) {
+                uint64_t result = response.results[i];
+                if (operation == BloomdOperation::upgrade) {
+                    output += result < size(VERDICT_NAMES) ? VERDICT_NAMES[result] : "?";
+                } else if (operation == BloomdOperation::trackerEntity) {
+                    output += result == BloomdProtocol::NO_ENTITY ? "-" : to_string(result);
+                } else if (operation == BloomdOperation::domainLists) {
+                    char mask[17];
+                    snprintf(mask, sizeof(mask), "%llx", (unsigned long long) result);
+                    output += mask;
+                } else {
+                    output += to_string(result);
+                }
+                output += '\t';
+                output.append(lines[firstLine + i].data(), lines[firstLine + i].size());
+                output += '\n';
+            }
+            answered++;
+        }
+        memmove(input.data(), input.data() + consumed, inputLength - consumed);
+        inputLength -= consumed;
+        fwrite(output.data(), 1, output.size(), stdout);
+        output.clear();
+    }
+    if (failed) {
+        // Unblocks the writer should the daemon have stopped reading
+        shutdown(fd, SHUT_RDWR);
+    }
+    writer.join();
+    close(fd);
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%zu lines in %zu batches, %.3f s, %.2f us per line\n",
+            lines.size(), batchCount, seconds, lines.empty() ? 0.0 : seconds * 1e6 / lines.size());
+    return failed ? 1 : 0;
+}
+
+static BloomdOperation parseOperation(const string &name) {
+    if (name == "upgrade") {
+        return BloomdOperation::upgrade;
+    }
+    if (name == "upgrade-failed") {
+        return BloomdOperation::upgradeFailed;
+    }
+    if (name == "tracker-entity") {
+        return BloomdOperation::trackerEntity;
+    }
+    if (name == "tracker-allowlisted") {
+        return BloomdOperation::trackerAllowlisted;
+    }
+    if (name == "domain-lists") {
+        return BloomdOperation::domainLists;
+    }
+    throw runtime_error("Unknown operation " + name);
+}
+
+static int connectTo(const string &path) {
+    sockaddr_un address {};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("Socket path too long: " + path);
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (const sockaddr *) &address, sizeof(address)) != 0) {
+        int error = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw runtime_error("Can't connect to " + path + ": " + strerror(error));
+    }
+    return fd;
+}
+
+static void sendAll(int fd, const vector<char> &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t written = send(fd, data.data() + sent, data.size() - sent, 0);
+        if (written < 0 && errno != EINTR) {
+            return;
+        }
+        sent += written > 0 ? (size_t) written : 0;
+    }
+}
@@ -18,10 +18,12 @@
 //
 
 #import "BloomFilterWrapper.h"
-#import "BloomFilter.hpp"
+#import "BloomFilterWrapperInternal.h"
+#import "BloomFilterFile.hpp"
+#import "BloomFilterMetrics.hpp"
 
 @interface BloomFilterWrapper() {
-    BloomFilter *filter;
+    std::shared_ptr<BloomFilter> filter;
 }
 @end
 
@@ -31,7 +33,31 @@
     self = [super init];
     if (self != nil) {
         NSLog(@"Bloom: Importing data from %@", path);
-        filter = new BloomFilter([path cStringUsingEncoding: NSString.defaultCStringEncoding], bitCount, totalItems);
+        try {
+            filter = std::make_shared<BloomFilter>([path cStringUsingEncoding: NSString.defaultCStringEncoding], bitCount, totalItems);
+        } catch (const std::exception &error) {
+            NSLog(@"Bloom: Rejected data from %@: %s", path, error.what());
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (instancetype)initFromPath:(NSString*)path withBitCount:(int)bitCount andTotalItems:(int)totalItems sha256:(NSString*)sha256 {
+    self = [super init];
+    if (self != nil) {
+        NSLog(@"Bloom: Importing verified data from %@", path);
+        try {
+            SHA256::Digest expected;
+            if (sha256 == nil || !SHA256::fromHex([sha256 UTF8String], expected)) {
+                throw std::runtime_error("Invalid SHA-256");
+            }
+            BloomFilterFile file = BloomFilterFile::readLegacy([path cStringUsingEncoding: NSString.defaultCStringEncoding], bitCount, totalItems, expected);
+            filter = std::make_shared<BloomFilter>(file.takeFilter());
+        } catch (const std::exception &error) {
+            NSLog(@"Bloom: Rejected data from %@: %s", path, error.what());
+            return nil;
+        }
     }
     return self;
 }
@@ -39,26 +65,95 @@
 - (instancetype)initWithTotalItems:(int)count errorRate:(double)errorRate {
     self = [super init];
     if (self != nil) {
-        filter = new BloomFilter(count, errorRate);
+        try {
+            filter = std::make_shared<BloomFilter>(count, errorRate);
+        } catch (const std::exception &error) {
+            NSLog(@"Bloom: Invalid parameters: %s", error.what());
+            return nil;
+        }
     }
     return self;
 }
 
 - (void)dealloc {
-	delete filter;
+	filter.reset();
 }
 
 - (void)add:(NSString*)entry {
-    if (filter != nil) {
+    if (filter != nullptr) {
         filter->add([entry UTF8String]);
     }
 }
 
 - (BOOL)contains:(NSString*)entry {
-    if (filter == nil || entry == nil) {
+    if (filter == nullptr || entry == nil) {
+        return false;
+    }
+    if (!BloomFilterMetrics::isEnabled() || !BloomFilterMetrics::shouldSampleWrapperLatency()) {
+        return filter->contains([entry UTF8String]);
+    }
+
+    uint64_t start = BloomFilterMetrics::now();
+    BOOL result = filter->contains([entry UTF8String]);
+    BloomFilterMetrics::recordWrapperLatency(BloomFilterMetrics::now() - start);
+    return result;
+}
+
+- (NSString*)longestContainedSuffixOf:(NSString*)host {
+    if (filter == nullptr || host == nil) {
+        return nil;
+    }
+    std::string_view suffix = filter->containsAnySuffix([host UTF8String]);
+    if (suffix.empty()) {
+        return nil;
+    }
+    return [[NSString alloc] initWithBytes:suffix.data() length:suffix.size() encoding:NSUTF8StringEncoding];
+}
+
+- (std::shared_ptr<BloomFilter>)nativeFilter {
+    return filter;
+}
+
+- (double)fillRatio {
+    return filter == nullptr ? 0 : filter->stats().fillRatio;
+}
+
+- (double)estimatedFalsePositiveRate {
+    return filter == nullptr ? 1 : filter->stats().falsePositiveRate;
+}
+
+- (double)estimatedItemCount {
+    return filter == nullptr ? 0 : filter->stats().estimatedItemCount;
+}
+
+- (BOOL)isValidForErrorRate:(double)errorRate {
+    if (filter == nullptr) {
         return false;
     }
-    return filter->contains([entry UTF8String]);
+    BloomFilterStats stats = filter->stats();
+    return stats.isWithinErrorRate(errorRate) && stats.hasExpectedEntropy();
+}
+
++ (void)setMetricsEnabled:(BOOL)enabled {
+    BloomFilterMetrics::setEnabled(enabled);
+}
+
++ (void)setMetricsLatencySampleInterval:(uint32_t)interval {
+    BloomFilterMetrics::setLatencySampleInterval(interval);
+}
+
++ (NSDictionary<NSString*, NSNumber*>*)metricsSnapshot {
+    BloomFilterMetricsSnapshot snapshot = BloomFilterMetrics::snapshot();
+    return @{
+        @"lookups": @(snapshot.lookups),
+        @"positives": @(snapshot.positives),
+        @"hitRatio": @(snapshot.hitRatio()),
+        @"averageRoundsProbed": @(snapshot.averageRoundsProbed()),
+        @"probeLatencyP50": @(snapshot.probeLatency.valueAtPercentile(50)),
+        @"probeLatencyP99": @(snapshot.probeLatency.valueAtPercentile(99)),
+        @"wrapperLatencyP50": @(snapshot.wrapperLatency.valueAtPercentile(50)),
+        @"wrapperLatencyP99": @(snapshot.wrapperLatency.valueAtPercentile(99))
+    };
 }
 
 @end
@@ -0,0 +1,56 @@
+//
+//  DomainArenaAPI.mm
+//  DuckDuckGo
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <cstring>
+#import "DomainArena.h"
+#import "DomainArena.hpp"
+
+uint32_t DomainArenaIntern(const char *domain, size_t length) {
+    try {
+        return DomainArena::shared().intern(std::string_view(domain, length));
+    } catch (const std::exception &error) {
+        NSLog(@"Bloom: Can't intern domain: %s", error.what());
+        return DomainArenaInvalidID;
+    }
+}
+
+bool DomainArenaFind(const char *domain, size_t length, uint32_t *domainID) {
+    uint32_t found;
+    if (!DomainArena::shared().find(std::string_view(domain, length), found) || found >= DomainArena::shared().size()) {
+        return false;
+    }
+    *domainID = found;
+    return true;
+}
+
+size_t DomainArenaCopyDomain(uint32_t domainID, char *buffer, size_t capacity) {
+    // IDs at or beyond the count have no record, their segment may not even exist
+    if (domainID >= DomainArena::shared().size()) {
+        return 0;
+    }
+    std::string_view domain = DomainArena::shared().domain(domainID);
+    if (buffer != nullptr && domain.size() <= capacity) {
+        memcpy(buffer, domain.data(), domain.size());
+    }
+    return domain.size();
+}
+
+size_t DomainArenaGetCount(void) {
+    return DomainArena::shared().size();
+}
@@ -0,0 +1,151 @@
+//
+//  HTTPSUpgradeEngineAPI.mm
+//  DuckDuckGo
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import "HTTPSUpgradeEngine.h"
+#import "HTTPSUpgradeEngine.hpp"
+#import "BloomFilterBuilder.hpp"
+#import "BloomFilterWrapperInternal.h"
+
+// Failing hosts are rare, a false positive only skips one upgrade for a while
+static const double FAILURE_ERROR_RATE = 0.0001;
+
+struct HTTPSUpgradeEngineHandle {
+    HTTPSUpgradeEngine engine;
+
+    explicit HTTPSUpgradeEngineHandle(size_t decisionCacheCapacity) : engine(decisionCacheCapacity) {}
+};
+
+static std::vector<std::string> makeDomains(const char *const *domains, size_t count) {
+    return domains == nullptr ? std::vector<std::string>() : std::vector<std::string>(domains, domains + count);
+}
+
+HTTPSUpgradeEngineHandle *HTTPSUpgradeEngineCreate(size_t decisionCacheCapacity) {
+    return new HTTPSUpgradeEngineHandle(decisionCacheCapacity);
+}
+
+void HTTPSUpgradeEngineRelease(HTTPSUpgradeEngineHandle *engine) {
+    delete engine;
+}
+
+void HTTPSUpgradeEngineSetUpgradeList(HTTPSUpgradeEngineHandle *engine,
+                                      BloomFilterWrapper *filter,
+                                      const char *const *excludedDomains,
+                                      size_t excludedDomainCount) {
+    try {
+        // Frozen from the wrapper's bits, so later adds to it aren't seen
+        std::shared_ptr<BloomFilter> nativeFilter = filter == nil ? nullptr : [filter nativeFilter];
+        std::shared_ptr<const FrozenBloomFilter> frozen;
+        if (nativeFilter != nullptr) {
+            BloomFilterBuilder builder(*nativeFilter);
+            frozen = std::make_shared<const FrozenBloomFilter>(builder.freeze());
+        }
+        engine->engine.setUpgradeList(frozen, makeDomains(excludedDomains, excludedDomainCount));
+    } catch (const std::exception &error) {
+        // Keeps the previous list
+        NSLog(@"Bloom: Can't set the upgrade list: %s", error.what());
+    }
+}
+
+bool HTTPSUpgradeEngineSetExcludedDomains(HTTPSUpgradeEngineHandle *engine,
+                                          const char *const *excludedDomains,
+                                          size_t excludedDomainCount) {
+    try {
+        engine->engine.setExcludedDomains(makeDomains(excludedDomains, excludedDomainCount));
+        return true;
+    } catch (const std::exception &error) {
+        NSLog(@"Bloom: Can't set the excluded domains: %s", error.what());
+        return false;
+    }
+}
+
+bool HTTPSUpgradeEngineSetFeatureState(HTTPSUpgradeEngineHandle *engine,
+                                       bool enabled,
+                                       const char *const *exceptionDomains,
+                                       size_t exceptionDomainCount,
+                                       const char *const *unprotectedDomains,
+                                       size_t unprotectedDomainCount) {
+    try {
+        engine->engine.setFeatureState(enabled,
+                                       makeDomains(exceptionDomains, exceptionDomainCount),
+                                       makeDomains(unprotectedDomains, unprotectedDomainCount));
+        return true;
+    } catch (const std::exception &error) {
+        // Keeps the previous state
+        NSLog(@"Bloom: Can't set the feature state: %s", error.what());
+        return false;
+    }
+}
+
+bool HTTPSUpgradeEngineSetFailureMemory(HTTPSUpgradeEngineHandle *engine, size_t capacity, double ttlSeconds) {
+    if (capacity == 0) {
+        engine->engine.setFailureMemory(nullptr);
+        return true;
+    }
+    try {
+        auto ttl = std::chrono::duration_cast<AgePartitionedBloomFilter::Clock::duration>(std::chrono::duration<double>(ttlSeconds));
+        engine->engine.setFailureMemory(std::make_shared<AgePartitionedBloomFilter>(capacity, FAILURE_ERROR_RATE, ttl));
+        return true;
+    } catch (const std::exception &error) {
+        NSLog(@"Bloom: Invalid failure memory: %s", error.what());
+        return false;
+    }
+}
+
+bool HTTPSUpgradeEngineRecordUpgradeFailure(HTTPSUpgradeEngineHandle *engine, const char *host, size_t length) {
+    return engine->engine.recordUpgradeFailure(std::string_view(host, length));
+}
+
+HTTPSUpgradeEngineVerdict HTTPSUpgradeEngineDecide(HTTPSUpgradeEngineHandle *engine,
+                                                   const char *url,
+                                                   size_t length,
+                                                   char *output,
+                                                   size_t capacity,
+                                                   size_t *outputLength) {
+    size_t written;
+    HTTPSUpgradeVerdict verdict = engine->engine.decide(url, length, output, capacity, written);
+    if (outputLength != nullptr) {
+        *outputLength = written;
+    }
+
+    switch (verdict) {
+        case HTTPSUpgradeVerdict::upgrade:
+            return HTTPSUpgradeEngineVerdictUpgrade;
+        case HTTPSUpgradeVerdict::notHTTP:
+            return HTTPSUpgradeEngineVerdictNotHTTP;
+        case HTTPSUpgradeVerdict::invalidHost:
+            return HTTPSUpgradeEngineVerdictInvalidHost;
+        case HTTPSUpgradeVerdict::featureDisabled:
+            return HTTPSUpgradeEngineVerdictFeatureDisabled;
+        case HTTPSUpgradeVerdict::excluded:
+            return HTTPSUpgradeEngineVerdictExcluded;
+        case HTTPSUpgradeVerdict::notInUpgradeList:
+            return HTTPSUpgradeEngineVerdictNotInUpgradeList;
+        case HTTPSUpgradeVerdict::bufferTooSmall:
+            return HTTPSUpgradeEngineVerdictBufferTooSmall;
+        case HTTPSUpgradeVerdict::recentlyFailed:
+            return HTTPSUpgradeEngineVerdictRecentlyFailed;
+    }
+    return HTTPSUpgradeEngineVerdictNotInUpgradeList;
+}
+
+void HTTPSUpgradeEngineGetCacheStats(const HTTPSUpgradeEngineHandle *engine, uint64_t *hits, uint64_t *misses) {
+    HostDecisionCacheStats stats = engine->engine.cacheStats();
+    *hits = stats.hits;
+    *misses = stats.misses;
+}
@@ -0,0 +1,74 @@
+//
+//  TrackerAllowlistAPI.mm
+//  DuckDuckGo
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <memory>
+#import <vector>
+#import "TrackerAllowlist.h"
+#import "TrackerAllowlist.hpp"
+
+struct TrackerAllowlistHandle {
+    std::vector<TrackerAllowlistEntry> pending;
+    std::shared_ptr<const TrackerAllowlist> current = std::make_shared<const TrackerAllowlist>(std::vector<TrackerAllowlistEntry>());
+};
+
+TrackerAllowlistHandle *TrackerAllowlistCreate(void) {
+    return new TrackerAllowlistHandle();
+}
+
+void TrackerAllowlistRelease(TrackerAllowlistHandle *allowlist) {
+    delete allowlist;
+}
+
+void TrackerAllowlistAddEntry(TrackerAllowlistHandle *allowlist,
+                              const char *trackerDomain,
+                              const char *rule,
+                              const char *const *domains,
+                              size_t domainCount) {
+    TrackerAllowlistEntry entry { trackerDomain, rule, {} };
+    if (domains != nullptr) {
+        entry.domains.assign(domains, domains + domainCount);
+    }
+    allowlist->pending.push_back(std::move(entry));
+}
+
+bool TrackerAllowlistCompile(TrackerAllowlistHandle *allowlist) {
+    std::vector<TrackerAllowlistEntry> pending = std::move(allowlist->pending);
+    allowlist->pending.clear();
+    try {
+        auto compiled = std::make_shared<const TrackerAllowlist>(pending);
+        std::atomic_store(&allowlist->current, compiled);
+        return true;
+    } catch (const std::exception &error) {
+        NSLog(@"Bloom: Can't compile the tracker allowlist: %s", error.what());
+        return false;
+    }
+}
+
+bool TrackerAllowlistIsAllowlisted(TrackerAllowlistHandle *allowlist,
+                                   const char *requestURL,
+                                   size_t requestURLLength,
+                                   const char *siteHost,
+                                   size_t siteHostLength) {
+    auto current = std::atomic_load(&allowlist->current);
+    return current->isAllowlisted(std::string_view(requestURL, requestURLLength), std::string_view(siteHost, siteHostLength));
+}
+
+size_t TrackerAllowlistGetRuleCount(TrackerAllowlistHandle *allowlist) {
+    return std::atomic_load(&allowlist->current)->size();
+}
@@ -18,10 +18,28 @@
 //
 #import <Foundation/Foundation.h>
 
+// Every initializer returns nil for a missing, truncated or corrupt file, or
+// for parameters no filter can have.
 @interface BloomFilterWrapper : NSObject
 - (instancetype)initFromPath:(NSString*)path withBitCount:(int)bitCount andTotalItems:(int)totalItems;
+// Checks the data against the hexadecimal SHA-256 of its specification while
+// reading it, so the file is only read once. Returns nil on a mismatch too.
+- (instancetype)initFromPath:(NSString*)path withBitCount:(int)bitCount andTotalItems:(int)totalItems sha256:(NSString*)sha256;
 - (instancetype)initWithTotalItems:(int)count errorRate:(double)errorRate;
 - (void)dealloc;
 - (void)add:(NSString*) entry;
 - (BOOL)contains:(NSString*) entry;
+// The longest of host and its parent domains that the filter contains, nil if none
+- (NSString*)longestContainedSuffixOf:(NSString*)host;
+
+// Computed from the bits actually set, see BloomFilterStats
+@property (nonatomic, readonly) double fillRatio;
+@property (nonatomic, readonly) double estimatedFalsePositiveRate;
+@property (nonatomic, readonly) double estimatedItemCount;
+- (BOOL)isValidForErrorRate:(double)errorRate;
+
+// Lookup instrumentation is off by default and shared by all filters in the process
++ (void)setMetricsEnabled:(BOOL)enabled;
++ (void)setMetricsLatencySampleInterval:(uint32_t)interval;
++ (NSDictionary<NSString*, NSNumber*>*)metricsSnapshot;
 @end
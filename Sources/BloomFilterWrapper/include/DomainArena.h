@@ -0,0 +1,56 @@
+//
+//  DomainArena.h
+//  DuckDuckGo
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ The domain arena shared by the native indexes. Interning returns a dense ID
+ that is the same for every caller interning the same domain, so structures
+ keeping domain IDs instead of strings can be joined by comparing IDs. Domains
+ are stored as given and expected lowercase. All functions are safe to call
+ from any thread.
+ */
+
+// Never handed out by the arena
+static const uint32_t DomainArenaInvalidID = UINT32_MAX;
+
+// Returns DomainArenaInvalidID when the arena is full or the domain too long
+uint32_t DomainArenaIntern(const char *domain, size_t length);
+
+// Returns false when the domain was never interned
+bool DomainArenaFind(const char *domain, size_t length, uint32_t *domainID);
+
+// Copies the domain of an interned ID into `buffer` without a terminating NUL
+// and returns its length. Nothing is copied when it exceeds `capacity`, and
+// IDs the arena never handed out give 0.
+size_t DomainArenaCopyDomain(uint32_t domainID, char *_Nullable buffer, size_t capacity);
+
+size_t DomainArenaGetCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+NS_ASSUME_NONNULL_END
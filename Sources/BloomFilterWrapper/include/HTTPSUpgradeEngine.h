@@ -0,0 +1,97 @@
+//
+//  HTTPSUpgradeEngine.h
+//  DuckDuckGo
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+#import "BloomFilterWrapper.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HTTPSUpgradeEngineHandle HTTPSUpgradeEngineHandle;
+
+typedef NS_ENUM(NSInteger, HTTPSUpgradeEngineVerdict) {
+    HTTPSUpgradeEngineVerdictUpgrade,
+    HTTPSUpgradeEngineVerdictNotHTTP,
+    HTTPSUpgradeEngineVerdictInvalidHost,
+    HTTPSUpgradeEngineVerdictFeatureDisabled,
+    HTTPSUpgradeEngineVerdictExcluded,
+    HTTPSUpgradeEngineVerdictNotInUpgradeList,
+    HTTPSUpgradeEngineVerdictBufferTooSmall,
+    HTTPSUpgradeEngineVerdictRecentlyFailed
+};
+
+HTTPSUpgradeEngineHandle *HTTPSUpgradeEngineCreate(size_t decisionCacheCapacity);
+
+void HTTPSUpgradeEngineRelease(HTTPSUpgradeEngineHandle *engine);
+
+// A nil filter upgrades nothing. The engine keeps a frozen copy of the filter's
+// bits, adds made afterwards aren't seen. Domains only need to stay valid for
+// the duration of the call.
+void HTTPSUpgradeEngineSetUpgradeList(HTTPSUpgradeEngineHandle *engine,
+                                      BloomFilterWrapper *_Nullable filter,
+                                      const char *_Nonnull const *_Nullable excludedDomains,
+                                      size_t excludedDomainCount);
+
+// Keeps the current filter, e.g. when a new one was rejected. Returns false
+// and keeps the previous domains if they can't be set.
+bool HTTPSUpgradeEngineSetExcludedDomains(HTTPSUpgradeEngineHandle *engine,
+                                          const char *_Nonnull const *_Nullable excludedDomains,
+                                          size_t excludedDomainCount);
+
+// Exception domains also cover their subdomains, unprotected domains only match exactly.
+// Returns false and keeps the previous state if it can't be set.
+bool HTTPSUpgradeEngineSetFeatureState(HTTPSUpgradeEngineHandle *engine,
+                                       bool enabled,
+                                       const char *_Nonnull const *_Nullable exceptionDomains,
+                                       size_t exceptionDomainCount,
+                                       const char *_Nonnull const *_Nullable unprotectedDomains,
+                                       size_t unprotectedDomainCount);
+
+// Hosts reported through HTTPSUpgradeEngineRecordUpgradeFailure aren't upgraded
+// for `ttlSeconds`, for up to `capacity` failures within that time. A capacity
+// of 0 forgets every failure. Returns false for invalid parameters.
+bool HTTPSUpgradeEngineSetFailureMemory(HTTPSUpgradeEngineHandle *engine, size_t capacity, double ttlSeconds);
+
+// For a host whose upgraded navigation failed, e.g. over TLS
+bool HTTPSUpgradeEngineRecordUpgradeFailure(HTTPSUpgradeEngineHandle *engine, const char *host, size_t length);
+
+/*
+ Decides whether the URL should be upgraded, from the URL bytes alone. On
+ HTTPSUpgradeEngineVerdictUpgrade the https URL is written to `output` with a
+ terminating NUL and its length to `outputLength`; `capacity` of `length` + 2
+ bytes is always enough. Safe to call from any thread, also while the engine
+ is being updated.
+ */
+HTTPSUpgradeEngineVerdict HTTPSUpgradeEngineDecide(HTTPSUpgradeEngineHandle *engine,
+                                                   const char *url,
+                                                   size_t length,
+                                                   char *output,
+                                                   size_t capacity,
+                                                   size_t *outputLength);
+
+void HTTPSUpgradeEngineGetCacheStats(const HTTPSUpgradeEngineHandle *engine, uint64_t *hits, uint64_t *misses);
+
+#ifdef __cplusplus
+}
+#endif
+
+NS_ASSUME_NONNULL_END
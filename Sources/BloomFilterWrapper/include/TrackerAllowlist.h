@@ -0,0 +1,65 @@
+//
+//  TrackerAllowlist.h
+//  DuckDuckGo
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TrackerAllowlistHandle TrackerAllowlistHandle;
+
+// Starts out empty, nothing is allowlisted until the first compile
+TrackerAllowlistHandle *TrackerAllowlistCreate(void);
+
+void TrackerAllowlistRelease(TrackerAllowlistHandle *allowlist);
+
+// Queues a rule for the next TrackerAllowlistCompile. Rules of a tracker are tried in the
+// order they are added. Strings only need to stay valid for the duration of the call.
+void TrackerAllowlistAddEntry(TrackerAllowlistHandle *allowlist,
+                              const char *trackerDomain,
+                              const char *rule,
+                              const char *_Nonnull const *_Nullable domains,
+                              size_t domainCount);
+
+// Replaces the matched rules with the ones queued since the last compile. When
+// they can't be compiled, returns false and keeps the previous rules; the
+// queue is emptied either way.
+bool TrackerAllowlistCompile(TrackerAllowlistHandle *allowlist);
+
+/*
+ Whether a request to `requestURL` made by a page on `siteHost` is covered by
+ the tracker allowlist, as contentblockerrules.js decides it. Safe to call from
+ any thread, also while a compile is replacing the rules.
+ */
+bool TrackerAllowlistIsAllowlisted(TrackerAllowlistHandle *allowlist,
+                                   const char *requestURL,
+                                   size_t requestURLLength,
+                                   const char *siteHost,
+                                   size_t siteHostLength);
+
+size_t TrackerAllowlistGetRuleCount(TrackerAllowlistHandle *allowlist);
+
+#ifdef __cplusplus
+}
+#endif
+
+NS_ASSUME_NONNULL_END
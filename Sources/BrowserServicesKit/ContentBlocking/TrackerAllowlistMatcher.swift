@@ -0,0 +1,71 @@
+//
+//  TrackerAllowlistMatcher.swift
+//  DuckDuckGo
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+import Foundation
+import BloomFilterWrapper
+
+/// Native evaluation of the tracker allowlist, matching what `contentblockerrules.js` decides
+/// from the injected regular expressions. Rules are compiled once per privacy configuration
+/// identifier, lookups are then safe from any thread.
+public final class TrackerAllowlistMatcher {
+
+    private let allowlist: OpaquePointer
+    private let compileLock = NSLock()
+    private var compiledIdentifier: String?
+
+    public init() {
+        allowlist = TrackerAllowlistCreate()
+    }
+
+    deinit {
+        TrackerAllowlistRelease(allowlist)
+    }
+
+    public func isAllowlisted(trackerURL: String, siteHost: String, privacyConfig: PrivacyConfiguration) -> Bool {
+        compileIfNeeded(privacyConfig)
+
+        let siteHost = siteHost.lowercased()
+        return TrackerAllowlistIsAllowlisted(allowlist, trackerURL, trackerURL.utf8.count, siteHost, siteHost.utf8.count)
+    }
+
+    private func compileIfNeeded(_ privacyConfig: PrivacyConfiguration) {
+        compileLock.lock()
+        defer { compileLock.unlock() }
+        guard privacyConfig.identifier != compiledIdentifier else { return }
+
+        for (trackerDomain, entries) in privacyConfig.trackerAllowlist {
+            for entry in entries {
+                Self.withCStrings(entry.domains) { domains, count in
+                    TrackerAllowlistAddEntry(allowlist, trackerDomain, entry.rule, domains, count)
+                }
+            }
+        }
+        // A configuration that can't be compiled keeps the previous rules (the native side logs
+        // why) and isn't retried on every lookup
+        _ = TrackerAllowlistCompile(allowlist)
+        compiledIdentifier = privacyConfig.identifier
+    }
+
+    private static func withCStrings(_ strings: [String], _ body: (UnsafePointer<UnsafePointer<CChar>>?, Int) -> Void) {
+        let cStrings = strings.map { UnsafePointer(strdup($0)!) }
+        defer { cStrings.forEach { free(UnsafeMutablePointer(mutating: $0)) } }
+        cStrings.withUnsafeBufferPointer { body($0.baseAddress, $0.count) }
+    }
+
+}
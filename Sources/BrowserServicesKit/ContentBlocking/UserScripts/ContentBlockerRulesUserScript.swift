@@ -152,10 +152,16 @@ open class ContentBlockerRulesUserScript: NSObject, UserScript {
             + "\n"
             + (privacyConfiguration.exceptionsList(forFeature: .contentBlocking).joined(separator: "\n"))
 
-        return ContentBlockerRulesUserScript.loadJS("contentblockerrules", from: Bundle.module, withReplacements: [
+        let template = loadJSTemplate("contentblockerrules", from: Bundle.module, placeholders: [
+            "$TEMP_UNPROTECTED_DOMAINS$",
+            "$USER_UNPROTECTED_DOMAINS$",
+            "$TRACKER_ALLOWLIST_ENTRIES$"
+        ])
+        return template.render(replacements: [
             "$TEMP_UNPROTECTED_DOMAINS$": remoteUnprotectedDomains,
-            "$USER_UNPROTECTED_DOMAINS$": privacyConfiguration.userUnprotectedDomains.joined(separator: "\n"),
-            "$TRACKER_ALLOWLIST_ENTRIES$": TrackerAllowlistInjection.prepareForInjection(allowlist: privacyConfiguration.trackerAllowlist)
+            "$USER_UNPROTECTED_DOMAINS$": privacyConfiguration.userUnprotectedDomains.joined(separator: "\n")
+        ], payloads: [
+            "$TRACKER_ALLOWLIST_ENTRIES$": TrackerAllowlistInjection.makeInjectionPayload(allowlist: privacyConfiguration.trackerAllowlist)
         ])
     }
 }
@@ -163,18 +169,29 @@ open class ContentBlockerRulesUserScript: NSObject, UserScript {
 public class TrackerAllowlistInjection {
 
     static public func prepareForInjection(allowlist: PrivacyConfigurationData.TrackerAllowlistData) -> String {
-        // Transform rules into regular expresions
-        var output = PrivacyConfigurationData.TrackerAllowlistData()
-        for dictEntry in allowlist {
-            let newValue = dictEntry.value.map { entry -> PrivacyConfigurationData.TrackerAllowlist.Entry in
+        return makeInjectionPayload(allowlist: allowlist).json
+    }
+
+    static func makeInjectionPayload(allowlist: PrivacyConfigurationData.TrackerAllowlistData) -> UserScriptJSONWriter {
+        let writer = UserScriptJSONWriter()
+        writer.beginObject()
+        for (trackerDomain, entries) in allowlist {
+            writer.key(trackerDomain)
+            writer.beginArray()
+            for entry in entries {
+                // Rules are injected as regular expressions, inside a template literal that consumes one level of backslashes
                 let regexp = ContentBlockerRulesBuilder.makeRegexpFilter(fromAllowlistRule: entry.rule)
-                let escapedRegexp = regexp.replacingOccurrences(of: "\\", with: "\\\\")
-                return PrivacyConfigurationData.TrackerAllowlist.Entry(rule: escapedRegexp, domains: entry.domains)
+                writer.beginObject()
+                writer.key("rule")
+                writer.string(regexp, doublingBackslashes: true)
+                writer.key("domains")
+                writer.array(of: entry.domains)
+                writer.endObject()
             }
-            output[dictEntry.key] = newValue
+            writer.endArray()
         }
-
-        return (try? String(data: JSONEncoder().encode(output), encoding: .utf8)) ?? ""
+        writer.endObject()
+        return writer
     }
 
 }
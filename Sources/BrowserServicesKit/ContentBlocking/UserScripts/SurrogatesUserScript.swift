@@ -172,14 +172,19 @@ open class SurrogatesUserScript: NSObject, UserScript {
             trackerData = String(data: encodedData!, encoding: .utf8)!
         }
 
-        return SurrogatesUserScript.loadJS("surrogates", from: Bundle.module, withReplacements: [
+        let replacements = [
             "$IS_DEBUG$": isDebugBuild ? "true" : "false",
             "$TEMP_UNPROTECTED_DOMAINS$": remoteUnprotectedDomains,
             "$USER_UNPROTECTED_DOMAINS$": privacyConfiguration.userUnprotectedDomains.joined(separator: "\n"),
-            "$TRACKER_ALLOWLIST_ENTRIES$": TrackerAllowlistInjection.prepareForInjection(allowlist: privacyConfiguration.trackerAllowlist),
             "$TRACKER_DATA$": trackerData,
             "$SURROGATES$": createSurrogateFunctions(surrogates),
             "$BLOCKING_ENABLED$": privacyConfiguration.isEnabled(featureKey: .contentBlocking) ? "true" : "false"
-        ])
+        ]
+        let payloads = [
+            "$TRACKER_ALLOWLIST_ENTRIES$": TrackerAllowlistInjection.makeInjectionPayload(allowlist: privacyConfiguration.trackerAllowlist)
+        ]
+
+        let template = loadJSTemplate("surrogates", from: Bundle.module, placeholders: Array(replacements.keys) + Array(payloads.keys))
+        return template.render(replacements: replacements, payloads: payloads)
     }
 }
@@ -41,7 +41,7 @@ public class PrivacyConfigurationManager {
     
     private let lock = NSLock()
     private let embeddedDataProvider: EmbeddedDataProvider
-    private let localProtection: DomainsProtectionStore
+    let localProtection: DomainsProtectionStore
     
     private var _fetchedConfigData: ConfigurationData?
     private(set) public var fetchedConfigData: ConfigurationData? {
@@ -110,6 +110,14 @@ public class PrivacyConfigurationManager {
                                        localProtection: localProtection)
     }
     
+    /// The identifier `privacyConfig` would have, without building it.
+    var currentIdentifier: String {
+        if let fetchedData = fetchedConfigData {
+            return fetchedData.etag
+        }
+        return embeddedConfigData.etag
+    }
+    
     public var currentConfig: Data {
         if let fetchedData = fetchedConfigData {
             return fetchedData.rawData
@@ -25,51 +25,127 @@ public struct HTTPSUpgradeError: Error {}
 
 public final class HTTPSUpgrade {
     
+    struct Constants {
+        static let decisionCacheCapacity = 4096
+        static let failureMemoryCapacity = 16384
+        static let failureMemoryTTL: TimeInterval = 300
+    }
+    
+    // Cheap to build and compare for every URL: the unprotected domains are the
+    // store's own set, which compares by identity until it changes
+    private struct FeatureStateKey: Equatable {
+        let configIdentifier: String
+        let unprotectedDomains: Set<String>
+    }
+    
     private let dataReloadLock = NSLock()
     private let store: HTTPSUpgradeStore
     private let privacyManager: PrivacyConfigurationManager
-   
-    private var bloomFilter: BloomFilterWrapper?
+    
+    // Owns the upgrade list, excluded domains and feature exceptions, and caches combined verdicts per host
+    private let engine: OpaquePointer
+    // Written under dataReloadLock
+    private var storeProvidesExcludedDomains = false
+    private let featureStateLock = NSLock()
+    private var featureStateKey: FeatureStateKey?
     
     public init(store: HTTPSUpgradeStore,
                 privacyManager: PrivacyConfigurationManager) {
         self.store = store
         self.privacyManager = privacyManager
+        self.engine = HTTPSUpgradeEngineCreate(Constants.decisionCacheCapacity)
+        _ = HTTPSUpgradeEngineSetFailureMemory(engine, Constants.failureMemoryCapacity, Constants.failureMemoryTTL)
+    }
+    
+    deinit {
+        HTTPSUpgradeEngineRelease(engine)
     }
     
     public func upgrade(url: URL) async -> Result<URL, HTTPSUpgradeError> {
-        guard url.isHttp,
-              let host = url.host,
-              !shouldExcludeDomain(host),
-              isFeatureEnabled(forHost: host, privacyConfig: privacyConfig) else {
-                  return .failure(.init())
+        updateFeatureStateIfNeeded()
+        let storeProvidesExcludedDomains = waitForAnyReloadsToComplete()
+        
+        var urlString = url.absoluteString
+        let (verdict, upgradedURLString): (HTTPSUpgradeEngineVerdict, String?) = urlString.withUTF8 { bytes in
+            guard let base = bytes.baseAddress else { return (.invalidHost, nil) }
+            var output = [CChar](repeating: 0, count: bytes.count + 2)
+            var outputLength = 0
+            let verdict = base.withMemoryRebound(to: CChar.self, capacity: bytes.count) { url in
+                HTTPSUpgradeEngineDecide(engine, url, bytes.count, &output, output.count, &outputLength)
+            }
+            return (verdict, verdict == .upgrade ? String(cString: output) : nil)
         }
         
-        waitForAnyReloadsToComplete()
-        let isUpgradable = isInUpgradeList(host: host)
-        if isUpgradable, let upgradedUrl = url.toHttps() {
+        // Includes recentlyFailed: the https version of this host failed recently,
+        // so it stays on http until the failure expires
+        guard verdict == .upgrade, let upgradedURLString = upgradedURLString else {
+            return .failure(.init())
+        }
+        if !storeProvidesExcludedDomains, let host = url.host, store.hasExcludedDomain(host) {
+            return .failure(.init())
+        }
+        if let upgradedUrl = URL(string: upgradedURLString) {
             return .success(upgradedUrl)
         }
         return .failure(.init())
     }
     
-    private var privacyConfig: PrivacyConfiguration { privacyManager.privacyConfig }
+    /// Call when an upgraded navigation fails, e.g. with a TLS error, so the host
+    /// isn't upgraded again until `Constants.failureMemoryTTL` has passed.
+    public func reportUpgradeFailure(for url: URL) {
+        guard var host = url.host, !host.isEmpty else { return }
+        host.withUTF8 { bytes in
+            guard let base = bytes.baseAddress else { return }
+            base.withMemoryRebound(to: CChar.self, capacity: bytes.count) { host in
+                _ = HTTPSUpgradeEngineRecordUpgradeFailure(engine, host, bytes.count)
+            }
+        }
+    }
     
-    private func shouldExcludeDomain(_ host: String) -> Bool { store.hasExcludedDomain(host) }
+    private var privacyConfig: PrivacyConfiguration { privacyManager.privacyConfig }
     
-    private func isFeatureEnabled(forHost host: String, privacyConfig: PrivacyConfiguration) -> Bool {
-        privacyConfig.isFeature(.httpsUpgrade, enabledForDomain: host)
+    private func updateFeatureStateIfNeeded() {
+        let key = FeatureStateKey(configIdentifier: privacyManager.currentIdentifier,
+                                  unprotectedDomains: privacyManager.localProtection.unprotectedDomains)
+        
+        featureStateLock.lock()
+        defer { featureStateLock.unlock() }
+        guard key != featureStateKey else { return }
+        
+        // Only built when the configuration or the user's choices changed
+        let privacyConfig = privacyConfig
+        let exceptionDomains = (privacyConfig.tempUnprotectedDomains + privacyConfig.exceptionsList(forFeature: .httpsUpgrade))
+            .filter { !$0.trimWhitespace().isEmpty }
+        let updated = Self.withCStrings(exceptionDomains) { exceptions, exceptionCount in
+            Self.withCStrings(privacyConfig.userUnprotectedDomains) { unprotected, unprotectedCount in
+                HTTPSUpgradeEngineSetFeatureState(engine,
+                                                  privacyConfig.isEnabled(featureKey: .httpsUpgrade),
+                                                  exceptions,
+                                                  exceptionCount,
+                                                  unprotected,
+                                                  unprotectedCount)
+            }
+        }
+        // Retried on the next URL when the engine kept its previous state
+        if updated {
+            featureStateKey = key
+        }
     }
     
-    private func waitForAnyReloadsToComplete() {
+    // Returns whether the engine was given the store's excluded domains by the last reload
+    private func waitForAnyReloadsToComplete() -> Bool {
         // wait for lock (by locking and unlocking) before continuing
         dataReloadLock.lock()
-        dataReloadLock.unlock()
+        defer { dataReloadLock.unlock() }
+        return storeProvidesExcludedDomains
     }
     
-    private func isInUpgradeList(host: String) -> Bool {
-        guard let bloomFilter = bloomFilter else { return false }
-        return bloomFilter.contains(host)
+    public var decisionCacheHitRatio: Double {
+        var hits: UInt64 = 0
+        var misses: UInt64 = 0
+        HTTPSUpgradeEngineGetCacheStats(engine, &hits, &misses)
+        let total = hits + misses
+        return total == 0 ? 0 : Double(hits) / Double(total)
     }
     
     public func loadDataAsync() {
@@ -83,8 +159,32 @@ public final class HTTPSUpgrade {
             os_log("Reload already in progress", type: .debug)
             return
         }
-        bloomFilter = store.bloomFilter
+        // The excluded domains may have changed along with the filter. The engine
+        // matches lowercase hosts.
+        let excludedDomains = store.allExcludedDomains?.map { $0.lowercased() }
+        // Only held until the engine has frozen a copy of its bits
+        let bloomFilter = store.bloomFilter
+        Self.withCStrings(excludedDomains ?? []) { domains, count in
+            if let filter = bloomFilter,
+               let specification = store.bloomFilterSpecification,
+               !filter.isValid(forErrorRate: specification.errorRate) {
+                // Keep serving the previous filter rather than upgrading hosts that will fail
+                os_log("Bloom filter rejected, estimated false positive rate %f exceeds %f",
+                       type: .error, filter.estimatedFalsePositiveRate, specification.errorRate)
+                _ = HTTPSUpgradeEngineSetExcludedDomains(engine, domains, count)
+            } else {
+                HTTPSUpgradeEngineSetUpgradeList(engine, bloomFilter, domains, count)
+            }
+        }
+        storeProvidesExcludedDomains = excludedDomains != nil
         dataReloadLock.unlock()
     }
     
+    private static func withCStrings<T>(_ strings: [String],
+                                        _ body: (UnsafePointer<UnsafePointer<CChar>>?, Int) -> T) -> T {
+        let cStrings = strings.map { UnsafePointer(strdup($0)!) }
+        defer { cStrings.forEach { free(UnsafeMutablePointer(mutating: $0)) } }
+        return cStrings.withUnsafeBufferPointer { body($0.baseAddress, $0.count) }
+    }
+    
 }
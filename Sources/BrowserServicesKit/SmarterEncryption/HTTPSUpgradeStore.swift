@@ -29,4 +29,14 @@ public protocol HTTPSUpgradeStore {
     
     func hasExcludedDomain(_ domain: String) -> Bool
     
+    /// Every excluded domain, so upgrade decisions can be made without calling back into the store.
+    /// Stores returning nil are asked with `hasExcludedDomain(_:)` for each upgradable host instead.
+    var allExcludedDomains: [String]? { get }
+    
+}
+
+public extension HTTPSUpgradeStore {
+    
+    var allExcludedDomains: [String]? { nil }
+    
 }
@@ -111,20 +111,44 @@ public final class ContentScopeUserScript: NSObject, UserScript {
 
     public static func generateSource(_ privacyConfigurationManager: PrivacyConfigurationManager, properties: ContentScopeProperties) -> String {
 
-        guard let privacyConfigJson = String(data: privacyConfigurationManager.currentConfig, encoding: .utf8),
-              let userUnprotectedDomains = try? JSONEncoder().encode(privacyConfigurationManager.privacyConfig.userUnprotectedDomains),
-              let userUnprotectedDomainsString = String(data: userUnprotectedDomains, encoding: .utf8),
-              let jsonProperties = try? JSONEncoder().encode(properties),
+        let privacyConfig = privacyConfigurationManager.privacyConfig
+        let userUnprotectedDomains = privacyConfig.userUnprotectedDomains
+        // Properties stay on JSONEncoder: their nested Encodable types define the schema
+        guard let jsonProperties = try? JSONEncoder().encode(properties),
               let jsonPropertiesString = String(data: jsonProperties, encoding: .utf8)
               else {
             return ""
         }
-        
-        return loadJS("contentScope", from: ContentScopeScripts.Bundle, withReplacements: [
-            "$CONTENT_SCOPE$": privacyConfigJson,
-            "$USER_UNPROTECTED_DOMAINS$": userUnprotectedDomainsString,
-            "$USER_PREFERENCES$": jsonPropertiesString
-        ])
+
+        let template = loadJSTemplate("contentScope", from: ContentScopeScripts.Bundle, placeholders: Placeholder.all)
+
+        // The config itself is only converted and substituted when its identifier changes
+        let cacheKey = ([privacyConfig.identifier, jsonPropertiesString] + userUnprotectedDomains).joined(separator: "\n")
+        if let source = template.cachedSource(forKey: cacheKey) {
+            return source
+        }
+
+        guard let privacyConfigJson = String(data: privacyConfigurationManager.currentConfig, encoding: .utf8) else {
+            return ""
+        }
+
+        let userUnprotectedDomainsPayload = UserScriptJSONWriter()
+        userUnprotectedDomainsPayload.array(of: userUnprotectedDomains)
+
+        return template.render(replacements: [
+            Placeholder.contentScope: privacyConfigJson,
+            Placeholder.userPreferences: jsonPropertiesString
+        ], payloads: [
+            Placeholder.userUnprotectedDomains: userUnprotectedDomainsPayload
+        ], cacheKey: cacheKey)
+    }
+
+    private enum Placeholder {
+        static let contentScope = "$CONTENT_SCOPE$"
+        static let userUnprotectedDomains = "$USER_UNPROTECTED_DOMAINS$"
+        static let userPreferences = "$USER_PREFERENCES$"
+
+        static let all = [contentScope, userUnprotectedDomains, userPreferences]
     }
 
     public func userContentController(_ userContentController: WKUserContentController, didReceive message: WKScriptMessage) {
@@ -56,18 +56,18 @@ extension UserScript {
     }
 
     public static func loadJS(_ jsFile: String, from bundle: Bundle, withReplacements replacements: [String: String] = [:]) -> String {
+        return loadJSTemplate(jsFile, from: bundle, placeholders: Array(replacements.keys)).render(replacements: replacements)
+    }
+
+    static func loadJSTemplate(_ jsFile: String, from bundle: Bundle, placeholders: [String]) -> UserScriptTemplate {
 
         let path = bundle.path(forResource: jsFile, ofType: "js")!
 
-        guard var js = try? String(contentsOfFile: path) else {
+        guard let template = UserScriptTemplate.load(path: path, placeholders: placeholders) else {
             fatalError("Failed to load JavaScript \(jsFile) from \(path)")
         }
 
-        for (key, value) in replacements {
-            js = js.replacingOccurrences(of: key, with: value, options: .literal)
-        }
-
-        return js
+        return template
     }
 
     static func makeWKUserScript(source: String, injectionTime: WKUserScriptInjectionTime,
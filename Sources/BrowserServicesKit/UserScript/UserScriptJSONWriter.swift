@@ -0,0 +1,85 @@
+//
+//  UserScriptJSONWriter.swift
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+import Foundation
+import ScriptTemplate
+
+/// Writes a JSON payload into a native buffer that `UserScriptTemplate` renders from without an intermediate `Data` or `String`.
+final class UserScriptJSONWriter {
+
+    let writer: OpaquePointer
+
+    init(capacity: Int = 0) {
+        writer = ScriptTemplateJSONWriterCreate(capacity)
+    }
+
+    deinit {
+        ScriptTemplateJSONWriterRelease(writer)
+    }
+
+    var value: ScriptTemplateValue {
+        ScriptTemplateJSONWriterGetValue(writer)
+    }
+
+    var json: String {
+        let value = self.value
+        return String(decoding: UnsafeRawBufferPointer(start: value.bytes, count: value.length), as: UTF8.self)
+    }
+
+    func beginObject() {
+        ScriptTemplateJSONWriterBeginObject(writer)
+    }
+
+    func endObject() {
+        ScriptTemplateJSONWriterEndObject(writer)
+    }
+
+    func beginArray() {
+        ScriptTemplateJSONWriterBeginArray(writer)
+    }
+
+    func endArray() {
+        ScriptTemplateJSONWriterEndArray(writer)
+    }
+
+    func key(_ key: String) {
+        var key = key
+        key.withUTF8 { utf8 in
+            utf8.withMemoryRebound(to: CChar.self) { ScriptTemplateJSONWriterKey(writer, $0.baseAddress, $0.count) }
+        }
+    }
+
+    /// - Parameter doublingBackslashes: Doubles every backslash before escaping, for payloads embedded in a JS template literal.
+    func string(_ value: String, doublingBackslashes: Bool = false) {
+        var value = value
+        value.withUTF8 { utf8 in
+            utf8.withMemoryRebound(to: CChar.self) { ScriptTemplateJSONWriterString(writer, $0.baseAddress, $0.count, doublingBackslashes) }
+        }
+    }
+
+    func bool(_ value: Bool) {
+        ScriptTemplateJSONWriterBool(writer, value)
+    }
+
+    func array(of strings: [String]) {
+        beginArray()
+        strings.forEach { string($0) }
+        endArray()
+    }
+
+}
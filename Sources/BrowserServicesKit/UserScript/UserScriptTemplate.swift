@@ -0,0 +1,113 @@
+//
+//  UserScriptTemplate.swift
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+import Foundation
+import ScriptTemplate
+
+/// JS source tokenized once at its placeholders, so rendering is a single gather copy instead of a `replacingOccurrences` pass per key.
+final class UserScriptTemplate {
+
+    private let handle: OpaquePointer
+    let placeholders: [String]
+
+    private init(handle: OpaquePointer, placeholders: [String]) {
+        self.handle = handle
+        self.placeholders = placeholders
+    }
+
+    /// Templates are cached natively by path and placeholder set, so the file is only read the first time.
+    static func load(path: String, placeholders: [String]) -> UserScriptTemplate? {
+        let placeholders = placeholders.sorted()
+        let handle = withCStrings(placeholders[...]) { pointers in
+            pointers.withUnsafeBufferPointer { buffer in
+                ScriptTemplateLoad(path, buffer.baseAddress, buffer.count)
+            }
+        }
+
+        guard let handle = handle else { return nil }
+        return UserScriptTemplate(handle: handle, placeholders: placeholders)
+    }
+
+    /// Output rendered with a `cacheKey` is returned for later renders with the same key without touching the replacements again.
+    func cachedSource(forKey cacheKey: String) -> String? {
+        guard let output = ScriptTemplateCopyCachedOutput(handle, cacheKey) else { return nil }
+        return Self.consume(output)
+    }
+
+    /// Placeholders found in `payloads` are filled straight from the writer's native buffer.
+    func render(replacements: [String: String],
+                payloads: [String: UserScriptJSONWriter] = [:],
+                cacheKey: String? = nil) -> String {
+        let values = placeholders.map { replacements[$0] ?? $0 }
+        var buffers = [ScriptTemplateValue]()
+        buffers.reserveCapacity(values.count)
+
+        let output = Self.withValueBuffers(values[...], into: &buffers) { buffers -> OpaquePointer? in
+            var buffers = buffers
+            for (index, placeholder) in placeholders.enumerated() {
+                if let payload = payloads[placeholder] {
+                    let value = payload.value
+                    guard value.bytes != nil else {
+                        fatalError("Malformed JSON payload for \(placeholder)")
+                    }
+                    buffers[index] = value
+                }
+            }
+            return buffers.withUnsafeBufferPointer { buffer in
+                if let cacheKey = cacheKey {
+                    return ScriptTemplateRender(handle, buffer.baseAddress, buffer.count, cacheKey)
+                }
+                return ScriptTemplateRender(handle, buffer.baseAddress, buffer.count, nil)
+            }
+        }
+
+        guard let output = output else {
+            fatalError("Failed to render user script template")
+        }
+        return Self.consume(output)
+    }
+
+    private static func consume(_ output: OpaquePointer) -> String {
+        defer { ScriptTemplateOutputRelease(output) }
+        var length = 0
+        let bytes = ScriptTemplateOutputGetBytes(output, &length)
+        return String(decoding: UnsafeRawBufferPointer(start: bytes, count: length), as: UTF8.self)
+    }
+
+    /// Keeps the UTF-8 storage of every value alive while the native renderer reads it.
+    private static func withValueBuffers<Result>(_ values: ArraySlice<String>,
+                                                 into buffers: inout [ScriptTemplateValue],
+                                                 _ body: ([ScriptTemplateValue]) -> Result) -> Result {
+        guard var value = values.first else { return body(buffers) }
+        return value.withUTF8 { utf8 in
+            let bytes = utf8.baseAddress.map { UnsafeRawPointer($0).assumingMemoryBound(to: CChar.self) }
+            buffers.append(ScriptTemplateValue(bytes: bytes, length: utf8.count))
+            return withValueBuffers(values.dropFirst(), into: &buffers, body)
+        }
+    }
+
+    private static func withCStrings<Result>(_ strings: ArraySlice<String>,
+                                             pointers: [UnsafePointer<CChar>?] = [],
+                                             _ body: ([UnsafePointer<CChar>?]) -> Result) -> Result {
+        guard let string = strings.first else { return body(pointers) }
+        return string.withCString { pointer in
+            withCStrings(strings.dropFirst(), pointers: pointers + [pointer], body)
+        }
+    }
+
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdexcept>
+#include "JSONWriter.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+// Forward declarations
+
+static bool needsEscaping(unsigned char byte);
+
+static size_t findNextEscape(const char *bytes, size_t length, size_t from);
+
+
+// Implementation
+
+void JSONWriter::beginObject() {
+    beforeValue();
+    buffer.push_back('{');
+    hasElements.push_back(false);
+}
+
+void JSONWriter::endObject() {
+    if (hasElements.empty() || afterKey) {
+        throw logic_error("Unbalanced JSON object");
+    }
+    hasElements.pop_back();
+    buffer.push_back('}');
+}
+
+void JSONWriter::beginArray() {
+    beforeValue();
+    buffer.push_back('[');
+    hasElements.push_back(false);
+}
+
+void JSONWriter::endArray() {
+    if (hasElements.empty() || afterKey) {
+        throw logic_error("Unbalanced JSON array");
+    }
+    hasElements.pop_back();
+    buffer.push_back(']');
+}
+
+void JSONWriter::key(string_view name) {
+    if (hasElements.empty() || afterKey) {
+        throw logic_error("JSON key outside of an object");
+    }
+    if (hasElements.back()) {
+        buffer.push_back(',');
+    }
+    hasElements.back() = true;
+
+    buffer.push_back('"');
+    appendEscaped(name, Escaping::standard);
+    buffer.append("\":", 2);
+    afterKey = true;
+}
+
+void JSONWriter::string(string_view value, Escaping escaping) {
+    beforeValue();
+    buffer.reserve(buffer.size() + value.size() + 2);
+    buffer.push_back('"');
+    appendEscaped(value, escaping);
+    buffer.push_back('"');
+}
+
+void JSONWriter::boolean(bool value) {
+    beforeValue();
+    buffer.append(value ? "true" : "false");
+}
+
+void JSONWriter::number(int64_t value) {
+    beforeValue();
+    buffer.append(to_string(value));
+}
+
+void JSONWriter::null() {
+    beforeValue();
+    buffer.append("null", 4);
+}
+
+void JSONWriter::reserve(size_t capacity) {
+    buffer.reserve(capacity);
+}
+
+void JSONWriter::clear() {
+    buffer.clear();
+    hasElements.clear();
+    afterKey = false;
+}
+
+const std::string &JSONWriter::getBuffer() const {
+    return buffer;
+}
+
+void JSONWriter::beforeValue() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (hasElements.empty()) {
+        return;
+    }
+    if (hasElements.back()) {
+        buffer.push_back(',');
+    }
+    hasElements.back() = true;
+}
+
+void JSONWriter::appendEscaped(string_view value, Escaping escaping) {
+    static const char *hexDigits = "0123456789abcdef";
+
+    const char *bytes = value.data();
+    size_t length = value.size();
+    size_t runStart = 0;
+
+    while (runStart < length) {
+        size_t escapeIndex = findNextEscape(bytes, length, runStart);
+        buffer.append(bytes + runStart, escapeIndex - runStart);
+        if (escapeIndex == length) {
+            break;
+        }
+
+        auto byte = (unsigned char) bytes[escapeIndex];
+        switch (byte) {
+            case '"': buffer.append("\\\"", 2); break;
+            case '/': buffer.append("\\/", 2); break;
+            case '\n': buffer.append("\\n", 2); break;
+            case '\r': buffer.append("\\r", 2); break;
+            case '\t': buffer.append("\\t", 2); break;
+            case '\b': buffer.append("\\b", 2); break;
+            case '\f': buffer.append("\\f", 2); break;
+            case '\\':
+                if (escaping == Escaping::doubledBackslashes) {
+                    buffer.append("\\\\\\\\", 4);
+                } else {
+                    buffer.append("\\\\", 2);
+                }
+                break;
+            default: {
+                char unicodeEscape[6] = { '\\', 'u', '0', '0', hexDigits[byte >> 4], hexDigits[byte & 0xF] };
+                buffer.append(unicodeEscape, sizeof(unicodeEscape));
+                break;
+            }
+        }
+        runStart = escapeIndex + 1;
+    }
+}
+
+static bool needsEscaping(unsigned char byte) {
+    return byte < 0x20 || byte == '"' || byte == '\\' || byte == '/';
+}
+
+static size_t findNextEscape(const char *bytes, size_t length, size_t from) {
+    size_t index = from;
+
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i controlMax = _mm_set1_epi8(0x1F);
+
+    for (; index + 16 <= length; index += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (bytes + index));
+        // Unsigned chunk <= 0x1F is the same as max(chunk, 0x1F) == 0x1F
+        __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(chunk, slash),
+                                                    _mm_cmpeq_epi8(_mm_max_epu8(chunk, controlMax), controlMax)));
+        int mask = _mm_movemask_epi8(matches);
+        if (mask != 0) {
+            return index + __builtin_ctz((unsigned int) mask);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t slash = vdupq_n_u8('/');
+    const uint8x16_t controlLimit = vdupq_n_u8(0x20);
+
+    for (; index + 16 <= length; index += 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t *) (bytes + index));
+        uint8x16_t matches = vorrq_u8(vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash)),
+                                      vorrq_u8(vceqq_u8(chunk, slash), vcltq_u8(chunk, controlLimit)));
+        if (vmaxvq_u8(matches) != 0) {
+            break;
+        }
+    }
+#endif
+
+    for (; index < length; index++) {
+        if (needsEscaping((unsigned char) bytes[index])) {
+            return index;
+        }
+    }
+    return length;
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include "ScriptTemplate.hpp"
+
+using namespace std;
+
+// Rendered variants kept per template, e.g. one per privacy config identifier
+static const size_t MAX_CACHED_OUTPUTS = 4;
+
+// Forward declarations
+
+static string readFile(const string &path);
+
+static string makeRegistryKey(const string &path, const vector<string> &placeholders);
+
+
+// Implementation
+
+ScriptTemplate::ScriptTemplate(string source, vector<string> placeholders)
+    : source(move(source)), placeholders(move(placeholders)), literalLength(0) {
+    for (const auto &placeholder : this->placeholders) {
+        if (placeholder.empty()) {
+            throw invalid_argument("Placeholder must not be empty");
+        }
+    }
+    tokenize();
+}
+
+shared_ptr<const ScriptTemplate> ScriptTemplate::load(const string &path, const vector<string> &placeholders) {
+    static mutex registryMutex;
+    static map<string, shared_ptr<const ScriptTemplate>> registry;
+
+    auto key = makeRegistryKey(path, placeholders);
+    {
+        lock_guard<mutex> lock(registryMutex);
+        auto existing = registry.find(key);
+        if (existing != registry.end()) {
+            return existing->second;
+        }
+    }
+
+    // Read and tokenize outside the lock; if two threads race, the first one stored wins
+    auto loaded = make_shared<const ScriptTemplate>(readFile(path), placeholders);
+
+    lock_guard<mutex> lock(registryMutex);
+    auto inserted = registry.emplace(key, loaded);
+    return inserted.first->second;
+}
+
+void ScriptTemplate::tokenize() {
+    // Placeholders grouped by their first byte, longest first, so that a
+    // placeholder which is a prefix of another never shadows it
+    vector<size_t> candidates[256];
+    for (size_t i = 0; i < placeholders.size(); i++) {
+        candidates[(unsigned char) placeholders[i][0]].push_back(i);
+    }
+    for (auto &group : candidates) {
+        sort(group.begin(), group.end(), [this](size_t lhs, size_t rhs) {
+            return placeholders[lhs].size() > placeholders[rhs].size();
+        });
+    }
+
+    occurrences.assign(placeholders.size(), 0);
+
+    size_t literalStart = 0;
+    size_t position = 0;
+    while (position < source.size()) {
+        const auto &group = candidates[(unsigned char) source[position]];
+        size_t matched = LITERAL;
+        for (size_t index : group) {
+            const auto &placeholder = placeholders[index];
+            if (source.compare(position, placeholder.size(), placeholder) == 0) {
+                matched = index;
+                break;
+            }
+        }
+
+        if (matched == LITERAL) {
+            position++;
+            continue;
+        }
+
+        if (position > literalStart) {
+            segments.push_back({ literalStart, position - literalStart, LITERAL });
+            literalLength += position - literalStart;
+        }
+        segments.push_back({ position, placeholders[matched].size(), matched });
+        occurrences[matched]++;
+
+        position += placeholders[matched].size();
+        literalStart = position;
+    }
+
+    if (source.size() > literalStart) {
+        segments.push_back({ literalStart, source.size() - literalStart, LITERAL });
+        literalLength += source.size() - literalStart;
+    }
+}
+
+size_t ScriptTemplate::renderedSize(const vector<string_view> &values) const {
+    if (values.size() != placeholders.size()) {
+        throw invalid_argument("Value count does not match placeholder count");
+    }
+
+    size_t size = literalLength;
+    for (size_t i = 0; i < values.size(); i++) {
+        size += occurrences[i] * values[i].size();
+    }
+    return size;
+}
+
+string ScriptTemplate::render(const vector<string_view> &values) const {
+    string output;
+    output.resize(renderedSize(values));
+
+    char *cursor = &output[0];
+    for (const auto &segment : segments) {
+        if (segment.placeholder == LITERAL) {
+            memcpy(cursor, source.data() + segment.offset, segment.length);
+            cursor += segment.length;
+        } else {
+            const auto &value = values[segment.placeholder];
+            if (!value.empty()) {
+                memcpy(cursor, value.data(), value.size());
+            }
+            cursor += value.size();
+        }
+    }
+    return output;
+}
+
+shared_ptr<const string> ScriptTemplate::cachedOutput(const string &cacheKey) const {
+    lock_guard<mutex> lock(cacheMutex);
+    for (auto entry = cache.begin(); entry != cache.end(); entry++) {
+        if (entry->first == cacheKey) {
+            // Move to front so the least recently used variant is evicted first
+            cache.splice(cache.begin(), cache, entry);
+            return cache.front().second;
+        }
+    }
+    return nullptr;
+}
+
+void ScriptTemplate::storeCachedOutput(const string &cacheKey, shared_ptr<const string> output) const {
+    lock_guard<mutex> lock(cacheMutex);
+    cache.remove_if([&cacheKey](const pair<string, shared_ptr<const string>> &entry) {
+        return entry.first == cacheKey;
+    });
+    cache.emplace_front(cacheKey, move(output));
+    if (cache.size() > MAX_CACHED_OUTPUTS) {
+        cache.pop_back();
+    }
+}
+
+const vector<string> &ScriptTemplate::getPlaceholders() const {
+    return placeholders;
+}
+
+size_t ScriptTemplate::getSegmentCount() const {
+    return segments.size();
+}
+
+static string readFile(const string &path) {
+    ifstream in(path, ifstream::binary);
+    if (!in) {
+        throw runtime_error("Unable to read script template at " + path);
+    }
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static string makeRegistryKey(const string &path, const vector<string> &placeholders) {
+    string key = path;
+    for (const auto &placeholder : placeholders) {
+        key.push_back('\0');
+        key.append(placeholder);
+    }
+    return key;
+}
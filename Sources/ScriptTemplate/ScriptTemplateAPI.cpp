@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <exception>
+#include "JSONWriter.hpp"
+#include "ScriptTemplate.h"
+#include "ScriptTemplate.hpp"
+
+using namespace std;
+
+struct ScriptTemplateHandle {
+    shared_ptr<const ScriptTemplate> scriptTemplate;
+};
+
+struct ScriptTemplateOutput {
+    shared_ptr<const string> contents;
+};
+
+struct ScriptTemplateJSONWriter {
+    JSONWriter writer;
+    // Set by the first call that threw, e.g. an unbalanced endObject. Every
+    // later call is ignored and GetValue has nothing to give.
+    bool failed = false;
+};
+
+// Forward declarations
+
+template <typename Write>
+static void writeJSON(ScriptTemplateJSONWriter *writer, Write write);
+
+
+// Implementation
+
+
+const ScriptTemplateHandle *ScriptTemplateLoad(const char *path, const char *const *placeholders, size_t placeholderCount) {
+    try {
+        vector<string> keys(placeholders, placeholders + placeholderCount);
+        auto loaded = ScriptTemplate::load(path, keys);
+
+        // Handles are interned alongside the templates they point to
+        static mutex handlesMutex;
+        static vector<unique_ptr<ScriptTemplateHandle>> handles;
+
+        lock_guard<mutex> lock(handlesMutex);
+        for (const auto &handle : handles) {
+            if (handle->scriptTemplate == loaded) {
+                return handle.get();
+            }
+        }
+        handles.push_back(unique_ptr<ScriptTemplateHandle>(new ScriptTemplateHandle { loaded }));
+        return handles.back().get();
+    } catch (const exception &) {
+        return nullptr;
+    }
+}
+
+ScriptTemplateOutput *ScriptTemplateRender(const ScriptTemplateHandle *scriptTemplate,
+                                           const ScriptTemplateValue *values,
+                                           size_t valueCount,
+                                           const char *cacheKey) {
+    if (scriptTemplate == nullptr) {
+        return nullptr;
+    }
+
+    try {
+        vector<string_view> views;
+        views.reserve(valueCount);
+        for (size_t i = 0; i < valueCount; i++) {
+            views.emplace_back(values[i].bytes, values[i].bytes == nullptr ? 0 : values[i].length);
+        }
+
+        auto contents = make_shared<const string>(scriptTemplate->scriptTemplate->render(views));
+        if (cacheKey != nullptr) {
+            scriptTemplate->scriptTemplate->storeCachedOutput(cacheKey, contents);
+        }
+        return new ScriptTemplateOutput { contents };
+    } catch (const exception &) {
+        return nullptr;
+    }
+}
+
+ScriptTemplateOutput *ScriptTemplateCopyCachedOutput(const ScriptTemplateHandle *scriptTemplate, const char *cacheKey) {
+    if (scriptTemplate == nullptr || cacheKey == nullptr) {
+        return nullptr;
+    }
+
+    auto contents = scriptTemplate->scriptTemplate->cachedOutput(cacheKey);
+    if (contents == nullptr) {
+        return nullptr;
+    }
+    return new ScriptTemplateOutput { contents };
+}
+
+const char *ScriptTemplateOutputGetBytes(const ScriptTemplateOutput *output, size_t *length) {
+    *length = output->contents->size();
+    return output->contents->data();
+}
+
+void ScriptTemplateOutputRelease(ScriptTemplateOutput *output) {
+    delete output;
+}
+
+ScriptTemplateJSONWriter *ScriptTemplateJSONWriterCreate(size_t capacity) {
+    auto writer = new ScriptTemplateJSONWriter();
+    writer->writer.reserve(capacity);
+    return writer;
+}
+
+void ScriptTemplateJSONWriterRelease(ScriptTemplateJSONWriter *writer) {
+    delete writer;
+}
+
+void ScriptTemplateJSONWriterBeginObject(ScriptTemplateJSONWriter *writer) {
+    writeJSON(writer, [](JSONWriter &json) { json.beginObject(); });
+}
+
+void ScriptTemplateJSONWriterEndObject(ScriptTemplateJSONWriter *writer) {
+    writeJSON(writer, [](JSONWriter &json) { json.endObject(); });
+}
+
+void ScriptTemplateJSONWriterBeginArray(ScriptTemplateJSONWriter *writer) {
+    writeJSON(writer, [](JSONWriter &json) { json.beginArray(); });
+}
+
+void ScriptTemplateJSONWriterEndArray(ScriptTemplateJSONWriter *writer) {
+    writeJSON(writer, [](JSONWriter &json) { json.endArray(); });
+}
+
+void ScriptTemplateJSONWriterKey(ScriptTemplateJSONWriter *writer, const char *bytes, size_t length) {
+    writeJSON(writer, [&](JSONWriter &json) { json.key(string_view(bytes, bytes == nullptr ? 0 : length)); });
+}
+
+void ScriptTemplateJSONWriterString(ScriptTemplateJSONWriter *writer, const char *bytes, size_t length, bool doubleBackslashes) {
+    writeJSON(writer, [&](JSONWriter &json) {
+        json.string(string_view(bytes, bytes == nullptr ? 0 : length),
+                    doubleBackslashes ? JSONWriter::Escaping::doubledBackslashes : JSONWriter::Escaping::standard);
+    });
+}
+
+void ScriptTemplateJSONWriterBool(ScriptTemplateJSONWriter *writer, bool value) {
+    writeJSON(writer, [&](JSONWriter &json) { json.boolean(value); });
+}
+
+ScriptTemplateValue ScriptTemplateJSONWriterGetValue(const ScriptTemplateJSONWriter *writer) {
+    if (writer->failed) {
+        return ScriptTemplateValue { nullptr, 0 };
+    }
+    const auto &buffer = writer->writer.getBuffer();
+    return ScriptTemplateValue { buffer.data(), buffer.size() };
+}
+
+template <typename Write>
+static void writeJSON(ScriptTemplateJSONWriter *writer, Write write) {
+    if (writer->failed) {
+        return;
+    }
+    try {
+        write(writer->writer);
+    } catch (const exception &) {
+        writer->failed = true;
+    }
+}
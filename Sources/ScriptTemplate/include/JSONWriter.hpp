@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JSON_WRITER_HPP
+#define JSON_WRITER_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ Streaming JSON writer that appends straight into a byte buffer, used to
+ produce script payloads without going through Encodable and Data. Strings
+ are escaped the way JSONEncoder does by default, including "\/", so the
+ output matches what the Swift side used to inject.
+ */
+class JSONWriter {
+
+public:
+    enum class Escaping {
+        standard,
+        // Every backslash in the value is doubled before it is escaped. Used for
+        // payloads that pass through a JS template literal before JSON.parse.
+        doubledBackslashes
+    };
+
+    void beginObject();
+
+    void endObject();
+
+    void beginArray();
+
+    void endArray();
+
+    void key(std::string_view name);
+
+    void string(std::string_view value, Escaping escaping = Escaping::standard);
+
+    void boolean(bool value);
+
+    void number(int64_t value);
+
+    void null();
+
+    void reserve(size_t capacity);
+
+    void clear();
+
+    const std::string &getBuffer() const;
+
+private:
+    void beforeValue();
+
+    void appendEscaped(std::string_view value, Escaping escaping);
+
+    std::string buffer;
+    // One entry per open container; true once it holds at least one element
+    std::vector<bool> hasElements;
+    bool afterKey = false;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCRIPT_TEMPLATE_H
+#define SCRIPT_TEMPLATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ScriptTemplateHandle ScriptTemplateHandle;
+typedef struct ScriptTemplateOutput ScriptTemplateOutput;
+typedef struct ScriptTemplateJSONWriter ScriptTemplateJSONWriter;
+
+typedef struct {
+    const char *bytes;
+    size_t length;
+} ScriptTemplateValue;
+
+/*
+ Returns the template for the file at `path` tokenized at the given
+ placeholders, loading it on first use. Templates live for the rest of the
+ process and must not be freed. Returns NULL if the file can't be read.
+ */
+const ScriptTemplateHandle *ScriptTemplateLoad(const char *path, const char *const *placeholders, size_t placeholderCount);
+
+/*
+ Renders the template. `values` must be ordered like the placeholders passed to
+ ScriptTemplateLoad and only need to stay valid for the duration of the call.
+ When `cacheKey` is not NULL the result is remembered under that key.
+ */
+ScriptTemplateOutput *ScriptTemplateRender(const ScriptTemplateHandle *scriptTemplate,
+                                           const ScriptTemplateValue *values,
+                                           size_t valueCount,
+                                           const char *cacheKey);
+
+// Returns the output previously rendered under `cacheKey`, or NULL.
+ScriptTemplateOutput *ScriptTemplateCopyCachedOutput(const ScriptTemplateHandle *scriptTemplate, const char *cacheKey);
+
+const char *ScriptTemplateOutputGetBytes(const ScriptTemplateOutput *output, size_t *length);
+
+void ScriptTemplateOutputRelease(ScriptTemplateOutput *output);
+
+/*
+ JSON payloads are written into a native buffer that ScriptTemplateRender can
+ gather from directly, via ScriptTemplateJSONWriterGetValue.
+ */
+ScriptTemplateJSONWriter *ScriptTemplateJSONWriterCreate(size_t capacity);
+
+void ScriptTemplateJSONWriterRelease(ScriptTemplateJSONWriter *writer);
+
+void ScriptTemplateJSONWriterBeginObject(ScriptTemplateJSONWriter *writer);
+
+void ScriptTemplateJSONWriterEndObject(ScriptTemplateJSONWriter *writer);
+
+void ScriptTemplateJSONWriterBeginArray(ScriptTemplateJSONWriter *writer);
+
+void ScriptTemplateJSONWriterEndArray(ScriptTemplateJSONWriter *writer);
+
+void ScriptTemplateJSONWriterKey(ScriptTemplateJSONWriter *writer, const char *bytes, size_t length);
+
+void ScriptTemplateJSONWriterString(ScriptTemplateJSONWriter *writer, const char *bytes, size_t length, bool doubleBackslashes);
+
+void ScriptTemplateJSONWriterBool(ScriptTemplateJSONWriter *writer, bool value);
+
+// The value stays valid until the writer is modified or released. Its bytes
+// are NULL once a call failed, e.g. an endObject without a matching
+// beginObject; the writer ignores every call after that.
+ScriptTemplateValue ScriptTemplateJSONWriterGetValue(const ScriptTemplateJSONWriter *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
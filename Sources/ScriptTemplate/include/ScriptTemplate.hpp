@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2022 DuckDuckGo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCRIPT_TEMPLATE_HPP
+#define SCRIPT_TEMPLATE_HPP
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ User script source split once at placeholder boundaries. Rendering sizes the
+ output up front and gathers literal and value segments into it in a single
+ pass, so a render costs one allocation regardless of how many placeholders
+ the script has. Values are never rescanned for placeholders.
+ */
+class ScriptTemplate {
+
+public:
+    ScriptTemplate(std::string source, std::vector<std::string> placeholders);
+
+    ScriptTemplate(const ScriptTemplate &) = delete;
+
+    ScriptTemplate &operator=(const ScriptTemplate &) = delete;
+
+    // Loads and tokenizes the file on first use; later calls with the same
+    // path and placeholders return the same instance. Throws if the file can't be read.
+    static std::shared_ptr<const ScriptTemplate> load(const std::string &path, const std::vector<std::string> &placeholders);
+
+    // `values` is indexed like the placeholders passed at construction.
+    std::string render(const std::vector<std::string_view> &values) const;
+
+    size_t renderedSize(const std::vector<std::string_view> &values) const;
+
+    std::shared_ptr<const std::string> cachedOutput(const std::string &cacheKey) const;
+
+    void storeCachedOutput(const std::string &cacheKey, std::shared_ptr<const std::string> output) const;
+
+    const std::vector<std::string> &getPlaceholders() const;
+
+    size_t getSegmentCount() const;
+
+private:
+    static const size_t LITERAL = (size_t) -1;
+
+    struct Segment {
+        size_t offset;
+        size_t length;
+        size_t placeholder;
+    };
+
+    void tokenize();
+
+    std::string source;
+    std::vector<std::string> placeholders;
+    std::vector<Segment> segments;
+    std::vector<size_t> occurrences;
+    size_t literalLength;
+
+    mutable std::mutex cacheMutex;
+    mutable std::list<std::pair<std::string, std::shared_ptr<const std::string>>> cache;
+};
+
+#endif
@@ -0,0 +1,60 @@
+//
+//  TrackerAllowlistMatcherTests.swift
+//  DuckDuckGo
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+import XCTest
+import BrowserServicesKit
+
+final class TrackerAllowlistMatcherTests: XCTestCase {
+
+    private let matcher = TrackerAllowlistMatcher()
+
+    private func makeConfig(identifier: String,
+                            allowlist: PrivacyConfigurationData.TrackerAllowlistData) -> PrivacyConfiguration {
+        let data = PrivacyConfigurationData(features: [:], unprotectedTemporary: [], trackerAllowlist: allowlist)
+        return AppPrivacyConfiguration(data: data, identifier: identifier, localProtection: MockDomainsProtectionStore())
+    }
+
+    func testWhenRuleMatchesOnListedSiteThenRequestIsAllowlisted() {
+        let config = makeConfig(identifier: "1", allowlist: [
+            "tracker.com": [.init(rule: "tracker.com/scripts/*.js", domains: ["site.com"])]
+        ])
+
+        XCTAssertTrue(matcher.isAllowlisted(trackerURL: "https://cdn.tracker.com/scripts/a.js", siteHost: "www.site.com", privacyConfig: config))
+        XCTAssertFalse(matcher.isAllowlisted(trackerURL: "https://cdn.tracker.com/images/a.png", siteHost: "site.com", privacyConfig: config))
+        XCTAssertFalse(matcher.isAllowlisted(trackerURL: "https://tracker.com/scripts/a.js", siteHost: "other.com", privacyConfig: config))
+    }
+
+    func testWhenFirstMatchingRuleDoesNotCoverSiteThenLaterRulesAreNotConsulted() {
+        let config = makeConfig(identifier: "1", allowlist: [
+            "tracker.com": [.init(rule: "tracker.com/", domains: ["site.com"]),
+                            .init(rule: "tracker.com/a.js", domains: ["<all>"])]
+        ])
+
+        XCTAssertFalse(matcher.isAllowlisted(trackerURL: "https://tracker.com/a.js", siteHost: "other.com", privacyConfig: config))
+    }
+
+    func testWhenConfigIdentifierChangesThenRulesAreRecompiled() {
+        let first = makeConfig(identifier: "1", allowlist: ["tracker.com": [.init(rule: "tracker.com/", domains: ["<all>"])]])
+        let second = makeConfig(identifier: "2", allowlist: [:])
+
+        XCTAssertTrue(matcher.isAllowlisted(trackerURL: "https://tracker.com/a.js", siteHost: "site.com", privacyConfig: first))
+        XCTAssertFalse(matcher.isAllowlisted(trackerURL: "https://tracker.com/a.js", siteHost: "site.com", privacyConfig: second))
+    }
+
+}
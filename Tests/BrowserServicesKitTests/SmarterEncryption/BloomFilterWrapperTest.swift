@@ -42,6 +42,15 @@ class BloomFilterWrapperTest: XCTestCase {
         XCTAssertTrue(testee.contains("abc"))
     }
     
+    func testWhenParentDomainIsContainedThenLongestContainedSuffixIsReturned() {
+        let testee = BloomFilterWrapper(totalItems: Int32(Constants.filterElementCount), errorRate: Constants.targetErrorRate)!
+        testee.add("example.com")
+        testee.add("static.example.com")
+        XCTAssertEqual(testee.longestContainedSuffixOf("cdn.static.example.com"), "static.example.com")
+        XCTAssertEqual(testee.longestContainedSuffixOf("www.example.com"), "example.com")
+        XCTAssertNil(testee.longestContainedSuffixOf("example.org"))
+    }
+    
     func testWhenBloomFilterContainsItemsThenLookupResultsAreWithinRange() {
         let bloomData = createRandomStrings(count: Constants.filterElementCount)
         let testData = bloomData + createRandomStrings(count: Constants.additionalTestDataElementCount)
@@ -65,6 +74,47 @@ class BloomFilterWrapperTest: XCTestCase {
         XCTAssertTrue(errorRate <= Constants.acceptableErrorRate)
     }
     
+    func testWhenBloomFilterFilledToCapacityThenItIsValidForItsErrorRate() {
+        let testee = BloomFilterWrapper(totalItems: Int32(Constants.filterElementCount), errorRate: Constants.targetErrorRate)!
+        createRandomStrings(count: Constants.filterElementCount).forEach { testee.add($0) }
+
+        XCTAssertEqual(testee.fillRatio, 0.5, accuracy: 0.05)
+        XCTAssertEqual(testee.estimatedItemCount, Double(Constants.filterElementCount), accuracy: Double(Constants.filterElementCount) * 0.1)
+        XCTAssertTrue(testee.isValid(forErrorRate: Constants.targetErrorRate))
+    }
+
+    func testWhenBloomFilterOverfilledThenItIsNotValidForItsErrorRate() {
+        let testee = BloomFilterWrapper(totalItems: Int32(Constants.filterElementCount), errorRate: Constants.targetErrorRate)!
+        createRandomStrings(count: Constants.filterElementCount * 4).forEach { testee.add($0) }
+
+        XCTAssertGreaterThan(testee.estimatedFalsePositiveRate, Constants.targetErrorRate * 2)
+        XCTAssertFalse(testee.isValid(forErrorRate: Constants.targetErrorRate))
+    }
+
+    func testWhenBloomFilterFileIsTruncatedThenItIsRejected() throws {
+        let path = NSTemporaryDirectory() + "truncated_bloom_filter.bin"
+        try Data(repeating: 0xff, count: 16).write(to: URL(fileURLWithPath: path))
+        defer { try? FileManager.default.removeItem(atPath: path) }
+
+        XCTAssertNil(BloomFilterWrapper(fromPath: path, withBitCount: 1024, andTotalItems: 100))
+    }
+
+    func testWhenMetricsEnabledThenLookupsAndPositivesAreCounted() {
+        let testee = BloomFilterWrapper(totalItems: Int32(Constants.filterElementCount), errorRate: Constants.targetErrorRate)!
+        testee.add("abc")
+
+        BloomFilterWrapper.setMetricsEnabled(true)
+        defer { BloomFilterWrapper.setMetricsEnabled(false) }
+        let before = BloomFilterWrapper.metricsSnapshot()
+
+        XCTAssertTrue(testee.contains("abc"))
+        XCTAssertFalse(testee.contains("def"))
+
+        let after = BloomFilterWrapper.metricsSnapshot()
+        XCTAssertEqual(after["lookups"]!.intValue - before["lookups"]!.intValue, 2)
+        XCTAssertEqual(after["positives"]!.intValue - before["positives"]!.intValue, 1)
+    }
+
     private func createRandomStrings(count: Int) -> [String] {
         var list = [String]()
         for _ in 0..<count {
@@ -0,0 +1,106 @@
+//
+//  HTTPSUpgradeEngineTests.swift
+//  DuckDuckGo
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+import XCTest
+@testable import BloomFilterWrapper
+
+final class HTTPSUpgradeEngineTests: XCTestCase {
+
+    private var engine: OpaquePointer!
+
+    override func setUp() {
+        super.setUp()
+        let filter = BloomFilterWrapper(totalItems: 100, errorRate: 0.0001)
+        ["example.com", "www.example.com", "excluded.com", "broken.example.org"].forEach { filter.add($0) }
+
+        engine = HTTPSUpgradeEngineCreate(16)
+        withCStrings(["excluded.com"]) { HTTPSUpgradeEngineSetUpgradeList(engine, filter, $0, $1) }
+        withCStrings(["example.org"]) { exceptions, exceptionCount in
+            withCStrings(["www.example.com"]) { unprotected, unprotectedCount in
+                HTTPSUpgradeEngineSetFeatureState(engine, true, exceptions, exceptionCount, unprotected, unprotectedCount)
+            }
+        }
+    }
+
+    override func tearDown() {
+        HTTPSUpgradeEngineRelease(engine)
+        super.tearDown()
+    }
+
+    func testWhenHostIsInUpgradeListThenURLIsRewrittenToHTTPS() {
+        let result = decide("http://user@EXAMPLE.com:8080/path?query=1#fragment")
+        XCTAssertEqual(result.verdict, .upgrade)
+        XCTAssertEqual(result.url, "https://user@EXAMPLE.com:8080/path?query=1#fragment")
+    }
+
+    func testWhenHostIsExcludedThenURLIsNotUpgraded() {
+        XCTAssertEqual(decide("http://excluded.com/").verdict, .excluded)
+    }
+
+    func testWhenParentDomainIsAnExceptionThenSubdomainIsNotUpgraded() {
+        XCTAssertEqual(decide("http://broken.example.org/").verdict, .featureDisabled)
+    }
+
+    func testWhenDomainIsUnprotectedThenOnlyThatDomainIsNotUpgraded() {
+        XCTAssertEqual(decide("http://www.example.com/").verdict, .featureDisabled)
+        XCTAssertEqual(decide("http://example.com/").verdict, .upgrade)
+    }
+
+    func testWhenURLIsNotHTTPThenItIsNotUpgraded() {
+        XCTAssertEqual(decide("https://example.com/").verdict, .notHTTP)
+        XCTAssertEqual(decide("ftp://example.com/").verdict, .notHTTP)
+        XCTAssertEqual(decide("http:///path").verdict, .invalidHost)
+    }
+
+    func testWhenHostIsDecidedTwiceThenSecondDecisionIsCached() {
+        _ = decide("http://example.com/")
+        _ = decide("http://example.com/other")
+
+        var hits: UInt64 = 0
+        var misses: UInt64 = 0
+        HTTPSUpgradeEngineGetCacheStats(engine, &hits, &misses)
+        XCTAssertEqual(hits, 1)
+        XCTAssertEqual(misses, 1)
+    }
+
+    func testWhenUpgradeFailedThenHostIsNotUpgradedUntilFailuresAreForgotten() {
+        XCTAssertTrue(HTTPSUpgradeEngineSetFailureMemory(engine, 100, 60))
+        XCTAssertTrue(HTTPSUpgradeEngineRecordUpgradeFailure(engine, "Example.com", 11))
+        XCTAssertEqual(decide("http://example.com/").verdict, .recentlyFailed)
+        XCTAssertEqual(decide("http://excluded.com/").verdict, .excluded)
+
+        XCTAssertTrue(HTTPSUpgradeEngineSetFailureMemory(engine, 0, 0))
+        XCTAssertEqual(decide("http://example.com/").verdict, .upgrade)
+    }
+
+    private func decide(_ url: String) -> (verdict: HTTPSUpgradeEngineVerdict, url: String?) {
+        let bytes = Array(url.utf8CString)
+        var output = [CChar](repeating: 0, count: bytes.count + 1)
+        var outputLength = 0
+        let verdict = HTTPSUpgradeEngineDecide(engine, bytes, bytes.count - 1, &output, output.count, &outputLength)
+        return (verdict, verdict == .upgrade ? String(cString: output) : nil)
+    }
+
+    private func withCStrings(_ strings: [String], _ body: (UnsafePointer<UnsafePointer<CChar>>?, Int) -> Void) {
+        let cStrings = strings.map { UnsafePointer(strdup($0)!) }
+        defer { cStrings.forEach { free(UnsafeMutablePointer(mutating: $0)) } }
+        cStrings.withUnsafeBufferPointer { body($0.baseAddress, $0.count) }
+    }
+
+}
@@ -166,4 +166,20 @@ final class HTTPSUpgradeReferenceTests: XCTestCase {
         XCTAssertEqual(resultURL.absoluteString, url.toHttps()?.absoluteString, "FAILED: \(resultURL)")
     }
 
+    func testReportedUpgradeFailureStopsUpgradingHost() async {
+        let httpsUpgrade = HTTPSUpgrade(store: mockStore, privacyManager: makePrivacyManager(config: nil, unprotectedDomains: []))
+        httpsUpgrade.loadData()
+        
+        let url = URL(string: "http://secure.thirdtest.com")!
+        if case .failure = await httpsUpgrade.upgrade(url: url) {
+            XCTFail("Expected \(url) to upgrade before any failure was reported")
+        }
+        
+        httpsUpgrade.reportUpgradeFailure(for: url.toHttps()!)
+        
+        if case let .success(upgradedURL) = await httpsUpgrade.upgrade(url: url) {
+            XCTFail("Expected \(url) not to upgrade after a failure, got \(upgradedURL)")
+        }
+    }
+
 }
@@ -30,4 +30,6 @@ struct HTTPSUpgradeStoreMock: HTTPSUpgradeStore {
         excludedDomains.contains(domain)
     }
     
+    var allExcludedDomains: [String]? { excludedDomains }
+    
 }
@@ -0,0 +1,69 @@
+//
+//  UserScriptJSONWriterTests.swift
+//
+//  Copyright © 2022 DuckDuckGo. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+import XCTest
+@testable import BrowserServicesKit
+
+final class UserScriptJSONWriterTests: XCTestCase {
+
+    func testWhenStringsAreWrittenThenOutputMatchesJSONEncoder() throws {
+        let strings = ["plain", "quote\"d", "back\\slash", "sl/ash", "new\nline\ttab", "ünïcødé", String(repeating: "long/\"", count: 20)]
+
+        let writer = UserScriptJSONWriter()
+        writer.array(of: strings)
+
+        let expected = try XCTUnwrap(String(data: JSONEncoder().encode(strings), encoding: .utf8))
+        XCTAssertEqual(writer.json, expected)
+    }
+
+    func testWhenObjectIsWrittenThenElementsAreSeparated() {
+        let writer = UserScriptJSONWriter()
+        writer.beginObject()
+        writer.key("a")
+        writer.bool(true)
+        writer.key("b")
+        writer.array(of: ["x", "y"])
+        writer.key("c")
+        writer.beginObject()
+        writer.endObject()
+        writer.endObject()
+
+        XCTAssertEqual(writer.json, #"{"a":true,"b":["x","y"],"c":{}}"#)
+    }
+
+    func testWhenBackslashesAreDoubledThenEachIsWrittenFourTimes() {
+        let writer = UserScriptJSONWriter()
+        writer.string(#"a\.b"#, doublingBackslashes: true)
+
+        XCTAssertEqual(writer.json, #""a\\\\.b""#)
+    }
+
+    func testWhenAllowlistIsPreparedThenItDecodesToRegexpRules() throws {
+        let allowlist: PrivacyConfigurationData.TrackerAllowlistData = [
+            "tracker.com": [.init(rule: "tracker.com/script.js", domains: ["example.com", "<all>"])]
+        ]
+
+        let json = TrackerAllowlistInjection.prepareForInjection(allowlist: allowlist)
+        let decoded = try XCTUnwrap(JSONSerialization.jsonObject(with: Data(json.utf8)) as? [String: [[String: Any]]])
+
+        let entry = try XCTUnwrap(decoded["tracker.com"]?.first)
+        XCTAssertEqual(entry["domains"] as? [String], ["example.com", "<all>"])
+        XCTAssertNotNil(entry["rule"] as? String)
+    }
+
+}
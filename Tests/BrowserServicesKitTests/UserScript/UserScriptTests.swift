@@ -61,4 +61,23 @@ class UserScriptTests: XCTestCase {
         XCTAssertEqual(script.isForMainFrameOnly, false)
     }
 
+    func testWhenReplacementContainsPlaceholderThenItIsNotSubstitutedAgain() {
+        let source = TestUserScript.loadJS("testUserScript", from: .module, withReplacements: ["${val}": "${val}${val}"])
+        XCTAssertEqual(source, "var val = '${val}${val}';\n")
+    }
+
+    func testWhenTemplateIsRenderedRepeatedlyThenEachRenderUsesItsOwnValues() {
+        XCTAssertEqual(TestUserScript.loadJS("testUserScript", from: .module, withReplacements: ["${val}": "first"]), "var val = 'first';\n")
+        XCTAssertEqual(TestUserScript.loadJS("testUserScript", from: .module, withReplacements: ["${val}": "second"]), "var val = 'second';\n")
+    }
+
+    func testWhenOutputIsCachedThenItIsReturnedForTheSameKey() {
+        let template = TestUserScript.loadJSTemplate("testUserScript", from: .module, placeholders: ["${val}"])
+        XCTAssertNil(template.cachedSource(forKey: "testWhenOutputIsCachedThenItIsReturnedForTheSameKey"))
+
+        let source = template.render(replacements: ["${val}": "cached"], cacheKey: "testWhenOutputIsCachedThenItIsReturnedForTheSameKey")
+        XCTAssertEqual(template.cachedSource(forKey: "testWhenOutputIsCachedThenItIsReturnedForTheSameKey"), source)
+        XCTAssertNil(template.cachedSource(forKey: "unknown"))
+    }
+
 }